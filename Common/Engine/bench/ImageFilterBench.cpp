@@ -0,0 +1,116 @@
+﻿#include "ImageFilter.h"
+#include "ImageFilterCpu.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ExecuteImageFilterPlanCpu のスレッド数ごとの処理速度を、チェインとオプションの組み合わせごとに測るベンチマーク.
+//   ImageFilterBench [チェイン ...]
+// チェインの形式は ParseImageFilterChain と同じ. 指定が無い場合は代表的なチェインを使う.
+// 画像はグラデーションにノイズを加えた 2048x2048 の RGBA8.
+namespace
+{
+  const uint32_t ImageWidth = 2048;
+  const uint32_t ImageHeight = 2048;
+
+  std::vector<uint8_t> MakeSyntheticImage()
+  {
+    std::vector<uint8_t> pixels(size_t(ImageWidth) * ImageHeight * 4);
+    std::mt19937 random(1);
+    for (uint32_t y = 0; y < ImageHeight; ++y)
+    {
+      for (uint32_t x = 0; x < ImageWidth; ++x)
+      {
+        uint8_t* texel = &pixels[(size_t(y) * ImageWidth + x) * 4];
+        const uint32_t noise = random() & 15;
+        texel[0] = uint8_t(x * 255 / ImageWidth + noise);
+        texel[1] = uint8_t(y * 255 / ImageHeight + noise);
+        texel[2] = uint8_t((x + y) * 7);
+        texel[3] = 255;
+      }
+    }
+    return pixels;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<std::string> chains(argv + 1, argv + argc);
+  if (chains.empty())
+  {
+    chains = {
+      "sepia,hue:0.2,tonemap:0.5:1",
+      "blur:4:2",
+      "blur:16:6",
+      "sharpen:0.5",
+      "blur:3,matrix:0.1:1.3:0.8,sharpen:0.5,hue:0.2",
+    };
+  }
+
+  auto pixels = MakeSyntheticImage();
+  std::vector<uint8_t> result(pixels.size());
+  const ImageFilterSurface source = {
+    .format = ImageFilterPixelFormat::RGBA8,
+    .width = ImageWidth,
+    .height = ImageHeight,
+    .rowPitch = size_t(ImageWidth) * 4,
+    .data = pixels.data(),
+  };
+  ImageFilterSurface destination = source;
+  destination.data = result.data();
+
+  const uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<uint32_t> threadCounts;
+  for (uint32_t count = 1; count < hardwareThreads; count *= 2)
+  {
+    threadCounts.push_back(count);
+  }
+  threadCounts.push_back(hardwareThreads);
+
+  // BenchmarkImageFilterCpu は maxThreadCount で使うスレッドを絞るため、ワーカーは最大数で1回だけ作る.
+  // 発行元スレッドも処理に加わるため、ワーカーは1つ少なくする.
+  auto& jobSystem = GetJobSystem();
+  if (hardwareThreads > 1)
+  {
+    jobSystem->Initialize(hardwareThreads - 1);
+  }
+
+  printf("image: %ux%u RGBA8\n", ImageWidth, ImageHeight);
+  printf("%-48s  %-10s  threads  passes      ms  MPix/s  speedup\n", "chain", "options");
+  for (const auto& text : chains)
+  {
+    std::vector<ImageFilterNode> chain;
+    if (!ParseImageFilterChain(text, chain))
+    {
+      fprintf(stderr, "invalid chain: %s\n", text.c_str());
+      continue;
+    }
+    const struct
+    {
+      const char* name;
+      ImageFilterPlanOptions options;
+    } variants[] = {
+      { "default", { } },
+      { "transposed", { .transposedBlur = true } },
+      { "lut32", { .colorLutSize = 32 } },
+    };
+    for (const auto& variant : variants)
+    {
+      auto plan = PlanImageFilterChain(chain, variant.options);
+      BakeImageFilterColorLuts(plan);
+      const auto results = BenchmarkImageFilterCpu(plan, source, destination, threadCounts, 5);
+      for (const auto& stats : results)
+      {
+        printf("%-48s  %-10s  %7u  %6zu  %6.2f  %6.1f  %6.2fx\n", text.c_str(), variant.name, stats.threadCount,
+          plan.passes.size(), stats.elapsedMs, stats.GetMegaPixelsPerSecond(), results.front().elapsedMs / stats.elapsedMs);
+      }
+    }
+  }
+  jobSystem->Shutdown();
+  return 0;
+}
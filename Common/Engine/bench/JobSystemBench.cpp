@@ -0,0 +1,120 @@
+﻿#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// DrawModel の描画リストの分割記録(MakeCommandLists)を模したベンチマーク.
+// 描画ごとにワールド行列を計算してコマンド(定数とインデックス範囲)をチャンクごとのリストへ書き出す.
+// チャンクの分け方は MakeCommandLists と同じく first = index * drawCount / chunkCount とする.
+//   JobSystemBench [描画数]
+namespace
+{
+  struct DrawCommand
+  {
+    float world[16];
+    uint32_t materialIndex;
+    uint32_t indexCount;
+    uint32_t startIndex;
+    uint32_t baseVertex;
+  };
+
+  void RecordDraw(uint32_t drawIndex, std::vector<DrawCommand>& commandList)
+  {
+    // 行列の計算とコマンドの書き込みで、1描画あたりの記録の負荷を模す.
+    DrawCommand command{};
+    const float angle = float(drawIndex) * 0.001f;
+    float rotation[16] = {
+      std::cos(angle), 0, -std::sin(angle), 0,
+      0, 1, 0, 0,
+      std::sin(angle), 0, std::cos(angle), 0,
+      float(drawIndex % 100), 0, float(drawIndex / 100), 1,
+    };
+    for (int i = 0; i < 4; ++i)
+    {
+      for (int j = 0; j < 4; ++j)
+      {
+        float sum = 0;
+        for (int k = 0; k < 4; ++k)
+        {
+          sum += rotation[i * 4 + k] * rotation[k * 4 + j];
+        }
+        command.world[i * 4 + j] = sum;
+      }
+    }
+    command.materialIndex = drawIndex % 64;
+    command.indexCount = 36 + drawIndex % 7;
+    command.startIndex = drawIndex * 36;
+    commandList.push_back(command);
+  }
+
+  double MeasureFrame(JobSystem& jobSystem, uint32_t drawCount, uint32_t drawsPerChunk, uint32_t frameCount)
+  {
+    const uint32_t chunkCount = std::max(1u, (drawCount + drawsPerChunk - 1) / drawsPerChunk);
+    std::vector<std::vector<DrawCommand>> commandLists(chunkCount);
+    double bestMs = 1e30;
+    for (uint32_t frame = 0; frame < frameCount; ++frame)
+    {
+      auto start = std::chrono::high_resolution_clock::now();
+      jobSystem.Dispatch(chunkCount, [&](uint32_t chunkIndex, uint32_t) {
+        auto& commandList = commandLists[chunkIndex];
+        commandList.clear();
+        const uint32_t first = uint32_t(uint64_t(chunkIndex) * drawCount / chunkCount);
+        const uint32_t last = uint32_t(uint64_t(chunkIndex + 1) * drawCount / chunkCount);
+        for (uint32_t i = first; i < last; ++i)
+        {
+          RecordDraw(i, commandList);
+        }
+      });
+      auto end = std::chrono::high_resolution_clock::now();
+      bestMs = std::min(bestMs, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return bestMs;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  const uint32_t drawCount = argc > 1 ? uint32_t(strtoul(argv[1], nullptr, 10)) : 20000;
+  const uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<uint32_t> threadCounts;
+  for (uint32_t count = 1; count < hardwareThreads; count *= 2)
+  {
+    threadCounts.push_back(count);
+  }
+  threadCounts.push_back(hardwareThreads);
+
+  printf("draws: %u, hardware threads: %u (best of 20 frames)\n", drawCount, hardwareThreads);
+  printf("threads  draws/chunk  record ms  speedup\n");
+  for (uint32_t drawsPerChunk : { 64u, 256u, 1024u })
+  {
+    double baseMs = 0;
+    for (uint32_t threadCount : threadCounts)
+    {
+      // 発行元スレッドも処理に加わるため、ワーカーは1つ少なくする. 1スレッドはワーカー無し(その場で処理).
+      JobSystem jobSystem;
+      if (threadCount > 1)
+      {
+        jobSystem.Initialize(threadCount - 1);
+      }
+      const double ms = MeasureFrame(jobSystem, drawCount, drawsPerChunk, 20);
+      baseMs = threadCount == 1 ? ms : baseMs;
+      printf("%7u  %11u  %9.3f  %6.2fx\n", threadCount, drawsPerChunk, ms, baseMs / ms);
+    }
+  }
+
+  // 空のジョブでの発行と完了待ちのオーバーヘッド.
+  JobSystem jobSystem;
+  jobSystem.Initialize(std::max(1u, hardwareThreads - 1));
+  const uint32_t emptyJobCount = 200000;
+  auto start = std::chrono::high_resolution_clock::now();
+  jobSystem.Dispatch(emptyJobCount, [](uint32_t, uint32_t) {});
+  auto end = std::chrono::high_resolution_clock::now();
+  const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+  printf("empty jobs: %u in %.2f ms (%.2f Mjobs/s, %u threads)\n", emptyJobCount, ms, emptyJobCount / (ms * 1000.0), jobSystem.GetThreadCount());
+  return 0;
+}
@@ -0,0 +1,134 @@
+﻿#include "ImageBatch.h"
+#include "JobSystem.h"
+#include "PngFile.h"
+#include "TextureDecode.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <vector>
+
+// DrawModel の PrepareModelData と同じく、画像ファイルの展開とミップマップ作成を DecodeImages で並列に行うベンチマーク.
+// ファイルの読み込みは最初に1回だけ行い、スレッド数ごとに展開とミップマップ作成の速度を測る.
+//   TextureDecodeBench [画像ファイルかディレクトリ ...]
+// 指定が無い場合は、グラデーションにノイズを加えた PNG をメモリ上に作成して使う.
+namespace
+{
+  std::vector<std::vector<uint8_t>> MakeSyntheticFiles()
+  {
+    const uint32_t sizes[][2] = { { 1024, 1024 }, { 2048, 1024 }, { 512, 512 }, { 768, 1280 }, { 256, 256 }, { 1000, 600 } };
+    std::vector<std::vector<uint8_t>> files;
+    std::mt19937 random(1);
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      const auto& size = sizes[i % std::size(sizes)];
+      DecodedImage image;
+      image.Allocate(size[0], size[1], 1);
+      for (uint32_t y = 0; y < size[1]; ++y)
+      {
+        uint8_t* row = image.GetLevelData(0) + size_t(image.mipLevels[0].rowPitch) * y;
+        for (uint32_t x = 0; x < size[0]; ++x)
+        {
+          const uint32_t noise = random() & 15;
+          row[x * 4 + 0] = uint8_t(x * 255 / size[0] + noise);
+          row[x * 4 + 1] = uint8_t(y * 255 / size[1] + noise);
+          row[x * 4 + 2] = uint8_t((x + y) * 7 + i * 16);
+          row[x * 4 + 3] = 255;
+        }
+      }
+      std::vector<uint8_t> buffer;
+      if (EncodePNG(image, buffer))
+      {
+        files.push_back(std::move(buffer));
+      }
+    }
+    return files;
+  }
+
+  std::vector<std::vector<uint8_t>> ReadFiles(const std::vector<std::filesystem::path>& inputs)
+  {
+    std::vector<std::vector<uint8_t>> files;
+    for (const auto& entry : CollectImageBatchEntries(inputs))
+    {
+      std::ifstream file(entry.input, std::ios::binary);
+      std::vector<uint8_t> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+      if (!buffer.empty())
+      {
+        files.push_back(std::move(buffer));
+      }
+    }
+    return files;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<std::filesystem::path> inputs(argv + 1, argv + argc);
+  auto readStart = std::chrono::high_resolution_clock::now();
+  const auto files = inputs.empty() ? MakeSyntheticFiles() : ReadFiles(inputs);
+  auto readEnd = std::chrono::high_resolution_clock::now();
+  if (files.empty())
+  {
+    fprintf(stderr, "no image files.\n");
+    return 1;
+  }
+  size_t totalBytes = 0;
+  for (const auto& file : files)
+  {
+    totalBytes += file.size();
+  }
+  printf("files: %zu (%.1f MB, %s %.1f ms)\n", files.size(), totalBytes / (1024.0 * 1024.0),
+    inputs.empty() ? "encoded in" : "read in", std::chrono::duration<double, std::milli>(readEnd - readStart).count());
+
+  const uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<uint32_t> threadCounts;
+  for (uint32_t count = 1; count < hardwareThreads; count *= 2)
+  {
+    threadCounts.push_back(count);
+  }
+  threadCounts.push_back(hardwareThreads);
+
+  printf("threads  mips  decode ms  MPix/s  speedup\n");
+  for (bool generateMips : { false, true })
+  {
+    double baseMs = 0;
+    for (uint32_t threadCount : threadCounts)
+    {
+      // DecodeImages はエンジン共通のジョブシステムを使うため、スレッド数を変えて作り直す.
+      // 発行元スレッドも処理に加わるため、ワーカーは1つ少なくする. 1スレッドはワーカー無し(その場で処理).
+      auto& jobSystem = GetJobSystem();
+      jobSystem->Shutdown();
+      if (threadCount > 1)
+      {
+        jobSystem->Initialize(threadCount - 1);
+      }
+
+      // 3回のうち最も速いものを使う.
+      TextureDecodeStats best;
+      for (int iteration = 0; iteration < 3; ++iteration)
+      {
+        std::vector<TextureDecodeRequest> requests(files.size());
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+          requests[i].srcBuffer = files[i].data();
+          requests[i].bufferSize = files[i].size();
+          requests[i].generateMips = generateMips;
+          requests[i].mipOptions.srgb = true;
+        }
+        const auto stats = DecodeImages(requests);
+        if (iteration == 0 || stats.decodeMs < best.decodeMs)
+        {
+          best = stats;
+        }
+      }
+      baseMs = threadCount == 1 ? best.decodeMs : baseMs;
+      printf("%7u  %4s  %9.2f  %6.1f  %6.2fx\n", best.threadCount, generateMips ? "yes" : "no",
+        best.decodeMs, best.GetMegaPixelsPerSecond(), baseMs / best.decodeMs);
+    }
+  }
+  GetJobSystem()->Shutdown();
+  return 0;
+}
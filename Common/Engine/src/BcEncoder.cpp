@@ -0,0 +1,740 @@
+﻿#include "BcEncoder.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+  #include <emmintrin.h>
+  #define BCENC_USE_SSE2
+#endif
+
+namespace
+{
+  // ブロック内の16テクセルをチャンネルごとに並べたもの.
+  struct BlockTexels
+  {
+    alignas(16) float channel[4][16];
+  };
+
+  void LoadBlock(const uint8_t* texels, BlockTexels& block)
+  {
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      for (uint32_t c = 0; c < 4; ++c)
+      {
+        block.channel[c][i] = float(texels[i * 4 + c]);
+      }
+    }
+  }
+
+  float Clamp255(float v)
+  {
+    return std::min(255.0f, std::max(0.0f, v));
+  }
+
+  // origin から axis 方向への射影を16テクセル分求める.
+  void ProjectBlock(const BlockTexels& block, uint32_t channelCount, const float origin[4], const float axis[4], float outT[16])
+  {
+#if defined(BCENC_USE_SSE2)
+    for (uint32_t i = 0; i < 16; i += 4)
+    {
+      __m128 t = _mm_setzero_ps();
+      for (uint32_t c = 0; c < channelCount; ++c)
+      {
+        __m128 v = _mm_sub_ps(_mm_load_ps(&block.channel[c][i]), _mm_set1_ps(origin[c]));
+        t = _mm_add_ps(t, _mm_mul_ps(v, _mm_set1_ps(axis[c])));
+      }
+      _mm_storeu_ps(outT + i, t);
+    }
+#else
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      float t = 0.0f;
+      for (uint32_t c = 0; c < channelCount; ++c)
+      {
+        t += (block.channel[c][i] - origin[c]) * axis[c];
+      }
+      outT[i] = t;
+    }
+#endif
+  }
+
+  // 分散が最大となる方向を共分散行列のべき乗法で求める.
+  void ComputePrincipalAxis(const BlockTexels& block, uint32_t channelCount, float mean[4], float axis[4])
+  {
+    for (uint32_t c = 0; c < 4; ++c)
+    {
+      mean[c] = 0.0f;
+      axis[c] = 0.0f;
+      for (uint32_t i = 0; i < 16; ++i)
+      {
+        mean[c] += block.channel[c][i];
+      }
+      mean[c] /= 16.0f;
+    }
+    float covariance[4][4]{};
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      for (uint32_t r = 0; r < channelCount; ++r)
+      {
+        for (uint32_t c = 0; c < channelCount; ++c)
+        {
+          covariance[r][c] += (block.channel[r][i] - mean[r]) * (block.channel[c][i] - mean[c]);
+        }
+      }
+    }
+
+    // 分散が最大のチャンネルの行を初期値とする.
+    uint32_t start = 0;
+    for (uint32_t c = 1; c < channelCount; ++c)
+    {
+      start = covariance[c][c] > covariance[start][start] ? c : start;
+    }
+    for (uint32_t c = 0; c < channelCount; ++c)
+    {
+      axis[c] = covariance[start][c];
+    }
+    for (int iteration = 0; iteration < 8; ++iteration)
+    {
+      float next[4]{};
+      for (uint32_t r = 0; r < channelCount; ++r)
+      {
+        for (uint32_t c = 0; c < channelCount; ++c)
+        {
+          next[r] += covariance[r][c] * axis[c];
+        }
+      }
+      float length = 0.0f;
+      for (uint32_t c = 0; c < channelCount; ++c)
+      {
+        length += next[c] * next[c];
+      }
+      if (length < 1e-8f)
+      {
+        break;
+      }
+      length = 1.0f / std::sqrt(length);
+      for (uint32_t c = 0; c < channelCount; ++c)
+      {
+        axis[c] = next[c] * length;
+      }
+    }
+  }
+
+  // 圧縮前の端点を求める. Fast は各チャンネルの範囲、それ以外は主成分軸上の範囲.
+  void ComputeEndpoints(const BlockTexels& block, uint32_t channelCount, BcQuality quality, float e0[4], float e1[4])
+  {
+    if (quality == BcQuality::Fast)
+    {
+      for (uint32_t c = 0; c < channelCount; ++c)
+      {
+        e0[c] = *std::min_element(block.channel[c], block.channel[c] + 16);
+        e1[c] = *std::max_element(block.channel[c], block.channel[c] + 16);
+      }
+      return;
+    }
+
+    float mean[4], axis[4];
+    ComputePrincipalAxis(block, channelCount, mean, axis);
+    float t[16];
+    ProjectBlock(block, channelCount, mean, axis, t);
+    const float minT = *std::min_element(t, t + 16);
+    const float maxT = *std::max_element(t, t + 16);
+    for (uint32_t c = 0; c < channelCount; ++c)
+    {
+      e0[c] = Clamp255(mean[c] + axis[c] * minT);
+      e1[c] = Clamp255(mean[c] + axis[c] * maxT);
+    }
+  }
+
+  // 各テクセルの補間係数(e0 が 0, e1 が 1)を固定して、誤差が最小となる端点を最小二乗法で求める.
+  bool RefineEndpoints(const BlockTexels& block, uint32_t channelCount, const float weights[16], float e0[4], float e1[4])
+  {
+    float a = 0.0f, b = 0.0f, c = 0.0f;
+    float r0[4]{}, r1[4]{};
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      const float w = weights[i];
+      const float iw = 1.0f - w;
+      a += iw * iw;
+      b += iw * w;
+      c += w * w;
+      for (uint32_t ch = 0; ch < channelCount; ++ch)
+      {
+        r0[ch] += iw * block.channel[ch][i];
+        r1[ch] += w * block.channel[ch][i];
+      }
+    }
+    const float det = a * c - b * b;
+    if (std::abs(det) < 1e-6f)
+    {
+      return false;
+    }
+    for (uint32_t ch = 0; ch < channelCount; ++ch)
+    {
+      e0[ch] = Clamp255((c * r0[ch] - b * r1[ch]) / det);
+      e1[ch] = Clamp255((a * r1[ch] - b * r0[ch]) / det);
+    }
+    return true;
+  }
+
+  // ---- BC1 ----
+
+  uint16_t PackRGB565(const float color[3])
+  {
+    const auto r = uint32_t(Clamp255(color[0]) * 31.0f / 255.0f + 0.5f);
+    const auto g = uint32_t(Clamp255(color[1]) * 63.0f / 255.0f + 0.5f);
+    const auto b = uint32_t(Clamp255(color[2]) * 31.0f / 255.0f + 0.5f);
+    return uint16_t((r << 11) | (g << 5) | b);
+  }
+
+  void UnpackRGB565(uint16_t packed, int color[3])
+  {
+    const int r = (packed >> 11) & 31;
+    const int g = (packed >> 5) & 63;
+    const int b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+  }
+
+  // 4色モード(c0 > c1)のパレットから最も近い色を選び、誤差の合計を返す.
+  float SelectIndicesBC1(const BlockTexels& block, uint16_t c0, uint16_t c1, uint32_t indices[16])
+  {
+    int palette[4][3];
+    UnpackRGB565(c0, palette[0]);
+    UnpackRGB565(c1, palette[1]);
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+    }
+    // 同じ端点では3色モードと解釈されるため、インデックス0のみを使う.
+    const uint32_t paletteCount = c0 == c1 ? 1 : 4;
+
+    float totalError = 0.0f;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      float bestError = 1e30f;
+      for (uint32_t p = 0; p < paletteCount; ++p)
+      {
+        float error = 0.0f;
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+          const float d = block.channel[c][i] - float(palette[p][c]);
+          error += d * d;
+        }
+        if (error < bestError)
+        {
+          bestError = error;
+          indices[i] = p;
+        }
+      }
+      totalError += bestError;
+    }
+    return totalError;
+  }
+
+  void EncodeColorBC1(const BlockTexels& block, BcQuality quality, uint8_t* outBlock)
+  {
+    float e0[4], e1[4];
+    ComputeEndpoints(block, 3, quality, e0, e1);
+
+    uint16_t bestC0 = 0, bestC1 = 0;
+    uint32_t bestIndices[16]{};
+    float bestError = 1e30f;
+    auto tryEndpoints = [&](const float* lo, const float* hi) {
+      uint16_t c0 = PackRGB565(hi);
+      uint16_t c1 = PackRGB565(lo);
+      if (c0 < c1)
+      {
+        std::swap(c0, c1);
+      }
+      uint32_t indices[16];
+      const float error = SelectIndicesBC1(block, c0, c1, indices);
+      if (error < bestError)
+      {
+        bestError = error;
+        bestC0 = c0;
+        bestC1 = c1;
+        memcpy(bestIndices, indices, sizeof(indices));
+      }
+    };
+    tryEndpoints(e0, e1);
+
+    if (quality == BcQuality::High)
+    {
+      // インデックスごとの補間係数. パレットは c0, c1, 2/3c0+1/3c1, 1/3c0+2/3c1 の順.
+      const float indexWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+      for (int iteration = 0; iteration < 2 && bestC0 != bestC1; ++iteration)
+      {
+        float weights[16];
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+          weights[i] = indexWeights[bestIndices[i]];
+        }
+        float r0[4], r1[4];
+        if (!RefineEndpoints(block, 3, weights, r0, r1))
+        {
+          break;
+        }
+        tryEndpoints(r0, r1);
+      }
+    }
+
+    outBlock[0] = uint8_t(bestC0 & 0xFF);
+    outBlock[1] = uint8_t(bestC0 >> 8);
+    outBlock[2] = uint8_t(bestC1 & 0xFF);
+    outBlock[3] = uint8_t(bestC1 >> 8);
+    uint32_t bits = 0;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      bits |= bestIndices[i] << (i * 2);
+    }
+    memcpy(outBlock + 4, &bits, sizeof(bits));
+  }
+
+  // ---- BC4 ----
+
+  // a0 > a1 で8段階、それ以外で6段階+0と255のパレットを作る.
+  void MakePaletteBC4(int a0, int a1, int palette[8])
+  {
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1)
+    {
+      for (int i = 2; i < 8; ++i)
+      {
+        palette[i] = ((8 - i) * a0 + (i - 1) * a1 + 3) / 7;
+      }
+    }
+    else
+    {
+      for (int i = 2; i < 6; ++i)
+      {
+        palette[i] = ((6 - i) * a0 + (i - 1) * a1 + 2) / 5;
+      }
+      palette[6] = 0;
+      palette[7] = 255;
+    }
+  }
+
+  float SelectIndicesBC4(const float values[16], int a0, int a1, uint32_t indices[16])
+  {
+    int palette[8];
+    MakePaletteBC4(a0, a1, palette);
+    float totalError = 0.0f;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      float bestError = 1e30f;
+      for (uint32_t p = 0; p < 8; ++p)
+      {
+        const float d = values[i] - float(palette[p]);
+        if (d * d < bestError)
+        {
+          bestError = d * d;
+          indices[i] = p;
+        }
+      }
+      totalError += bestError;
+    }
+    return totalError;
+  }
+
+  void EncodeChannelBC4(const BlockTexels& block, uint32_t channel, BcQuality quality, uint8_t* outBlock)
+  {
+    const float* values = block.channel[channel];
+    const float minValue = *std::min_element(values, values + 16);
+    const float maxValue = *std::max_element(values, values + 16);
+
+    int bestA0 = 0, bestA1 = 0;
+    uint32_t bestIndices[16]{};
+    float bestError = 1e30f;
+    auto tryEndpoints = [&](int a0, int a1) {
+      uint32_t indices[16];
+      const float error = SelectIndicesBC4(values, a0, a1, indices);
+      if (error < bestError)
+      {
+        bestError = error;
+        bestA0 = a0;
+        bestA1 = a1;
+        memcpy(bestIndices, indices, sizeof(indices));
+      }
+    };
+    // 8段階モード. 同じ値の場合は6段階モードとなるが、インデックス0で表現できる.
+    tryEndpoints(int(maxValue + 0.5f), int(minValue + 0.5f));
+
+    if (quality == BcQuality::High)
+    {
+      // 0 と 255 をパレットに持つ6段階モード. 両端の値を除いた範囲で端点を決める.
+      float lo = 255.0f, hi = 0.0f;
+      for (uint32_t i = 0; i < 16; ++i)
+      {
+        if (values[i] > 0.0f && values[i] < 255.0f)
+        {
+          lo = std::min(lo, values[i]);
+          hi = std::max(hi, values[i]);
+        }
+      }
+      if (lo <= hi)
+      {
+        tryEndpoints(int(lo + 0.5f), int(hi + 0.5f));
+      }
+
+      // 8段階モードの端点を最小二乗法で調整する.
+      if (bestA0 > bestA1)
+      {
+        float weights[16];
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+          weights[i] = bestIndices[i] < 2 ? float(bestIndices[i]) : float(bestIndices[i] - 1) / 7.0f;
+        }
+        BlockTexels single;
+        memcpy(single.channel[0], values, sizeof(single.channel[0]));
+        float r0[4], r1[4];
+        if (RefineEndpoints(single, 1, weights, r0, r1))
+        {
+          const int a0 = int(r0[0] + 0.5f), a1 = int(r1[0] + 0.5f);
+          if (a0 > a1)
+          {
+            tryEndpoints(a0, a1);
+          }
+        }
+      }
+    }
+
+    outBlock[0] = uint8_t(bestA0);
+    outBlock[1] = uint8_t(bestA1);
+    uint64_t bits = 0;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      bits |= uint64_t(bestIndices[i]) << (i * 3);
+    }
+    for (uint32_t i = 0; i < 6; ++i)
+    {
+      outBlock[2 + i] = uint8_t(bits >> (i * 8));
+    }
+  }
+
+  // ---- BC7 (モード6) ----
+
+  const int BC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+  struct BC7Endpoints
+  {
+    uint32_t color[2][4];  // 7bit.
+    uint32_t pbit[2];
+  };
+
+  void QuantizeBC7(const float endpoint[4], uint32_t pbit, uint32_t outColor[4])
+  {
+    for (uint32_t c = 0; c < 4; ++c)
+    {
+      const float q = (Clamp255(endpoint[c]) - float(pbit)) * 0.5f + 0.5f;
+      outColor[c] = uint32_t(std::min(127.0f, std::max(0.0f, q)));
+    }
+  }
+
+  // 端点の量子化誤差が小さくなる Pビット.
+  uint32_t ChoosePBitBC7(const float endpoint[4])
+  {
+    float errors[2]{};
+    for (uint32_t p = 0; p < 2; ++p)
+    {
+      uint32_t q[4];
+      QuantizeBC7(endpoint, p, q);
+      for (uint32_t c = 0; c < 4; ++c)
+      {
+        const float d = endpoint[c] - float((q[c] << 1) | p);
+        errors[p] += d * d;
+      }
+    }
+    return errors[1] < errors[0] ? 1 : 0;
+  }
+
+  float SelectIndicesBC7(const BlockTexels& block, const BC7Endpoints& endpoints, BcQuality quality, uint32_t indices[16])
+  {
+    int expanded[2][4];
+    for (uint32_t e = 0; e < 2; ++e)
+    {
+      for (uint32_t c = 0; c < 4; ++c)
+      {
+        expanded[e][c] = int((endpoints.color[e][c] << 1) | endpoints.pbit[e]);
+      }
+    }
+    int palette[16][4];
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      for (uint32_t c = 0; c < 4; ++c)
+      {
+        palette[i][c] = ((64 - BC7Weights4[i]) * expanded[0][c] + BC7Weights4[i] * expanded[1][c] + 32) >> 6;
+      }
+    }
+    auto paletteError = [&](uint32_t texel, uint32_t p) {
+      float error = 0.0f;
+      for (uint32_t c = 0; c < 4; ++c)
+      {
+        const float d = block.channel[c][texel] - float(palette[p][c]);
+        error += d * d;
+      }
+      return error;
+    };
+
+    // High 以外は端点間の射影からインデックスを推定し、前後のみを調べる.
+    float guess[16]{};
+    if (quality != BcQuality::High)
+    {
+      float origin[4], axis[4];
+      float lengthSq = 0.0f;
+      for (uint32_t c = 0; c < 4; ++c)
+      {
+        origin[c] = float(expanded[0][c]);
+        axis[c] = float(expanded[1][c] - expanded[0][c]);
+        lengthSq += axis[c] * axis[c];
+      }
+      if (lengthSq > 0.0f)
+      {
+        const float scale = 15.0f / lengthSq;
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+          axis[c] *= scale;
+        }
+        ProjectBlock(block, 4, origin, axis, guess);
+      }
+    }
+
+    float totalError = 0.0f;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      uint32_t first = 0, last = 15;
+      if (quality != BcQuality::High)
+      {
+        const int center = std::min(15, std::max(0, int(guess[i] + 0.5f)));
+        first = uint32_t(std::max(0, center - 1));
+        last = uint32_t(std::min(15, center + 1));
+      }
+      float bestError = 1e30f;
+      for (uint32_t p = first; p <= last; ++p)
+      {
+        const float error = paletteError(i, p);
+        if (error < bestError)
+        {
+          bestError = error;
+          indices[i] = p;
+        }
+      }
+      totalError += bestError;
+    }
+    return totalError;
+  }
+
+  // 下位ビットから順に書き込む.
+  struct BlockBitWriter
+  {
+    uint8_t* data;
+    uint32_t position = 0;
+
+    void Write(uint32_t value, uint32_t bitCount)
+    {
+      for (uint32_t i = 0; i < bitCount; ++i, ++position)
+      {
+        if (value & (1u << i))
+        {
+          data[position / 8] |= uint8_t(1u << (position % 8));
+        }
+      }
+    }
+  };
+
+  void EncodeBlockBC7Mode6(const BlockTexels& block, BcQuality quality, uint8_t* outBlock)
+  {
+    float e0[4], e1[4];
+    ComputeEndpoints(block, 4, quality, e0, e1);
+
+    BC7Endpoints best{};
+    uint32_t bestIndices[16]{};
+    float bestError = 1e30f;
+    auto tryEndpoints = [&](const float* lo, const float* hi) {
+      // High は Pビットの全組み合わせを試す.
+      const uint32_t p0 = ChoosePBitBC7(lo), p1 = ChoosePBitBC7(hi);
+      for (uint32_t combination = 0; combination < 4; ++combination)
+      {
+        BC7Endpoints endpoints{};
+        endpoints.pbit[0] = combination & 1;
+        endpoints.pbit[1] = combination >> 1;
+        if (quality != BcQuality::High && (endpoints.pbit[0] != p0 || endpoints.pbit[1] != p1))
+        {
+          continue;
+        }
+        QuantizeBC7(lo, endpoints.pbit[0], endpoints.color[0]);
+        QuantizeBC7(hi, endpoints.pbit[1], endpoints.color[1]);
+        uint32_t indices[16];
+        const float error = SelectIndicesBC7(block, endpoints, quality, indices);
+        if (error < bestError)
+        {
+          bestError = error;
+          best = endpoints;
+          memcpy(bestIndices, indices, sizeof(indices));
+        }
+      }
+    };
+    tryEndpoints(e0, e1);
+
+    if (quality == BcQuality::High)
+    {
+      for (int iteration = 0; iteration < 2; ++iteration)
+      {
+        float weights[16];
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+          weights[i] = float(BC7Weights4[bestIndices[i]]) / 64.0f;
+        }
+        float r0[4], r1[4];
+        if (!RefineEndpoints(block, 4, weights, r0, r1))
+        {
+          break;
+        }
+        tryEndpoints(r0, r1);
+      }
+    }
+
+    // 先頭テクセルのインデックスは最上位ビットが省略されるため、0 になるよう端点を入れ替える.
+    if (bestIndices[0] & 8)
+    {
+      std::swap(best.color[0], best.color[1]);
+      std::swap(best.pbit[0], best.pbit[1]);
+      for (auto& index : bestIndices)
+      {
+        index = 15 - index;
+      }
+    }
+
+    memset(outBlock, 0, 16);
+    BlockBitWriter writer{ outBlock };
+    writer.Write(1u << 6, 7);  // モード6.
+    for (uint32_t c = 0; c < 4; ++c)
+    {
+      writer.Write(best.color[0][c], 7);
+      writer.Write(best.color[1][c], 7);
+    }
+    writer.Write(best.pbit[0], 1);
+    writer.Write(best.pbit[1], 1);
+    writer.Write(bestIndices[0], 3);
+    for (uint32_t i = 1; i < 16; ++i)
+    {
+      writer.Write(bestIndices[i], 4);
+    }
+  }
+
+  void EncodeBlock(ImageFormat format, const uint8_t* texels, uint8_t* outBlock, BcQuality quality)
+  {
+    switch (format)
+    {
+    case ImageFormat::BC1: EncodeBlockBC1(texels, outBlock, quality); break;
+    case ImageFormat::BC3: EncodeBlockBC3(texels, outBlock, quality); break;
+    case ImageFormat::BC4: EncodeBlockBC4(texels, 0, outBlock, quality); break;
+    case ImageFormat::BC5: EncodeBlockBC5(texels, outBlock, quality); break;
+    case ImageFormat::BC7: EncodeBlockBC7(texels, outBlock, quality); break;
+    default: break;
+    }
+  }
+}
+
+void EncodeBlockBC1(const uint8_t* texels, uint8_t* outBlock, BcQuality quality)
+{
+  BlockTexels block;
+  LoadBlock(texels, block);
+  EncodeColorBC1(block, quality, outBlock);
+}
+
+void EncodeBlockBC3(const uint8_t* texels, uint8_t* outBlock, BcQuality quality)
+{
+  BlockTexels block;
+  LoadBlock(texels, block);
+  EncodeChannelBC4(block, 3, quality, outBlock);
+  EncodeColorBC1(block, quality, outBlock + 8);
+}
+
+void EncodeBlockBC4(const uint8_t* texels, uint32_t channel, uint8_t* outBlock, BcQuality quality)
+{
+  BlockTexels block;
+  LoadBlock(texels, block);
+  EncodeChannelBC4(block, channel, quality, outBlock);
+}
+
+void EncodeBlockBC5(const uint8_t* texels, uint8_t* outBlock, BcQuality quality)
+{
+  BlockTexels block;
+  LoadBlock(texels, block);
+  EncodeChannelBC4(block, 0, quality, outBlock);
+  EncodeChannelBC4(block, 1, quality, outBlock + 8);
+}
+
+void EncodeBlockBC7(const uint8_t* texels, uint8_t* outBlock, BcQuality quality)
+{
+  BlockTexels block;
+  LoadBlock(texels, block);
+  EncodeBlockBC7Mode6(block, quality, outBlock);
+}
+
+bool CompressImage(const DecodedImage& image, ImageFormat format, BcQuality quality, DecodedImage& outImage)
+{
+  if (image.format != ImageFormat::RGBA8 || !IsBlockCompressed(format) || image.GetMipLevelCount() == 0)
+  {
+    return false;
+  }
+  if ((image.GetWidth() % 4) != 0 || (image.GetHeight() % 4) != 0)
+  {
+    return false;
+  }
+
+  DecodedImage result;
+  result.Allocate(image.GetWidth(), image.GetHeight(), image.GetMipLevelCount(), format);
+  result.srgb = image.srgb;
+
+  // 全レベルのブロック行を1つのジョブ列にまとめる.
+  struct BlockRow
+  {
+    uint32_t mip;
+    uint32_t row;
+  };
+  std::vector<BlockRow> blockRows;
+  for (uint32_t mip = 0; mip < result.GetMipLevelCount(); ++mip)
+  {
+    for (uint32_t row = 0; row < result.mipLevels[mip].rowCount; ++row)
+    {
+      blockRows.push_back({ mip, row });
+    }
+  }
+
+  const uint32_t blockBytes = GetFormatElementBytes(format);
+  GetJobSystem()->Dispatch(uint32_t(blockRows.size()), [&](uint32_t jobIndex, uint32_t) {
+    const auto& blockRow = blockRows[jobIndex];
+    const auto& srcLevel = image.mipLevels[blockRow.mip];
+    const auto& dstLevel = result.mipLevels[blockRow.mip];
+    const uint8_t* src = image.GetLevelData(blockRow.mip);
+    uint8_t* dst = result.GetLevelData(blockRow.mip) + size_t(blockRow.row) * dstLevel.rowPitch;
+
+    uint8_t texels[16 * 4];
+    const uint32_t blockCount = (srcLevel.width + 3) / 4;
+    for (uint32_t bx = 0; bx < blockCount; ++bx)
+    {
+      // 4テクセルに満たないレベルは端のテクセルを繰り返して埋める.
+      for (uint32_t y = 0; y < 4; ++y)
+      {
+        const uint32_t sy = std::min(blockRow.row * 4 + y, srcLevel.height - 1);
+        for (uint32_t x = 0; x < 4; ++x)
+        {
+          const uint32_t sx = std::min(bx * 4 + x, srcLevel.width - 1);
+          memcpy(texels + (y * 4 + x) * 4, src + size_t(sy) * srcLevel.rowPitch + sx * 4, 4);
+        }
+      }
+      EncodeBlock(format, texels, dst + bx * blockBytes, quality);
+    }
+  });
+
+  outImage = std::move(result);
+  return true;
+}
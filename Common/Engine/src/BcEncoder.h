@@ -0,0 +1,26 @@
+﻿#pragma once
+#include "TextureDecode.h"
+
+// RGBA8 イメージのブロック圧縮(BC1/BC3/BC4/BC5/BC7).
+// 端点は主成分軸から求め、品質に応じて最小二乗法で調整する. 射影計算は SIMD(SSE2) で行う.
+// BC7 はモード6(1サブセット, RGBA 7bit+Pビット, 4bit インデックス)のみを使用する.
+// Direct3D に依存しないため、Windows 以外でも単体で動作する.
+
+enum class BcQuality
+{
+  Fast,    // 範囲の最小・最大を端点とし、インデックスは射影で決める.
+  Normal,  // 主成分軸で端点を決め、インデックスは近傍を探索する.
+  High,    // Normal に加えて端点を最小二乗法で調整し、BC7 は Pビットの全組み合わせを試す.
+};
+
+// 4x4 テクセル(RGBA8 を行順に64バイト)を1ブロックに圧縮する.
+// BC1 は不透明として扱い、アルファは出力しない.
+void EncodeBlockBC1(const uint8_t* texels, uint8_t* outBlock, BcQuality quality);
+void EncodeBlockBC3(const uint8_t* texels, uint8_t* outBlock, BcQuality quality);
+void EncodeBlockBC4(const uint8_t* texels, uint32_t channel, uint8_t* outBlock, BcQuality quality);
+void EncodeBlockBC5(const uint8_t* texels, uint8_t* outBlock, BcQuality quality);
+void EncodeBlockBC7(const uint8_t* texels, uint8_t* outBlock, BcQuality quality);
+
+// RGBA8 イメージの全ミップレベルを圧縮する. ブロック行単位でジョブシステムにより並列処理する.
+// BC 形式のテクスチャは mip0 の幅・高さが4の倍数である必要があるため、それ以外は失敗する.
+bool CompressImage(const DecodedImage& image, ImageFormat format, BcQuality quality, DecodedImage& outImage);
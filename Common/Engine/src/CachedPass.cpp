@@ -0,0 +1,29 @@
+﻿#include "CachedPass.h"
+
+HashBuilder& HashBuilder::Add(const void* data, size_t size)
+{
+  auto bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; ++i)
+  {
+    m_hash ^= bytes[i];
+    m_hash *= 1099511628211ull;
+  }
+  return *this;
+}
+
+bool CachedPass::IsDirty(uint64_t key)
+{
+  if (m_valid && m_key == key)
+  {
+    ++m_hitCount;
+    return false;
+  }
+  ++m_missCount;
+  return true;
+}
+
+void CachedPass::MarkValid(uint64_t key)
+{
+  m_key = key;
+  m_valid = true;
+}
@@ -0,0 +1,58 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+// パスの入力や定数から結果の同一性を判定するためのハッシュ(64bit FNV-1a).
+// 構造体はバイト列として扱うため、パディングを含む型は要素ごとに加えること.
+class HashBuilder
+{
+public:
+  HashBuilder& Add(const void* data, size_t size);
+
+  template<class T>
+  HashBuilder& Add(const T& value)
+  {
+    static_assert(std::is_trivially_copyable_v<T>, "HashBuilder requires a trivially copyable type");
+    return Add(&value, sizeof(T));
+  }
+  template<class T>
+  HashBuilder& Add(const std::vector<T>& values)
+  {
+    static_assert(std::is_trivially_copyable_v<T>, "HashBuilder requires a trivially copyable type");
+    Add(values.size());
+    return Add(values.data(), sizeof(T) * values.size());
+  }
+
+  uint64_t Get() const { return m_hash; }
+
+private:
+  uint64_t m_hash = 14695981039346656037ull;
+};
+
+// 入力と定数が変わったときだけ処理をやり直すための記録.
+// 結果を作ったときのキー(入力と定数のハッシュ)を覚えておき、同じキーなら前回の結果を使い回す.
+//   auto key = HashBuilder().Add(...).Get();
+//   if (cache.IsDirty(key)) { 処理を実行; cache.MarkValid(key); }
+// 入力のリソースの中身を書き換えた場合は、キーに版数を含めるか Invalidate すること.
+class CachedPass
+{
+public:
+  // 前回の結果が key に対するものでなければ true. 判定の回数を数える.
+  bool IsDirty(uint64_t key);
+  // key に対する結果を作った.
+  void MarkValid(uint64_t key);
+  // 結果を破棄したとき(出力先を作り直したときなど)に呼ぶ.
+  void Invalidate() { m_valid = false; }
+
+  bool IsValid() const { return m_valid; }
+  uint32_t GetHitCount() const { return m_hitCount; }
+  uint32_t GetMissCount() const { return m_missCount; }
+
+private:
+  uint64_t m_key = 0;
+  bool m_valid = false;
+  uint32_t m_hitCount = 0;
+  uint32_t m_missCount = 0;
+};
@@ -0,0 +1,102 @@
+﻿#include "ComputeDispatch.h"
+
+#include <cstring>
+
+DispatchGroupCount GetDispatchGroupCount(const ThreadGroupSize& groupSize, uint32_t width, uint32_t height, uint32_t depth)
+{
+  if (width == 0 || height == 0 || depth == 0)
+  {
+    return {};
+  }
+  auto divideUp = [](uint32_t count, uint32_t size) {
+    size = size > 0 ? size : 1;
+    return uint32_t((uint64_t(count) + size - 1) / size);
+  };
+  return {
+    .x = divideUp(width, groupSize.x),
+    .y = divideUp(height, groupSize.y),
+    .z = divideUp(depth, groupSize.z),
+  };
+}
+
+namespace
+{
+  constexpr uint32_t MakeFourCC(char a, char b, char c, char d)
+  {
+    return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) | (uint32_t(uint8_t(c)) << 16) | (uint32_t(uint8_t(d)) << 24);
+  }
+
+  uint32_t ReadU32(const uint8_t* p)
+  {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+  }
+
+  // DxilContainerHeader: FourCC, Digest[16], Major/MinorVersion, ContainerSize, PartCount.
+  const size_t ContainerHeaderSize = 32;
+  // PSVRuntimeInfo 内の位置(DxilPipelineStateValidation.h).
+  const size_t PsvShaderStageOffset = 24;   // PSVRuntimeInfo1::ShaderStage
+  const size_t PsvNumThreadsOffset = 36;    // PSVRuntimeInfo2::NumThreadsX,Y,Z
+  const size_t PsvRuntimeInfo2Size = 48;
+  const uint8_t PsvShaderKindCompute = 5;
+}
+
+bool ReflectThreadGroupSize(const void* bytecode, size_t bytecodeLength, ThreadGroupSize& outSize)
+{
+  auto data = reinterpret_cast<const uint8_t*>(bytecode);
+  if (data == nullptr || bytecodeLength < ContainerHeaderSize || ReadU32(data) != MakeFourCC('D', 'X', 'B', 'C'))
+  {
+    return false;
+  }
+  const auto containerSize = ReadU32(data + 24);
+  const auto partCount = ReadU32(data + 28);
+  if (containerSize > bytecodeLength || ContainerHeaderSize + size_t(partCount) * 4 > containerSize)
+  {
+    return false;
+  }
+  for (uint32_t i = 0; i < partCount; ++i)
+  {
+    const auto partOffset = ReadU32(data + ContainerHeaderSize + i * 4);
+    if (size_t(partOffset) + 8 > containerSize)
+    {
+      return false;
+    }
+    const auto partFourCC = ReadU32(data + partOffset);
+    const auto partSize = ReadU32(data + partOffset + 4);
+    if (partFourCC != MakeFourCC('P', 'S', 'V', '0'))
+    {
+      continue;
+    }
+    // PSV0 は先頭に PSVRuntimeInfo の大きさを持ち、版によって大きさが異なる.
+    const auto partData = data + partOffset + 8;
+    if (size_t(partOffset) + 8 + partSize > containerSize || partSize < 4)
+    {
+      return false;
+    }
+    const auto runtimeInfoSize = ReadU32(partData);
+    if (runtimeInfoSize < PsvRuntimeInfo2Size || size_t(runtimeInfoSize) + 4 > partSize)
+    {
+      return false;
+    }
+    const auto runtimeInfo = partData + 4;
+    if (runtimeInfo[PsvShaderStageOffset] != PsvShaderKindCompute)
+    {
+      return false;
+    }
+    ThreadGroupSize size{
+      .x = ReadU32(runtimeInfo + PsvNumThreadsOffset),
+      .y = ReadU32(runtimeInfo + PsvNumThreadsOffset + 4),
+      .z = ReadU32(runtimeInfo + PsvNumThreadsOffset + 8),
+    };
+    // D3D12 の上限(1グループ 1024 スレッド, Z は 64)を超える値は読み違いとして扱う.
+    if (size.x == 0 || size.y == 0 || size.z == 0 || size.z > 64 ||
+      uint64_t(size.x) * size.y * size.z > 1024)
+    {
+      return false;
+    }
+    outSize = size;
+    return true;
+  }
+  return false;
+}
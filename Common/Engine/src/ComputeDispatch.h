@@ -0,0 +1,36 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// コンピュートシェーダーのスレッドグループの大きさ([numthreads] の値).
+struct ThreadGroupSize
+{
+  uint32_t x = 1;
+  uint32_t y = 1;
+  uint32_t z = 1;
+};
+
+// Dispatch に渡すスレッドグループ数.
+struct DispatchGroupCount
+{
+  uint32_t x = 0;
+  uint32_t y = 0;
+  uint32_t z = 0;
+};
+
+// width x height x depth 個のスレッドを覆うのに必要なスレッドグループ数.
+// 端数は切り上げるため、シェーダー側で範囲外のスレッドを判定すること.
+// 大きさが 0 の軸がある場合はすべて 0 (Dispatch 不要)となる.
+DispatchGroupCount GetDispatchGroupCount(const ThreadGroupSize& groupSize, uint32_t width, uint32_t height = 1, uint32_t depth = 1);
+
+// テクスチャのミップレベル mipLevel の大きさ(各軸 1 未満にはならない).
+inline uint32_t GetMipLevelSize(uint64_t size, uint32_t mipLevel)
+{
+  const auto value = mipLevel < 64 ? size >> mipLevel : 0;
+  return value > 0 ? uint32_t(value) : 1u;
+}
+
+// コンパイル済みシェーダー(DXIL コンテナ)からスレッドグループの大きさを読み取る.
+// PSV0 パートに記録された値(PSVRuntimeInfo2 以降)を使う. DXBC(SM5.x 以前)や古いコンパイラの出力、
+// コンピュートシェーダー以外では false を返すため、呼び出し側で既定値を用意しておくこと.
+bool ReflectThreadGroupSize(const void* bytecode, size_t bytecodeLength, ThreadGroupSize& outSize);
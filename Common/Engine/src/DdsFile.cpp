@@ -0,0 +1,446 @@
+﻿#include "DdsFile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+  constexpr uint32_t MakeFourCC(char a, char b, char c, char d)
+  {
+    return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) | (uint32_t(uint8_t(c)) << 16) | (uint32_t(uint8_t(d)) << 24);
+  }
+
+  const uint32_t DdsMagic = MakeFourCC('D', 'D', 'S', ' ');
+
+  struct DdsPixelFormat
+  {
+    uint32_t size;
+    uint32_t flags;
+    uint32_t fourCC;
+    uint32_t rgbBitCount;
+    uint32_t rBitMask;
+    uint32_t gBitMask;
+    uint32_t bBitMask;
+    uint32_t aBitMask;
+  };
+  struct DdsHeader
+  {
+    uint32_t size;
+    uint32_t flags;
+    uint32_t height;
+    uint32_t width;
+    uint32_t pitchOrLinearSize;
+    uint32_t depth;
+    uint32_t mipMapCount;
+    uint32_t reserved1[11];
+    DdsPixelFormat pixelFormat;
+    uint32_t caps;
+    uint32_t caps2;
+    uint32_t caps3;
+    uint32_t caps4;
+    uint32_t reserved2;
+  };
+  struct DdsHeaderDX10
+  {
+    uint32_t dxgiFormat;
+    uint32_t resourceDimension;
+    uint32_t miscFlag;
+    uint32_t arraySize;
+    uint32_t miscFlags2;
+  };
+  static_assert(sizeof(DdsHeader) == 124, "DDS header size mismatch");
+  static_assert(sizeof(DdsHeaderDX10) == 20, "DDS DX10 header size mismatch");
+
+  // ヘッダのフラグ.
+  const uint32_t DDSD_CAPS = 0x1;
+  const uint32_t DDSD_HEIGHT = 0x2;
+  const uint32_t DDSD_WIDTH = 0x4;
+  const uint32_t DDSD_PIXELFORMAT = 0x1000;
+  const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+  const uint32_t DDSD_LINEARSIZE = 0x80000;
+  const uint32_t DDPF_ALPHAPIXELS = 0x1;
+  const uint32_t DDPF_FOURCC = 0x4;
+  const uint32_t DDPF_RGB = 0x40;
+  const uint32_t DDSCAPS_COMPLEX = 0x8;
+  const uint32_t DDSCAPS_TEXTURE = 0x1000;
+  const uint32_t DDSCAPS_MIPMAP = 0x400000;
+  const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+  const uint32_t DDSCAPS2_VOLUME = 0x200000;
+  const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+
+  // DXGI_FORMAT の値. Direct3D のヘッダに依存しないよう数値で持つ.
+  enum DdsDxgiFormat : uint32_t
+  {
+    DDS_R8G8B8A8_UNORM = 28,
+    DDS_R8G8B8A8_UNORM_SRGB = 29,
+    DDS_BC1_UNORM = 71,
+    DDS_BC1_UNORM_SRGB = 72,
+    DDS_BC3_UNORM = 77,
+    DDS_BC3_UNORM_SRGB = 78,
+    DDS_BC4_UNORM = 80,
+    DDS_BC5_UNORM = 83,
+    DDS_B8G8R8A8_UNORM = 87,
+    DDS_B8G8R8X8_UNORM = 88,
+    DDS_B8G8R8A8_UNORM_SRGB = 91,
+    DDS_B8G8R8X8_UNORM_SRGB = 93,
+    DDS_BC7_UNORM = 98,
+    DDS_BC7_UNORM_SRGB = 99,
+  };
+
+  // 読み込み時の形式. BGRA は RGBA8 に並べ替え、X 付きはアルファを 255 で埋める.
+  struct SourceFormat
+  {
+    ImageFormat format = ImageFormat::RGBA8;
+    bool swapRB = false;
+    bool opaque = false;
+  };
+
+  bool FromDxgiFormat(uint32_t dxgiFormat, SourceFormat& out)
+  {
+    switch (dxgiFormat)
+    {
+    case DDS_R8G8B8A8_UNORM:
+    case DDS_R8G8B8A8_UNORM_SRGB:
+      out = { ImageFormat::RGBA8 };
+      return true;
+    case DDS_B8G8R8A8_UNORM:
+    case DDS_B8G8R8A8_UNORM_SRGB:
+      out = { ImageFormat::RGBA8, true };
+      return true;
+    case DDS_B8G8R8X8_UNORM:
+    case DDS_B8G8R8X8_UNORM_SRGB:
+      out = { ImageFormat::RGBA8, true, true };
+      return true;
+    case DDS_BC1_UNORM:
+    case DDS_BC1_UNORM_SRGB:
+      out = { ImageFormat::BC1 };
+      return true;
+    case DDS_BC3_UNORM:
+    case DDS_BC3_UNORM_SRGB:
+      out = { ImageFormat::BC3 };
+      return true;
+    case DDS_BC4_UNORM:
+      out = { ImageFormat::BC4 };
+      return true;
+    case DDS_BC5_UNORM:
+      out = { ImageFormat::BC5 };
+      return true;
+    case DDS_BC7_UNORM:
+    case DDS_BC7_UNORM_SRGB:
+      out = { ImageFormat::BC7 };
+      return true;
+    }
+    return false;
+  }
+
+  // DX10 拡張ヘッダを持たない旧形式.
+  bool FromLegacyPixelFormat(const DdsPixelFormat& pf, SourceFormat& out)
+  {
+    if (pf.flags & DDPF_FOURCC)
+    {
+      switch (pf.fourCC)
+      {
+      case MakeFourCC('D', 'X', 'T', '1'):
+        out = { ImageFormat::BC1 };
+        return true;
+      case MakeFourCC('D', 'X', 'T', '4'):
+      case MakeFourCC('D', 'X', 'T', '5'):
+        out = { ImageFormat::BC3 };
+        return true;
+      case MakeFourCC('A', 'T', 'I', '1'):
+      case MakeFourCC('B', 'C', '4', 'U'):
+        out = { ImageFormat::BC4 };
+        return true;
+      case MakeFourCC('A', 'T', 'I', '2'):
+      case MakeFourCC('B', 'C', '5', 'U'):
+        out = { ImageFormat::BC5 };
+        return true;
+      }
+      return false;
+    }
+    if ((pf.flags & DDPF_RGB) && pf.rgbBitCount == 32)
+    {
+      const bool opaque = (pf.flags & DDPF_ALPHAPIXELS) == 0 || pf.aBitMask == 0;
+      if (pf.rBitMask == 0x000000ff && pf.gBitMask == 0x0000ff00 && pf.bBitMask == 0x00ff0000)
+      {
+        out = { ImageFormat::RGBA8, false, opaque };
+        return true;
+      }
+      if (pf.rBitMask == 0x00ff0000 && pf.gBitMask == 0x0000ff00 && pf.bBitMask == 0x000000ff)
+      {
+        out = { ImageFormat::RGBA8, true, opaque };
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool IsSrgbDxgiFormat(uint32_t dxgiFormat)
+  {
+    switch (dxgiFormat)
+    {
+    case DDS_R8G8B8A8_UNORM_SRGB:
+    case DDS_B8G8R8A8_UNORM_SRGB:
+    case DDS_B8G8R8X8_UNORM_SRGB:
+    case DDS_BC1_UNORM_SRGB:
+    case DDS_BC3_UNORM_SRGB:
+    case DDS_BC7_UNORM_SRGB:
+      return true;
+    }
+    return false;
+  }
+
+  // BC4, BC5 には sRGB の形式が無いため UNORM とする.
+  uint32_t ToDxgiFormat(ImageFormat format, bool srgb)
+  {
+    switch (format)
+    {
+    case ImageFormat::BC1: return srgb ? DDS_BC1_UNORM_SRGB : DDS_BC1_UNORM;
+    case ImageFormat::BC3: return srgb ? DDS_BC3_UNORM_SRGB : DDS_BC3_UNORM;
+    case ImageFormat::BC4: return DDS_BC4_UNORM;
+    case ImageFormat::BC5: return DDS_BC5_UNORM;
+    case ImageFormat::BC7: return srgb ? DDS_BC7_UNORM_SRGB : DDS_BC7_UNORM;
+    default: return srgb ? DDS_R8G8B8A8_UNORM_SRGB : DDS_R8G8B8A8_UNORM;
+    }
+  }
+}
+
+bool IsDDS(const void* srcBuffer, size_t bufferSize)
+{
+  uint32_t magic = 0;
+  if (srcBuffer == nullptr || bufferSize < sizeof(magic) + sizeof(DdsHeader))
+  {
+    return false;
+  }
+  memcpy(&magic, srcBuffer, sizeof(magic));
+  return magic == DdsMagic;
+}
+
+namespace
+{
+  // ヘッダを読み取り、ピクセルデータの先頭位置を返す.
+  bool ParseHeader(const void* srcBuffer, size_t bufferSize, ImageInfo& outInfo, SourceFormat& outFormat, size_t& outDataOffset)
+  {
+    if (!IsDDS(srcBuffer, bufferSize))
+    {
+      return false;
+    }
+    auto src = reinterpret_cast<const uint8_t*>(srcBuffer);
+    size_t offset = sizeof(uint32_t);
+    DdsHeader header;
+    memcpy(&header, src + offset, sizeof(header));
+    offset += sizeof(header);
+    if (header.size != sizeof(DdsHeader) || header.pixelFormat.size != sizeof(DdsPixelFormat))
+    {
+      return false;
+    }
+    if (header.caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME))
+    {
+      return false;
+    }
+
+    bool srgb = false;
+    if ((header.pixelFormat.flags & DDPF_FOURCC) && header.pixelFormat.fourCC == MakeFourCC('D', 'X', '1', '0'))
+    {
+      if (bufferSize < offset + sizeof(DdsHeaderDX10))
+      {
+        return false;
+      }
+      DdsHeaderDX10 headerDX10;
+      memcpy(&headerDX10, src + offset, sizeof(headerDX10));
+      offset += sizeof(headerDX10);
+      if (headerDX10.resourceDimension != DDS_DIMENSION_TEXTURE2D || headerDX10.arraySize > 1)
+      {
+        return false;
+      }
+      if (!FromDxgiFormat(headerDX10.dxgiFormat, outFormat))
+      {
+        return false;
+      }
+      srgb = IsSrgbDxgiFormat(headerDX10.dxgiFormat);
+    }
+    else if (!FromLegacyPixelFormat(header.pixelFormat, outFormat))
+    {
+      return false;
+    }
+
+    if (header.width == 0 || header.height == 0)
+    {
+      return false;
+    }
+    // レベル数は 1x1 までの数を超えないようにする(壊れたファイルでレベルの配置より多く読まないため).
+    uint32_t fullMipCount = 1;
+    for (uint32_t size = std::max(header.width, header.height); size > 1; size >>= 1)
+    {
+      ++fullMipCount;
+    }
+    outInfo = ImageInfo{
+      .width = header.width,
+      .height = header.height,
+      .mipCount = (header.flags & DDSD_MIPMAPCOUNT) ? std::clamp(header.mipMapCount, 1u, fullMipCount) : 1u,
+      .format = outFormat.format,
+      .srgb = srgb,
+    };
+    outDataOffset = offset;
+    return true;
+  }
+
+  // DX10 拡張ヘッダ付きのヘッダを outBuffer の先頭に書き込み、画素データの位置を返す.
+  size_t EncodeHeaders(uint32_t width, uint32_t height, uint32_t mipCount, uint32_t pitchOrLinearSize,
+    ImageFormat format, bool srgb, std::vector<uint8_t>& outBuffer)
+  {
+    DdsHeader header{};
+    header.size = sizeof(DdsHeader);
+    header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+    header.width = width;
+    header.height = height;
+    header.pitchOrLinearSize = pitchOrLinearSize;
+    header.mipMapCount = mipCount;
+    header.pixelFormat.size = sizeof(DdsPixelFormat);
+    header.pixelFormat.flags = DDPF_FOURCC;
+    header.pixelFormat.fourCC = MakeFourCC('D', 'X', '1', '0');
+    header.caps = DDSCAPS_TEXTURE | (mipCount > 1 ? (DDSCAPS_COMPLEX | DDSCAPS_MIPMAP) : 0);
+
+    DdsHeaderDX10 headerDX10{
+      .dxgiFormat = ToDxgiFormat(format, srgb),
+      .resourceDimension = DDS_DIMENSION_TEXTURE2D,
+      .miscFlag = 0,
+      .arraySize = 1,
+      .miscFlags2 = 0,
+    };
+
+    const size_t headerSize = sizeof(DdsMagic) + sizeof(header) + sizeof(headerDX10);
+    if (outBuffer.size() < headerSize)
+    {
+      outBuffer.resize(headerSize);
+    }
+    auto dst = outBuffer.data();
+    memcpy(dst, &DdsMagic, sizeof(DdsMagic));
+    dst += sizeof(DdsMagic);
+    memcpy(dst, &header, sizeof(header));
+    dst += sizeof(header);
+    memcpy(dst, &headerDX10, sizeof(headerDX10));
+    return headerSize;
+  }
+}
+
+bool ReadDDSInfo(const void* srcBuffer, size_t bufferSize, ImageInfo& outInfo)
+{
+  SourceFormat sourceFormat;
+  size_t dataOffset = 0;
+  return ParseHeader(srcBuffer, bufferSize, outInfo, sourceFormat, dataOffset);
+}
+
+bool ReadDDSPixelDataOffset(const void* srcBuffer, size_t bufferSize, ImageInfo& outInfo, size_t& outDataOffset)
+{
+  SourceFormat sourceFormat;
+  if (!ParseHeader(srcBuffer, bufferSize, outInfo, sourceFormat, outDataOffset))
+  {
+    return false;
+  }
+  return outInfo.format == ImageFormat::RGBA8 && !sourceFormat.swapRB && !sourceFormat.opaque;
+}
+
+bool DecodeDDS(const void* srcBuffer, size_t bufferSize, DecodedImage& outImage)
+{
+  ImageInfo info;
+  SourceFormat sourceFormat;
+  size_t offset = 0;
+  if (!ParseHeader(srcBuffer, bufferSize, info, sourceFormat, offset))
+  {
+    return false;
+  }
+  auto src = reinterpret_cast<const uint8_t*>(srcBuffer);
+  uint32_t mipCount = info.mipCount;
+  if (outImage.externalPixels != nullptr)
+  {
+    // 格納先の配置に合わせる. 配置のレベル数が少なければ、そこまでを読み込む.
+    if (outImage.GetMipLevelCount() == 0 || outImage.format != info.format ||
+      outImage.GetWidth() != info.width || outImage.GetHeight() != info.height)
+    {
+      return false;
+    }
+    mipCount = std::min(mipCount, outImage.GetMipLevelCount());
+    outImage.srgb = outImage.srgb || info.srgb;
+  }
+  else
+  {
+    outImage.Allocate(info.width, info.height, mipCount, info.format);
+    mipCount = std::min(mipCount, outImage.GetMipLevelCount());
+    outImage.srgb = info.srgb;
+  }
+
+  // DDS 内の各レベルは詰めて格納されているため、ピッチを揃えながら1行ずつ移す.
+  for (uint32_t mip = 0; mip < mipCount; ++mip)
+  {
+    const auto& level = outImage.mipLevels[mip];
+    const size_t rowSize = outImage.GetRowSize(mip);
+    if (bufferSize < offset + rowSize * level.rowCount)
+    {
+      return false;
+    }
+    for (uint32_t row = 0; row < level.rowCount; ++row)
+    {
+      uint8_t* dst = outImage.GetLevelData(mip) + size_t(row) * level.rowPitch;
+      memcpy(dst, src + offset, rowSize);
+      offset += rowSize;
+      if (sourceFormat.swapRB || sourceFormat.opaque)
+      {
+        for (uint32_t x = 0; x < level.width; ++x)
+        {
+          auto texel = dst + x * DecodedImage::PixelBytes;
+          if (sourceFormat.swapRB)
+          {
+            std::swap(texel[0], texel[2]);
+          }
+          if (sourceFormat.opaque)
+          {
+            texel[3] = 0xFF;
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+bool EncodeDDS(const DecodedImage& image, std::vector<uint8_t>& outBuffer)
+{
+  if (image.GetMipLevelCount() == 0)
+  {
+    return false;
+  }
+  const auto mipCount = image.GetMipLevelCount();
+
+  size_t dataSize = 0;
+  for (uint32_t mip = 0; mip < mipCount; ++mip)
+  {
+    dataSize += size_t(image.GetRowSize(mip)) * image.mipLevels[mip].rowCount;
+  }
+  outBuffer.clear();
+  const size_t headerSize = EncodeHeaders(image.GetWidth(), image.GetHeight(), mipCount,
+    image.GetRowSize(0) * image.mipLevels[0].rowCount, image.format, image.srgb, outBuffer);
+  outBuffer.resize(headerSize + dataSize);
+
+  auto dst = outBuffer.data() + headerSize;
+  for (uint32_t mip = 0; mip < mipCount; ++mip)
+  {
+    const auto& level = image.mipLevels[mip];
+    const size_t rowSize = image.GetRowSize(mip);
+    for (uint32_t row = 0; row < level.rowCount; ++row)
+    {
+      memcpy(dst, image.GetLevelData(mip) + size_t(row) * level.rowPitch, rowSize);
+      dst += rowSize;
+    }
+  }
+  return true;
+}
+
+size_t EncodeDDSHeader(uint32_t width, uint32_t height, bool srgb, std::vector<uint8_t>& outBuffer)
+{
+  outBuffer.clear();
+  // 4GB を超える画像ではデータの大きさを表せないため、上限に丸める(読み込み側では使わない).
+  const uint32_t linearSize = uint32_t(std::min<uint64_t>(uint64_t(width) * 4 * height, UINT32_MAX));
+  return EncodeHeaders(width, height, 1, linearSize, ImageFormat::RGBA8, srgb, outBuffer);
+}
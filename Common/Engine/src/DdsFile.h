@@ -0,0 +1,25 @@
+﻿#pragma once
+#include "TextureDecode.h"
+
+// DDS ファイルの読み書き.
+// 2D テクスチャ(配列・キューブマップを除く)の RGBA8, BGRA8, BC1/BC3/BC4/BC5/BC7 に対応する.
+// 格納されているミップマップはそのまま読み込み、GPU へはブロック単位のフットプリントで転送できる.
+
+// 先頭が DDS のマジックナンバーかどうか.
+bool IsDDS(const void* srcBuffer, size_t bufferSize);
+
+// ヘッダのみを読み取る.
+bool ReadDDSInfo(const void* srcBuffer, size_t bufferSize, ImageInfo& outInfo);
+
+// DDS のメモリイメージを読み込む. BGRA8 は RGBA8 に並べ替える.
+// outImage が AttachStorage 済みの場合は、その配置へ格納されているレベルを書き込む(大きさと形式が一致すること).
+bool DecodeDDS(const void* srcBuffer, size_t bufferSize, DecodedImage& outImage);
+
+// イメージを DDS 形式(DX10 拡張ヘッダ付き)で書き出す.
+bool EncodeDDS(const DecodedImage& image, std::vector<uint8_t>& outBuffer);
+
+// 大きな画像をファイルから行単位で読み書きするためのもの. mip0 の画素は1行 width * 4 バイトで詰めて格納されている.
+// ヘッダから mip0 の画素データの位置を求める. 並べ替えずにそのまま読める RGBA8 の場合だけ true.
+bool ReadDDSPixelDataOffset(const void* srcBuffer, size_t bufferSize, ImageInfo& outInfo, size_t& outDataOffset);
+// width x height の RGBA8(ミップマップ無し)の DDS ヘッダを作り、その大きさ(画素データの位置)を返す.
+size_t EncodeDDSHeader(uint32_t width, uint32_t height, bool srgb, std::vector<uint8_t>& outBuffer);
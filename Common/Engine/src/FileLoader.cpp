@@ -1,8 +1,10 @@
 ﻿#include "FileLoader.h"
 #include <fstream>
 
+#if defined(_WIN32)
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#endif
 
 static std::unique_ptr<FileLoader> gFileLoader = nullptr;
 
@@ -41,7 +43,7 @@ bool FileLoader::Load(std::filesystem::path filePath, std::vector<char>& fileDat
       return true;
     }
   }
-#if _DEBUG
+#if _DEBUG && defined(_WIN32)
   // Not Found
   DebugBreak();
 #endif
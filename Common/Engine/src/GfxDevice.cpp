@@ -1,6 +1,7 @@
 ﻿#include "GfxDevice.h"
-#include "Win32Application.h"
+#include "UploadRing.h"
 #include <stdexcept>
+#include <algorithm>
 
 #pragma comment(lib, "d3d12.lib")
 #pragma comment(lib, "dxgi.lib")
@@ -60,13 +61,13 @@ void GfxDevice::Initialize(const DeviceInitParams& initParams)
   CreateDescriptorHeaps();
 
   // スワップチェインの作成.
-  CreateSwapchain(initParams.formatDesired);
+  CreateSwapchain(initParams.hwnd, initParams.formatDesired);
 
   // レンダーターゲットビューの準備.
-  PrepareRenderTargetView();
+  PrepareRenderTargetView(initParams.srgbRenderTarget);
 
   // コマンドアロケーターの作成.
-  CreateCommandAllocators();
+  CreateCommandAllocators(initParams.commandThreadCount);
 
   m_frameIndex = m_swapchain->GetCurrentBackBufferIndex();
 }
@@ -74,6 +75,7 @@ void GfxDevice::Initialize(const DeviceInitParams& initParams)
 void GfxDevice::Shutdown()
 {
   DestroyCommandAllocators();
+  m_samplerCache.clear();
   
   m_swapchain.Reset();
   m_commandQueue.Reset();
@@ -81,6 +83,11 @@ void GfxDevice::Shutdown()
 }
 
 GfxDevice::DescriptorHandle GfxDevice::GetSwapchainBufferDescriptor()
+{
+  return m_frameInfo[m_frameIndex].rtvDescriptorSrgb;
+}
+
+GfxDevice::DescriptorHandle GfxDevice::GetSwapchainBufferUnormDescriptor()
 {
   return m_frameInfo[m_frameIndex].rtvDescriptor;
 }
@@ -95,6 +102,12 @@ void GfxDevice::Submit(ID3D12CommandList* const commandList)
   m_commandQueue->ExecuteCommandLists(1, &commandList);
 }
 
+void GfxDevice::Submit(UINT count, ID3D12CommandList* const* commandLists)
+{
+  // 渡された順序で実行される.
+  m_commandQueue->ExecuteCommandLists(count, commandLists);
+}
+
 void GfxDevice::Present(UINT syncInterval, UINT flags)
 {
   if (m_swapchain)
@@ -118,26 +131,22 @@ void GfxDevice::Present(UINT syncInterval, UINT flags)
 
 void GfxDevice::NewFrame()
 {
-  m_frameInfo[m_frameIndex].commandAllocator->Reset();
+  for (auto& allocator : m_frameInfo[m_frameIndex].commandAllocators)
+  {
+    allocator->Reset();
+  }
 }
 
 void GfxDevice::WaitForGPU()
 {
-  ComPtr<ID3D12Fence1> fence;
-  HANDLE hWait = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-  HRESULT hr;
-  hr = m_d3d12Device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence));
-  ThrowIfFailed(hr, "CreateFenceに失敗");
-
-  auto frameIndex = GetFrameIndex();
-  const auto value = m_frameInfo[frameIndex].fenceValue;
-  m_commandQueue->Signal(m_frameFence.Get(), value);
-  m_frameFence->SetEventOnCompletion(value, hWait);
-  WaitForSingleObjectEx(hWait, INFINITE, FALSE);
-
-  m_frameInfo[frameIndex].fenceValue = value + 1;
-
-  CloseHandle(hWait);
+  // 呼び出しごとにフェンスを作成せず、フレームのフェンス値も変更しない.
+  const auto value = ++m_idleFenceValue;
+  m_commandQueue->Signal(m_idleFence.Get(), value);
+  if (m_idleFence->GetCompletedValue() < value)
+  {
+    m_idleFence->SetEventOnCompletion(value, m_waitFence);
+    WaitForSingleObjectEx(m_waitFence, INFINITE, FALSE);
+  }
 }
 
 
@@ -199,15 +208,66 @@ GfxDevice::ComPtr<ID3D12PipelineState> GfxDevice::CreateComputePipelineState(con
   return pso;
 }
 
-GfxDevice::ComPtr<ID3D12GraphicsCommandList> GfxDevice::CreateCommandList()
+ThreadGroupSize GfxDevice::GetThreadGroupSize(const D3D12_SHADER_BYTECODE& shader, const ThreadGroupSize& defaultSize)
+{
+  ThreadGroupSize groupSize;
+  if (ReflectThreadGroupSize(shader.pShaderBytecode, shader.BytecodeLength, groupSize))
+  {
+    return groupSize;
+  }
+  return defaultSize;
+}
+
+void GfxDevice::Dispatch(ID3D12GraphicsCommandList* commandList, const ThreadGroupSize& groupSize, UINT width, UINT height, UINT depth)
+{
+  const auto count = GetDispatchGroupCount(groupSize, width, height, depth);
+  if (count.x == 0)
+  {
+    return;
+  }
+  commandList->Dispatch(count.x, count.y, count.z);
+}
+
+void GfxDevice::DispatchForResource(ID3D12GraphicsCommandList* commandList, const ThreadGroupSize& groupSize, ID3D12Resource* resource, UINT mipLevel)
+{
+  const auto desc = resource->GetDesc();
+  UINT width = GetMipLevelSize(desc.Width, mipLevel);
+  UINT height = 1, depth = 1;
+  switch (desc.Dimension)
+  {
+  case D3D12_RESOURCE_DIMENSION_BUFFER:
+    width = UINT(desc.Width);
+    break;
+  case D3D12_RESOURCE_DIMENSION_TEXTURE1D:
+    depth = desc.DepthOrArraySize;
+    break;
+  case D3D12_RESOURCE_DIMENSION_TEXTURE2D:
+    height = GetMipLevelSize(desc.Height, mipLevel);
+    depth = desc.DepthOrArraySize;
+    break;
+  case D3D12_RESOURCE_DIMENSION_TEXTURE3D:
+    height = GetMipLevelSize(desc.Height, mipLevel);
+    depth = GetMipLevelSize(desc.DepthOrArraySize, mipLevel);
+    break;
+  default:
+    return;
+  }
+  Dispatch(commandList, groupSize, width, height, depth);
+}
+
+GfxDevice::ComPtr<ID3D12GraphicsCommandList> GfxDevice::CreateCommandList(UINT threadIndex)
 {
   ComPtr<ID3D12GraphicsCommandList> commandList;
   auto frameIndex = GetFrameIndex();
+  if (threadIndex >= m_commandThreadCount)
+  {
+    throw std::runtime_error("threadIndex is out of range.");
+  }
   
   HRESULT hr = m_d3d12Device->CreateCommandList(
     0,
     D3D12_COMMAND_LIST_TYPE_DIRECT,
-    m_frameInfo[frameIndex].commandAllocator.Get(),
+    m_frameInfo[frameIndex].commandAllocators[threadIndex].Get(),
     nullptr,
     IID_PPV_ARGS(&commandList)
   );
@@ -215,6 +275,30 @@ GfxDevice::ComPtr<ID3D12GraphicsCommandList> GfxDevice::CreateCommandList()
   return commandList;
 }
 
+GfxDevice::ComPtr<ID3D12GraphicsCommandList> GfxDevice::CreateCopyCommandList()
+{
+  auto allocator = AcquireCopyAllocator();
+  ComPtr<ID3D12GraphicsCommandList> commandList;
+  HRESULT hr = m_d3d12Device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, allocator.Get(), nullptr, IID_PPV_ARGS(&commandList));
+  ThrowIfFailed(hr, "CreateCommandListに失敗");
+  m_recordingCopyAllocators.emplace_back(commandList.Get(), allocator);
+  return commandList;
+}
+
+void GfxDevice::SubmitCopy(ID3D12GraphicsCommandList* commandList)
+{
+  auto it = std::find_if(m_recordingCopyAllocators.begin(), m_recordingCopyAllocators.end(),
+    [commandList](const auto& recording) { return recording.first == commandList; });
+  if (it == m_recordingCopyAllocators.end())
+  {
+    throw std::runtime_error("commandList was not created by CreateCopyCommandList.");
+  }
+  auto allocator = it->second;
+  m_recordingCopyAllocators.erase(it);
+  Submit(commandList);
+  ReleaseCopyAllocator(allocator);
+}
+
 GfxDevice::ComPtr<ID3D12Resource1> GfxDevice::CreateBuffer(const D3D12_RESOURCE_DESC& resDesc, D3D12_HEAP_TYPE heapType, D3D12_RESOURCE_STATES resourceState, const void* srcData)
 {
   bool useStaging = false;
@@ -225,10 +309,19 @@ GfxDevice::ComPtr<ID3D12Resource1> GfxDevice::CreateBuffer(const D3D12_RESOURCE_
     useStaging = true;
     initState = D3D12_RESOURCE_STATE_COMMON;
   }
-  if (heapType == D3D12_HEAP_TYPE_READBACK || heapType == D3D12_HEAP_TYPE_CUSTOM)
+  if (heapType == D3D12_HEAP_TYPE_CUSTOM)
   {
     throw std::runtime_error("Not Supported.");
   }
+  if (heapType == D3D12_HEAP_TYPE_READBACK)
+  {
+    // 読み返し用のヒープはコピー先の状態でしか作成できない. 初期データは持てない.
+    if (srcData != nullptr)
+    {
+      throw std::runtime_error("Not Supported.");
+    }
+    initState = D3D12_RESOURCE_STATE_COPY_DEST;
+  }
 
   D3D12_HEAP_PROPERTIES heapProps{
     .Type = heapType,
@@ -256,24 +349,41 @@ GfxDevice::ComPtr<ID3D12Resource1> GfxDevice::CreateBuffer(const D3D12_RESOURCE_
     }
     else
     {
-      // ステージングバッファを作成.
-      D3D12_HEAP_PROPERTIES uploadHeapProps(heapProps);
-      uploadHeapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
+      // 転送元は常駐のアップロードリングから確保する.
+      // リングの領域はフェンスで回収されるため、転送の完了を待つ必要はない.
+      auto& uploadRing = GetUploadRing();
+      UploadRing::Allocation allocation;
       ComPtr<ID3D12Resource1> staging;
-      hr = m_d3d12Device->CreateCommittedResource(&uploadHeapProps, D3D12_HEAP_FLAG_NONE, &resDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&staging));
-      ThrowIfFailed(hr, "CreateCommittedResourceに失敗(ステージングバッファ)");
-
-      void* p = nullptr;
-      staging->Map(0, nullptr, &p);
-      if (p)
+      ID3D12Resource1* srcBuffer = nullptr;
+      UINT64 srcOffset = 0;
+      if (uploadRing->Allocate(resDesc.Width, D3D12_RAW_UAV_SRV_BYTE_ALIGNMENT, allocation))
       {
-        memcpy(p, srcData, resDesc.Width);
-        staging->Unmap(0, nullptr);
+        memcpy(allocation.cpuAddress, srcData, resDesc.Width);
+        srcBuffer = allocation.resource;
+        srcOffset = allocation.offset;
+      }
+      else
+      {
+        // リングに収まらない場合はステージングバッファを作成.
+        D3D12_HEAP_PROPERTIES uploadHeapProps(heapProps);
+        uploadHeapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
+        hr = m_d3d12Device->CreateCommittedResource(&uploadHeapProps, D3D12_HEAP_FLAG_NONE, &resDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&staging));
+        ThrowIfFailed(hr, "CreateCommittedResourceに失敗(ステージングバッファ)");
+
+        void* p = nullptr;
+        staging->Map(0, nullptr, &p);
+        if (p)
+        {
+          memcpy(p, srcData, resDesc.Width);
+          staging->Unmap(0, nullptr);
+        }
+        srcBuffer = staging.Get();
       }
 
       // ステージングバッファから目的のバッファへ転送.
-      auto commandList = CreateCommandList();
-      commandList->CopyResource(retBuffer.Get(), staging.Get());
+      // フレームのアロケーターは次の NewFrame でリセットされるため、完了を追跡する転送用のものを使う.
+      auto commandList = CreateCopyCommandList();
+      commandList->CopyBufferRegion(retBuffer.Get(), 0, srcBuffer, srcOffset, resDesc.Width);
 
       // リソース状態を変更.
       D3D12_RESOURCE_BARRIER lastBarrier{
@@ -288,8 +398,15 @@ GfxDevice::ComPtr<ID3D12Resource1> GfxDevice::CreateBuffer(const D3D12_RESOURCE_
       };
       commandList->ResourceBarrier(1, &lastBarrier);
       commandList->Close();
-      Submit(commandList.Get());
-      WaitForGPU();
+      SubmitCopy(commandList.Get());
+      if (staging)
+      {
+        WaitForGPU();
+      }
+      else
+      {
+        uploadRing->Signal();
+      }
     }
   }
   return retBuffer;
@@ -330,6 +447,35 @@ GfxDevice::DescriptorHandle GfxDevice::CreateSampler(const D3D12_SAMPLER_DESC& s
   return descriptor;
 }
 
+GfxDevice::DescriptorHandle GfxDevice::GetSampler(const D3D12_SAMPLER_DESC& samplerDesc)
+{
+  if (auto itr = m_samplerCache.find(samplerDesc); itr != m_samplerCache.end())
+  {
+    return itr->second;
+  }
+  auto descriptor = CreateSampler(samplerDesc);
+  m_samplerCache.emplace(samplerDesc, descriptor);
+  return descriptor;
+}
+
+size_t GfxDevice::SamplerDescHash::operator()(const D3D12_SAMPLER_DESC& desc) const
+{
+  // D3D12_SAMPLER_DESC はパディングを含まないため、バイト列として FNV-1a でハッシュ化する.
+  auto bytes = reinterpret_cast<const uint8_t*>(&desc);
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < sizeof(desc); ++i)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return size_t(hash);
+}
+
+bool GfxDevice::SamplerDescEqual::operator()(const D3D12_SAMPLER_DESC& a, const D3D12_SAMPLER_DESC& b) const
+{
+  return memcmp(&a, &b, sizeof(D3D12_SAMPLER_DESC)) == 0;
+}
+
 GfxDevice::DescriptorHandle GfxDevice::AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE type)
 {
   DescriptorHandle handle = { };
@@ -372,9 +518,16 @@ GfxDevice::ComPtr<ID3D12DescriptorHeap> GfxDevice::GetDescriptorHeap(D3D12_DESCR
   return info->heap;
 }
 
-GfxDevice::ComPtr<ID3D12CommandAllocator> GfxDevice::GetD3D12CommandAllocator(int index)
+UINT GfxDevice::GetDescriptorIndex(const DescriptorHandle& descriptor)
 {
-  return m_frameInfo[index].commandAllocator;
+  auto info = GetDescriptorHeapInfo(descriptor.type);
+  auto heapStart = info->heap->GetCPUDescriptorHandleForHeapStart();
+  return UINT((descriptor.hCpu.ptr - heapStart.ptr) / info->handleSize);
+}
+
+GfxDevice::ComPtr<ID3D12CommandAllocator> GfxDevice::GetD3D12CommandAllocator(int index, UINT threadIndex)
+{
+  return m_frameInfo[index].commandAllocators[threadIndex];
 }
 
 void GfxDevice::ThrowIfFailed(HRESULT hr, const std::string& errorMsg)
@@ -410,9 +563,12 @@ void GfxDevice::SelectDevice()
   }
 }
 
-void GfxDevice::CreateSwapchain(DXGI_FORMAT dxgiFormat)
+void GfxDevice::CreateSwapchain(HWND hwnd, DXGI_FORMAT dxgiFormat)
 {
-  Win32Application::GetWindowSize(m_width, m_height);
+  RECT rect = { 0 };
+  GetClientRect(hwnd, &rect);
+  m_width = rect.right - rect.left;
+  m_height = rect.bottom - rect.top;
   m_dxgiFormat = dxgiFormat;
   ComPtr<IDXGISwapChain1> swapchain;
   DXGI_SWAP_CHAIN_DESC1 swapchainDesc{
@@ -428,7 +584,6 @@ void GfxDevice::CreateSwapchain(DXGI_FORMAT dxgiFormat)
     .Scaling = DXGI_SCALING_STRETCH,
     .SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD,
   };
-  HWND hwnd = Win32Application::GetHwnd();
   HRESULT hr = m_dxgiFactory->CreateSwapChainForHwnd(
     m_commandQueue.Get(),
     hwnd,
@@ -485,8 +640,20 @@ void GfxDevice::CreateDescriptorHeaps()
   ThrowIfFailed(hr, "ID3D12DescriptorHeap(Sampler)作成失敗");
 }
 
-void GfxDevice::PrepareRenderTargetView()
+void GfxDevice::PrepareRenderTargetView(bool srgb)
 {
+  // _SRGB 形式を持つ形式のみ sRGB の RTV を作成する.
+  m_rtvFormat = m_dxgiFormat;
+  if (srgb)
+  {
+    switch (m_dxgiFormat)
+    {
+    case DXGI_FORMAT_R8G8B8A8_UNORM: m_rtvFormat = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB; break;
+    case DXGI_FORMAT_B8G8R8A8_UNORM: m_rtvFormat = DXGI_FORMAT_B8G8R8A8_UNORM_SRGB; break;
+    default: break;
+    }
+  }
+
   // スワップチェインイメージへのレンダーターゲットビュー生成
   for (UINT i = 0; i < BackBufferCount; ++i)
   {
@@ -497,42 +664,107 @@ void GfxDevice::PrepareRenderTargetView()
     m_d3d12Device->CreateRenderTargetView(renderTarget.Get(), nullptr, descriptor.hCpu);
 
     m_frameInfo[i].rtvDescriptor = descriptor;
+    m_frameInfo[i].rtvDescriptorSrgb = descriptor;
     m_frameInfo[i].targetBuffer = renderTarget;
+
+    if (m_rtvFormat != m_dxgiFormat)
+    {
+      D3D12_RENDER_TARGET_VIEW_DESC rtvDesc{
+        .Format = m_rtvFormat,
+        .ViewDimension = D3D12_RTV_DIMENSION_TEXTURE2D,
+        .Texture2D = {.MipSlice = 0, .PlaneSlice = 0 },
+      };
+      auto descriptorSrgb = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+      m_d3d12Device->CreateRenderTargetView(renderTarget.Get(), &rtvDesc, descriptorSrgb.hCpu);
+      m_frameInfo[i].rtvDescriptorSrgb = descriptorSrgb;
+    }
   }
 }
 
-void GfxDevice::CreateCommandAllocators()
+void GfxDevice::CreateCommandAllocators(UINT threadCount)
 {
+  m_commandThreadCount = std::max(1u, threadCount);
   m_waitFence = CreateEvent(NULL, FALSE, FALSE, NULL);
   HRESULT hr;
   hr = m_d3d12Device->CreateFence(
     0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_frameFence)
   );
   ThrowIfFailed(hr, "CreateFenceに失敗.");
+  hr = m_d3d12Device->CreateFence(
+    0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_idleFence)
+  );
+  ThrowIfFailed(hr, "CreateFenceに失敗.");
+  m_idleFenceValue = 0;
+  hr = m_d3d12Device->CreateFence(
+    0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_copyFence)
+  );
+  ThrowIfFailed(hr, "CreateFenceに失敗.");
+  m_copyFenceValue = 0;
+  m_copyAllocators.clear();
 
   for (UINT i = 0; i < BackBufferCount; ++i)
   {
     auto& frame = m_frameInfo[i];
     frame.fenceValue = 0;
 
-    hr = m_d3d12Device->CreateCommandAllocator(
-      D3D12_COMMAND_LIST_TYPE_DIRECT,
-      IID_PPV_ARGS(&frame.commandAllocator)
-    );
-    ThrowIfFailed(hr, "CreateCommandAllocatorに失敗");
+    // コマンドリストを並列に記録するため、スレッドごとにアロケーターを用意する.
+    frame.commandAllocators.resize(m_commandThreadCount);
+    for (auto& allocator : frame.commandAllocators)
+    {
+      hr = m_d3d12Device->CreateCommandAllocator(
+        D3D12_COMMAND_LIST_TYPE_DIRECT,
+        IID_PPV_ARGS(&allocator)
+      );
+      ThrowIfFailed(hr, "CreateCommandAllocatorに失敗");
+    }
   }
 }
 
 void GfxDevice::DestroyCommandAllocators()
 {
+  // 実行中の転送が使っているアロケーターは完了を待ってから解放する.
+  if (m_copyFence && m_copyFence->GetCompletedValue() < m_copyFenceValue)
+  {
+    m_copyFence->SetEventOnCompletion(m_copyFenceValue, nullptr);
+  }
+  m_copyAllocators.clear();
+  m_recordingCopyAllocators.clear();
+  m_copyFence.Reset();
   m_frameFence.Reset();
+  m_idleFence.Reset();
   for (UINT i = 0; i < BackBufferCount; ++i)
   {
     auto& frame = m_frameInfo[i];
-    frame.commandAllocator.Reset();
+    frame.commandAllocators.clear();
   }
 }
 
+GfxDevice::ComPtr<ID3D12CommandAllocator> GfxDevice::AcquireCopyAllocator()
+{
+  // 提出順に並んでいるため、先頭が未完了なら後ろも未完了.
+  if (!m_copyAllocators.empty() && m_copyAllocators.front().fenceValue <= m_copyFence->GetCompletedValue())
+  {
+    auto allocator = m_copyAllocators.front().allocator;
+    m_copyAllocators.pop_front();
+    allocator->Reset();
+    return allocator;
+  }
+  ComPtr<ID3D12CommandAllocator> allocator;
+  HRESULT hr = m_d3d12Device->CreateCommandAllocator(
+    D3D12_COMMAND_LIST_TYPE_DIRECT,
+    IID_PPV_ARGS(&allocator)
+  );
+  ThrowIfFailed(hr, "CreateCommandAllocatorに失敗");
+  return allocator;
+}
+
+void GfxDevice::ReleaseCopyAllocator(ComPtr<ID3D12CommandAllocator> allocator)
+{
+  // 直前に提出したコマンドリストの完了でシグナルされる.
+  m_commandQueue->Signal(m_copyFence.Get(), ++m_copyFenceValue);
+  m_copyAllocators.push_back({ allocator, m_copyFenceValue });
+}
+
 GfxDevice::DescriptorHeapInfo* GfxDevice::GetDescriptorHeapInfo(D3D12_DESCRIPTOR_HEAP_TYPE type)
 {
   switch (type)
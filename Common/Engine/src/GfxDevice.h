@@ -0,0 +1,186 @@
+﻿#pragma once
+#include <memory>
+#include <vector>
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+#define NOMINMAX
+#include <d3d12.h>
+#include <wrl.h>
+#include <dxgi1_6.h>
+#include "ComputeDispatch.h"
+
+class GfxDevice
+{
+public:
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+
+  struct DeviceInitParams
+  {
+    HWND hwnd = nullptr;  // 描画先のウィンドウ. スワップチェインはクライアント領域の大きさで作成する.
+    DXGI_FORMAT formatDesired = DXGI_FORMAT_R8G8B8A8_UNORM;
+    UINT commandThreadCount = 1;  // コマンドを並列に記録するスレッド数.
+    // バックバッファへ _SRGB 形式の RTV で描画する(書き込み時に線形から sRGB へ変換される).
+    // フリップモデルのスワップチェインは _SRGB 形式で作成できないため、バッファ自体は UNORM のままとする.
+    bool srgbRenderTarget = false;
+  };
+  void Initialize(const DeviceInitParams& initParams);
+  void Shutdown();
+
+  static const int BackBufferCount = 2;
+  struct DescriptorHandle
+  {
+    D3D12_CPU_DESCRIPTOR_HANDLE hCpu;
+    D3D12_GPU_DESCRIPTOR_HANDLE hGpu;
+    D3D12_DESCRIPTOR_HEAP_TYPE  type;
+  };
+
+  // 現在処理対象フレームインデックスを取得.
+  UINT GetFrameIndex() const { return m_frameIndex; }
+  // srgbRenderTarget の場合は _SRGB 形式の RTV を返す.
+  DescriptorHandle GetSwapchainBufferDescriptor();
+  // 変換を行わない(UNORM の)RTV. sRGB の値をそのまま書き込む UI の描画などで使う.
+  DescriptorHandle GetSwapchainBufferUnormDescriptor();
+  ComPtr<ID3D12Resource1>     GetSwapchainBufferResource();
+
+  void Submit(ID3D12CommandList* const commandList);
+  void Submit(UINT count, ID3D12CommandList* const* commandLists);
+  void Present(UINT syncInterval, UINT flags = 0);
+  void NewFrame();
+  void WaitForGPU();
+
+  ComPtr<ID3D12Resource1> CreateBuffer(const D3D12_RESOURCE_DESC& resDesc, const D3D12_HEAP_PROPERTIES& heapProps);
+  ComPtr<ID3D12Resource1> CreateImage2D(const D3D12_RESOURCE_DESC& resDesc, const D3D12_HEAP_PROPERTIES& heapProps,
+    D3D12_RESOURCE_STATES resourceState, const D3D12_CLEAR_VALUE* clearValue);
+  ComPtr<ID3D12RootSignature> CreateRootSignature(ComPtr<ID3DBlob> rootSignatureBlob);
+  ComPtr<ID3D12PipelineState> CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& psoDesc);
+  ComPtr<ID3D12PipelineState> CreateComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC& psoDesc);
+  // コンパイル済みシェーダーのスレッドグループの大きさ. 読み取れない場合は defaultSize を返す.
+  static ThreadGroupSize GetThreadGroupSize(const D3D12_SHADER_BYTECODE& shader, const ThreadGroupSize& defaultSize);
+  // width x height x depth 個のスレッドを処理するのに必要な数のスレッドグループで Dispatch する.
+  static void Dispatch(ID3D12GraphicsCommandList* commandList, const ThreadGroupSize& groupSize, UINT width, UINT height = 1, UINT depth = 1);
+  // resource のミップレベル mipLevel を1テクセル1スレッドで処理する大きさで Dispatch する.
+  // 3D テクスチャは奥行き、テクスチャ配列はスライス数を z とする.
+  static void DispatchForResource(ID3D12GraphicsCommandList* commandList, const ThreadGroupSize& groupSize, ID3D12Resource* resource, UINT mipLevel = 0);
+  // threadIndex に対応したコマンドアロケーターを使ってコマンドリストを作成.
+  // 同じ threadIndex のコマンドリストを同時に記録してはならない.
+  ComPtr<ID3D12GraphicsCommandList> CreateCommandList(UINT threadIndex = 0);
+  // フレーム外で発行する転送用のコマンドリストを作成. 完了を追跡するアロケーターを使うため、
+  // 完了を待たずに NewFrame へ進んでもよい. Close してから SubmitCopy で提出すること.
+  ComPtr<ID3D12GraphicsCommandList> CreateCopyCommandList();
+  void SubmitCopy(ID3D12GraphicsCommandList* commandList);
+  UINT GetCommandThreadCount() const { return m_commandThreadCount; }
+
+  // D3D12_HEAP_TYPE_READBACK は resourceState に関わらず D3D12_RESOURCE_STATE_COPY_DEST で作成する(srcData は指定できない).
+  ComPtr<ID3D12Resource1> CreateBuffer(const D3D12_RESOURCE_DESC& resDesc, D3D12_HEAP_TYPE heapType, D3D12_RESOURCE_STATES resourceState = D3D12_RESOURCE_STATE_GENERIC_READ, const void* srcData = nullptr);
+  DescriptorHandle CreateDepthStencilView(ComPtr<ID3D12Resource1> depthImage, D3D12_DEPTH_STENCIL_VIEW_DESC& dsvDesc);
+  DescriptorHandle CreateConstantBufferView(const D3D12_CONSTANT_BUFFER_VIEW_DESC& cbvDesc);
+  DescriptorHandle CreateShaderResourceView(ComPtr<ID3D12Resource1> res, D3D12_SHADER_RESOURCE_VIEW_DESC& srvDesc);
+  DescriptorHandle CreateUnorderedAccessView(ComPtr<ID3D12Resource1> res, D3D12_UNORDERED_ACCESS_VIEW_DESC& uavDesc);
+  DescriptorHandle CreateSampler(const D3D12_SAMPLER_DESC& samplerDesc);
+  // 同一設定のサンプラーは作成済みのディスクリプタを返す.
+  // 返却したディスクリプタは共有されるため DeallocateDescriptor しないこと.
+  DescriptorHandle GetSampler(const D3D12_SAMPLER_DESC& samplerDesc);
+  size_t GetCachedSamplerCount() const { return m_samplerCache.size(); }
+  DXGI_FORMAT GetSwapchainFormat() const { return m_dxgiFormat; }
+  // GetSwapchainBufferDescriptor の RTV の形式. パイプラインの RTVFormats に使う.
+  DXGI_FORMAT GetRenderTargetFormat() const { return m_rtvFormat; }
+
+  // ディスクリプタ関連.
+  DescriptorHandle AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE type);
+  void DeallocateDescriptor(DescriptorHandle descriptor);
+  ComPtr<ID3D12DescriptorHeap> GetDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE type);
+  // ヒープ先頭からのインデックス. ヒープ全体をテーブルとして使う場合に使用.
+  UINT GetDescriptorIndex(const DescriptorHandle& descriptor);
+
+  // 内部オブジェクトを使うときに使用する.
+  //   主にD3D12の使い方をラップせずに見せたいとき.
+  ComPtr<ID3D12Device5> GetD3D12Device() { return m_d3d12Device; }
+  ComPtr<ID3D12CommandQueue> GetD3D12CommandQueue() { return m_commandQueue; }
+  ComPtr<ID3D12CommandAllocator> GetD3D12CommandAllocator(int index, UINT threadIndex = 0);
+
+private:
+  void ThrowIfFailed(HRESULT hr, const std::string& errorMsg);
+  void SelectDevice();
+  void CreateSwapchain(HWND hwnd, DXGI_FORMAT dxgiFormat);
+  void CreateDescriptorHeaps();
+  void PrepareRenderTargetView(bool srgb);
+  void CreateCommandAllocators(UINT threadCount);
+  void DestroyCommandAllocators();
+  ComPtr<ID3D12CommandAllocator> AcquireCopyAllocator();
+  void ReleaseCopyAllocator(ComPtr<ID3D12CommandAllocator> allocator);
+
+  ComPtr<ID3D12Device5> m_d3d12Device;
+  ComPtr<ID3D12CommandQueue> m_commandQueue;
+  ComPtr<IDXGIAdapter4> m_adapter;
+
+  int m_width = 0, m_height = 0;
+  DXGI_FORMAT m_dxgiFormat = DXGI_FORMAT_UNKNOWN;
+  DXGI_FORMAT m_rtvFormat = DXGI_FORMAT_UNKNOWN;
+  ComPtr<IDXGIFactory7> m_dxgiFactory;
+  ComPtr<IDXGISwapChain4> m_swapchain;
+
+  UINT   m_frameIndex = 0;
+  UINT   m_commandThreadCount = 1;
+  HANDLE m_waitFence;
+  ComPtr<ID3D12Fence1> m_frameFence;
+  // WaitForGPU 用. フレームのフェンス値とは独立に単調増加させる.
+  ComPtr<ID3D12Fence1> m_idleFence;
+  UINT64 m_idleFenceValue = 0;
+
+  // フレーム外で発行する転送(CreateBuffer の初期データ, CreateCopyCommandList)用のコマンドアロケーター.
+  // 初期化中など NewFrame/Present の外から呼ばれてもフレームのアロケーターを使わないよう、
+  // 提出ごとに m_copyFence をシグナルし、完了したものだけをリセットして再利用する.
+  struct CopyAllocator
+  {
+    ComPtr<ID3D12CommandAllocator> allocator;
+    UINT64 fenceValue = 0;
+  };
+  std::deque<CopyAllocator> m_copyAllocators;
+  // CreateCopyCommandList で作成し、まだ SubmitCopy されていないコマンドリストのアロケーター.
+  std::vector<std::pair<ID3D12CommandList*, ComPtr<ID3D12CommandAllocator>>> m_recordingCopyAllocators;
+  ComPtr<ID3D12Fence1> m_copyFence;
+  UINT64 m_copyFenceValue = 0;
+
+  // 描画フレーム情報
+  struct FrameInfo
+  {
+    UINT64 fenceValue = 0;
+    // スレッドごとのコマンドアロケーター(0番はメインスレッド用).
+    std::vector<ComPtr<ID3D12CommandAllocator>> commandAllocators;
+
+    DescriptorHandle rtvDescriptor;       // 描画先のRTV
+    DescriptorHandle rtvDescriptorSrgb;   // 描画先のRTV(_SRGB 形式). 無効な場合は rtvDescriptor と同じ.
+    ComPtr<ID3D12Resource1> targetBuffer; // 描画先バックバッファ.
+  };
+  FrameInfo m_frameInfo[BackBufferCount];
+
+  // DescriptorHeap
+  struct DescriptorHeapInfo
+  {
+    ComPtr<ID3D12DescriptorHeap> heap;
+    UINT handleSize = 0;
+    UINT usedIndex = 0;
+    std::vector<DescriptorHandle> freeHandles;
+  };
+  DescriptorHeapInfo* GetDescriptorHeapInfo(D3D12_DESCRIPTOR_HEAP_TYPE);
+  DescriptorHeapInfo m_rtvDescriptorHeap;
+  DescriptorHeapInfo m_dsvDescriptorHeap;
+  DescriptorHeapInfo m_srvDescriptorHeap;
+  DescriptorHeapInfo m_samplerDescriptorHeap;
+
+  // サンプラーキャッシュ. D3D12_SAMPLER_DESC の内容をキーとする.
+  struct SamplerDescHash
+  {
+    size_t operator()(const D3D12_SAMPLER_DESC& desc) const;
+  };
+  struct SamplerDescEqual
+  {
+    bool operator()(const D3D12_SAMPLER_DESC& a, const D3D12_SAMPLER_DESC& b) const;
+  };
+  std::unordered_map<D3D12_SAMPLER_DESC, DescriptorHandle, SamplerDescHash, SamplerDescEqual> m_samplerCache;
+};
+
+std::unique_ptr<GfxDevice>& GetGfxDevice();
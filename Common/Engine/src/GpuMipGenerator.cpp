@@ -0,0 +1,178 @@
+﻿#include "GpuMipGenerator.h"
+#include "FileLoader.h"
+
+#include <algorithm>
+
+static std::unique_ptr<GpuMipGenerator> gGpuMipGenerator = nullptr;
+
+std::unique_ptr<GpuMipGenerator>& GetGpuMipGenerator()
+{
+  if (gGpuMipGenerator == nullptr)
+  {
+    gGpuMipGenerator = std::make_unique<GpuMipGenerator>();
+  }
+  return gGpuMipGenerator;
+}
+
+void GpuMipGenerator::Initialize()
+{
+  auto& gfxDevice = GetGfxDevice();
+  auto d3d12Device = gfxDevice->GetD3D12Device();
+
+  // 縮小元のレベルも UAV として読むため、型付き UAV ロードの対応を確認する.
+  D3D12_FEATURE_DATA_FORMAT_SUPPORT formatSupport{ .Format = DXGI_FORMAT_R8G8B8A8_UNORM };
+  d3d12Device->CheckFeatureSupport(D3D12_FEATURE_FORMAT_SUPPORT, &formatSupport, sizeof(formatSupport));
+  if ((formatSupport.Support2 & D3D12_FORMAT_SUPPORT2_UAV_TYPED_LOAD) == 0)
+  {
+    return;
+  }
+
+  // u0: 縮小元, u1-u4: 出力先. 出力先ごとに別のテーブルとし、ディスクリプタの連続性を求めない.
+  D3D12_DESCRIPTOR_RANGE uavRanges[1 + MaxMipsPerDispatch];
+  D3D12_ROOT_PARAMETER rootParams[2 + MaxMipsPerDispatch];
+  rootParams[0] = D3D12_ROOT_PARAMETER{
+    .ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS,
+    .Constants = {
+      .ShaderRegister = 0,
+      .RegisterSpace = 0,
+      .Num32BitValues = 4,
+    },
+    .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL,
+  };
+  for (UINT i = 0; i < _countof(uavRanges); ++i)
+  {
+    uavRanges[i] = D3D12_DESCRIPTOR_RANGE{
+      .RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV,
+      .NumDescriptors = 1,
+      .BaseShaderRegister = i,
+      .RegisterSpace = 0,
+      .OffsetInDescriptorsFromTableStart = 0,
+    };
+    rootParams[1 + i] = D3D12_ROOT_PARAMETER{
+      .ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE,
+      .DescriptorTable = {
+        .NumDescriptorRanges = 1,
+        .pDescriptorRanges = &uavRanges[i],
+      },
+      .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL,
+    };
+  }
+  D3D12_ROOT_SIGNATURE_DESC rootSignatureDesc{
+    .NumParameters = _countof(rootParams),
+    .pParameters = rootParams,
+    .NumStaticSamplers = 0,
+    .pStaticSamplers = nullptr,
+    .Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE,
+  };
+  ComPtr<ID3DBlob> signature;
+  ComPtr<ID3DBlob> error;
+  D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error);
+  m_rootSignature = gfxDevice->CreateRootSignature(signature);
+
+  std::vector<char> csdata;
+  GetFileLoader()->Load(L"res/shader/GenerateMipsCS.cso", csdata);
+  m_groupSize = GfxDevice::GetThreadGroupSize({ csdata.data(), csdata.size() }, { 8, 8, 1 });
+  D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc{
+    .pRootSignature = m_rootSignature.Get(),
+    .CS = {
+      .pShaderBytecode = csdata.data(),
+      .BytecodeLength = csdata.size(),
+    },
+  };
+  m_pipeline = gfxDevice->CreateComputePipelineState(psoDesc);
+}
+
+void GpuMipGenerator::Shutdown()
+{
+  ReleasePendingDescriptors();
+  m_pipeline.Reset();
+  m_rootSignature.Reset();
+}
+
+void GpuMipGenerator::Generate(ComPtr<ID3D12GraphicsCommandList> commandList, ComPtr<ID3D12Resource1> texture)
+{
+  auto& gfxDevice = GetGfxDevice();
+  const auto texDesc = texture->GetDesc();
+  const UINT mipCount = texDesc.MipLevels;
+  if (!IsSupported() || mipCount <= 1)
+  {
+    return;
+  }
+
+  // 全レベル分の UAV を作成.
+  // _SRGB 形式は型付き UAV に使えないため、sRGB のテクスチャは UNORM として参照し、変換はシェーダーで行う.
+  const bool srgb = texDesc.Format == DXGI_FORMAT_R8G8B8A8_TYPELESS;
+  std::vector<GfxDevice::DescriptorHandle> uavs(mipCount);
+  for (UINT mip = 0; mip < mipCount; ++mip)
+  {
+    D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc{
+      .Format = srgb ? DXGI_FORMAT_R8G8B8A8_UNORM : texDesc.Format,
+      .ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D,
+      .Texture2D = {
+        .MipSlice = mip,
+        .PlaneSlice = 0,
+      },
+    };
+    uavs[mip] = gfxDevice->CreateUnorderedAccessView(texture, uavDesc);
+    m_pendingDescriptors.push_back(uavs[mip]);
+  }
+
+  ID3D12DescriptorHeap* heaps[] = {
+    gfxDevice->GetDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV).Get(),
+  };
+  commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+  commandList->SetComputeRootSignature(m_rootSignature.Get());
+  commandList->SetPipelineState(m_pipeline.Get());
+
+  auto getMipSize = [&](UINT mip) {
+    return std::make_pair(std::max(1u, UINT(texDesc.Width >> mip)), std::max(1u, UINT(texDesc.Height >> mip)));
+  };
+
+  for (UINT srcMip = 0; srcMip + 1 < mipCount;)
+  {
+    // グループ共有メモリ上で続けて縮小できるのは、縮小元のサイズが偶数の間のみ.
+    UINT mipsInDispatch = 1;
+    while (mipsInDispatch < MaxMipsPerDispatch && srcMip + mipsInDispatch + 1 < mipCount)
+    {
+      auto [width, height] = getMipSize(srcMip + mipsInDispatch);
+      if ((width & 1) != 0 || (height & 1) != 0)
+      {
+        break;
+      }
+      mipsInDispatch++;
+    }
+
+    auto [srcWidth, srcHeight] = getMipSize(srcMip);
+    auto [dstWidth, dstHeight] = getMipSize(srcMip + 1);
+    UINT constants[] = { srcWidth, srcHeight, mipsInDispatch, srgb ? 1u : 0u };
+    commandList->SetComputeRoot32BitConstants(0, _countof(constants), constants, 0);
+    commandList->SetComputeRootDescriptorTable(1, uavs[srcMip].hGpu);
+    for (UINT i = 0; i < MaxMipsPerDispatch; ++i)
+    {
+      // 使用しない出力先にも有効なディスクリプタを設定しておく.
+      auto dstMip = srcMip + 1 + std::min(i, mipsInDispatch - 1);
+      commandList->SetComputeRootDescriptorTable(2 + i, uavs[dstMip].hGpu);
+    }
+    GfxDevice::Dispatch(commandList.Get(), m_groupSize, dstWidth, dstHeight);
+
+    // 次のディスパッチで今回の出力を読むため UAV バリアを設定.
+    D3D12_RESOURCE_BARRIER barrier{
+      .Type = D3D12_RESOURCE_BARRIER_TYPE_UAV,
+      .UAV = {
+        .pResource = texture.Get(),
+      },
+    };
+    commandList->ResourceBarrier(1, &barrier);
+    srcMip += mipsInDispatch;
+  }
+}
+
+void GpuMipGenerator::ReleasePendingDescriptors()
+{
+  auto& gfxDevice = GetGfxDevice();
+  for (auto& descriptor : m_pendingDescriptors)
+  {
+    gfxDevice->DeallocateDescriptor(descriptor);
+  }
+  m_pendingDescriptors.clear();
+}
@@ -0,0 +1,40 @@
+﻿#pragma once
+#include <memory>
+#include <vector>
+#include "GfxDevice.h"
+
+// コンピュートシェーダーによるミップマップ作成.
+// アップロード直後のテクスチャやレンダーターゲットに、CPU を経由せずミップマップを作成する.
+// 結果は CPU の参照実装 GenerateMipLevelsReference と一致する.
+// シェーダー(GenerateMipsCS.hlsl)は使用するアプリケーション側で res/shader にビルドしておくこと.
+class GpuMipGenerator
+{
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+public:
+  void Initialize();
+  void Shutdown();
+
+  // R8G8B8A8_UNORM の UAV ロードに対応していない環境では使用できない.
+  bool IsSupported() const { return m_pipeline != nullptr; }
+
+  // mip0 から残りのレベルを作成するコマンドを記録する.
+  // texture は R8G8B8A8_UNORM で D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS 付きで作成し、
+  // 全サブリソースを D3D12_RESOURCE_STATE_UNORDERED_ACCESS にしておくこと.
+  // sRGB のテクスチャは R8G8B8A8_TYPELESS で作成する. UNORM の UAV で読み書きし、RGB は線形空間で平均する.
+  void Generate(ComPtr<ID3D12GraphicsCommandList> commandList, ComPtr<ID3D12Resource1> texture);
+
+  // Generate で使用したディスクリプタを解放する. GPU の処理完了後に呼ぶこと.
+  void ReleasePendingDescriptors();
+
+private:
+  static const UINT MaxMipsPerDispatch = 4;
+
+  ComPtr<ID3D12RootSignature> m_rootSignature;
+  ComPtr<ID3D12PipelineState> m_pipeline;
+  // 1スレッドが最初の出力レベルの1テクセルを担当する. 続くレベルはグループ内で縮小するため 8x8 を前提とする.
+  ThreadGroupSize m_groupSize = { 8, 8, 1 };
+  std::vector<GfxDevice::DescriptorHandle> m_pendingDescriptors;
+};
+
+std::unique_ptr<GpuMipGenerator>& GetGpuMipGenerator();
@@ -0,0 +1,293 @@
+﻿#include "ImageBatch.h"
+#include "ImageFilterCpu.h"
+#include "JobSystem.h"
+#include "DdsFile.h"
+#include "PngFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+  bool IsImageFileExtension(const std::filesystem::path& path)
+  {
+    auto ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return char(std::tolower(uint8_t(c))); });
+    const char* supported[] = { ".png", ".jpg", ".jpeg", ".tga", ".bmp", ".psd", ".gif", ".hdr", ".pic", ".pnm", ".dds" };
+    return std::find(std::begin(supported), std::end(supported), ext) != std::end(supported);
+  }
+
+  // 経過時間をマイクロ秒単位で加算する.
+  class StageTimer
+  {
+  public:
+    explicit StageTimer(std::atomic<uint64_t>& total) : m_total(total), m_start(std::chrono::high_resolution_clock::now()) {}
+    ~StageTimer()
+    {
+      auto elapsed = std::chrono::high_resolution_clock::now() - m_start;
+      m_total.fetch_add(uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()), std::memory_order_relaxed);
+    }
+  private:
+    std::atomic<uint64_t>& m_total;
+    std::chrono::high_resolution_clock::time_point m_start;
+  };
+
+  struct BatchItem
+  {
+    ImageBatchItemResult result;
+    std::vector<char> fileData;
+    DecodedImage image;
+    std::vector<uint8_t> encoded;
+    JobSystem::JobGroup group;
+  };
+}
+
+std::vector<ImageBatchEntry> CollectImageBatchEntries(const std::vector<std::filesystem::path>& inputs)
+{
+  std::vector<ImageBatchEntry> entries;
+  for (const auto& input : inputs)
+  {
+    std::error_code ec;
+    if (std::filesystem::is_directory(input, ec))
+    {
+      std::vector<ImageBatchEntry> found;
+      for (auto it = std::filesystem::recursive_directory_iterator(input, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+      {
+        if (it->is_regular_file(ec) && IsImageFileExtension(it->path()))
+        {
+          auto relative = std::filesystem::relative(it->path(), input, ec);
+          found.push_back({ it->path(), relative.replace_extension() });
+        }
+      }
+      // 実行ごとに同じ順序で処理する.
+      std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) { return a.input < b.input; });
+      entries.insert(entries.end(), found.begin(), found.end());
+    }
+    else
+    {
+      entries.push_back({ input, input.stem() });
+    }
+  }
+  return entries;
+}
+
+ImageBatchStats RunImageBatch(const ImageBatchSettings& settings, const ImageFilterPlan& plan)
+{
+  auto startTime = std::chrono::high_resolution_clock::now();
+  auto& jobSystem = GetJobSystem();
+  const auto entries = CollectImageBatchEntries(settings.inputs);
+  const uint32_t maxInFlight = settings.maxImagesInFlight > 0 ? settings.maxImagesInFlight : jobSystem->GetThreadCount() * 2;
+  const char* outputExtension = settings.outputFormat == ImageBatchOutputFormat::DDS ? ".dds" : ".png";
+
+  ImageBatchStats stats;
+  stats.imageCount = uint32_t(entries.size());
+  std::atomic<uint64_t> readUs = 0, decodeUs = 0, filterUs = 0, encodeUs = 0, writeUs = 0;
+  std::atomic<uint64_t> pixelCount = 0;
+
+  std::mutex mutex;
+  std::condition_variable stateChanged;
+  std::deque<BatchItem*> writeQueue;
+  uint32_t inFlight = 0;
+  bool readFinished = false;
+
+  auto pushToWriter = [&](BatchItem* item) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      writeQueue.push_back(item);
+    }
+    stateChanged.notify_all();
+  };
+
+  // 書き出しスレッド. 完了した画像を順不同で書き出し、メモリを解放する.
+  std::thread writer([&]() {
+    while (true)
+    {
+      BatchItem* item = nullptr;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        stateChanged.wait(lock, [&] { return !writeQueue.empty() || (readFinished && inFlight == 0); });
+        if (writeQueue.empty())
+        {
+          break;
+        }
+        item = writeQueue.front();
+        writeQueue.pop_front();
+      }
+
+      auto& result = item->result;
+      if (result.succeeded && !result.skipped)
+      {
+        StageTimer timer(writeUs);
+        std::error_code ec;
+        std::filesystem::create_directories(result.output.parent_path(), ec);
+        std::ofstream outfile(result.output, std::ios::binary);
+        outfile.write(reinterpret_cast<const char*>(item->encoded.data()), item->encoded.size());
+        if (!outfile)
+        {
+          result.succeeded = false;
+          result.error = "write failed";
+        }
+      }
+      if (result.skipped)
+      {
+        stats.skippedCount++;
+      }
+      else if (result.succeeded)
+      {
+        stats.succeededCount++;
+      }
+      else
+      {
+        stats.failedCount++;
+      }
+      if (settings.onItemFinished)
+      {
+        settings.onItemFinished(result);
+      }
+      // 項目自体はジョブの完了まで残し、画像のメモリだけ解放する.
+      item->encoded = std::vector<uint8_t>();
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        --inFlight;
+      }
+      stateChanged.notify_all();
+    }
+  });
+
+  // 展開・フィルタ・圧縮. JobSystem のワーカーで画像ごとに行う.
+  auto process = [&](BatchItem* item) {
+    auto& result = item->result;
+    {
+      StageTimer timer(decodeUs);
+      if (!DecodeImage(item->fileData.data(), item->fileData.size(), item->image))
+      {
+        result.error = "decode failed";
+        return;
+      }
+      item->fileData = std::vector<char>();
+      if (item->image.format != ImageFormat::RGBA8)
+      {
+        result.error = "compressed formats are not supported";
+        return;
+      }
+      // フィルタは mip0 のみに適用する.
+      item->image.mipLevels.resize(1);
+    }
+    {
+      StageTimer timer(filterUs);
+      bool filtered = false;
+      if (settings.filter)
+      {
+        filtered = settings.filter(item->image);
+      }
+      else
+      {
+        const auto& level = item->image.mipLevels[0];
+        ImageFilterSurface surface{
+          .format = ImageFilterPixelFormat::RGBA8,
+          .width = level.width,
+          .height = level.height,
+          .rowPitch = level.rowPitch,
+          .data = item->image.GetLevelData(0),
+        };
+        ExecuteImageFilterPlanCpu(plan, surface, surface, settings.filterThreadsPerImage);
+        filtered = true;
+      }
+      if (!filtered)
+      {
+        result.error = "filter failed";
+        return;
+      }
+    }
+    {
+      StageTimer timer(encodeUs);
+      bool encoded = settings.outputFormat == ImageBatchOutputFormat::DDS ?
+        EncodeDDS(item->image, item->encoded) : EncodePNG(item->image, item->encoded);
+      if (!encoded)
+      {
+        result.error = "encode failed";
+        return;
+      }
+    }
+    pixelCount.fetch_add(uint64_t(item->image.GetWidth()) * item->image.GetHeight(), std::memory_order_relaxed);
+    item->image = DecodedImage();
+    result.succeeded = true;
+  };
+
+  // 呼び出し元のスレッドで順に読み込み、処理中の画像が上限に達したら書き出しを待つ.
+  std::vector<std::unique_ptr<BatchItem>> items;
+  items.reserve(entries.size());
+  for (const auto& entry : entries)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      stateChanged.wait(lock, [&] { return inFlight < maxInFlight; });
+      ++inFlight;
+    }
+
+    items.push_back(std::make_unique<BatchItem>());
+    auto item = items.back().get();
+    item->result.input = entry.input;
+    item->result.output = settings.outputDirectory / entry.relativeOutput;
+    item->result.output += outputExtension;
+    std::error_code ec;
+    if (settings.skipExisting && std::filesystem::exists(item->result.output, ec))
+    {
+      item->result.succeeded = true;
+      item->result.skipped = true;
+      pushToWriter(item);
+      continue;
+    }
+
+    bool loaded = false;
+    {
+      StageTimer timer(readUs);
+      std::ifstream infile(entry.input, std::ios::binary);
+      if (infile)
+      {
+        auto size = infile.seekg(0, std::ios::end).tellg();
+        item->fileData.resize(size_t(size));
+        loaded = bool(infile.seekg(0, std::ios::beg).read(item->fileData.data(), size));
+      }
+    }
+    if (!loaded)
+    {
+      item->result.error = "read failed";
+      pushToWriter(item);
+      continue;
+    }
+
+    jobSystem->Run(item->group, 1, [&, item](uint32_t, uint32_t) {
+      process(item);
+      pushToWriter(item);
+    });
+  }
+  for (auto& item : items)
+  {
+    jobSystem->Wait(item->group);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    readFinished = true;
+  }
+  stateChanged.notify_all();
+  writer.join();
+
+  auto endTime = std::chrono::high_resolution_clock::now();
+  stats.elapsedMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+  stats.pixelCount = pixelCount.load();
+  stats.readMs = readUs.load() / 1000.0;
+  stats.decodeMs = decodeUs.load() / 1000.0;
+  stats.filterMs = filterUs.load() / 1000.0;
+  stats.encodeMs = encodeUs.load() / 1000.0;
+  stats.writeMs = writeUs.load() / 1000.0;
+  return stats;
+}
@@ -0,0 +1,75 @@
+﻿#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+#include "ImageFilter.h"
+#include "TextureDecode.h"
+
+enum class ImageBatchOutputFormat : uint32_t
+{
+  PNG,
+  DDS,  // RGBA8 のまま格納する.
+};
+
+// 1枚ごとの処理結果.
+struct ImageBatchItemResult
+{
+  std::filesystem::path input;
+  std::filesystem::path output;
+  bool succeeded = false;
+  bool skipped = false;  // 出力が既にあったため処理しなかった.
+  std::string error;
+};
+
+struct ImageBatchSettings
+{
+  // 入力のファイルまたはディレクトリ. ディレクトリはサブディレクトリも含めて画像ファイルを探し、
+  // 出力先にも同じ相対パスで書き出す.
+  std::vector<std::filesystem::path> inputs;
+  std::filesystem::path outputDirectory;
+  ImageBatchOutputFormat outputFormat = ImageBatchOutputFormat::PNG;
+  // 読み込みから書き出しまでの間に同時に存在する画像の上限(メモリ使用量の上限). 0 ならスレッド数の2倍.
+  uint32_t maxImagesInFlight = 0;
+  // 1枚のフィルタ処理に使うスレッド数. 画像単位で並列に処理するため、既定では分割しない.
+  uint32_t filterThreadsPerImage = 1;
+  bool skipExisting = false;
+
+  // フィルタ処理. 未設定なら ExecuteImageFilterPlanCpu で行う. 複数のスレッドから同時に呼ばれる.
+  std::function<bool(DecodedImage& image)> filter;
+  // 1枚の処理が終わるたびに書き出しスレッドから呼ばれる.
+  std::function<void(const ImageBatchItemResult& result)> onItemFinished;
+};
+
+struct ImageBatchStats
+{
+  uint32_t imageCount = 0;
+  uint32_t succeededCount = 0;
+  uint32_t skippedCount = 0;
+  uint32_t failedCount = 0;
+  uint64_t pixelCount = 0;
+  double   elapsedMs = 0;
+  // 各段階にかかった時間の合計. 段階同士が重なって処理されるため、和は elapsedMs より大きくなりうる.
+  double   readMs = 0;
+  double   decodeMs = 0;
+  double   filterMs = 0;
+  double   encodeMs = 0;
+  double   writeMs = 0;
+
+  double GetMegaPixelsPerSecond() const { return elapsedMs > 0 ? double(pixelCount) / (elapsedMs * 1000.0) : 0.0; }
+  double GetImagesPerSecond() const { return elapsedMs > 0 ? succeededCount * 1000.0 / elapsedMs : 0.0; }
+};
+
+// 入力に含まれる画像ファイルと、出力先からの相対パス(拡張子を除く).
+struct ImageBatchEntry
+{
+  std::filesystem::path input;
+  std::filesystem::path relativeOutput;
+};
+std::vector<ImageBatchEntry> CollectImageBatchEntries(const std::vector<std::filesystem::path>& inputs);
+
+// 画像をまとめてフィルタ処理して書き出す.
+// 呼び出したスレッドがファイルを読み込み、展開・フィルタ・圧縮は JobSystem のジョブ、書き出しは専用のスレッドで行う.
+// 画像ごとにこれらの段階を順に進めるため、ある画像の読み込み中に別の画像のフィルタ処理や書き出しが進む.
+ImageBatchStats RunImageBatch(const ImageBatchSettings& settings, const ImageFilterPlan& plan);
@@ -0,0 +1,501 @@
+﻿#include "ImageFilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace
+{
+  ImageFilterOp MakeMatrixOp(const float matrix[12])
+  {
+    ImageFilterOp op{ .type = ImageFilterOpType::ColorMatrix };
+    std::copy_n(matrix, 12, op.matrix);
+    return op;
+  }
+
+  // first を適用した後に second を適用する行列を求める.
+  void ConcatColorMatrix(const float first[12], const float second[12], float outMatrix[12])
+  {
+    float result[12];
+    for (int row = 0; row < 3; ++row)
+    {
+      for (int col = 0; col < 4; ++col)
+      {
+        float v = (col == 3) ? second[row * 4 + 3] : 0.0f;
+        for (int k = 0; k < 3; ++k)
+        {
+          v += second[row * 4 + k] * first[k * 4 + col];
+        }
+        result[row * 4 + col] = v;
+      }
+    }
+    std::copy_n(result, 12, outMatrix);
+  }
+
+  // 直前の演算に next をまとめられれば true.
+  bool TryMergeOp(ImageFilterOp& prev, const ImageFilterOp& next)
+  {
+    if (prev.type != next.type)
+    {
+      return false;
+    }
+    switch (next.type)
+    {
+    case ImageFilterOpType::ColorMatrix:
+      ConcatColorMatrix(prev.matrix, next.matrix, prev.matrix);
+      return true;
+    case ImageFilterOpType::HueShift:
+      prev.params[0] = prev.params[0] + next.params[0];
+      prev.params[0] -= std::floor(prev.params[0]);
+      return true;
+    default:
+      return false;
+    }
+  }
+}
+
+bool IsPerPixelImageFilter(ImageFilterType type)
+{
+  return type != ImageFilterType::Blur && type != ImageFilterType::Sharpen;
+}
+
+bool IsMeasuredImageFilter(ImageFilterType type)
+{
+  return type == ImageFilterType::AutoExposure || type == ImageFilterType::AutoLevels;
+}
+
+bool IsBlurImageFilterKernel(ImageFilterKernel kernel)
+{
+  return kernel == ImageFilterKernel::BlurHorizontal || kernel == ImageFilterKernel::BlurVertical
+    || kernel == ImageFilterKernel::BlurTransposed;
+}
+
+const char* GetImageFilterName(ImageFilterType type)
+{
+  switch (type)
+  {
+  case ImageFilterType::Sepia: return "Sepia";
+  case ImageFilterType::HueShift: return "Hue Shift";
+  case ImageFilterType::ColorMatrix: return "Color Matrix";
+  case ImageFilterType::ToneMap: return "Tone Map";
+  case ImageFilterType::Blur: return "Blur";
+  case ImageFilterType::Sharpen: return "Sharpen";
+  case ImageFilterType::AutoExposure: return "Auto Exposure";
+  case ImageFilterType::AutoLevels: return "Auto Levels";
+  default: return "Unknown";
+  }
+}
+
+ImageFilterNode MakeImageFilterNode(ImageFilterType type)
+{
+  ImageFilterNode node{ .type = type };
+  switch (type)
+  {
+  case ImageFilterType::Sepia:
+    node.params[0] = 1.0f;
+    break;
+  case ImageFilterType::HueShift:
+    node.params[0] = 0.5f;
+    break;
+  case ImageFilterType::ColorMatrix:
+    node.params[0] = 0.0f;
+    node.params[1] = 1.0f;
+    node.params[2] = 1.0f;
+    MakeColorAdjustMatrix(node.params[0], node.params[1], node.params[2], node.matrix);
+    break;
+  case ImageFilterType::ToneMap:
+    node.params[0] = 0.0f;
+    node.params[1] = 1.0f;
+    break;
+  case ImageFilterType::Blur:
+    node.params[0] = 4.0f;
+    node.params[1] = 2.0f;
+    break;
+  case ImageFilterType::Sharpen:
+    node.params[0] = 0.5f;
+    break;
+  case ImageFilterType::AutoExposure:
+    // 中間グレー(18%)に合わせ、暗い半分と明るい 5% を測光から除く.
+    node.params[0] = 0.18f;
+    node.params[1] = 50.0f;
+    node.params[2] = 95.0f;
+    node.params[3] = 0.0f;
+    break;
+  case ImageFilterType::AutoLevels:
+    node.params[0] = 0.5f;
+    node.params[1] = 99.5f;
+    node.params[2] = 0.0f;
+    node.params[3] = 1.0f;
+    break;
+  default:
+    break;
+  }
+  return node;
+}
+
+bool ParseImageFilterChain(const std::string& text, std::vector<ImageFilterNode>& outChain)
+{
+  static const struct
+  {
+    const char* name;
+    ImageFilterType type;
+  } names[] = {
+    { "sepia", ImageFilterType::Sepia },
+    { "hue", ImageFilterType::HueShift },
+    { "matrix", ImageFilterType::ColorMatrix },
+    { "tonemap", ImageFilterType::ToneMap },
+    { "blur", ImageFilterType::Blur },
+    { "sharpen", ImageFilterType::Sharpen },
+    { "autoexposure", ImageFilterType::AutoExposure },
+    { "autolevels", ImageFilterType::AutoLevels },
+  };
+
+  std::vector<ImageFilterNode> chain;
+  size_t start = 0;
+  while (start < text.size())
+  {
+    size_t end = text.find(',', start);
+    if (end == std::string::npos)
+    {
+      end = text.size();
+    }
+    // 名前とパラメータに分ける.
+    std::vector<std::string> fields;
+    size_t fieldStart = start;
+    while (true)
+    {
+      size_t fieldEnd = std::min(text.find(':', fieldStart), end);
+      fields.push_back(text.substr(fieldStart, fieldEnd - fieldStart));
+      if (fieldEnd == end)
+      {
+        break;
+      }
+      fieldStart = fieldEnd + 1;
+    }
+    start = end + 1;
+    if (fields[0].empty() && fields.size() == 1)
+    {
+      continue;
+    }
+
+    auto found = std::find_if(std::begin(names), std::end(names), [&](const auto& entry) { return fields[0] == entry.name; });
+    if (found == std::end(names) || fields.size() > 5)
+    {
+      return false;
+    }
+    auto node = MakeImageFilterNode(found->type);
+    for (size_t i = 1; i < fields.size(); ++i)
+    {
+      char* parsedEnd = nullptr;
+      float value = std::strtof(fields[i].c_str(), &parsedEnd);
+      if (fields[i].empty() || *parsedEnd != '\0')
+      {
+        return false;
+      }
+      node.params[i - 1] = value;
+    }
+    if (node.type == ImageFilterType::ColorMatrix)
+    {
+      MakeColorAdjustMatrix(node.params[0], node.params[1], node.params[2], node.matrix);
+    }
+    chain.push_back(node);
+  }
+  outChain = std::move(chain);
+  return true;
+}
+
+void MakeColorAdjustMatrix(float brightness, float contrast, float saturation, float outMatrix[12])
+{
+  // 彩度は輝度(BT.709)との補間、コントラストは 0.5 を中心に拡大する.
+  const float luma[3] = { 0.2126f, 0.7152f, 0.0722f };
+  for (int row = 0; row < 3; ++row)
+  {
+    for (int col = 0; col < 3; ++col)
+    {
+      float v = (1.0f - saturation) * luma[col] + (row == col ? saturation : 0.0f);
+      outMatrix[row * 4 + col] = contrast * v;
+    }
+    outMatrix[row * 4 + 3] = 0.5f * (1.0f - contrast) + brightness;
+  }
+}
+
+ImageFilterPlan PlanImageFilterChain(const std::vector<ImageFilterNode>& chain, const ImageFilterPlanOptions& options)
+{
+  // パスごとに演算を集めてから、最後に1つの配列へ詰める.
+  struct PassBuild
+  {
+    ImageFilterPass pass;
+    std::vector<ImageFilterOp> ops;
+  };
+  std::vector<PassBuild> builds;
+
+  auto appendOp = [&](const ImageFilterOp& op) {
+    if (!builds.empty())
+    {
+      auto& ops = builds.back().ops;
+      if (!ops.empty() && TryMergeOp(ops.back(), op))
+      {
+        return;
+      }
+      if (ops.size() < ImageFilterMaxOpsPerPass)
+      {
+        ops.push_back(op);
+        return;
+      }
+    }
+    builds.push_back({});
+    builds.back().ops.push_back(op);
+  };
+
+  for (const auto& node : chain)
+  {
+    if (!node.enabled)
+    {
+      continue;
+    }
+    if (IsPerPixelImageFilter(node.type))
+    {
+      ImageFilterOp op;
+      switch (node.type)
+      {
+      case ImageFilterType::Sepia:
+        {
+          // mul(rgb, toSepia) の行列を列ベクトル用に並べたもの.
+          const float sepia[9] = {
+            0.393f, 0.769f, 0.189f,
+            0.349f, 0.686f, 0.168f,
+            0.272f, 0.534f, 0.131f,
+          };
+          const float strength = node.params[0];
+          float matrix[12] = { };
+          for (int row = 0; row < 3; ++row)
+          {
+            for (int col = 0; col < 3; ++col)
+            {
+              float identity = (row == col) ? 1.0f : 0.0f;
+              matrix[row * 4 + col] = identity + (sepia[row * 3 + col] - identity) * strength;
+            }
+          }
+          op = MakeMatrixOp(matrix);
+        }
+        break;
+      case ImageFilterType::HueShift:
+        op.type = ImageFilterOpType::HueShift;
+        op.params[0] = node.params[0] - std::floor(node.params[0]);
+        break;
+      case ImageFilterType::ColorMatrix:
+        op = MakeMatrixOp(node.matrix);
+        break;
+      case ImageFilterType::ToneMap:
+        // 露出は倍率にしておく.
+        op.type = ImageFilterOpType::ToneMap;
+        op.params[0] = std::exp2(node.params[0]);
+        op.params[1] = node.params[1];
+        break;
+      case ImageFilterType::AutoExposure:
+        {
+          // 求めた露出を掛ける行列にする. 前後の色行列とまとめられる.
+          const float scale = std::exp2(node.params[3]);
+          const float matrix[12] = {
+            scale, 0.0f, 0.0f, 0.0f,
+            0.0f, scale, 0.0f, 0.0f,
+            0.0f, 0.0f, scale, 0.0f,
+          };
+          op = MakeMatrixOp(matrix);
+        }
+        break;
+      case ImageFilterType::AutoLevels:
+        {
+          // 黒と白の輝度を 0 と 1 へ移す. RGB に同じ変換を行い色味は変えない.
+          const float range = node.params[3] - node.params[2];
+          const float scale = range > 0.0f ? 1.0f / range : 1.0f;
+          const float offset = range > 0.0f ? -node.params[2] * scale : 0.0f;
+          const float matrix[12] = {
+            scale, 0.0f, 0.0f, offset,
+            0.0f, scale, 0.0f, offset,
+            0.0f, 0.0f, scale, offset,
+          };
+          op = MakeMatrixOp(matrix);
+        }
+        break;
+      default:
+        continue;
+      }
+      appendOp(op);
+      continue;
+    }
+
+    const float amount = node.params[0];
+    const int radius = std::min(int(std::round(amount)), int(ImageFilterMaxBlurRadius));
+    if ((node.type == ImageFilterType::Blur && radius <= 0) || (node.type == ImageFilterType::Sharpen && amount == 0.0f))
+    {
+      continue;
+    }
+
+    // 直前のパスの末尾にある色行列は、このフィルタの後に適用する.
+    std::vector<ImageFilterOp> carried;
+    if (!builds.empty())
+    {
+      auto& ops = builds.back().ops;
+      while (!ops.empty() && ops.back().type == ImageFilterOpType::ColorMatrix)
+      {
+        carried.insert(carried.begin(), ops.back());
+        ops.pop_back();
+      }
+      // 何もしないコピーになったパスは除く.
+      if (builds.back().pass.kernel == ImageFilterKernel::PerPixel && ops.empty())
+      {
+        builds.pop_back();
+      }
+    }
+
+    if (node.type == ImageFilterType::Blur)
+    {
+      const auto horizontal = options.transposedBlur ? ImageFilterKernel::BlurTransposed : ImageFilterKernel::BlurHorizontal;
+      const auto vertical = options.transposedBlur ? ImageFilterKernel::BlurTransposed : ImageFilterKernel::BlurVertical;
+      for (auto kernel : { horizontal, vertical })
+      {
+        PassBuild build;
+        build.pass.kernel = kernel;
+        build.pass.kernelParams[0] = float(radius);
+        build.pass.kernelParams[1] = std::max(node.params[1], 0.0f);
+        builds.push_back(build);
+      }
+    }
+    else
+    {
+      PassBuild build;
+      build.pass.kernel = ImageFilterKernel::Sharpen;
+      build.pass.kernelParams[0] = amount;
+      builds.push_back(build);
+    }
+    for (const auto& op : carried)
+    {
+      appendOp(op);
+    }
+  }
+
+  if (builds.empty())
+  {
+    builds.push_back({});
+  }
+
+  ImageFilterPlan plan;
+  // 縦横を入れ替えた中間画像は大きさが異なるため、別のスロットの組から割り当てる.
+  std::vector<TransientLifetime> lifetimes[2];
+  std::vector<uint32_t> lifetimeIndices;  // パスの出力に対応する lifetimes[transposed] の要素番号.
+  std::vector<bool> outputTransposed;
+  bool transposed = false;
+  for (uint32_t i = 0; i < uint32_t(builds.size()); ++i)
+  {
+    auto pass = builds[i].pass;
+    pass.firstOp = uint32_t(plan.ops.size());
+    pass.opCount = uint32_t(builds[i].ops.size());
+    plan.ops.insert(plan.ops.end(), builds[i].ops.begin(), builds[i].ops.end());
+    plan.passes.push_back(pass);
+    if (pass.kernel == ImageFilterKernel::BlurTransposed)
+    {
+      transposed = !transposed;
+    }
+    if (i + 1 < builds.size())
+    {
+      // 各パスの出力は次のパスだけが読む.
+      lifetimeIndices.push_back(uint32_t(lifetimes[transposed].size()));
+      lifetimes[transposed].push_back({ .firstPass = i, .lastPass = i + 1 });
+      outputTransposed.push_back(transposed);
+    }
+  }
+
+  uint32_t slotCounts[2] = { };
+  std::vector<uint32_t> slots[2] = {
+    AssignTransientSlots(lifetimes[0], slotCounts[0]),
+    AssignTransientSlots(lifetimes[1], slotCounts[1]),
+  };
+  plan.transientSlotCount = slotCounts[0] + slotCounts[1];
+  plan.transientSlotTransposed.assign(plan.transientSlotCount, false);
+  std::fill(plan.transientSlotTransposed.begin() + slotCounts[0], plan.transientSlotTransposed.end(), true);
+  auto getSlot = [&](size_t output) {
+    const bool t = outputTransposed[output];
+    return int32_t(slots[t][lifetimeIndices[output]] + (t ? slotCounts[0] : 0));
+  };
+  for (size_t i = 0; i < plan.passes.size(); ++i)
+  {
+    auto& pass = plan.passes[i];
+    pass.input = (i == 0) ? ImageFilterPass::Source : getSlot(i - 1);
+    pass.output = (i + 1 == plan.passes.size()) ? ImageFilterPass::Destination : getSlot(i);
+  }
+
+  if (options.colorLutSize > 0)
+  {
+    // 入力が [0, 1] に収まるかをパスの順に追い、収まるパスの演算を LUT にまとめる.
+    // ぼかしは重みが正で和が 1 のため範囲を保つが、シャープは範囲を超えうる.
+    bool inputInRange = true;
+    const uint32_t maxColorLutCount = ImageFilterMaxColorLutDepth / options.colorLutSize;
+    for (auto& pass : plan.passes)
+    {
+      const bool kernelInRange = inputInRange && pass.kernel != ImageFilterKernel::Sharpen;
+      const ImageFilterOp* ops = plan.ops.data() + pass.firstOp;
+      const bool worthBaking = pass.opCount > 1 || (pass.opCount == 1 && ops[0].type != ImageFilterOpType::ColorMatrix);
+      if (kernelInRange && worthBaking && plan.colorLutCount < maxColorLutCount)
+      {
+        pass.colorLut = int32_t(plan.colorLutCount++);
+      }
+
+      // 色行列は範囲を超えうる. 色相シフトは範囲を保ち、トーンマップの結果は必ず [0, 1] になる.
+      bool outputInRange = kernelInRange;
+      for (uint32_t i = 0; i < pass.opCount; ++i)
+      {
+        if (ops[i].type == ImageFilterOpType::ColorMatrix)
+        {
+          outputInRange = false;
+        }
+        else if (ops[i].type == ImageFilterOpType::ToneMap)
+        {
+          outputInRange = true;
+        }
+      }
+      inputInRange = outputInRange;
+    }
+    if (plan.colorLutCount > 0)
+    {
+      plan.colorLutSize = options.colorLutSize;
+    }
+  }
+  return plan;
+}
+
+std::vector<uint32_t> AssignTransientSlots(const std::vector<TransientLifetime>& lifetimes, uint32_t& outSlotCount)
+{
+  std::vector<uint32_t> order(lifetimes.size());
+  for (uint32_t i = 0; i < uint32_t(order.size()); ++i)
+  {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return lifetimes[a].firstPass < lifetimes[b].firstPass;
+  });
+
+  std::vector<uint32_t> slots(lifetimes.size(), 0);
+  std::vector<uint32_t> slotLastPass;  // スロットを最後に使うパス.
+  for (auto index : order)
+  {
+    const auto& lifetime = lifetimes[index];
+    uint32_t found = uint32_t(slotLastPass.size());
+    for (uint32_t slot = 0; slot < uint32_t(slotLastPass.size()); ++slot)
+    {
+      if (slotLastPass[slot] < lifetime.firstPass)
+      {
+        found = slot;
+        break;
+      }
+    }
+    if (found == slotLastPass.size())
+    {
+      slotLastPass.push_back(0);
+    }
+    slotLastPass[found] = lifetime.lastPass;
+    slots[index] = found;
+  }
+  outSlotCount = uint32_t(slotLastPass.size());
+  return slots;
+}
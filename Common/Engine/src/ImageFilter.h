@@ -0,0 +1,149 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 画像フィルタの種類.
+enum class ImageFilterType : uint32_t
+{
+  Sepia,        // params.x: 強さ(0-1).
+  HueShift,     // params.x: 色相のずらし量(1.0 で一周).
+  ColorMatrix,  // matrix: RGB に掛ける行列. params.xyz は UI 用の明るさ・コントラスト・彩度.
+  ToneMap,      // params.x: 露出(EV), params.y: 0 なら Reinhard, 1 なら ACES(近似式).
+  Blur,         // params.x: 半径(テクセル), params.y: ガウス分布の標準偏差(0 ならボックス).
+  Sharpen,      // params.x: 強さ.
+  // 以下は輝度ヒストグラムから求めた値(ApplyImageHistogramToChain で設定する)を使う.
+  AutoExposure, // params.x: 目標の輝度, params.yz: 測光に使う画素の範囲(暗い方からの %), params.w: 求めた露出(EV).
+  AutoLevels,   // params.xy: 黒と白にする画素の位置(暗い方からの %), params.zw: 求めた黒と白の輝度.
+  Count,
+};
+
+// 1画素の値だけで結果が決まるフィルタか. 連続するものは1つのパスにまとめて実行する.
+bool IsPerPixelImageFilter(ImageFilterType type);
+// 画像の計測結果を params に設定してから使うフィルタか.
+bool IsMeasuredImageFilter(ImageFilterType type);
+const char* GetImageFilterName(ImageFilterType type);
+
+// フィルタチェインの1要素.
+struct ImageFilterNode
+{
+  ImageFilterType type = ImageFilterType::Sepia;
+  bool enabled = true;
+  float params[4] = { };
+  // 行優先の3行4列. out.rgb = matrix * float4(in.rgb, 1).
+  float matrix[12] = {
+    1.0f, 0.0f, 0.0f, 0.0f,
+    0.0f, 1.0f, 0.0f, 0.0f,
+    0.0f, 0.0f, 1.0f, 0.0f,
+  };
+};
+
+// 種類ごとの既定のパラメータを設定したノードを作る.
+ImageFilterNode MakeImageFilterNode(ImageFilterType type);
+
+// "sepia,hue:0.3,blur:4:2" の形式の文字列からチェインを作る. コマンドラインでの指定に使う.
+// 名前(sepia, hue, matrix, tonemap, blur, sharpen, autoexposure, autolevels)に続けて ':' 区切りで params を先頭から指定する.
+// 省略したパラメータは既定値のまま. matrix は明るさ・コントラスト・彩度から行列を作る.
+bool ParseImageFilterChain(const std::string& text, std::vector<ImageFilterNode>& outChain);
+
+// 明るさ(加算), コントラスト(0.5 中心の倍率), 彩度(輝度との補間)から色行列を作る.
+void MakeColorAdjustMatrix(float brightness, float contrast, float saturation, float outMatrix[12]);
+
+// パス内で順に適用する1画素の演算. 値はシェーダーの FILTER_OP_* と一致させること.
+enum class ImageFilterOpType : uint32_t
+{
+  ColorMatrix,  // セピアもここに含める.
+  HueShift,
+  ToneMap,
+};
+
+// シェーダーの FilterOp と同じ並び(16バイト単位).
+struct ImageFilterOp
+{
+  ImageFilterOpType type = ImageFilterOpType::ColorMatrix;
+  uint32_t reserved[3] = { };
+  float params[4] = { };
+  float matrix[12] = { };
+};
+
+// パスで実行するカーネル. 値はシェーダーの FILTER_KERNEL_* と一致させること.
+enum class ImageFilterKernel : uint32_t
+{
+  PerPixel,        // 入力をそのまま読む.
+  BlurHorizontal,  // kernelParams.x: 半径, .y: 標準偏差.
+  BlurVertical,
+  Sharpen,         // kernelParams.x: 強さ.
+  BlurTransposed,  // 水平方向にぼかし、縦横を入れ替えて書き出す. 2回続けると水平・垂直のぼかしになる.
+};
+
+// ぼかしのカーネルか. これらは SeparableBlur.hlsl で実行する.
+bool IsBlurImageFilterKernel(ImageFilterKernel kernel);
+
+// 1回の Dispatch で行う処理. カーネルの結果に ops の演算を順に適用して出力する.
+struct ImageFilterPass
+{
+  static const int32_t Source = -1;       // フィルタ適用前の画像.
+  static const int32_t Destination = -2;  // 最終結果の書込先.
+
+  ImageFilterKernel kernel = ImageFilterKernel::PerPixel;
+  float kernelParams[4] = { };
+  uint32_t firstOp = 0;  // ImageFilterPlan::ops の範囲.
+  uint32_t opCount = 0;
+  int32_t input = Source;       // 0 以上は中間テクスチャのスロット番号.
+  int32_t output = Destination;
+  // 0 以上なら ops を順に適用する代わりに、ops を焼き込んだ3D LUT(ImageFilterPlan の colorLut 番目)を引く.
+  int32_t colorLut = -1;
+};
+
+struct ImageFilterPlan
+{
+  std::vector<ImageFilterOp> ops;
+  std::vector<ImageFilterPass> passes;
+  uint32_t transientSlotCount = 0;  // 必要な中間テクスチャの数.
+  // スロットごとに、幅と高さを入れ替えた大きさ(BlurTransposed の出力)か.
+  std::vector<bool> transientSlotTransposed;
+
+  // 3D LUT の1辺の大きさと数. 中身は BakeImageFilterColorLuts で作る.
+  uint32_t colorLutSize = 0;
+  uint32_t colorLutCount = 0;
+  // RGBA32F で、R を最も内側、LUT の番号を最も外側とした並び(1辺 × 1辺 × (1辺 × 数) の3Dテクスチャの配置).
+  std::vector<float> colorLutTexels;
+};
+
+// 1つのパスに詰める演算の最大数. シェーダーの FILTER_MAX_OPS と一致させること.
+static const uint32_t ImageFilterMaxOpsPerPass = 8;
+// ぼかし半径の上限. SeparableBlur.hlsl の BLUR_MAX_RADIUS と一致させること.
+static const uint32_t ImageFilterMaxBlurRadius = 64;
+// LUT を奥行き方向に並べた3Dテクスチャの奥行きの上限(D3D12_REQ_TEXTURE3D_U_V_OR_W_DIMENSION).
+static const uint32_t ImageFilterMaxColorLutDepth = 2048;
+
+struct ImageFilterPlanOptions
+{
+  // ぼかしを BlurTransposed の2パスで行う. どちらのパスも行に沿って読むため、
+  // 垂直方向に読むよりメモリアクセスが連続するが、中間画像は縦横を入れ替えた大きさになる.
+  bool transposedBlur = false;
+  // 0 以外なら、パスの1画素の演算をこの大きさ(32 か 64)の3D LUT にまとめ、実行時は1回の参照で済ませる.
+  // LUT は [0, 1] の入力しか表せないため、カーネルの結果がその範囲に収まるパスだけを対象とする.
+  // 入力画像は [0, 1] (UNORM) とみなす. 1つの色行列だけのパスは LUT を引くより計算の方が軽いため対象外.
+  // 大きさ × 数が ImageFilterMaxColorLutDepth を超える分のパスは LUT にまとめず、演算を順に適用する.
+  uint32_t colorLutSize = 0;
+};
+
+// フィルタチェインを実行するパスの並びに変換する.
+//  - 連続する1画素フィルタは直前のパスの後処理としてまとめ、中間テクスチャへの書き出しを省く.
+//  - 隣り合う色行列は積にまとめ、色相シフトは加算でまとめる.
+//  - 色行列は重みの和が 1 の線形フィルタ(ぼかし・シャープ)と順序を入れ替えても結果が変わらないため、後ろのパスへ移す.
+//  - ぼかしは水平・垂直の2パスに分ける. 半径は ImageFilterMaxBlurRadius までに制限する.
+// 無効なノードは無視する. 空のチェインは入力をそのまま書き出す1パスになる.
+ImageFilterPlan PlanImageFilterChain(const std::vector<ImageFilterNode>& chain, const ImageFilterPlanOptions& options = {});
+
+// 中間リソースを生成するパスと最後に読むパス.
+struct TransientLifetime
+{
+  uint32_t firstPass = 0;
+  uint32_t lastPass = 0;
+};
+
+// 生存区間が重ならないリソースに同じスロットを割り当てる(区間グラフの貪欲彩色).
+// 区間の端が同じパスのもの同士は重なっているとみなす(読みながら書くことはできないため).
+std::vector<uint32_t> AssignTransientSlots(const std::vector<TransientLifetime>& lifetimes, uint32_t& outSlotCount);
@@ -0,0 +1,701 @@
+﻿#include "ImageFilterCpu.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__)
+  #include <immintrin.h>
+  #define IMGFILTER_USE_AVX2
+  #define IMGFILTER_USE_SSE2
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+  #include <emmintrin.h>
+  #define IMGFILTER_USE_SSE2
+#endif
+
+namespace
+{
+  // SIMD レジスタ1本分の float. 要素ごとに別の画素を受け持つ.
+#if defined(IMGFILTER_USE_AVX2)
+  struct VecF { __m256 v; };
+  const uint32_t VecWidth = 8;
+  inline VecF Set(float x) { return { _mm256_set1_ps(x) }; }
+  inline VecF Load(const float* p) { return { _mm256_loadu_ps(p) }; }
+  inline void Store(float* p, VecF a) { _mm256_storeu_ps(p, a.v); }
+  inline VecF operator+(VecF a, VecF b) { return { _mm256_add_ps(a.v, b.v) }; }
+  inline VecF operator-(VecF a, VecF b) { return { _mm256_sub_ps(a.v, b.v) }; }
+  inline VecF operator*(VecF a, VecF b) { return { _mm256_mul_ps(a.v, b.v) }; }
+  inline VecF operator/(VecF a, VecF b) { return { _mm256_div_ps(a.v, b.v) }; }
+  inline VecF Min(VecF a, VecF b) { return { _mm256_min_ps(a.v, b.v) }; }
+  inline VecF Max(VecF a, VecF b) { return { _mm256_max_ps(a.v, b.v) }; }
+  inline VecF Floor(VecF a) { return { _mm256_floor_ps(a.v) }; }
+  inline VecF Abs(VecF a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+  // HLSL の step(edge, x). x >= edge なら 1.
+  inline VecF Step(VecF edge, VecF x) { return { _mm256_and_ps(_mm256_cmp_ps(x.v, edge.v, _CMP_GE_OQ), _mm256_set1_ps(1.0f)) }; }
+#elif defined(IMGFILTER_USE_SSE2)
+  struct VecF { __m128 v; };
+  const uint32_t VecWidth = 4;
+  inline VecF Set(float x) { return { _mm_set1_ps(x) }; }
+  inline VecF Load(const float* p) { return { _mm_loadu_ps(p) }; }
+  inline void Store(float* p, VecF a) { _mm_storeu_ps(p, a.v); }
+  inline VecF operator+(VecF a, VecF b) { return { _mm_add_ps(a.v, b.v) }; }
+  inline VecF operator-(VecF a, VecF b) { return { _mm_sub_ps(a.v, b.v) }; }
+  inline VecF operator*(VecF a, VecF b) { return { _mm_mul_ps(a.v, b.v) }; }
+  inline VecF operator/(VecF a, VecF b) { return { _mm_div_ps(a.v, b.v) }; }
+  inline VecF Min(VecF a, VecF b) { return { _mm_min_ps(a.v, b.v) }; }
+  inline VecF Max(VecF a, VecF b) { return { _mm_max_ps(a.v, b.v) }; }
+  inline VecF Floor(VecF a)
+  {
+    // SSE2 には floor が無いため、切り捨てた結果が元より大きければ 1 引く.
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+    return { _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.0f))) };
+  }
+  inline VecF Abs(VecF a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+  inline VecF Step(VecF edge, VecF x) { return { _mm_and_ps(_mm_cmpge_ps(x.v, edge.v), _mm_set1_ps(1.0f)) }; }
+#else
+  struct VecF { float v; };
+  const uint32_t VecWidth = 1;
+  inline VecF Set(float x) { return { x }; }
+  inline VecF Load(const float* p) { return { *p }; }
+  inline void Store(float* p, VecF a) { *p = a.v; }
+  inline VecF operator+(VecF a, VecF b) { return { a.v + b.v }; }
+  inline VecF operator-(VecF a, VecF b) { return { a.v - b.v }; }
+  inline VecF operator*(VecF a, VecF b) { return { a.v * b.v }; }
+  inline VecF operator/(VecF a, VecF b) { return { a.v / b.v }; }
+  inline VecF Min(VecF a, VecF b) { return { a.v < b.v ? a.v : b.v }; }
+  inline VecF Max(VecF a, VecF b) { return { a.v > b.v ? a.v : b.v }; }
+  inline VecF Floor(VecF a) { return { std::floor(a.v) }; }
+  inline VecF Abs(VecF a) { return { std::fabs(a.v) }; }
+  inline VecF Step(VecF edge, VecF x) { return { x.v >= edge.v ? 1.0f : 0.0f }; }
+#endif
+  inline VecF Frac(VecF a) { return a - Floor(a); }
+  inline VecF Lerp(VecF a, VecF b, VecF t) { return a + (b - a) * t; }
+  inline VecF Saturate(VecF a) { return Min(Max(a, Set(0.0f)), Set(1.0f)); }
+
+  // ImageFilterCommon.hlsli の rgb2hsv, hsv2rgb と同じ計算.
+  void RgbToHsv(VecF r, VecF g, VecF b, VecF& h, VecF& s, VecF& v)
+  {
+    VecF s1 = Step(b, g);
+    VecF px = Lerp(b, g, s1);
+    VecF py = Lerp(g, b, s1);
+    VecF pz = Lerp(Set(-1.0f), Set(0.0f), s1);
+    VecF pw = Lerp(Set(2.0f / 3.0f), Set(-1.0f / 3.0f), s1);
+    VecF s2 = Step(px, r);
+    VecF qx = Lerp(px, r, s2);
+    VecF qy = py;
+    VecF qz = Lerp(pw, pz, s2);
+    VecF qw = Lerp(r, px, s2);
+
+    VecF d = qx - Min(qw, qy);
+    VecF e = Set(1.0e-10f);
+    h = Abs(qz + (qw - qy) / (Set(6.0f) * d + e));
+    s = d / (qx + e);
+    v = qx;
+  }
+
+  void HsvToRgb(VecF h, VecF s, VecF v, VecF& r, VecF& g, VecF& b)
+  {
+    auto channel = [&](float k) {
+      VecF p = Abs(Frac(h + Set(k)) * Set(6.0f) - Set(3.0f));
+      return v * Lerp(Set(1.0f), Saturate(p - Set(1.0f)), s);
+    };
+    r = channel(1.0f);
+    g = channel(2.0f / 3.0f);
+    b = channel(1.0f / 3.0f);
+  }
+
+  void ApplyOps(const ImageFilterOp* ops, uint32_t opCount, VecF& r, VecF& g, VecF& b)
+  {
+    for (uint32_t i = 0; i < opCount; ++i)
+    {
+      const auto& op = ops[i];
+      switch (op.type)
+      {
+      case ImageFilterOpType::ColorMatrix:
+        {
+          const float* m = op.matrix;
+          VecF nr = Set(m[0]) * r + Set(m[1]) * g + Set(m[2]) * b + Set(m[3]);
+          VecF ng = Set(m[4]) * r + Set(m[5]) * g + Set(m[6]) * b + Set(m[7]);
+          VecF nb = Set(m[8]) * r + Set(m[9]) * g + Set(m[10]) * b + Set(m[11]);
+          r = nr; g = ng; b = nb;
+        }
+        break;
+      case ImageFilterOpType::HueShift:
+        {
+          VecF h, s, v;
+          RgbToHsv(r, g, b, h, s, v);
+          h = Frac(h + Set(op.params[0]));
+          HsvToRgb(h, s, v, r, g, b);
+        }
+        break;
+      case ImageFilterOpType::ToneMap:
+        {
+          const VecF exposure = Set(op.params[0]);
+          const bool aces = op.params[1] >= 0.5f;
+          auto tonemap = [&](VecF c) {
+            VecF x = Max(c * exposure, Set(0.0f));
+            if (aces)
+            {
+              return Saturate((x * (Set(2.51f) * x + Set(0.03f))) / (x * (Set(2.43f) * x + Set(0.59f)) + Set(0.14f)));
+            }
+            return x / (Set(1.0f) + x);
+          };
+          r = tonemap(r); g = tonemap(g); b = tonemap(b);
+        }
+        break;
+      }
+    }
+  }
+
+  // 3D LUT を三線形補間で引く. 入力は [0, 1] に丸める.
+  void ApplyColorLut(const float* lut, uint32_t size, uint32_t count, float* r, float* g, float* b)
+  {
+    const float scale = float(size - 1);
+    const int last = int(size) - 2;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      float coords[3] = { r[i], g[i], b[i] };
+      int base[3];
+      float t[3];
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        float f = std::clamp(coords[axis], 0.0f, 1.0f) * scale;
+        base[axis] = std::min(int(f), last);
+        t[axis] = f - float(base[axis]);
+      }
+      // 周囲8テクセル. 隣のテクセルまでの距離は R, G, B 方向にそれぞれ 4, 4 * size, 4 * size^2 個.
+      const float* p = lut + ((size_t(base[2]) * size + base[1]) * size + base[0]) * 4;
+      const size_t dg = size_t(size) * 4;
+      const size_t db = dg * size;
+      float result[3];
+      for (int c = 0; c < 3; ++c)
+      {
+        float c00 = p[c] + (p[c + 4] - p[c]) * t[0];
+        float c10 = p[c + dg] + (p[c + dg + 4] - p[c + dg]) * t[0];
+        float c01 = p[c + db] + (p[c + db + 4] - p[c + db]) * t[0];
+        float c11 = p[c + dg + db] + (p[c + dg + db + 4] - p[c + dg + db]) * t[0];
+        float c0 = c00 + (c10 - c00) * t[1];
+        float c1 = c01 + (c11 - c01) * t[1];
+        result[c] = c0 + (c1 - c0) * t[2];
+      }
+      r[i] = result[0];
+      g[i] = result[1];
+      b[i] = result[2];
+    }
+  }
+
+  // チャンネルごとに分けて並べた float の画像. 各行の幅は VecWidth の倍数に切り上げる.
+  struct PlanarImage
+  {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t stride = 0;
+    std::vector<float> data;
+
+    void Allocate(uint32_t w, uint32_t h)
+    {
+      width = w;
+      height = h;
+      stride = (w + VecWidth - 1) / VecWidth * VecWidth;
+      data.assign(size_t(stride) * h * 4, 0.0f);
+    }
+    float* GetRow(uint32_t channel, uint32_t y) { return data.data() + (size_t(channel) * height + y) * stride; }
+    const float* GetRow(uint32_t channel, uint32_t y) const { return data.data() + (size_t(channel) * height + y) * stride; }
+  };
+
+  // 画像の1行をチャンネルごとに分けて読む.
+  void LoadSurfaceRow(const ImageFilterSurface& surface, uint32_t y, float* const planes[4])
+  {
+    const uint8_t* row = surface.GetRow(y);
+    const uint32_t width = surface.width;
+    uint32_t x = 0;
+    if (surface.format == ImageFilterPixelFormat::RGBA8)
+    {
+#if defined(IMGFILTER_USE_SSE2)
+      // 4画素を float に広げて転置する.
+      const __m128i zero = _mm_setzero_si128();
+      const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+      for (; x + 4 <= width; x += 4)
+      {
+        __m128i texels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x * 4));
+        __m128i lo = _mm_unpacklo_epi8(texels, zero);
+        __m128i hi = _mm_unpackhi_epi8(texels, zero);
+        __m128 p0 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale);
+        __m128 p1 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale);
+        __m128 p2 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale);
+        __m128 p3 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale);
+        _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+        _mm_storeu_ps(planes[0] + x, p0);
+        _mm_storeu_ps(planes[1] + x, p1);
+        _mm_storeu_ps(planes[2] + x, p2);
+        _mm_storeu_ps(planes[3] + x, p3);
+      }
+#endif
+      for (; x < width; ++x)
+      {
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+          planes[c][x] = row[x * 4 + c] * (1.0f / 255.0f);
+        }
+      }
+    }
+    else
+    {
+      const float* texels = reinterpret_cast<const float*>(row);
+#if defined(IMGFILTER_USE_SSE2)
+      for (; x + 4 <= width; x += 4)
+      {
+        __m128 p0 = _mm_loadu_ps(texels + x * 4 + 0);
+        __m128 p1 = _mm_loadu_ps(texels + x * 4 + 4);
+        __m128 p2 = _mm_loadu_ps(texels + x * 4 + 8);
+        __m128 p3 = _mm_loadu_ps(texels + x * 4 + 12);
+        _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+        _mm_storeu_ps(planes[0] + x, p0);
+        _mm_storeu_ps(planes[1] + x, p1);
+        _mm_storeu_ps(planes[2] + x, p2);
+        _mm_storeu_ps(planes[3] + x, p3);
+      }
+#endif
+      for (; x < width; ++x)
+      {
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+          planes[c][x] = texels[x * 4 + c];
+        }
+      }
+    }
+  }
+
+  // UNORM への変換. 範囲外と NaN は [0, 1] に収め、最近接に丸める(GPU の書き込みと同じ).
+  uint8_t ToUnorm8(float v)
+  {
+    v = v > 0.0f ? (v < 1.0f ? v : 1.0f) : 0.0f;
+    return uint8_t(std::lrint(v * 255.0f));
+  }
+
+  void StoreSurfaceRow(const ImageFilterSurface& surface, uint32_t y, const float* const planes[4])
+  {
+    uint8_t* row = surface.GetRow(y);
+    const uint32_t width = surface.width;
+    uint32_t x = 0;
+    if (surface.format == ImageFilterPixelFormat::RGBA8)
+    {
+#if defined(IMGFILTER_USE_SSE2)
+      const __m128 zero = _mm_setzero_ps();
+      const __m128 one = _mm_set1_ps(1.0f);
+      const __m128 scale = _mm_set1_ps(255.0f);
+      for (; x + 4 <= width; x += 4)
+      {
+        __m128 p0 = _mm_loadu_ps(planes[0] + x);
+        __m128 p1 = _mm_loadu_ps(planes[1] + x);
+        __m128 p2 = _mm_loadu_ps(planes[2] + x);
+        __m128 p3 = _mm_loadu_ps(planes[3] + x);
+        _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+        // max(v, 0) は NaN を 0 にする(第2引数が返る).
+        auto toInt = [&](__m128 v) { return _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(v, zero), one), scale)); };
+        __m128i lo = _mm_packs_epi32(toInt(p0), toInt(p1));
+        __m128i hi = _mm_packs_epi32(toInt(p2), toInt(p3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(row + x * 4), _mm_packus_epi16(lo, hi));
+      }
+#endif
+      for (; x < width; ++x)
+      {
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+          row[x * 4 + c] = ToUnorm8(planes[c][x]);
+        }
+      }
+    }
+    else
+    {
+      float* texels = reinterpret_cast<float*>(row);
+#if defined(IMGFILTER_USE_SSE2)
+      for (; x + 4 <= width; x += 4)
+      {
+        __m128 p0 = _mm_loadu_ps(planes[0] + x);
+        __m128 p1 = _mm_loadu_ps(planes[1] + x);
+        __m128 p2 = _mm_loadu_ps(planes[2] + x);
+        __m128 p3 = _mm_loadu_ps(planes[3] + x);
+        _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+        _mm_storeu_ps(texels + x * 4 + 0, p0);
+        _mm_storeu_ps(texels + x * 4 + 4, p1);
+        _mm_storeu_ps(texels + x * 4 + 8, p2);
+        _mm_storeu_ps(texels + x * 4 + 12, p3);
+      }
+#endif
+      for (; x < width; ++x)
+      {
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+          texels[x * 4 + c] = planes[c][x];
+        }
+      }
+    }
+  }
+
+  // ぼかしの重み(中心からの距離 -radius..radius). 和が 1 になるよう正規化する.
+  std::vector<float> MakeBlurWeights(int radius, float sigma)
+  {
+    std::vector<float> weights(2 * radius + 1);
+    float sum = 0.0f;
+    for (int i = -radius; i <= radius; ++i)
+    {
+      float w = sigma > 0.0f ? std::exp(-float(i * i) / (2.0f * sigma * sigma)) : 1.0f;
+      weights[i + radius] = w;
+      sum += w;
+    }
+    for (auto& w : weights)
+    {
+      w /= sum;
+    }
+    return weights;
+  }
+
+  // 左右に apron 画素ずつ端の値を複製した行を作る.
+  void MakePaddedRow(const float* src, uint32_t width, uint32_t apron, float* dst)
+  {
+    std::fill_n(dst, apron, src[0]);
+    std::memcpy(dst + apron, src, sizeof(float) * width);
+    std::fill_n(dst + apron + width, apron + VecWidth, src[width - 1]);
+  }
+
+  const uint32_t TileRows = 16;
+
+  // 行をタイルに分けて並列に処理する. 同時に処理するスレッドは threadCount 以下.
+  template<class Func>
+  void ForEachRowTile(uint32_t height, uint32_t threadCount, Func&& func)
+  {
+    const uint32_t tileCount = (height + TileRows - 1) / TileRows;
+    const uint32_t jobCount = std::min(threadCount, tileCount);
+    if (jobCount <= 1)
+    {
+      // 1スレッドの場合はジョブを発行せずにその場で処理する.
+      std::vector<float> scratch;
+      for (uint32_t tile = 0; tile < tileCount; ++tile)
+      {
+        func(tile * TileRows, std::min(height, (tile + 1) * TileRows), scratch);
+      }
+      return;
+    }
+    std::atomic<uint32_t> nextTile = 0;
+    GetJobSystem()->Dispatch(jobCount, [&](uint32_t, uint32_t) {
+      std::vector<float> scratch;
+      for (uint32_t tile = nextTile++; tile < tileCount; tile = nextTile++)
+      {
+        func(tile * TileRows, std::min(height, (tile + 1) * TileRows), scratch);
+      }
+    });
+  }
+}
+
+ImageFilterCpuStats ExecuteImageFilterPlanCpu(const ImageFilterPlan& plan,
+  const ImageFilterSurface& source, const ImageFilterSurface& destination, uint32_t maxThreadCount)
+{
+  auto startTime = std::chrono::high_resolution_clock::now();
+
+  ImageFilterCpuStats stats;
+  const uint32_t width = destination.width;
+  const uint32_t height = destination.height;
+  const uint32_t availableThreads = GetJobSystem()->GetThreadCount();
+  stats.threadCount = (maxThreadCount == 0) ? availableThreads : std::min(maxThreadCount, availableThreads);
+  stats.pixelCount = uint64_t(width) * height;
+  if (width == 0 || height == 0 || source.width != width || source.height != height)
+  {
+    return stats;
+  }
+
+  // 近傍を読むパスの入力はチャンネルごとの float にしておく.
+  // 最初に変換するため、source と destination が同じ画像でもよい.
+  PlanarImage sourcePlanar;
+  if (plan.passes.empty() || plan.passes[0].kernel != ImageFilterKernel::PerPixel)
+  {
+    sourcePlanar.Allocate(width, height);
+    ForEachRowTile(height, stats.threadCount, [&](uint32_t y0, uint32_t y1, std::vector<float>&) {
+      for (uint32_t y = y0; y < y1; ++y)
+      {
+        float* planes[4] = { sourcePlanar.GetRow(0, y), sourcePlanar.GetRow(1, y), sourcePlanar.GetRow(2, y), sourcePlanar.GetRow(3, y) };
+        LoadSurfaceRow(source, y, planes);
+      }
+    });
+  }
+
+  // 中間画像はスロット単位で確保し、生存区間の重ならないパスで使い回す.
+  std::vector<PlanarImage> transients(plan.transientSlotCount);
+  for (const auto& pass : plan.passes)
+  {
+    const PlanarImage* input = nullptr;
+    if (pass.input >= 0)
+    {
+      input = &transients[pass.input];
+    }
+    else if (!sourcePlanar.data.empty())
+    {
+      input = &sourcePlanar;
+    }
+    // 入力の行の長さと行数. BlurTransposed の出力を読むパスでは縦横が入れ替わっている.
+    const uint32_t lineWidth = input ? input->width : width;
+    const uint32_t lineCount = input ? input->height : height;
+    const bool transposing = (pass.kernel == ImageFilterKernel::BlurTransposed);
+
+    PlanarImage* output = nullptr;
+    PlanarImage staging;
+    if (pass.output >= 0)
+    {
+      output = &transients[pass.output];
+      if (output->data.empty())
+      {
+        output->Allocate(transposing ? lineCount : lineWidth, transposing ? lineWidth : lineCount);
+      }
+    }
+    else if (transposing)
+    {
+      // 列単位では書き出せないため、いったん float の画像に入れてから行ごとに書き出す.
+      staging.Allocate(width, height);
+      output = &staging;
+    }
+
+    const ImageFilterOp* ops = plan.ops.data() + pass.firstOp;
+    const int radius = int(pass.kernelParams[0]);
+    std::vector<float> weights;
+    uint32_t apron = 0;
+    if (IsBlurImageFilterKernel(pass.kernel))
+    {
+      weights = MakeBlurWeights(std::max(radius, 0), pass.kernelParams[1]);
+      apron = uint32_t(std::max(radius, 0));
+    }
+    else if (pass.kernel == ImageFilterKernel::Sharpen)
+    {
+      apron = 1;
+    }
+    const uint32_t stride = (lineWidth + VecWidth - 1) / VecWidth * VecWidth;
+
+    ForEachRowTile(lineCount, stats.threadCount, [&](uint32_t y0, uint32_t y1, std::vector<float>& scratch) {
+      // 出力1行分(4チャンネル)と、端を複製した入力1行分.
+      // 縦横を入れ替える場合は、タイルの全行を保持してからまとめて書き出す.
+      const size_t paddedSize = size_t(lineWidth) + apron * 2 + VecWidth;
+      const size_t rowSetSize = size_t(stride) * 4;
+      const uint32_t rowSetCount = transposing ? TileRows : 1;
+      scratch.resize(rowSetSize * rowSetCount + paddedSize);
+      float* padded = scratch.data() + rowSetSize * rowSetCount;
+
+      for (uint32_t y = y0; y < y1; ++y)
+      {
+        float* rowSet = scratch.data() + (transposing ? rowSetSize * (y - y0) : 0);
+        float* row[4] = { rowSet, rowSet + stride, rowSet + stride * 2, rowSet + stride * 3 };
+
+        // カーネルの結果を row に求める.
+        switch (pass.kernel)
+        {
+        case ImageFilterKernel::PerPixel:
+          if (input)
+          {
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+              std::memcpy(row[c], input->GetRow(c, y), sizeof(float) * lineWidth);
+            }
+          }
+          else
+          {
+            LoadSurfaceRow(source, y, row);
+          }
+          break;
+        case ImageFilterKernel::BlurHorizontal:
+        case ImageFilterKernel::BlurTransposed:
+          for (uint32_t c = 0; c < 4; ++c)
+          {
+            MakePaddedRow(input->GetRow(c, y), lineWidth, apron, padded);
+            for (uint32_t x = 0; x < lineWidth; x += VecWidth)
+            {
+              VecF sum = Set(0.0f);
+              for (size_t i = 0; i < weights.size(); ++i)
+              {
+                sum = sum + Set(weights[i]) * Load(padded + x + i);
+              }
+              Store(row[c] + x, sum);
+            }
+          }
+          break;
+        case ImageFilterKernel::BlurVertical:
+          for (uint32_t c = 0; c < 4; ++c)
+          {
+            for (uint32_t x = 0; x < lineWidth; x += VecWidth)
+            {
+              VecF sum = Set(0.0f);
+              for (int i = -radius; i <= radius; ++i)
+              {
+                const int sy = std::clamp(int(y) + i, 0, int(lineCount) - 1);
+                sum = sum + Set(weights[i + radius]) * Load(input->GetRow(c, sy) + x);
+              }
+              Store(row[c] + x, sum);
+            }
+          }
+          break;
+        case ImageFilterKernel::Sharpen:
+          {
+            // 上下左右との差を強調する. 重みの和は 1.
+            const VecF amount = Set(pass.kernelParams[0]);
+            const VecF four = Set(4.0f);
+            const uint32_t up = (y > 0) ? y - 1 : 0;
+            const uint32_t down = std::min(y + 1, lineCount - 1);
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+              MakePaddedRow(input->GetRow(c, y), lineWidth, 1, padded);
+              const float* upRow = input->GetRow(c, up);
+              const float* downRow = input->GetRow(c, down);
+              for (uint32_t x = 0; x < lineWidth; x += VecWidth)
+              {
+                VecF center = Load(padded + x + 1);
+                VecF neighbors = Load(padded + x) + Load(padded + x + 2) + Load(upRow + x) + Load(downRow + x);
+                Store(row[c] + x, center + amount * (center * four - neighbors));
+              }
+            }
+          }
+          break;
+        }
+
+        // まとめられた1画素の演算を適用する. LUT に焼き込み済みならそれを引く.
+        if (pass.colorLut >= 0 && !plan.colorLutTexels.empty())
+        {
+          const size_t lutTexelCount = size_t(plan.colorLutSize) * plan.colorLutSize * plan.colorLutSize;
+          const float* lut = plan.colorLutTexels.data() + lutTexelCount * 4 * pass.colorLut;
+          ApplyColorLut(lut, plan.colorLutSize, lineWidth, row[0], row[1], row[2]);
+        }
+        else if (pass.opCount > 0)
+        {
+          for (uint32_t x = 0; x < lineWidth; x += VecWidth)
+          {
+            VecF r = Load(row[0] + x), g = Load(row[1] + x), b = Load(row[2] + x);
+            ApplyOps(ops, pass.opCount, r, g, b);
+            Store(row[0] + x, r);
+            Store(row[1] + x, g);
+            Store(row[2] + x, b);
+          }
+        }
+
+        if (transposing)
+        {
+          continue;
+        }
+        if (output)
+        {
+          for (uint32_t c = 0; c < 4; ++c)
+          {
+            std::memcpy(output->GetRow(c, y), row[c], sizeof(float) * lineWidth);
+          }
+        }
+        else
+        {
+          StoreSurfaceRow(destination, y, row);
+        }
+      }
+
+      if (transposing)
+      {
+        // タイルの y0..y1 行目を出力の各行の y0..y1 列目へ書く. 出力側は行ごとに連続した書込みになる.
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+          for (uint32_t x = 0; x < lineWidth; ++x)
+          {
+            float* dst = output->GetRow(c, x) + y0;
+            const float* src = scratch.data() + size_t(stride) * c + x;
+            for (uint32_t i = 0; i < y1 - y0; ++i)
+            {
+              dst[i] = src[rowSetSize * i];
+            }
+          }
+        }
+      }
+    });
+
+    if (output == &staging)
+    {
+      ForEachRowTile(height, stats.threadCount, [&](uint32_t y0, uint32_t y1, std::vector<float>&) {
+        for (uint32_t y = y0; y < y1; ++y)
+        {
+          const float* planes[4] = { staging.GetRow(0, y), staging.GetRow(1, y), staging.GetRow(2, y), staging.GetRow(3, y) };
+          StoreSurfaceRow(destination, y, planes);
+        }
+      });
+    }
+  }
+
+  auto endTime = std::chrono::high_resolution_clock::now();
+  stats.elapsedMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+  return stats;
+}
+
+void BakeImageFilterColorLut(const ImageFilterOp* ops, uint32_t opCount, uint32_t size, float* outTexels)
+{
+  // R 方向の1列ずつ SIMD で計算する.
+  const uint32_t stride = (size + VecWidth - 1) / VecWidth * VecWidth;
+  std::vector<float> line(stride * 3);
+  float* lineR = line.data();
+  float* lineG = line.data() + stride;
+  float* lineB = line.data() + stride * 2;
+  const float scale = 1.0f / float(size - 1);
+  for (uint32_t z = 0; z < size; ++z)
+  {
+    for (uint32_t y = 0; y < size; ++y)
+    {
+      for (uint32_t x = 0; x < stride; ++x)
+      {
+        lineR[x] = float(std::min(x, size - 1)) * scale;
+      }
+      const VecF green = Set(float(y) * scale);
+      const VecF blue = Set(float(z) * scale);
+      for (uint32_t x = 0; x < size; x += VecWidth)
+      {
+        VecF r = Load(lineR + x), g = green, b = blue;
+        ApplyOps(ops, opCount, r, g, b);
+        Store(lineR + x, r);
+        Store(lineG + x, g);
+        Store(lineB + x, b);
+      }
+      float* texels = outTexels + (size_t(z) * size + y) * size * 4;
+      for (uint32_t x = 0; x < size; ++x)
+      {
+        texels[x * 4 + 0] = lineR[x];
+        texels[x * 4 + 1] = lineG[x];
+        texels[x * 4 + 2] = lineB[x];
+        texels[x * 4 + 3] = 1.0f;
+      }
+    }
+  }
+}
+
+void BakeImageFilterColorLuts(ImageFilterPlan& plan)
+{
+  const size_t lutFloatCount = size_t(plan.colorLutSize) * plan.colorLutSize * plan.colorLutSize * 4;
+  plan.colorLutTexels.assign(lutFloatCount * plan.colorLutCount, 0.0f);
+  for (const auto& pass : plan.passes)
+  {
+    if (pass.colorLut >= 0)
+    {
+      BakeImageFilterColorLut(plan.ops.data() + pass.firstOp, pass.opCount, plan.colorLutSize,
+        plan.colorLutTexels.data() + lutFloatCount * pass.colorLut);
+    }
+  }
+}
+
+std::vector<ImageFilterCpuStats> BenchmarkImageFilterCpu(const ImageFilterPlan& plan,
+  const ImageFilterSurface& source, const ImageFilterSurface& destination,
+  const std::vector<uint32_t>& threadCounts, uint32_t iterationCount)
+{
+  std::vector<ImageFilterCpuStats> results;
+  iterationCount = std::max(iterationCount, 1u);
+  for (auto threadCount : threadCounts)
+  {
+    auto stats = ExecuteImageFilterPlanCpu(plan, source, destination, threadCount);
+    double totalMs = 0.0;
+    for (uint32_t i = 0; i < iterationCount; ++i)
+    {
+      totalMs += ExecuteImageFilterPlanCpu(plan, source, destination, threadCount).elapsedMs;
+    }
+    stats.elapsedMs = totalMs / iterationCount;
+    results.push_back(stats);
+  }
+  return results;
+}
@@ -0,0 +1,54 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ImageFilter.h"
+
+// CPU でフィルタを適用する画像の画素形式.
+enum class ImageFilterPixelFormat : uint32_t
+{
+  RGBA8,    // UNORM. 書き出し時は [0, 1] に丸める.
+  RGBA32F,
+};
+
+// CPU でフィルタを適用する画像. メモリは所有しない.
+struct ImageFilterSurface
+{
+  ImageFilterPixelFormat format = ImageFilterPixelFormat::RGBA8;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  size_t   rowPitch = 0;  // バイト単位.
+  uint8_t* data = nullptr;
+
+  uint32_t GetPixelBytes() const { return format == ImageFilterPixelFormat::RGBA8 ? 4 : 16; }
+  uint8_t* GetRow(uint32_t y) const { return data + rowPitch * y; }
+};
+
+struct ImageFilterCpuStats
+{
+  uint32_t threadCount = 0;
+  uint64_t pixelCount = 0;  // 1回の実行で処理した画素数.
+  double   elapsedMs = 0;
+
+  double GetMegaPixelsPerSecond() const { return elapsedMs > 0 ? double(pixelCount) / (elapsedMs * 1000.0) : 0.0; }
+};
+
+// ImageFilterPlan を CPU で実行する. ComputeShader.hlsl と同じ計算を行うため、
+// GPU の無い環境での代替や、GPU の結果を検証する際の基準として使う.
+// 行をタイルに分けて JobSystem で並列に処理する. maxThreadCount が 0 なら JobSystem の全スレッドを使う.
+// 画素は SIMD で複数まとめて処理する(SSE2 で4画素. AVX2 を有効にしてビルドした場合は8画素).
+// colorLut が指定されたパスは、BakeImageFilterColorLuts 済みなら LUT を引き、そうでなければ ops を順に適用する.
+// source と destination は同じ大きさであること. 同じ画像を指定してもよい.
+ImageFilterCpuStats ExecuteImageFilterPlanCpu(const ImageFilterPlan& plan,
+  const ImageFilterSurface& source, const ImageFilterSurface& destination, uint32_t maxThreadCount = 0);
+
+// ops を順に適用した結果を size^3 の3D LUT に焼き込む. outTexels には size^3 画素分の RGBA を書く.
+void BakeImageFilterColorLut(const ImageFilterOp* ops, uint32_t opCount, uint32_t size, float* outTexels);
+// plan の colorLut が指定されたパスの LUT を焼き込み、plan.colorLutTexels を設定する.
+// チェインやオプションを変えて PlanImageFilterChain をやり直したときにだけ呼べばよい.
+void BakeImageFilterColorLuts(ImageFilterPlan& plan);
+
+// スレッド数ごとの処理速度を測る. 1回空実行した後、iterationCount 回の平均を返す.
+std::vector<ImageFilterCpuStats> BenchmarkImageFilterCpu(const ImageFilterPlan& plan,
+  const ImageFilterSurface& source, const ImageFilterSurface& destination,
+  const std::vector<uint32_t>& threadCounts, uint32_t iterationCount);
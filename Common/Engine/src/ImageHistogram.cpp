@@ -0,0 +1,199 @@
+﻿#include "ImageHistogram.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+
+namespace
+{
+  const uint32_t BandRows = 64;
+
+  float GetBinLuminance(uint32_t bin)
+  {
+    return (bin + 0.5f) / ImageHistogramBinCount;
+  }
+
+  // ビンの順に画素を並べたときの [begin, end) 番目の範囲と、bin の重なる画素数.
+  double GetOverlapCount(uint64_t binBegin, uint64_t binEnd, double begin, double end)
+  {
+    const double low = std::max(double(binBegin), begin);
+    const double high = std::min(double(binEnd), end);
+    return high > low ? high - low : 0.0;
+  }
+}
+
+uint64_t ImageHistogram::GetTotalCount() const
+{
+  uint64_t total = 0;
+  for (auto count : bins)
+  {
+    total += count;
+  }
+  return total;
+}
+
+uint32_t GetImageHistogramBin(float r, float g, float b)
+{
+  float luminance = 0.2126f * r + 0.7152f * g + 0.0722f * b;
+  luminance = std::clamp(luminance, 0.0f, 1.0f);
+  return std::min(uint32_t(luminance * ImageHistogramBinCount), ImageHistogramBinCount - 1);
+}
+
+void ComputeImageHistogram(const ImageFilterSurface& image, ImageHistogram& outHistogram, uint32_t maxThreadCount)
+{
+  outHistogram = { };
+  const uint32_t bandCount = (image.height + BandRows - 1) / BandRows;
+  const uint32_t availableThreads = GetJobSystem()->GetThreadCount();
+  const uint32_t threadCount = (maxThreadCount == 0) ? availableThreads : std::min(maxThreadCount, availableThreads);
+  const uint32_t jobCount = std::min(threadCount, bandCount);
+  if (jobCount == 0)
+  {
+    return;
+  }
+
+  // ジョブごとに集計してから足し合わせ、ビンへの書き込みを競合させない.
+  std::mutex mergeMutex;
+  std::atomic<uint32_t> nextBand = 0;
+  auto countBands = [&](uint32_t, uint32_t) {
+    ImageHistogram local;
+    for (uint32_t band = nextBand++; band < bandCount; band = nextBand++)
+    {
+      const uint32_t y1 = std::min(image.height, (band + 1) * BandRows);
+      for (uint32_t y = band * BandRows; y < y1; ++y)
+      {
+        const uint8_t* row = image.GetRow(y);
+        if (image.format == ImageFilterPixelFormat::RGBA8)
+        {
+          for (uint32_t x = 0; x < image.width; ++x)
+          {
+            const uint8_t* p = row + x * 4;
+            local.bins[GetImageHistogramBin(p[0] / 255.0f, p[1] / 255.0f, p[2] / 255.0f)]++;
+          }
+        }
+        else
+        {
+          const float* p = reinterpret_cast<const float*>(row);
+          for (uint32_t x = 0; x < image.width; ++x, p += 4)
+          {
+            local.bins[GetImageHistogramBin(p[0], p[1], p[2])]++;
+          }
+        }
+      }
+    }
+    std::lock_guard<std::mutex> lock(mergeMutex);
+    for (uint32_t i = 0; i < ImageHistogramBinCount; ++i)
+    {
+      outHistogram.bins[i] += local.bins[i];
+    }
+  };
+  if (jobCount == 1)
+  {
+    countBands(0, 0);
+    return;
+  }
+  GetJobSystem()->Dispatch(jobCount, countBands);
+}
+
+float GetImageHistogramPercentile(const ImageHistogram& histogram, float percent)
+{
+  const uint64_t total = histogram.GetTotalCount();
+  if (total == 0)
+  {
+    return 0.0f;
+  }
+  const double rank = total * std::clamp(double(percent), 0.0, 100.0) / 100.0;
+  uint64_t accumulated = 0;
+  for (uint32_t i = 0; i < ImageHistogramBinCount; ++i)
+  {
+    const uint64_t count = histogram.bins[i];
+    if (count > 0 && accumulated + count >= rank)
+    {
+      const double t = std::max(rank - double(accumulated), 0.0) / count;
+      return float((i + t) / ImageHistogramBinCount);
+    }
+    accumulated += count;
+  }
+  return 1.0f;
+}
+
+float ComputeAutoExposure(const ImageHistogram& histogram, float targetLuminance, float lowPercent, float highPercent)
+{
+  const uint64_t total = histogram.GetTotalCount();
+  const double begin = total * std::clamp(double(lowPercent), 0.0, 100.0) / 100.0;
+  const double end = total * std::clamp(double(highPercent), 0.0, 100.0) / 100.0;
+
+  // 範囲に含まれる画素の log2(輝度) を平均する. 輝度はビンの中央の値で代表する.
+  double weightSum = 0.0;
+  double logSum = 0.0;
+  uint64_t accumulated = 0;
+  for (uint32_t i = 0; i < ImageHistogramBinCount; ++i)
+  {
+    const uint64_t count = histogram.bins[i];
+    const double weight = GetOverlapCount(accumulated, accumulated + count, begin, end);
+    weightSum += weight;
+    logSum += weight * std::log2(GetBinLuminance(i));
+    accumulated += count;
+  }
+  if (weightSum <= 0.0 || targetLuminance <= 0.0f)
+  {
+    return 0.0f;
+  }
+  return float(std::log2(double(targetLuminance)) - logSum / weightSum);
+}
+
+void ComputeAutoLevels(const ImageHistogram& histogram, float lowPercent, float highPercent, float& outBlack, float& outWhite)
+{
+  const float black = GetImageHistogramPercentile(histogram, lowPercent);
+  const float white = GetImageHistogramPercentile(histogram, highPercent);
+  if (white - black < 1.0f / ImageHistogramBinCount)
+  {
+    outBlack = 0.0f;
+    outWhite = 1.0f;
+    return;
+  }
+  outBlack = black;
+  outWhite = white;
+}
+
+bool ImageFilterChainNeedsHistogram(const std::vector<ImageFilterNode>& chain)
+{
+  return std::any_of(chain.begin(), chain.end(), [](const ImageFilterNode& node) {
+    return node.enabled && IsMeasuredImageFilter(node.type);
+  });
+}
+
+bool ApplyImageHistogramToChain(const ImageHistogram& histogram, std::vector<ImageFilterNode>& chain)
+{
+  // 同じ画像を測り直したときの誤差でパスを組み直さないよう、小さな変化は無視する.
+  const float threshold = 1.0f / 1024.0f;
+  bool changed = false;
+  auto update = [&](float& value, float measured) {
+    if (std::abs(value - measured) > threshold)
+    {
+      value = measured;
+      changed = true;
+    }
+  };
+  for (auto& node : chain)
+  {
+    switch (node.type)
+    {
+    case ImageFilterType::AutoExposure:
+      update(node.params[3], ComputeAutoExposure(histogram, node.params[0], node.params[1], node.params[2]));
+      break;
+    case ImageFilterType::AutoLevels:
+      {
+        float black = 0.0f, white = 1.0f;
+        ComputeAutoLevels(histogram, node.params[0], node.params[1], black, white);
+        update(node.params[2], black);
+        update(node.params[3], white);
+      }
+      break;
+    default:
+      break;
+    }
+  }
+  return changed;
+}
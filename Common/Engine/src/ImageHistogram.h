@@ -0,0 +1,40 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+#include "ImageFilter.h"
+#include "ImageFilterCpu.h"
+
+// 輝度ヒストグラムのビンの数. Histogram.hlsl の HISTOGRAM_BIN_COUNT と一致させること.
+static const uint32_t ImageHistogramBinCount = 256;
+
+// 輝度(BT.709)を [0, 1] で等分したヒストグラム.
+// GPU(Histogram.hlsl)で集計したものを読み返すため、シェーダーの出力と同じ並びにしている.
+struct ImageHistogram
+{
+  uint32_t bins[ImageHistogramBinCount] = { };
+
+  uint64_t GetTotalCount() const;
+};
+
+// 画素の値が入るビン. Histogram.hlsl と同じ式で求める.
+uint32_t GetImageHistogramBin(float r, float g, float b);
+
+// CPU で輝度ヒストグラムを求める. GPU の結果を検証する際の基準として使う.
+// 行を分けて JobSystem で並列に集計する. maxThreadCount が 0 なら JobSystem の全スレッドを使う.
+void ComputeImageHistogram(const ImageFilterSurface& image, ImageHistogram& outHistogram, uint32_t maxThreadCount = 0);
+
+// 暗い方から percent(0-100)% の画素が含まれる輝度. ビンの中は一様に分布しているとみなして補間する.
+float GetImageHistogramPercentile(const ImageHistogram& histogram, float percent);
+
+// 暗い方から lowPercent% から highPercent% の画素の輝度の対数平均を targetLuminance にする露出(EV).
+// 極端に暗い・明るい画素を除いて測光する. 画素が無い場合は 0.
+float ComputeAutoExposure(const ImageHistogram& histogram, float targetLuminance, float lowPercent, float highPercent);
+
+// lowPercent%, highPercent% の輝度を黒と白にする. 幅が1ビンに満たない場合は 0 と 1 を返す.
+void ComputeAutoLevels(const ImageHistogram& histogram, float lowPercent, float highPercent, float& outBlack, float& outWhite);
+
+// チェインに計測の必要なノード(AutoExposure, AutoLevels)が含まれるか.
+bool ImageFilterChainNeedsHistogram(const std::vector<ImageFilterNode>& chain);
+// 計測の必要なノードに histogram から求めた値を設定する. 値の変わったノードがあれば true.
+// 計測はフィルタ適用前の画像で行う.
+bool ApplyImageHistogramToChain(const ImageHistogram& histogram, std::vector<ImageFilterNode>& chain);
@@ -0,0 +1,265 @@
+﻿#include "ImageTiling.h"
+#include "DdsFile.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+ImageFilterApron GetImageFilterPlanApron(const ImageFilterPlan& plan)
+{
+  ImageFilterApron apron;
+  // BlurTransposed の出力は縦横が入れ替わるため、入力の行が元の画像のどちらの軸かを追う.
+  bool transposed = false;
+  for (const auto& pass : plan.passes)
+  {
+    const uint32_t radius = uint32_t(std::max(pass.kernelParams[0], 0.0f));
+    switch (pass.kernel)
+    {
+    case ImageFilterKernel::BlurHorizontal:
+      apron.x += radius;
+      break;
+    case ImageFilterKernel::BlurVertical:
+      apron.y += radius;
+      break;
+    case ImageFilterKernel::BlurTransposed:
+      (transposed ? apron.y : apron.x) += radius;
+      transposed = !transposed;
+      break;
+    case ImageFilterKernel::Sharpen:
+      apron.x += 1;
+      apron.y += 1;
+      break;
+    default:
+      break;
+    }
+  }
+  return apron;
+}
+
+std::vector<ImageTile> MakeImageTiles(uint32_t width, uint32_t height, uint32_t tileSize, const ImageFilterApron& apron)
+{
+  std::vector<ImageTile> tiles;
+  if (width == 0 || height == 0 || tileSize == 0)
+  {
+    return tiles;
+  }
+  const uint32_t inputWidth = uint32_t(std::min<uint64_t>(uint64_t(tileSize) + apron.x * 2ull, width));
+  const uint32_t inputHeight = uint32_t(std::min<uint64_t>(uint64_t(tileSize) + apron.y * 2ull, height));
+  // 読み込み範囲はタイルをエプロンの分だけ広げた位置とし、画像からはみ出す場合は内側へずらす.
+  // ずらした側は画像の端に接するため、反対側にはエプロン以上の余白が残る.
+  auto placeInput = [](uint32_t position, uint32_t apronSize, uint32_t inputSize, uint32_t imageSize) {
+    const int64_t start = int64_t(position) - apronSize;
+    return uint32_t(std::clamp<int64_t>(start, 0, int64_t(imageSize) - inputSize));
+  };
+  for (uint32_t y = 0; y < height; y += tileSize)
+  {
+    for (uint32_t x = 0; x < width; x += tileSize)
+    {
+      tiles.push_back(ImageTile{
+        .x = x,
+        .y = y,
+        .width = std::min(tileSize, width - x),
+        .height = std::min(tileSize, height - y),
+        .inputX = placeInput(x, apron.x, inputWidth, width),
+        .inputY = placeInput(y, apron.y, inputHeight, height),
+        .inputWidth = inputWidth,
+        .inputHeight = inputHeight,
+      });
+    }
+  }
+  return tiles;
+}
+
+bool ExecuteImageFilterPlanTiledCpu(const ImageFilterPlan& plan, uint32_t width, uint32_t height, uint32_t tileSize,
+  const ImageTileReader& read, const ImageTileWriter& write, uint32_t maxThreadCount, ImageTilingStats* outStats)
+{
+  auto startTime = std::chrono::high_resolution_clock::now();
+  const auto tiles = MakeImageTiles(width, height, tileSize, GetImageFilterPlanApron(plan));
+  if (tiles.empty())
+  {
+    return false;
+  }
+
+  // 読み込み範囲は全タイルで同じ大きさのため、バッファは使い回す.
+  const uint32_t inputWidth = tiles[0].inputWidth;
+  const uint32_t inputHeight = tiles[0].inputHeight;
+  const size_t rowPitch = size_t(inputWidth) * 4;
+  struct Buffer
+  {
+    std::vector<uint8_t> input;
+    std::vector<uint8_t> output;
+  };
+  Buffer buffers[2];
+  auto makeSurface = [&](std::vector<uint8_t>& pixels) {
+    pixels.resize(rowPitch * inputHeight);
+    return ImageFilterSurface{
+      .format = ImageFilterPixelFormat::RGBA8,
+      .width = inputWidth,
+      .height = inputHeight,
+      .rowPitch = rowPitch,
+      .data = pixels.data(),
+    };
+  };
+  ImageFilterSurface inputs[2] = { makeSurface(buffers[0].input), makeSurface(buffers[1].input) };
+  ImageFilterSurface outputs[2] = { makeSurface(buffers[0].output), makeSurface(buffers[1].output) };
+
+  // 出力バッファのうち、タイルの書き出す範囲だけを指す.
+  auto writeTile = [&](size_t index) {
+    const auto& tile = tiles[index];
+    const auto& output = outputs[index % 2];
+    ImageFilterSurface region{
+      .format = ImageFilterPixelFormat::RGBA8,
+      .width = tile.width,
+      .height = tile.height,
+      .rowPitch = output.rowPitch,
+      .data = output.GetRow(tile.y - tile.inputY) + size_t(tile.x - tile.inputX) * 4,
+    };
+    return write(tile, region);
+  };
+
+  bool succeeded = read(tiles[0], inputs[0]);
+  auto& jobSystem = GetJobSystem();
+  for (size_t i = 0; succeeded && i < tiles.size(); ++i)
+  {
+    // 次のタイルの読み込みと前のタイルの書き出しを、このタイルの処理と並行して行う.
+    bool readOk = true, writeOk = true;
+    JobSystem::JobGroup io;
+    jobSystem->Run(io, 2, [&](uint32_t jobIndex, uint32_t) {
+      if (jobIndex == 0 && i + 1 < tiles.size())
+      {
+        readOk = read(tiles[i + 1], inputs[(i + 1) % 2]);
+      }
+      else if (jobIndex == 1 && i > 0)
+      {
+        writeOk = writeTile(i - 1);
+      }
+    });
+    ExecuteImageFilterPlanCpu(plan, inputs[i % 2], outputs[i % 2], maxThreadCount);
+    jobSystem->Wait(io);
+    succeeded = readOk && writeOk;
+  }
+  if (succeeded)
+  {
+    succeeded = writeTile(tiles.size() - 1);
+  }
+
+  if (outStats)
+  {
+    auto endTime = std::chrono::high_resolution_clock::now();
+    *outStats = ImageTilingStats{
+      .tileCount = uint32_t(tiles.size()),
+      .pixelCount = uint64_t(width) * height,
+      .inputPixelCount = uint64_t(inputWidth) * inputHeight * tiles.size(),
+      .elapsedMs = std::chrono::duration<double, std::milli>(endTime - startTime).count(),
+    };
+  }
+  return succeeded;
+}
+
+ImageTileReader MakeSurfaceTileReader(const ImageFilterSurface& source)
+{
+  return [source](const ImageTile& tile, const ImageFilterSurface& input) {
+    for (uint32_t y = 0; y < tile.inputHeight; ++y)
+    {
+      memcpy(input.GetRow(y), source.GetRow(tile.inputY + y) + size_t(tile.inputX) * 4, size_t(tile.inputWidth) * 4);
+    }
+    return true;
+  };
+}
+
+ImageTileWriter MakeSurfaceTileWriter(const ImageFilterSurface& destination)
+{
+  return [destination](const ImageTile& tile, const ImageFilterSurface& output) {
+    for (uint32_t y = 0; y < tile.height; ++y)
+    {
+      memcpy(destination.GetRow(tile.y + y) + size_t(tile.x) * 4, output.GetRow(y), size_t(tile.width) * 4);
+    }
+    return true;
+  };
+}
+
+bool DdsTileFile::OpenRead(const std::filesystem::path& path)
+{
+  Close();
+  m_file.open(path, std::ios::in | std::ios::binary);
+  if (!m_file)
+  {
+    return false;
+  }
+  // ヘッダ(DX10 拡張ヘッダを含む)だけを読んで画素データの位置を求める.
+  std::vector<char> header(4 + 124 + 20);
+  m_file.read(header.data(), header.size());
+  ImageInfo info;
+  size_t dataOffset = 0;
+  if (!ReadDDSPixelDataOffset(header.data(), size_t(m_file.gcount()), info, dataOffset))
+  {
+    Close();
+    return false;
+  }
+  m_file.clear();
+  m_dataOffset = dataOffset;
+  m_width = info.width;
+  m_height = info.height;
+  m_srgb = info.srgb;
+  return true;
+}
+
+bool DdsTileFile::Create(const std::filesystem::path& path, uint32_t width, uint32_t height, bool srgb)
+{
+  Close();
+  m_file.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!m_file)
+  {
+    return false;
+  }
+  std::vector<uint8_t> header;
+  m_dataOffset = EncodeDDSHeader(width, height, srgb, header);
+  m_file.write(reinterpret_cast<const char*>(header.data()), header.size());
+  m_width = width;
+  m_height = height;
+  m_srgb = srgb;
+  return m_file.good();
+}
+
+void DdsTileFile::Close()
+{
+  if (m_file.is_open())
+  {
+    m_file.close();
+  }
+  m_file.clear();
+  m_dataOffset = 0;
+  m_width = m_height = 0;
+  m_srgb = false;
+}
+
+bool DdsTileFile::ReadRegion(uint32_t x, uint32_t y, const ImageFilterSurface& surface)
+{
+  if (uint64_t(x) + surface.width > m_width || uint64_t(y) + surface.height > m_height)
+  {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (uint32_t row = 0; row < surface.height; ++row)
+  {
+    m_file.seekg(m_dataOffset + (uint64_t(y + row) * m_width + x) * 4);
+    m_file.read(reinterpret_cast<char*>(surface.GetRow(row)), std::streamsize(surface.width) * 4);
+  }
+  return m_file.good();
+}
+
+bool DdsTileFile::WriteRegion(uint32_t x, uint32_t y, const ImageFilterSurface& surface)
+{
+  if (uint64_t(x) + surface.width > m_width || uint64_t(y) + surface.height > m_height)
+  {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (uint32_t row = 0; row < surface.height; ++row)
+  {
+    m_file.seekp(m_dataOffset + (uint64_t(y + row) * m_width + x) * 4);
+    m_file.write(reinterpret_cast<const char*>(surface.GetRow(row)), std::streamsize(surface.width) * 4);
+  }
+  return m_file.good();
+}
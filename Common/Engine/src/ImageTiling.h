@@ -0,0 +1,101 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "ImageFilter.h"
+#include "ImageFilterCpu.h"
+
+// 大きな画像をタイルに分けてフィルタを適用する.
+// タイルの読み込み範囲には、近傍を読むフィルタが参照する周囲の画素(エプロン)を含める.
+// 読み込み範囲は画像の端では内側へずらすため、全タイルで同じ大きさになる.
+// 画像の端でのクランプは画像全体に適用した場合と同じ位置で起こるため、結果は全体に適用した場合と一致する.
+
+// 各軸のエプロンの幅(画素).
+struct ImageFilterApron
+{
+  uint32_t x = 0;
+  uint32_t y = 0;
+};
+
+// プランの全パスが参照する近傍の幅を、元の画像の軸ごとに足し合わせる.
+ImageFilterApron GetImageFilterPlanApron(const ImageFilterPlan& plan);
+
+struct ImageTile
+{
+  // 書き出す範囲.
+  uint32_t x = 0;
+  uint32_t y = 0;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  // エプロンを含めて読み込む範囲.
+  uint32_t inputX = 0;
+  uint32_t inputY = 0;
+  uint32_t inputWidth = 0;
+  uint32_t inputHeight = 0;
+};
+
+// 出力を tileSize 四方のタイルに分ける(左上から行順). 読み込み範囲は全て同じ大きさで、
+// 1辺 tileSize + エプロン * 2 (画像より大きい場合は画像の大きさ)になる.
+std::vector<ImageTile> MakeImageTiles(uint32_t width, uint32_t height, uint32_t tileSize, const ImageFilterApron& apron);
+
+// タイルの読み込み範囲を input (RGBA8, inputWidth x inputHeight) へ書き込む.
+using ImageTileReader = std::function<bool(const ImageTile& tile, const ImageFilterSurface& input)>;
+// タイルの書き出す範囲の結果 output (RGBA8, width x height) を受け取る.
+using ImageTileWriter = std::function<bool(const ImageTile& tile, const ImageFilterSurface& output)>;
+
+struct ImageTilingStats
+{
+  uint32_t tileCount = 0;
+  uint64_t pixelCount = 0;       // 出力の画素数.
+  uint64_t inputPixelCount = 0;  // エプロンを含めて処理した画素数.
+  double   elapsedMs = 0;
+
+  double GetMegaPixelsPerSecond() const { return elapsedMs > 0 ? double(pixelCount) / (elapsedMs * 1000.0) : 0.0; }
+  // エプロンのために重ねて処理した分の割合.
+  double GetOverhead() const { return pixelCount > 0 ? double(inputPixelCount) / double(pixelCount) - 1.0 : 0.0; }
+};
+
+// plan を width x height の画像にタイルごとに CPU で適用する.
+// 入出力は2組のバッファを交互に使い、あるタイルのフィルタ処理中に次のタイルの読み込みと前のタイルの書き出しを
+// JobSystem のジョブで行う. read と write は互いに並行して呼ばれることがあるが、それぞれが同時に呼ばれることはない.
+// 読み書きのどちらかが失敗した時点で中断して false を返す.
+bool ExecuteImageFilterPlanTiledCpu(const ImageFilterPlan& plan, uint32_t width, uint32_t height, uint32_t tileSize,
+  const ImageTileReader& read, const ImageTileWriter& write, uint32_t maxThreadCount = 0, ImageTilingStats* outStats = nullptr);
+
+// メモリ上の画像(RGBA8)との間でタイルを読み書きする. 画像はタイルの処理が終わるまで保持しておくこと.
+ImageTileReader MakeSurfaceTileReader(const ImageFilterSurface& source);
+ImageTileWriter MakeSurfaceTileWriter(const ImageFilterSurface& destination);
+
+// RGBA8 の DDS ファイルを、全体を読み込まずにタイルの範囲ずつ読み書きする.
+// 読み込みは ReadDDSPixelDataOffset で並べ替えずに読めるものに限る.
+class DdsTileFile
+{
+public:
+  bool OpenRead(const std::filesystem::path& path);
+  // 書き出し先を作成する. 画素データの領域はタイルを書き込んだ順に埋まる.
+  bool Create(const std::filesystem::path& path, uint32_t width, uint32_t height, bool srgb = false);
+  void Close();
+
+  uint32_t GetWidth() const { return m_width; }
+  uint32_t GetHeight() const { return m_height; }
+  bool IsSrgb() const { return m_srgb; }
+
+  // (x, y) から surface の大きさの範囲を読み書きする. 複数のスレッドから呼んでもよい.
+  bool ReadRegion(uint32_t x, uint32_t y, const ImageFilterSurface& surface);
+  bool WriteRegion(uint32_t x, uint32_t y, const ImageFilterSurface& surface);
+
+  ImageTileReader MakeReader() { return [this](const ImageTile& tile, const ImageFilterSurface& input) { return ReadRegion(tile.inputX, tile.inputY, input); }; }
+  ImageTileWriter MakeWriter() { return [this](const ImageTile& tile, const ImageFilterSurface& output) { return WriteRegion(tile.x, tile.y, output); }; }
+
+private:
+  std::fstream m_file;
+  std::mutex m_mutex;
+  uint64_t m_dataOffset = 0;
+  uint32_t m_width = 0;
+  uint32_t m_height = 0;
+  bool m_srgb = false;
+};
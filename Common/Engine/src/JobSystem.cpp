@@ -0,0 +1,213 @@
+﻿#include "JobSystem.h"
+#include <algorithm>
+#include <cassert>
+
+static std::unique_ptr<JobSystem> gJobSystem = nullptr;
+
+// 現在のスレッドが担当するキュー番号と、そのキューを持つジョブシステム. ワーカー以外のスレッドは0と nullptr.
+// 別のインスタンスのワーカーから呼ばれた場合は、ワーカー以外のスレッドとして扱う.
+static thread_local uint32_t tThreadIndex = 0;
+static thread_local const JobSystem* tOwner = nullptr;
+
+static uint32_t GetCurrentThreadIndex(const JobSystem* jobSystem)
+{
+  return tOwner == jobSystem ? tThreadIndex : 0;
+}
+
+std::unique_ptr<JobSystem>& GetJobSystem()
+{
+  if (gJobSystem == nullptr)
+  {
+    gJobSystem = std::make_unique<JobSystem>();
+  }
+  return gJobSystem;
+}
+
+void JobSystem::Initialize(uint32_t workerCount)
+{
+  if (m_running)
+  {
+    return;
+  }
+  if (workerCount == 0)
+  {
+    auto coreCount = std::thread::hardware_concurrency();
+    workerCount = std::max(1u, coreCount > 1 ? coreCount - 1 : 1u);
+  }
+
+  m_running = true;
+  m_queues.resize(workerCount + 1);
+  for (auto& queue : m_queues)
+  {
+    queue = std::make_unique<WorkQueue>();
+  }
+  for (uint32_t i = 0; i < workerCount; ++i)
+  {
+    m_workers.emplace_back(&JobSystem::WorkerMain, this, i + 1);
+  }
+}
+
+void JobSystem::Shutdown()
+{
+  if (!m_running)
+  {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+    m_running = false;
+  }
+  m_wakeup.notify_all();
+  for (auto& worker : m_workers)
+  {
+    worker.join();
+  }
+  m_workers.clear();
+  m_queues.clear();
+}
+
+void JobSystem::Run(JobGroup& group, uint32_t jobCount, JobFunction func)
+{
+  assert(!group.IsBusy());
+  if (jobCount == 0)
+  {
+    return;
+  }
+  group.m_function = std::move(func);
+  group.m_remain.store(jobCount, std::memory_order_release);
+
+  // ワーカーが未初期化ならその場で処理する.
+  if (m_queues.empty())
+  {
+    for (uint32_t i = 0; i < jobCount; ++i)
+    {
+      group.m_function(i, 0);
+    }
+    group.m_remain.store(0, std::memory_order_release);
+    return;
+  }
+
+  // 積む前に数えておく. 積んでから数えると、先に奪ったワーカーの減算が先に起こり一時的に負(0xFFFFFFFF 付近)になる.
+  {
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+    m_pendingJobs.fetch_add(jobCount, std::memory_order_release);
+  }
+
+  const auto queueCount = uint32_t(m_queues.size());
+  const auto threadIndex = GetCurrentThreadIndex(this);
+  if (threadIndex != 0)
+  {
+    // ワーカーからの入れ子の発行は自身のキューに積み、他のワーカーに奪わせる.
+    auto& queue = *m_queues[threadIndex];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    for (uint32_t i = 0; i < jobCount; ++i)
+    {
+      queue.jobs.push_back(Job{ &group, i });
+    }
+  }
+  else
+  {
+    // 最初から各キューに振り分けておき、奪い合いを減らす.
+    auto start = m_nextQueue.fetch_add(1, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < jobCount; ++i)
+    {
+      auto& queue = *m_queues[(start + i) % queueCount];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      queue.jobs.push_back(Job{ &group, i });
+    }
+  }
+
+  m_wakeup.notify_all();
+}
+
+void JobSystem::Wait(JobGroup& group)
+{
+  const auto threadIndex = GetCurrentThreadIndex(this);
+  while (group.IsBusy())
+  {
+    if (!ExecuteOne(threadIndex))
+    {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void JobSystem::Dispatch(uint32_t jobCount, JobFunction func)
+{
+  JobGroup group;
+  Run(group, jobCount, std::move(func));
+  Wait(group);
+}
+
+void JobSystem::WorkerMain(uint32_t threadIndex)
+{
+  tThreadIndex = threadIndex;
+  tOwner = this;
+  while (true)
+  {
+    if (ExecuteOne(threadIndex))
+    {
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(m_sleepMutex);
+    m_wakeup.wait(lock, [&]() {
+      return !m_running || m_pendingJobs.load(std::memory_order_acquire) > 0;
+    });
+    if (!m_running)
+    {
+      break;
+    }
+  }
+}
+
+bool JobSystem::PopJob(uint32_t queueIndex, Job& job)
+{
+  // 自身のキューは末尾から取り出す(直前に積んだものほどキャッシュに残っている).
+  auto& queue = *m_queues[queueIndex];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.jobs.empty())
+  {
+    return false;
+  }
+  job = queue.jobs.back();
+  queue.jobs.pop_back();
+  return true;
+}
+
+bool JobSystem::StealJob(uint32_t thiefIndex, Job& job)
+{
+  // 他のキューからは先頭から奪う.
+  const auto queueCount = uint32_t(m_queues.size());
+  for (uint32_t i = 1; i < queueCount; ++i)
+  {
+    auto& queue = *m_queues[(thiefIndex + i) % queueCount];
+    std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+    if (!lock.owns_lock() || queue.jobs.empty())
+    {
+      continue;
+    }
+    job = queue.jobs.front();
+    queue.jobs.pop_front();
+    return true;
+  }
+  return false;
+}
+
+bool JobSystem::ExecuteOne(uint32_t threadIndex)
+{
+  if (m_queues.empty())
+  {
+    return false;
+  }
+  Job job;
+  if (!PopJob(threadIndex, job) && !StealJob(threadIndex, job))
+  {
+    return false;
+  }
+  m_pendingJobs.fetch_sub(1, std::memory_order_acq_rel);
+
+  job.group->m_function(job.jobIndex, threadIndex);
+  job.group->m_remain.fetch_sub(1, std::memory_order_acq_rel);
+  return true;
+}
@@ -0,0 +1,78 @@
+﻿#pragma once
+#include <memory>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include <cstdint>
+
+// ワークスティーリング方式のスレッドプール.
+// 各ワーカーは自身のキューを持ち、空になったら他のワーカーのキューからジョブを奪って処理する.
+// プラットフォーム固有の機能は使用していないため、Windows以外でも動作する.
+class JobSystem
+{
+public:
+  // jobIndex: 発行したジョブの通し番号, threadIndex: 処理しているスレッドの番号(0は発行元スレッド).
+  using JobFunction = std::function<void(uint32_t jobIndex, uint32_t threadIndex)>;
+
+  // 発行したジョブの完了を追跡するためのグループ.
+  class JobGroup
+  {
+  public:
+    bool IsBusy() const { return m_remain.load(std::memory_order_acquire) != 0; }
+  private:
+    friend class JobSystem;
+    std::atomic<uint32_t> m_remain = 0;
+    JobFunction m_function;
+  };
+
+  // workerCount が 0 の時には論理コア数-1 のワーカーを作成する.
+  void Initialize(uint32_t workerCount = 0);
+  void Shutdown();
+
+  // 発行元スレッドを含めた処理スレッド数.
+  uint32_t GetThreadCount() const { return uint32_t(m_workers.size()) + 1; }
+  // 発行済みで、まだどのスレッドも取り出していないジョブの数.
+  uint32_t GetPendingJobCount() const { return m_pendingJobs.load(std::memory_order_acquire); }
+
+  // jobCount 個のジョブを非同期に発行する.
+  void Run(JobGroup& group, uint32_t jobCount, JobFunction func);
+  // グループ内のジョブ完了を待つ. 待機中は呼び出しスレッドもジョブを処理する.
+  void Wait(JobGroup& group);
+
+  // jobCount 個のジョブを発行し、完了まで待つ.
+  void Dispatch(uint32_t jobCount, JobFunction func);
+
+  ~JobSystem() { Shutdown(); }
+private:
+  struct Job
+  {
+    JobGroup* group = nullptr;
+    uint32_t  jobIndex = 0;
+  };
+  struct WorkQueue
+  {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+  };
+
+  void WorkerMain(uint32_t threadIndex);
+  bool PopJob(uint32_t queueIndex, Job& job);
+  bool StealJob(uint32_t thiefIndex, Job& job);
+  bool ExecuteOne(uint32_t threadIndex);
+
+  // キューはスレッド番号と対応させる(0番は発行元スレッド用).
+  std::vector<std::unique_ptr<WorkQueue>> m_queues;
+  std::vector<std::thread> m_workers;
+
+  std::mutex m_sleepMutex;
+  std::condition_variable m_wakeup;
+  std::atomic<uint32_t> m_pendingJobs = 0;
+  std::atomic<uint32_t> m_nextQueue = 0;
+  std::atomic<bool> m_running = false;
+};
+
+std::unique_ptr<JobSystem>& GetJobSystem();
@@ -0,0 +1,310 @@
+﻿#include "MipGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+  #include <emmintrin.h>
+  #define MIPGEN_USE_SSE2
+#elif defined(_M_ARM64) || defined(__ARM_NEON)
+  #include <arm_neon.h>
+  #define MIPGEN_USE_NEON
+#endif
+
+namespace
+{
+  // 1軸分のフィルタ. 縮小後の1ピクセルが参照する元ピクセルと重み.
+  struct FilterTaps
+  {
+    uint32_t index[3];
+    float    weight[3];
+    uint32_t count;
+  };
+
+  std::vector<FilterTaps> MakeFilterTaps(uint32_t srcSize, uint32_t dstSize)
+  {
+    std::vector<FilterTaps> taps(dstSize);
+    for (uint32_t i = 0; i < dstSize; ++i)
+    {
+      auto& tap = taps[i];
+      if (srcSize == 1)
+      {
+        tap = { { 0, 0, 0 }, { 1.0f, 0, 0 }, 1 };
+      }
+      else if ((srcSize & 1) == 0)
+      {
+        tap = { { 2 * i, 2 * i + 1, 0 }, { 0.5f, 0.5f, 0 }, 2 };
+      }
+      else
+      {
+        // 奇数サイズ(2n+1 -> n)では元の全ピクセルが均等に寄与するよう3タップで重み付けする.
+        const float n = float(dstSize);
+        const float invSize = 1.0f / float(srcSize);
+        tap = {
+          { 2 * i, 2 * i + 1, 2 * i + 2 },
+          { (n - float(i)) * invSize, n * invSize, (float(i) + 1.0f) * invSize },
+          3
+        };
+      }
+    }
+    return taps;
+  }
+
+  struct SrgbTable
+  {
+    float toLinear[256];
+    SrgbTable()
+    {
+      for (int i = 0; i < 256; ++i)
+      {
+        float c = float(i) / 255.0f;
+        toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+      }
+    }
+  };
+
+  uint8_t LinearToSrgb8(float c)
+  {
+    c = std::clamp(c, 0.0f, 1.0f);
+    c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+    return uint8_t(c * 255.0f + 0.5f);
+  }
+
+  uint8_t UnormToByte(float c)
+  {
+    return uint8_t(std::clamp(c, 0.0f, 255.0f) + 0.5f);
+  }
+
+  // 偶数サイズの 2x2 平均. 丸めは (a+b+c+d+2)/4 で、汎用処理と同じ結果になる.
+  void DownsampleBox2x2(
+    const uint8_t* src, uint32_t srcPitch,
+    uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight, uint32_t dstPitch)
+  {
+    for (uint32_t y = 0; y < dstHeight; ++y)
+    {
+      const uint8_t* row0 = src + size_t(2 * y) * srcPitch;
+      const uint8_t* row1 = row0 + srcPitch;
+      uint8_t* dstRow = dst + size_t(y) * dstPitch;
+      uint32_t x = 0;
+#if defined(MIPGEN_USE_SSE2)
+      // 元4ピクセル(16バイト) x 2行 から 2ピクセルを作る.
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i round = _mm_set1_epi16(2);
+      for (; x + 2 <= dstWidth; x += 2)
+      {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+        __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+        __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+        lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+        hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+        __m128i sum = _mm_unpacklo_epi64(lo, hi);
+        sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dstRow + x * 4), _mm_packus_epi16(sum, sum));
+      }
+#elif defined(MIPGEN_USE_NEON)
+      for (; x + 2 <= dstWidth; x += 2)
+      {
+        uint8x16_t a = vld1q_u8(row0 + x * 8);
+        uint8x16_t b = vld1q_u8(row1 + x * 8);
+        uint16x8_t lo = vaddl_u8(vget_low_u8(a), vget_low_u8(b));
+        uint16x8_t hi = vaddl_u8(vget_high_u8(a), vget_high_u8(b));
+        uint16x8_t sum = vcombine_u16(
+          vadd_u16(vget_low_u16(lo), vget_high_u16(lo)),
+          vadd_u16(vget_low_u16(hi), vget_high_u16(hi)));
+        vst1_u8(dstRow + x * 4, vrshrn_n_u16(sum, 2));
+      }
+#endif
+      for (; x < dstWidth; ++x)
+      {
+        for (uint32_t c = 0; c < DecodedImage::PixelBytes; ++c)
+        {
+          uint32_t sum = row0[x * 8 + c] + row0[x * 8 + 4 + c] + row1[x * 8 + c] + row1[x * 8 + 4 + c];
+          dstRow[x * 4 + c] = uint8_t((sum + 2) >> 2);
+        }
+      }
+    }
+  }
+
+  // 奇数サイズや sRGB を扱う汎用の縮小処理.
+  void DownsampleGeneric(
+    const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint32_t srcPitch,
+    uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight, uint32_t dstPitch,
+    bool srgb)
+  {
+    static const SrgbTable srgbTable;
+    const auto tapsX = MakeFilterTaps(srcWidth, dstWidth);
+    const auto tapsY = MakeFilterTaps(srcHeight, dstHeight);
+    for (uint32_t y = 0; y < dstHeight; ++y)
+    {
+      const auto& ty = tapsY[y];
+      uint8_t* dstRow = dst + size_t(y) * dstPitch;
+      for (uint32_t x = 0; x < dstWidth; ++x)
+      {
+        const auto& tx = tapsX[x];
+        float sum[4] = { 0, 0, 0, 0 };
+        for (uint32_t j = 0; j < ty.count; ++j)
+        {
+          const uint8_t* srcRow = src + size_t(ty.index[j]) * srcPitch;
+          for (uint32_t i = 0; i < tx.count; ++i)
+          {
+            const uint8_t* p = srcRow + tx.index[i] * 4;
+            const float w = ty.weight[j] * tx.weight[i];
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+              sum[c] += w * (srgb ? srgbTable.toLinear[p[c]] : float(p[c]));
+            }
+            sum[3] += w * float(p[3]);
+          }
+        }
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+          dstRow[x * 4 + c] = srgb ? LinearToSrgb8(sum[c]) : UnormToByte(sum[c]);
+        }
+        dstRow[x * 4 + 3] = UnormToByte(sum[3]);
+      }
+    }
+  }
+
+  void ScaleAlpha(uint8_t* pixels, uint32_t width, uint32_t height, uint32_t pitch, float scale)
+  {
+    for (uint32_t y = 0; y < height; ++y)
+    {
+      uint8_t* row = pixels + size_t(y) * pitch;
+      for (uint32_t x = 0; x < width; ++x)
+      {
+        row[x * 4 + 3] = UnormToByte(float(row[x * 4 + 3]) * scale);
+      }
+    }
+  }
+
+  // アルファを何倍すれば通過率が targetCoverage に近づくかを二分探索で求める.
+  float FindAlphaScale(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t pitch, float cutoff, float targetCoverage)
+  {
+    // 通過率は階段状に変化するため、試した中で最も近いものを採用する.
+    float minScale = 0.0f, maxScale = 4.0f, scale = 1.0f;
+    float bestScale = 1.0f, bestError = 2.0f;
+    std::vector<uint8_t> work(size_t(pitch) * height);
+    for (int step = 0; step < 10; ++step)
+    {
+      work.assign(pixels, pixels + work.size());
+      ScaleAlpha(work.data(), width, height, pitch, scale);
+      float coverage = ComputeAlphaCoverage(work.data(), width, height, pitch, cutoff);
+      float error = std::abs(coverage - targetCoverage);
+      if (error < bestError)
+      {
+        bestError = error;
+        bestScale = scale;
+      }
+      if (coverage < targetCoverage)
+      {
+        minScale = scale;
+      }
+      else if (coverage > targetCoverage)
+      {
+        maxScale = scale;
+      }
+      else
+      {
+        break;
+      }
+      scale = (minScale + maxScale) * 0.5f;
+    }
+    return bestScale;
+  }
+}
+
+void DownsampleLevel(
+  const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint32_t srcPitch,
+  uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight, uint32_t dstPitch,
+  bool srgb)
+{
+  const bool evenSize = (srcWidth & 1) == 0 && (srcHeight & 1) == 0;
+  if (evenSize && !srgb)
+  {
+    DownsampleBox2x2(src, srcPitch, dst, dstWidth, dstHeight, dstPitch);
+    return;
+  }
+  DownsampleGeneric(src, srcWidth, srcHeight, srcPitch, dst, dstWidth, dstHeight, dstPitch, srgb);
+}
+
+float ComputeAlphaCoverage(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t pitch, float cutoff)
+{
+  const uint32_t threshold = uint32_t(std::ceil(cutoff * 255.0f));
+  uint64_t passCount = 0;
+  for (uint32_t y = 0; y < height; ++y)
+  {
+    const uint8_t* row = pixels + size_t(y) * pitch;
+    for (uint32_t x = 0; x < width; ++x)
+    {
+      passCount += row[x * 4 + 3] >= threshold ? 1 : 0;
+    }
+  }
+  return float(passCount) / float(uint64_t(width) * height);
+}
+
+void GenerateMipLevelsReference(DecodedImage& image, bool srgb)
+{
+  static const SrgbTable srgbTable;
+  for (uint32_t mip = 1; mip < image.GetMipLevelCount(); ++mip)
+  {
+    const auto& src = image.mipLevels[mip - 1];
+    const auto& dst = image.mipLevels[mip];
+    const uint8_t* srcPixels = image.GetLevelData(mip - 1);
+    uint8_t* dstPixels = image.GetLevelData(mip);
+    if ((src.width & 1) == 0 && (src.height & 1) == 0 && !srgb)
+    {
+      DownsampleBox2x2(srcPixels, src.rowPitch, dstPixels, dst.width, dst.height, dst.rowPitch);
+      continue;
+    }
+    for (uint32_t y = 0; y < dst.height; ++y)
+    {
+      const uint8_t* row0 = srcPixels + size_t(std::min(2 * y, src.height - 1)) * src.rowPitch;
+      const uint8_t* row1 = srcPixels + size_t(std::min(2 * y + 1, src.height - 1)) * src.rowPitch;
+      uint8_t* dstRow = dstPixels + size_t(y) * dst.rowPitch;
+      for (uint32_t x = 0; x < dst.width; ++x)
+      {
+        const uint32_t x0 = std::min(2 * x, src.width - 1) * 4;
+        const uint32_t x1 = std::min(2 * x + 1, src.width - 1) * 4;
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+          if (srgb && c < 3)
+          {
+            const float sum = srgbTable.toLinear[row0[x0 + c]] + srgbTable.toLinear[row0[x1 + c]] +
+              srgbTable.toLinear[row1[x0 + c]] + srgbTable.toLinear[row1[x1 + c]];
+            dstRow[x * 4 + c] = LinearToSrgb8(sum * 0.25f);
+            continue;
+          }
+          uint32_t sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+          dstRow[x * 4 + c] = uint8_t((sum + 2) >> 2);
+        }
+      }
+    }
+  }
+}
+
+void GenerateMipLevels(DecodedImage& image, const MipGenerateOptions& options)
+{
+  float targetCoverage = 0.0f;
+  if (options.preserveAlphaCoverage && !image.mipLevels.empty())
+  {
+    const auto& level0 = image.mipLevels[0];
+    targetCoverage = ComputeAlphaCoverage(image.GetLevelData(0), level0.width, level0.height, level0.rowPitch, options.alphaCutoff);
+  }
+
+  for (uint32_t mip = 1; mip < image.GetMipLevelCount(); ++mip)
+  {
+    const auto& src = image.mipLevels[mip - 1];
+    const auto& dst = image.mipLevels[mip];
+    DownsampleLevel(
+      image.GetLevelData(mip - 1), src.width, src.height, src.rowPitch,
+      image.GetLevelData(mip), dst.width, dst.height, dst.rowPitch, options.srgb);
+
+    if (options.preserveAlphaCoverage)
+    {
+      auto dstPixels = image.GetLevelData(mip);
+      float scale = FindAlphaScale(dstPixels, dst.width, dst.height, dst.rowPitch, options.alphaCutoff, targetCoverage);
+      ScaleAlpha(dstPixels, dst.width, dst.height, dst.rowPitch, scale);
+    }
+  }
+}
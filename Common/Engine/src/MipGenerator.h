@@ -0,0 +1,23 @@
+﻿#pragma once
+#include "TextureDecode.h"
+
+// RGBA8 イメージのミップマップ作成.
+// 2x2 のボックスフィルタで縮小し、奇数サイズの軸では3タップの重み付きで隙間なく畳み込む.
+// 偶数サイズかつ sRGB 指定なしの場合は SIMD(SSE2/NEON) で処理する.
+
+// image.mipLevels に確保済みの領域へ、mip0 から残りのレベルを作成する.
+void GenerateMipLevels(DecodedImage& image, const MipGenerateOptions& options);
+
+// 1レベル分の縮小. dst のサイズは src の各軸を半分(最小1)にしたものであること.
+void DownsampleLevel(
+  const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint32_t srcPitch,
+  uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight, uint32_t dstPitch,
+  bool srgb);
+
+// GPU のミップマップ作成(GenerateMipsCS.hlsl)と同じ計算を行う参照実装. 結果の比較検証に使う.
+// 2x2 の平均で、奇数サイズの軸は端のテクセルを繰り返す(3タップの重み付けは行わない).
+// srgb の場合は RGB を線形空間で平均する. GPU とは pow の精度の違いで ±1 の差が出ることがある.
+void GenerateMipLevelsReference(DecodedImage& image, bool srgb = false);
+
+// アルファが cutoff 以上のピクセルの割合.
+float ComputeAlphaCoverage(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t pitch, float cutoff);
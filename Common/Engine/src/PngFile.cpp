@@ -0,0 +1,366 @@
+﻿#include "PngFile.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+  uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+  {
+    static const auto table = [] {
+      std::array<uint32_t, 256> t{};
+      for (uint32_t i = 0; i < 256; ++i)
+      {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k)
+        {
+          c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        t[i] = c;
+      }
+      return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+    {
+      crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+  }
+
+  uint32_t Adler32(const uint8_t* data, size_t size)
+  {
+    uint32_t a = 1, b = 0;
+    while (size > 0)
+    {
+      // 5552 バイトまでは剰余を取らなくても桁あふれしない.
+      size_t count = std::min<size_t>(size, 5552);
+      size -= count;
+      for (size_t i = 0; i < count; ++i)
+      {
+        a += *data++;
+        b += a;
+      }
+      a %= 65521;
+      b %= 65521;
+    }
+    return (b << 16) | a;
+  }
+
+  void WriteBigEndian(std::vector<uint8_t>& out, uint32_t value)
+  {
+    out.push_back(uint8_t(value >> 24));
+    out.push_back(uint8_t(value >> 16));
+    out.push_back(uint8_t(value >> 8));
+    out.push_back(uint8_t(value));
+  }
+
+  // 下位ビットから順に詰めて書き出す(Deflate のビット順).
+  class BitWriter
+  {
+  public:
+    explicit BitWriter(std::vector<uint8_t>& out) : m_out(out) {}
+
+    void Write(uint32_t bits, uint32_t count)
+    {
+      m_buffer |= uint64_t(bits) << m_count;
+      m_count += count;
+      while (m_count >= 8)
+      {
+        m_out.push_back(uint8_t(m_buffer));
+        m_buffer >>= 8;
+        m_count -= 8;
+      }
+    }
+    // ハフマン符号は上位ビットから格納するため、反転して書く.
+    void WriteCode(uint32_t code, uint32_t length)
+    {
+      uint32_t reversed = 0;
+      for (uint32_t i = 0; i < length; ++i)
+      {
+        reversed = (reversed << 1) | ((code >> i) & 1);
+      }
+      Write(reversed, length);
+    }
+    void Flush()
+    {
+      if (m_count > 0)
+      {
+        m_out.push_back(uint8_t(m_buffer));
+      }
+      m_buffer = 0;
+      m_count = 0;
+    }
+  private:
+    std::vector<uint8_t>& m_out;
+    uint64_t m_buffer = 0;
+    uint32_t m_count = 0;
+  };
+
+  // 固定ハフマン符号のリテラル・長さの符号(0-287).
+  void WriteFixedLiteral(BitWriter& writer, uint32_t value)
+  {
+    if (value < 144)
+    {
+      writer.WriteCode(0x30 + value, 8);
+    }
+    else if (value < 256)
+    {
+      writer.WriteCode(0x190 + value - 144, 9);
+    }
+    else if (value < 280)
+    {
+      writer.WriteCode(value - 256, 7);
+    }
+    else
+    {
+      writer.WriteCode(0xC0 + value - 280, 8);
+    }
+  }
+
+  const uint16_t LengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+  const uint8_t LengthExtraBits[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+  const uint16_t DistanceBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+  const uint8_t DistanceExtraBits[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+  void WriteFixedMatch(BitWriter& writer, uint32_t length, uint32_t distance)
+  {
+    int lengthCode = 28;
+    while (LengthBase[lengthCode] > length)
+    {
+      --lengthCode;
+    }
+    WriteFixedLiteral(writer, 257 + lengthCode);
+    writer.Write(length - LengthBase[lengthCode], LengthExtraBits[lengthCode]);
+
+    int distanceCode = 29;
+    while (DistanceBase[distanceCode] > distance)
+    {
+      --distanceCode;
+    }
+    writer.WriteCode(distanceCode, 5);
+    writer.Write(distance - DistanceBase[distanceCode], DistanceExtraBits[distanceCode]);
+  }
+
+  // zlib 形式で圧縮する. 1つの固定ハフマンブロックに、ハッシュ連鎖で探した一致を書き出す.
+  void CompressZlib(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+  {
+    const uint32_t HashBits = 15;
+    const uint32_t WindowSize = 32768;
+    const uint32_t MinMatch = 3;
+    const uint32_t MaxMatch = 258;
+    const uint32_t MaxChain = 8;
+
+    out.push_back(0x78);  // CM=8 (Deflate), 32K ウィンドウ.
+    out.push_back(0x01);
+    BitWriter writer(out);
+    writer.Write(1, 1);  // BFINAL
+    writer.Write(1, 2);  // BTYPE=01 (固定ハフマン符号)
+
+    std::vector<int32_t> head(size_t(1) << HashBits, -1);
+    std::vector<int32_t> prev(WindowSize, -1);
+    auto hash = [&](size_t pos) {
+      uint32_t v = data[pos] | (uint32_t(data[pos + 1]) << 8) | (uint32_t(data[pos + 2]) << 16);
+      return (v * 2654435761u) >> (32 - HashBits);
+    };
+    auto insert = [&](size_t pos) {
+      if (pos + MinMatch <= size)
+      {
+        auto h = hash(pos);
+        prev[pos & (WindowSize - 1)] = head[h];
+        head[h] = int32_t(pos);
+      }
+    };
+
+    size_t pos = 0;
+    while (pos < size)
+    {
+      uint32_t bestLength = 0;
+      uint32_t bestDistance = 0;
+      if (pos + MinMatch <= size)
+      {
+        const uint32_t maxLength = uint32_t(std::min<size_t>(MaxMatch, size - pos));
+        int32_t candidate = head[hash(pos)];
+        for (uint32_t chain = 0; candidate >= 0 && chain < MaxChain; ++chain)
+        {
+          const size_t distance = pos - size_t(candidate);
+          if (distance > WindowSize)
+          {
+            break;
+          }
+          uint32_t length = 0;
+          while (length < maxLength && data[candidate + length] == data[pos + length])
+          {
+            ++length;
+          }
+          if (length > bestLength)
+          {
+            bestLength = length;
+            bestDistance = uint32_t(distance);
+            if (length == maxLength)
+            {
+              break;
+            }
+          }
+          // 古い位置は上書きされている場合があるため、前へ進まなくなったら打ち切る.
+          int32_t next = prev[candidate & (WindowSize - 1)];
+          if (next >= candidate)
+          {
+            break;
+          }
+          candidate = next;
+        }
+      }
+
+      if (bestLength >= MinMatch)
+      {
+        WriteFixedMatch(writer, bestLength, bestDistance);
+        for (uint32_t i = 0; i < bestLength; ++i)
+        {
+          insert(pos + i);
+        }
+        pos += bestLength;
+      }
+      else
+      {
+        WriteFixedLiteral(writer, data[pos]);
+        insert(pos);
+        ++pos;
+      }
+    }
+    WriteFixedLiteral(writer, 256);  // ブロック終端.
+    writer.Flush();
+    WriteBigEndian(out, Adler32(data, size));
+  }
+
+  // 圧縮せずに格納ブロックだけで zlib 形式にする. 固定ハフマン符号で小さくならないデータ(ノイズなど)に使う.
+  void StoreZlib(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+  {
+    out.push_back(0x78);
+    out.push_back(0x01);
+    size_t pos = 0;
+    do
+    {
+      const uint16_t length = uint16_t(std::min<size_t>(size - pos, 65535));
+      const bool final = (pos + length == size);
+      out.push_back(final ? 1 : 0);  // BFINAL, BTYPE=00. 残りのビットは詰め物.
+      out.push_back(uint8_t(length));
+      out.push_back(uint8_t(length >> 8));
+      out.push_back(uint8_t(~length));
+      out.push_back(uint8_t(~length >> 8));
+      out.insert(out.end(), data + pos, data + pos + length);
+      pos += length;
+    } while (pos < size);
+    WriteBigEndian(out, Adler32(data, size));
+  }
+
+  uint8_t Paeth(int a, int b, int c)
+  {
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc)
+    {
+      return uint8_t(a);
+    }
+    return uint8_t(pb <= pc ? b : c);
+  }
+
+  void WriteChunk(std::vector<uint8_t>& out, const char type[4], const uint8_t* data, size_t size)
+  {
+    WriteBigEndian(out, uint32_t(size));
+    const size_t typeOffset = out.size();
+    out.insert(out.end(), type, type + 4);
+    if (size > 0)
+    {
+      out.insert(out.end(), data, data + size);
+    }
+    WriteBigEndian(out, Crc32(out.data() + typeOffset, size + 4));
+  }
+}
+
+bool EncodePNG(const DecodedImage& image, std::vector<uint8_t>& outBuffer)
+{
+  if (image.format != ImageFormat::RGBA8 || image.mipLevels.empty())
+  {
+    return false;
+  }
+  const auto& level = image.mipLevels[0];
+  const uint32_t width = level.width;
+  const uint32_t height = level.height;
+  const size_t rowBytes = size_t(width) * 4;
+  const uint8_t* pixels = image.GetLevelData(0);
+
+  // 各行の先頭にフィルタの種類を置き、差分の絶対値の和が最小になるものを選ぶ.
+  std::vector<uint8_t> filtered((rowBytes + 1) * height);
+  std::vector<uint8_t> candidate(rowBytes);
+  std::vector<uint8_t> zeroRow(rowBytes, 0);
+  for (uint32_t y = 0; y < height; ++y)
+  {
+    const uint8_t* row = pixels + size_t(level.rowPitch) * y;
+    const uint8_t* up = (y > 0) ? pixels + size_t(level.rowPitch) * (y - 1) : zeroRow.data();
+    uint8_t* dst = filtered.data() + (rowBytes + 1) * y;
+    uint64_t bestCost = ~0ull;
+    for (uint8_t filter = 0; filter < 5; ++filter)
+    {
+      uint64_t cost = 0;
+      for (size_t i = 0; i < rowBytes; ++i)
+      {
+        const int a = (i >= 4) ? row[i - 4] : 0;
+        const int b = up[i];
+        const int c = (i >= 4) ? up[i - 4] : 0;
+        uint8_t predictor = 0;
+        switch (filter)
+        {
+        case 1: predictor = uint8_t(a); break;
+        case 2: predictor = uint8_t(b); break;
+        case 3: predictor = uint8_t((a + b) / 2); break;
+        case 4: predictor = Paeth(a, b, c); break;
+        default: break;
+        }
+        candidate[i] = uint8_t(row[i] - predictor);
+        cost += std::abs(int(int8_t(candidate[i])));
+      }
+      if (cost < bestCost)
+      {
+        bestCost = cost;
+        dst[0] = filter;
+        std::memcpy(dst + 1, candidate.data(), rowBytes);
+      }
+    }
+  }
+
+  static const uint8_t Signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+  outBuffer.assign(Signature, Signature + 8);
+
+  std::vector<uint8_t> header;
+  WriteBigEndian(header, width);
+  WriteBigEndian(header, height);
+  header.push_back(8);  // ビット深度.
+  header.push_back(6);  // カラータイプ: RGBA.
+  header.push_back(0);  // 圧縮方式.
+  header.push_back(0);  // フィルタ方式.
+  header.push_back(0);  // インターレースなし.
+  WriteChunk(outBuffer, "IHDR", header.data(), header.size());
+
+  std::vector<uint8_t> compressed;
+  compressed.reserve(filtered.size() / 2);
+  CompressZlib(filtered.data(), filtered.size(), compressed);
+  if (compressed.size() > filtered.size() + filtered.size() / 65535 * 5 + 11)
+  {
+    compressed.clear();
+    StoreZlib(filtered.data(), filtered.size(), compressed);
+  }
+  WriteChunk(outBuffer, "IDAT", compressed.data(), compressed.size());
+  WriteChunk(outBuffer, "IEND", nullptr, 0);
+  return true;
+}
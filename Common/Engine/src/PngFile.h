@@ -0,0 +1,7 @@
+﻿#pragma once
+#include "TextureDecode.h"
+
+// PNG ファイルの書き出し. 読み込みは DecodeImage (stb_image) で行う.
+// RGBA8 の mip0 (配列の場合は先頭のスライス)を 8bit RGBA で出力する.
+// 行ごとに差分フィルタを選び、固定ハフマン符号の Deflate で圧縮する. 圧縮率より速度を優先している.
+bool EncodePNG(const DecodedImage& image, std::vector<uint8_t>& outBuffer);
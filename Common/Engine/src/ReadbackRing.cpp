@@ -0,0 +1,229 @@
+﻿#include "ReadbackRing.h"
+
+#include <utility>
+
+static std::unique_ptr<ReadbackRing> gReadbackRing = nullptr;
+
+std::unique_ptr<ReadbackRing>& GetReadbackRing()
+{
+  if (gReadbackRing == nullptr)
+  {
+    gReadbackRing = std::make_unique<ReadbackRing>();
+  }
+  return gReadbackRing;
+}
+
+void ReadbackRing::Initialize(UINT64 size)
+{
+  auto& gfxDevice = GetGfxDevice();
+  D3D12_RESOURCE_DESC resDesc{
+    .Dimension = D3D12_RESOURCE_DIMENSION_BUFFER,
+    .Alignment = 0,
+    .Width = size, .Height = 1, .DepthOrArraySize = 1, .MipLevels = 1,
+    .Format = DXGI_FORMAT_UNKNOWN,
+    .SampleDesc = {.Count = 1, .Quality = 0 },
+    .Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR,
+    .Flags = D3D12_RESOURCE_FLAG_NONE,
+  };
+  m_buffer = gfxDevice->CreateBuffer(resDesc, D3D12_HEAP_TYPE_READBACK, D3D12_RESOURCE_STATE_COPY_DEST);
+  if (m_buffer == nullptr)
+  {
+    return;
+  }
+  if (FAILED(gfxDevice->GetD3D12Device()->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence))))
+  {
+    m_buffer.Reset();
+    return;
+  }
+  // READBACK ヒープはマップしたままでよい. 読む範囲はリクエストの完了ごとに異なるため全体を指定する.
+  void* p = nullptr;
+  m_buffer->Map(0, nullptr, &p);
+  m_mapped = reinterpret_cast<BYTE*>(p);
+  m_size = size;
+  m_head = m_tail = m_used = 0;
+  m_fenceValue = 0;
+  m_requests.clear();
+}
+
+void ReadbackRing::Shutdown()
+{
+  // GPU が書き込み中の領域があれば完了を待ってから解放する.
+  if (!m_requests.empty() && m_fenceValue > 0)
+  {
+    m_fence->SetEventOnCompletion(m_fenceValue, nullptr);
+  }
+  m_requests.clear();
+  if (m_buffer)
+  {
+    const D3D12_RANGE writtenRange{ 0, 0 };
+    m_buffer->Unmap(0, &writtenRange);
+  }
+  m_mapped = nullptr;
+  m_buffer.Reset();
+  m_fence.Reset();
+  m_size = 0;
+}
+
+bool ReadbackRing::RequestReadback(ID3D12GraphicsCommandList* commandList, ID3D12Resource* resource,
+  D3D12_RESOURCE_STATES state, Callback callback, UINT subresource)
+{
+  if (!IsInitialized())
+  {
+    return false;
+  }
+  const auto resDesc = resource->GetDesc();
+  Data data;
+  UINT64 alignment = 0;
+  D3D12_PLACED_SUBRESOURCE_FOOTPRINT layout{};
+  if (resDesc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+  {
+    data.size = resDesc.Width;
+    data.footprint = { .Format = DXGI_FORMAT_UNKNOWN, .Width = UINT(resDesc.Width), .Height = 1, .Depth = 1, .RowPitch = UINT(resDesc.Width) };
+    alignment = D3D12_RAW_UAV_SRV_BYTE_ALIGNMENT;
+  }
+  else
+  {
+    GetGfxDevice()->GetD3D12Device()->GetCopyableFootprints(&resDesc, subresource, 1, 0, &layout, nullptr, nullptr, &data.size);
+    data.footprint = layout.Footprint;
+    data.isTexture = true;
+    alignment = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+  }
+
+  UINT64 offset = 0, consumed = 0;
+  if (!TryAllocate(data.size, alignment, offset, consumed))
+  {
+    m_failedCount++;
+    return false;
+  }
+  data.cpuAddress = m_mapped + offset;
+
+  D3D12_RESOURCE_BARRIER barrier{
+    .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+    .Transition = {
+      .pResource = resource,
+      .Subresource = subresource,
+      .StateBefore = state,
+      .StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE,
+    }
+  };
+  const bool needsTransition = state != D3D12_RESOURCE_STATE_COPY_SOURCE;
+  if (needsTransition)
+  {
+    commandList->ResourceBarrier(1, &barrier);
+  }
+  if (data.isTexture)
+  {
+    layout.Offset = offset;
+    D3D12_TEXTURE_COPY_LOCATION dst{
+      .pResource = m_buffer.Get(),
+      .Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT,
+      .PlacedFootprint = layout,
+    };
+    D3D12_TEXTURE_COPY_LOCATION src{
+      .pResource = resource,
+      .Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX,
+      .SubresourceIndex = subresource,
+    };
+    commandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+  }
+  else
+  {
+    commandList->CopyBufferRegion(m_buffer.Get(), offset, resource, 0, data.size);
+  }
+  if (needsTransition)
+  {
+    std::swap(barrier.Transition.StateBefore, barrier.Transition.StateAfter);
+    commandList->ResourceBarrier(1, &barrier);
+  }
+
+  m_requests.push_back({ 0, m_head, consumed, data, std::move(callback) });
+  return true;
+}
+
+void ReadbackRing::Signal()
+{
+  if (!IsInitialized() || m_requests.empty() || m_requests.back().fenceValue != 0)
+  {
+    return;
+  }
+  GetGfxDevice()->GetD3D12CommandQueue()->Signal(m_fence.Get(), ++m_fenceValue);
+  for (auto it = m_requests.rbegin(); it != m_requests.rend() && it->fenceValue == 0; ++it)
+  {
+    it->fenceValue = m_fenceValue;
+  }
+}
+
+void ReadbackRing::Update()
+{
+  if (!IsInitialized())
+  {
+    return;
+  }
+  // フェンスの値は発行順に増えるため、先頭から完了したものだけを処理すればよい.
+  const auto completed = m_fence->GetCompletedValue();
+  while (!m_requests.empty() && m_requests.front().fenceValue != 0 && m_requests.front().fenceValue <= completed)
+  {
+    // コールバックの中から RequestReadback を呼べるよう、先に取り出して領域を回収しておく.
+    // 回収した領域は次の Signal より後の GPU のコピーでしか上書きされないため、コールバックの間は有効.
+    Request request = std::move(m_requests.front());
+    m_requests.pop_front();
+    m_tail = request.end;
+    m_used -= request.usedSize;
+    m_completedCount++;
+    if (request.callback)
+    {
+      request.callback(request.data);
+    }
+  }
+}
+
+bool ReadbackRing::TryAllocate(UINT64 size, UINT64 alignment, UINT64& outOffset, UINT64& outConsumed)
+{
+  if (size > m_size)
+  {
+    return false;
+  }
+  if (m_used == 0)
+  {
+    m_head = m_tail = 0;
+  }
+  else if (m_used >= m_size)
+  {
+    return false;
+  }
+  auto alignUp = [&](UINT64 value) { return (value + alignment - 1) / alignment * alignment; };
+
+  UINT64 offset = 0, consumed = 0;
+  if (m_head >= m_tail)
+  {
+    // 末尾側に空きがあれば使い、足りなければ先頭に折り返す.
+    if (alignUp(m_head) + size <= m_size)
+    {
+      offset = alignUp(m_head);
+      consumed = offset - m_head + size;
+    }
+    else if (size <= m_tail)
+    {
+      offset = 0;
+      consumed = m_size - m_head + size;
+    }
+    else
+    {
+      return false;
+    }
+  }
+  else
+  {
+    if (alignUp(m_head) + size > m_tail)
+    {
+      return false;
+    }
+    offset = alignUp(m_head);
+    consumed = offset - m_head + size;
+  }
+  m_head = offset + size;
+  m_used += consumed;
+  outOffset = offset;
+  outConsumed = consumed;
+  return true;
+}
@@ -0,0 +1,75 @@
+﻿#pragma once
+#include <memory>
+#include <deque>
+#include <functional>
+#include <cstdint>
+#include "GfxDevice.h"
+
+// GPU のリソースを CPU へ読み返すための常駐の READBACK バッファ(リングバッファ).
+// RequestReadback でコピーを記録し、Signal で区切った区間のフェンスが完了した後の Update でコールバックを呼ぶ.
+// 完了を待たないため、結果は数フレーム後に届く. 空きが足りない場合も待たずに失敗を返す.
+// メインスレッドから使用すること.
+class ReadbackRing
+{
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+public:
+  // 読み返した内容. コールバックの間だけ有効.
+  struct Data
+  {
+    const BYTE* cpuAddress = nullptr;
+    UINT64 size = 0;
+    // テクスチャの場合の配置(行のピッチは D3D12_TEXTURE_DATA_PITCH_ALIGNMENT 単位). バッファの場合は Width が size.
+    D3D12_SUBRESOURCE_FOOTPRINT footprint = { };
+    bool isTexture = false;
+  };
+  using Callback = std::function<void(const Data& data)>;
+
+  void Initialize(UINT64 size);
+  // 完了していないリクエストは破棄し、コールバックは呼ばない.
+  void Shutdown();
+  bool IsInitialized() const { return m_buffer != nullptr; }
+  UINT64 GetSize() const { return m_size; }
+
+  // resource を読み返すコピーを commandList に記録する. テクスチャは subresource の1つを読む.
+  // resource は state の状態にあるものとし、コピーの前後で D3D12_RESOURCE_STATE_COPY_SOURCE との間を遷移させる.
+  // 空きが足りない場合は何も記録せずに false を返す.
+  bool RequestReadback(ID3D12GraphicsCommandList* commandList, ID3D12Resource* resource,
+    D3D12_RESOURCE_STATES state, Callback callback, UINT subresource = 0);
+  // 直前までに記録したリクエストを含むコマンドリストをキューに発行した後に呼ぶ.
+  void Signal();
+  // 完了したリクエストのコールバックを発行順に呼び、領域を回収する. フレームごとに呼ぶ.
+  void Update();
+
+  // 統計情報.
+  UINT64 GetUsedSize() const { return m_used; }
+  uint32_t GetPendingCount() const { return uint32_t(m_requests.size()); }
+  uint32_t GetCompletedCount() const { return m_completedCount; }
+  uint32_t GetFailedCount() const { return m_failedCount; }
+
+private:
+  struct Request
+  {
+    UINT64 fenceValue;  // Signal 前は 0.
+    UINT64 end;         // 領域の末尾(次の領域の先頭).
+    UINT64 usedSize;    // 整列や折り返しで空けた分を含む確保量.
+    Data data;
+    Callback callback;
+  };
+  bool TryAllocate(UINT64 size, UINT64 alignment, UINT64& outOffset, UINT64& outConsumed);
+
+  ComPtr<ID3D12Resource1> m_buffer;
+  BYTE*  m_mapped = nullptr;
+  UINT64 m_size = 0;
+  UINT64 m_head = 0;  // 次に確保する位置.
+  UINT64 m_tail = 0;  // 使用中の最も古い位置.
+  UINT64 m_used = 0;
+
+  ComPtr<ID3D12Fence1> m_fence;
+  UINT64 m_fenceValue = 0;
+  std::deque<Request> m_requests;
+  uint32_t m_completedCount = 0;
+  uint32_t m_failedCount = 0;
+};
+
+std::unique_ptr<ReadbackRing>& GetReadbackRing();
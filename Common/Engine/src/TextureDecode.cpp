@@ -0,0 +1,208 @@
+﻿#include "TextureDecode.h"
+#include "JobSystem.h"
+#include "MipGenerator.h"
+#include "DdsFile.h"
+
+#include "stb/stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+uint32_t DecodedImage::GetRowSize(uint32_t mip) const
+{
+  const auto width = mipLevels[mip].width;
+  const auto columns = IsBlockCompressed(format) ? (width + 3) / 4 : width;
+  return columns * GetFormatElementBytes(format);
+}
+
+size_t DecodedImage::Layout(uint32_t width, uint32_t height, uint32_t mipCount, ImageFormat imageFormat, uint32_t sliceCount)
+{
+  format = imageFormat;
+  arraySize = std::max(sliceCount, 1u);
+  mipLevels.clear();
+  size_t totalSize = 0;
+  while (true)
+  {
+    const bool compressed = IsBlockCompressed(format);
+    const uint32_t columns = compressed ? (width + 3) / 4 : width;
+    MipLevel level{
+      .width = width,
+      .height = height,
+      .rowPitch = (columns * GetFormatElementBytes(format) + RowPitchAlignment - 1) & ~(RowPitchAlignment - 1),
+      .rowCount = compressed ? (height + 3) / 4 : height,
+      .offset = (totalSize + PlacementAlignment - 1) & ~size_t(PlacementAlignment - 1),
+    };
+    totalSize = level.offset + size_t(level.rowPitch) * level.rowCount;
+    mipLevels.push_back(level);
+
+    if ((mipCount != 0 && mipLevels.size() >= mipCount) || (width == 1 && height == 1))
+    {
+      break;
+    }
+    width = std::max(1u, width / 2);
+    height = std::max(1u, height / 2);
+  }
+  // 次のスライスの先頭も PlacementAlignment に揃う.
+  slicePitch = (totalSize + PlacementAlignment - 1) & ~size_t(PlacementAlignment - 1);
+  return slicePitch * (arraySize - 1) + totalSize;
+}
+
+void DecodedImage::Allocate(uint32_t width, uint32_t height, uint32_t mipCount, ImageFormat imageFormat, uint32_t sliceCount)
+{
+  externalPixels = nullptr;
+  pixels.assign(Layout(width, height, mipCount, imageFormat, sliceCount), 0);
+}
+
+void DecodedImage::AttachStorage(uint8_t* data)
+{
+  pixels.clear();
+  pixels.shrink_to_fit();
+  externalPixels = data;
+}
+
+bool DecodeImage(const void* srcBuffer, size_t bufferSize, DecodedImage& outImage)
+{
+  if (IsDDS(srcBuffer, bufferSize))
+  {
+    return DecodeDDS(srcBuffer, bufferSize, outImage);
+  }
+
+  auto buffer = reinterpret_cast<const stbi_uc*>(srcBuffer);
+  int imageWidth = 0, imageHeight = 0;
+  auto srcImage = stbi_load_from_memory(buffer, int(bufferSize), &imageWidth, &imageHeight, nullptr, DecodedImage::PixelBytes);
+  if (srcImage == nullptr)
+  {
+    return false;
+  }
+
+  outImage.Allocate(uint32_t(imageWidth), uint32_t(imageHeight), 1);
+  const auto& level = outImage.mipLevels[0];
+  const size_t srcPitch = size_t(imageWidth) * DecodedImage::PixelBytes;
+  for (uint32_t y = 0; y < level.height; ++y)
+  {
+    memcpy(outImage.GetLevelData(0) + size_t(y) * level.rowPitch, srcImage + y * srcPitch, srcPitch);
+  }
+  stbi_image_free(srcImage);
+  return true;
+}
+
+bool ReadImageInfo(const void* srcBuffer, size_t bufferSize, ImageInfo& outInfo)
+{
+  if (IsDDS(srcBuffer, bufferSize))
+  {
+    return ReadDDSInfo(srcBuffer, bufferSize, outInfo);
+  }
+  int imageWidth = 0, imageHeight = 0, components = 0;
+  if (!stbi_info_from_memory(reinterpret_cast<const stbi_uc*>(srcBuffer), int(bufferSize), &imageWidth, &imageHeight, &components))
+  {
+    return false;
+  }
+  outInfo = ImageInfo{
+    .width = uint32_t(imageWidth),
+    .height = uint32_t(imageHeight),
+    .mipCount = 1,
+    .format = ImageFormat::RGBA8,
+  };
+  return true;
+}
+
+bool DecodeImageInto(const void* srcBuffer, size_t bufferSize, DecodedImage& image, const MipGenerateOptions& options)
+{
+  if (image.GetMipLevelCount() == 0)
+  {
+    return false;
+  }
+  uint32_t decodedMipCount = 1;
+  if (IsDDS(srcBuffer, bufferSize))
+  {
+    ImageInfo info;
+    if (!ReadDDSInfo(srcBuffer, bufferSize, info) || !DecodeDDS(srcBuffer, bufferSize, image))
+    {
+      return false;
+    }
+    decodedMipCount = std::min(info.mipCount, image.GetMipLevelCount());
+  }
+  else
+  {
+    // stb は展開結果を自前のバッファに返すため、そこから格納先の行ピッチに合わせて移す.
+    auto buffer = reinterpret_cast<const stbi_uc*>(srcBuffer);
+    int imageWidth = 0, imageHeight = 0;
+    auto srcImage = stbi_load_from_memory(buffer, int(bufferSize), &imageWidth, &imageHeight, nullptr, DecodedImage::PixelBytes);
+    if (srcImage == nullptr)
+    {
+      return false;
+    }
+    const auto& level = image.mipLevels[0];
+    if (image.format != ImageFormat::RGBA8 || uint32_t(imageWidth) != level.width || uint32_t(imageHeight) != level.height)
+    {
+      stbi_image_free(srcImage);
+      return false;
+    }
+    const size_t srcPitch = size_t(imageWidth) * DecodedImage::PixelBytes;
+    for (uint32_t y = 0; y < level.height; ++y)
+    {
+      memcpy(image.GetLevelData(0) + size_t(y) * level.rowPitch, srcImage + y * srcPitch, srcPitch);
+    }
+    stbi_image_free(srcImage);
+  }
+
+  image.srgb = image.srgb || options.srgb;
+  if (decodedMipCount == 1 && image.GetMipLevelCount() > 1 && !IsBlockCompressed(image.format))
+  {
+    GenerateMipLevels(image, options);
+  }
+  return true;
+}
+
+void BuildMipChain(DecodedImage& image, const MipGenerateOptions& options)
+{
+  if (image.GetMipLevelCount() != 1 || IsBlockCompressed(image.format))
+  {
+    return;
+  }
+
+  // 全レベル分の領域を確保し直して、mip0 を移す.
+  DecodedImage result;
+  result.Allocate(image.GetWidth(), image.GetHeight(), 0);
+  result.srgb = image.srgb;
+  const auto& srcLevel = image.mipLevels[0];
+  for (uint32_t y = 0; y < srcLevel.height; ++y)
+  {
+    memcpy(result.GetLevelData(0) + size_t(y) * result.mipLevels[0].rowPitch,
+      image.GetLevelData(0) + size_t(y) * srcLevel.rowPitch, size_t(srcLevel.width) * DecodedImage::PixelBytes);
+  }
+  GenerateMipLevels(result, options);
+  image = std::move(result);
+}
+
+TextureDecodeStats DecodeImages(std::vector<TextureDecodeRequest>& requests)
+{
+  auto& jobSystem = GetJobSystem();
+  auto startTime = std::chrono::high_resolution_clock::now();
+
+  // 1画像を1ジョブとして処理する. 画像サイズの偏りはワークスティーリングで均される.
+  jobSystem->Dispatch(uint32_t(requests.size()), [&](uint32_t jobIndex, uint32_t) {
+    auto& request = requests[jobIndex];
+    request.succeeded = DecodeImage(request.srcBuffer, request.bufferSize, request.image);
+    request.image.srgb = request.image.srgb || request.mipOptions.srgb;
+    if (request.succeeded && request.generateMips)
+    {
+      BuildMipChain(request.image, request.mipOptions);
+    }
+  });
+
+  auto endTime = std::chrono::high_resolution_clock::now();
+  TextureDecodeStats stats;
+  stats.threadCount = jobSystem->GetThreadCount();
+  stats.decodeMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+  for (const auto& request : requests)
+  {
+    if (request.succeeded)
+    {
+      stats.imageCount++;
+      stats.pixelCount += uint64_t(request.image.GetWidth()) * request.image.GetHeight();
+    }
+  }
+  return stats;
+}
@@ -0,0 +1,135 @@
+﻿#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// イメージの格納形式. BC 系は 4x4 テクセルを1ブロックとして格納する.
+enum class ImageFormat : uint32_t
+{
+  RGBA8,
+  BC1,  // RGB 4bpp. アルファは使用しない.
+  BC3,  // RGBA 8bpp. アルファは BC4 と同じ形式.
+  BC4,  // R 4bpp.
+  BC5,  // RG 8bpp. 法線マップ向け.
+  BC7,  // RGBA 8bpp. 高品質.
+};
+
+inline bool IsBlockCompressed(ImageFormat format) { return format != ImageFormat::RGBA8; }
+// RGBA8 は1テクセル、BC 系は1ブロックあたりのバイト数.
+inline uint32_t GetFormatElementBytes(ImageFormat format)
+{
+  switch (format)
+  {
+  case ImageFormat::BC1:
+  case ImageFormat::BC4:
+    return 8;
+  case ImageFormat::BC3:
+  case ImageFormat::BC5:
+  case ImageFormat::BC7:
+    return 16;
+  default:
+    return 4;
+  }
+}
+
+// CPU で展開した RGBA8 イメージ. 全ミップレベルを1つのバッファに連続して格納する.
+// 各レベルの配置は GetCopyableFootprints の結果と一致させており、ステージングバッファへはレベル単位で一括コピーできる.
+// Direct3D に依存しないため、Windows 以外でも単体で動作する.
+struct DecodedImage
+{
+  static const uint32_t PixelBytes = 4;
+  // D3D12_TEXTURE_DATA_PITCH_ALIGNMENT, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT と同じ値.
+  static const uint32_t RowPitchAlignment = 256;
+  static const uint32_t PlacementAlignment = 512;
+
+  struct MipLevel
+  {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t rowPitch = 0;  // バイト単位.
+    uint32_t rowCount = 0;  // rowPitch 単位の行数. 圧縮形式ではブロックの行数.
+    size_t   offset = 0;    // pixels 先頭からのオフセット.
+  };
+  std::vector<MipLevel> mipLevels;
+  std::vector<uint8_t>  pixels;
+  ImageFormat format = ImageFormat::RGBA8;
+  bool     srgb = false;    // 色データとして sRGB で符号化されている. _SRGB 形式のテクスチャとして作成する.
+  uint32_t arraySize = 1;   // テクスチャ配列のスライス数. 各スライスは同じ配置で slicePitch ごとに並ぶ.
+  size_t   slicePitch = 0;  // スライス間の間隔(バイト).
+  uint8_t* externalPixels = nullptr;  // AttachStorage で設定した格納先. 設定時は pixels を使わない.
+
+  uint32_t GetWidth() const { return mipLevels.empty() ? 0 : mipLevels[0].width; }
+  uint32_t GetHeight() const { return mipLevels.empty() ? 0 : mipLevels[0].height; }
+  uint32_t GetMipLevelCount() const { return uint32_t(mipLevels.size()); }
+  const uint8_t* GetLevelData(uint32_t mip, uint32_t slice = 0) const { return GetPixels() + slice * slicePitch + mipLevels[mip].offset; }
+  uint8_t* GetLevelData(uint32_t mip, uint32_t slice = 0) { return GetPixels() + slice * slicePitch + mipLevels[mip].offset; }
+  const uint8_t* GetPixels() const { return externalPixels ? externalPixels : pixels.data(); }
+  uint8_t* GetPixels() { return externalPixels ? externalPixels : pixels.data(); }
+
+  // 1行(圧縮形式では1ブロック行)の有効なバイト数.
+  uint32_t GetRowSize(uint32_t mip) const;
+
+  // 指定サイズのレベル配置を決めて、必要なバイト数を返す. mipCount が 0 の場合は 1x1 まで全て.
+  // 配列の場合も、サブリソース順(スライスごとに全レベル)で GetCopyableFootprints と同じ配置になる.
+  size_t Layout(uint32_t width, uint32_t height, uint32_t mipCount, ImageFormat imageFormat = ImageFormat::RGBA8, uint32_t sliceCount = 1);
+  // レベル配置を決めてバッファを確保する. 内容は 0 で初期化される.
+  void Allocate(uint32_t width, uint32_t height, uint32_t mipCount, ImageFormat imageFormat = ImageFormat::RGBA8, uint32_t sliceCount = 1);
+  // Layout 済みの配置のまま、外部のメモリ(アップロードヒープなど)を格納先とする. 所有はしない.
+  // data は Layout の返したバイト数以上で、PlacementAlignment に整列していること.
+  void AttachStorage(uint8_t* data);
+};
+
+// ミップマップ作成時の設定.
+struct MipGenerateOptions
+{
+  bool  srgb = false;                   // 色データ(sRGB)として扱う. RGB を線形空間に戻して平均し(アルファはそのまま)、イメージにも sRGB と記録する.
+  bool  preserveAlphaCoverage = false;  // アルファテストの通過率を mip0 と揃える.
+  float alphaCutoff = 0.5f;             // アルファテストの閾値.
+};
+
+// 画像ファイルのメモリイメージを RGBA8 に展開する. mip0 のみが作成される.
+// DDS の場合は格納されている形式とミップマップをそのまま読み込む.
+// 色空間を記録していない形式(PNG など)は線形として読み込むため、色データの場合は呼び出し側で srgb を設定すること.
+bool DecodeImage(const void* srcBuffer, size_t bufferSize, DecodedImage& outImage);
+
+// 展開せずにヘッダから読み取った情報.
+struct ImageInfo
+{
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t mipCount = 1;  // ファイルに格納されているレベル数.
+  ImageFormat format = ImageFormat::RGBA8;
+  bool srgb = false;      // ファイルに sRGB と記録されている(DDS の _SRGB 形式).
+};
+bool ReadImageInfo(const void* srcBuffer, size_t bufferSize, ImageInfo& outInfo);
+
+// ReadImageInfo の内容で Layout と AttachStorage を済ませたイメージへ直接展開する.
+// 中間のバッファを介さずに格納先へ書き込むため、アップロードヒープへの展開に使う.
+// 配置のレベル数がファイルより多い場合は、残りのレベルを格納先の上で作成する(RGBA8 のみ).
+bool DecodeImageInto(const void* srcBuffer, size_t bufferSize, DecodedImage& image, const MipGenerateOptions& options = {});
+
+// mip0 から 1x1 までのミップマップチェインを作成する.
+// 圧縮形式のものや、既にミップマップを持つものは何もしない.
+void BuildMipChain(DecodedImage& image, const MipGenerateOptions& options = {});
+
+// 複数の画像をジョブシステムで並列に展開する.
+struct TextureDecodeRequest
+{
+  const void* srcBuffer = nullptr;
+  size_t bufferSize = 0;
+  bool generateMips = false;
+  MipGenerateOptions mipOptions;
+
+  DecodedImage image;
+  bool succeeded = false;
+};
+struct TextureDecodeStats
+{
+  uint32_t imageCount = 0;
+  uint32_t threadCount = 0;
+  uint64_t pixelCount = 0;  // 展開した mip0 のピクセル数.
+  double   decodeMs = 0;    // 展開とミップマップ作成にかかった時間.
+
+  double GetMegaPixelsPerSecond() const { return decodeMs > 0 ? double(pixelCount) / (decodeMs * 1000.0) : 0.0; }
+};
+TextureDecodeStats DecodeImages(std::vector<TextureDecodeRequest>& requests);
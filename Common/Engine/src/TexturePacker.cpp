@@ -0,0 +1,268 @@
+﻿#include "TexturePacker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+SkylinePacker::SkylinePacker(uint32_t width, uint32_t height)
+  : m_width(width), m_height(height)
+{
+  m_skyline.push_back({ 0, 0, width });
+}
+
+bool SkylinePacker::Fit(size_t index, uint32_t width, uint32_t height, uint32_t& outY) const
+{
+  const auto x = m_skyline[index].x;
+  if (x + width > m_width)
+  {
+    return false;
+  }
+  uint32_t y = 0;
+  int64_t widthLeft = width;
+  for (size_t i = index; widthLeft > 0; ++i)
+  {
+    y = std::max(y, m_skyline[i].y);
+    if (y + height > m_height)
+    {
+      return false;
+    }
+    widthLeft -= m_skyline[i].width;
+  }
+  outY = y;
+  return true;
+}
+
+bool SkylinePacker::Insert(uint32_t width, uint32_t height, uint32_t& outX, uint32_t& outY)
+{
+  // 上端が最も低くなる位置を選び、同じ高さであれば隙間の少ない(幅の狭い)段を優先する.
+  size_t bestIndex = m_skyline.size();
+  uint32_t bestBottom = ~0u, bestWidth = ~0u, bestY = 0;
+  for (size_t i = 0; i < m_skyline.size(); ++i)
+  {
+    uint32_t y = 0;
+    if (!Fit(i, width, height, y))
+    {
+      continue;
+    }
+    if (y + height < bestBottom || (y + height == bestBottom && m_skyline[i].width < bestWidth))
+    {
+      bestIndex = i;
+      bestBottom = y + height;
+      bestWidth = m_skyline[i].width;
+      bestY = y;
+    }
+  }
+  if (bestIndex == m_skyline.size())
+  {
+    return false;
+  }
+
+  const Node node{ m_skyline[bestIndex].x, bestY + height, width };
+  m_skyline.insert(m_skyline.begin() + bestIndex, node);
+  // 新しい段に隠れた部分を削る.
+  for (size_t i = bestIndex + 1; i < m_skyline.size();)
+  {
+    const auto right = m_skyline[i - 1].x + m_skyline[i - 1].width;
+    if (m_skyline[i].x >= right)
+    {
+      break;
+    }
+    const auto shrink = right - m_skyline[i].x;
+    if (m_skyline[i].width <= shrink)
+    {
+      m_skyline.erase(m_skyline.begin() + i);
+      continue;
+    }
+    m_skyline[i].x += shrink;
+    m_skyline[i].width -= shrink;
+    break;
+  }
+  // 同じ高さの段をつなげる.
+  for (size_t i = 0; i + 1 < m_skyline.size();)
+  {
+    if (m_skyline[i].y == m_skyline[i + 1].y)
+    {
+      m_skyline[i].width += m_skyline[i + 1].width;
+      m_skyline.erase(m_skyline.begin() + i + 1);
+      continue;
+    }
+    ++i;
+  }
+
+  outX = node.x;
+  outY = bestY;
+  m_usedArea += uint64_t(width) * height;
+  return true;
+}
+
+uint32_t GetAtlasPadding(const TexturePackSettings& settings)
+{
+  return 1u << (std::max(settings.atlasMipCount, 1u) - 1);
+}
+
+TexturePackPlan PlanTexturePacking(const std::vector<TexturePackInput>& inputs, const TexturePackSettings& settings)
+{
+  TexturePackPlan plan;
+  plan.placements.resize(inputs.size());
+  const auto padding = GetAtlasPadding(settings);
+  auto alignUp = [&](uint32_t value) { return (value + padding - 1) / padding * padding; };
+
+  // アトラスの候補を色空間ごとに分ける. 背の高いものから詰めると隙間が少ない.
+  std::vector<uint32_t> atlasCandidateLists[2];
+  for (uint32_t i = 0; i < inputs.size(); ++i)
+  {
+    const auto& input = inputs[i];
+    if (input.format == ImageFormat::RGBA8 &&
+      input.width <= settings.atlasMaxTextureSize && input.height <= settings.atlasMaxTextureSize &&
+      input.width % padding == 0 && input.height % padding == 0 &&
+      input.mipCount >= settings.atlasMipCount &&
+      alignUp(input.width + padding * 2) <= settings.atlasSize && alignUp(input.height + padding * 2) <= settings.atlasSize)
+    {
+      atlasCandidateLists[input.srgb ? 1 : 0].push_back(i);
+    }
+  }
+  for (auto& atlasCandidates : atlasCandidateLists)
+  {
+    // 1枚だけではまとめる意味がない.
+    if (atlasCandidates.size() < 2)
+    {
+      continue;
+    }
+    std::stable_sort(atlasCandidates.begin(), atlasCandidates.end(), [&](uint32_t a, uint32_t b) {
+      return std::tie(inputs[a].height, inputs[a].width) > std::tie(inputs[b].height, inputs[b].width);
+    });
+    const auto groupIndex = uint32_t(plan.groups.size());
+    auto& group = plan.groups.emplace_back();
+    group.isAtlas = true;
+    group.width = group.height = settings.atlasSize;
+    group.mipCount = settings.atlasMipCount;
+    group.format = ImageFormat::RGBA8;
+    group.srgb = inputs[atlasCandidates[0]].srgb;
+
+    std::vector<SkylinePacker> pages;
+    for (auto index : atlasCandidates)
+    {
+      const auto& input = inputs[index];
+      const auto packedWidth = alignUp(input.width + padding * 2);
+      const auto packedHeight = alignUp(input.height + padding * 2);
+      uint32_t x = 0, y = 0;
+      uint32_t page = 0;
+      while (page < pages.size() && !pages[page].Insert(packedWidth, packedHeight, x, y))
+      {
+        ++page;
+      }
+      if (page == pages.size())
+      {
+        if (pages.size() >= settings.maxArraySize)
+        {
+          continue;
+        }
+        pages.emplace_back(settings.atlasSize, settings.atlasSize);
+        pages.back().Insert(packedWidth, packedHeight, x, y);
+      }
+      auto& placement = plan.placements[index];
+      placement.group = groupIndex;
+      placement.arraySlice = page;
+      placement.x = x + padding;
+      placement.y = y + padding;
+      const float atlasSize = float(settings.atlasSize);
+      placement.uvScale[0] = float(input.width) / atlasSize;
+      placement.uvScale[1] = float(input.height) / atlasSize;
+      placement.uvBias[0] = float(placement.x) / atlasSize;
+      placement.uvBias[1] = float(placement.y) / atlasSize;
+      group.members.push_back(index);
+    }
+    group.arraySize = uint32_t(pages.size());
+  }
+
+  // 残りを大きさ・形式・レベル数・色空間でまとめる.
+  std::map<std::tuple<uint32_t, uint32_t, uint32_t, ImageFormat, bool>, std::vector<uint32_t>> buckets;
+  for (uint32_t i = 0; i < inputs.size(); ++i)
+  {
+    const auto& input = inputs[i];
+    if (plan.placements[i].group == TexturePackPlacement::NotPacked && input.mipCount > 0)
+    {
+      buckets[{ input.width, input.height, input.mipCount, input.format, input.srgb }].push_back(i);
+    }
+  }
+  for (const auto& [key, members] : buckets)
+  {
+    for (size_t first = 0; first + settings.minArraySize <= members.size(); first += settings.maxArraySize)
+    {
+      const auto count = std::min<size_t>(members.size() - first, settings.maxArraySize);
+      if (count < settings.minArraySize)
+      {
+        break;
+      }
+      const auto groupIndex = uint32_t(plan.groups.size());
+      auto& group = plan.groups.emplace_back();
+      std::tie(group.width, group.height, group.mipCount, group.format, group.srgb) = key;
+      group.arraySize = uint32_t(count);
+      for (size_t i = 0; i < count; ++i)
+      {
+        const auto index = members[first + i];
+        plan.placements[index].group = groupIndex;
+        plan.placements[index].arraySlice = uint32_t(i);
+        group.members.push_back(index);
+      }
+    }
+  }
+  return plan;
+}
+
+// 余白を端のテクセルの延長で埋めながら、1レベル分をアトラスへ書き込む.
+static void CopyWithClampedBorder(
+  const uint8_t* src, uint32_t width, uint32_t height, uint32_t srcPitch,
+  uint8_t* dst, uint32_t dstX, uint32_t dstY, uint32_t dstPitch, uint32_t border)
+{
+  const uint32_t pixelBytes = DecodedImage::PixelBytes;
+  for (int64_t y = -int64_t(border); y < int64_t(height + border); ++y)
+  {
+    const auto srcY = uint32_t(std::clamp<int64_t>(y, 0, height - 1));
+    const uint8_t* srcRow = src + size_t(srcY) * srcPitch;
+    uint8_t* dstRow = dst + size_t(dstY + y) * dstPitch + size_t(dstX) * pixelBytes;
+    for (uint32_t x = 0; x < border; ++x)
+    {
+      memcpy(dstRow - size_t(border - x) * pixelBytes, srcRow, pixelBytes);
+      memcpy(dstRow + size_t(width + x) * pixelBytes, srcRow + size_t(width - 1) * pixelBytes, pixelBytes);
+    }
+    memcpy(dstRow, srcRow, size_t(width) * pixelBytes);
+  }
+}
+
+void BuildPackedImages(
+  const TexturePackPlan& plan, const TexturePackSettings& settings,
+  const std::vector<const DecodedImage*>& images, std::vector<DecodedImage>& outImages)
+{
+  const auto padding = GetAtlasPadding(settings);
+  outImages.resize(plan.groups.size());
+  for (size_t groupIndex = 0; groupIndex < plan.groups.size(); ++groupIndex)
+  {
+    const auto& group = plan.groups[groupIndex];
+    auto& packed = outImages[groupIndex];
+    packed.Allocate(group.width, group.height, group.mipCount, group.format, group.arraySize);
+    packed.srgb = group.srgb;
+    for (auto member : group.members)
+    {
+      const auto& image = *images[member];
+      const auto& placement = plan.placements[member];
+      for (uint32_t mip = 0; mip < group.mipCount; ++mip)
+      {
+        const auto& srcLevel = image.mipLevels[mip];
+        const auto& dstLevel = packed.mipLevels[mip];
+        auto dst = packed.GetLevelData(mip, placement.arraySlice);
+        if (!group.isAtlas)
+        {
+          // 同じ配置のイメージのため、レベル単位でそのまま移せる.
+          memcpy(dst, image.GetLevelData(mip), size_t(srcLevel.rowPitch) * srcLevel.rowCount);
+          continue;
+        }
+        // 配置と余白は余白の大きさの倍数に揃えてあるため、各レベルでも整数の位置になる.
+        CopyWithClampedBorder(
+          image.GetLevelData(mip), srcLevel.width, srcLevel.height, srcLevel.rowPitch,
+          dst, placement.x >> mip, placement.y >> mip, dstLevel.rowPitch, padding >> mip);
+      }
+    }
+  }
+}
@@ -0,0 +1,100 @@
+﻿#pragma once
+#include <vector>
+#include <cstdint>
+#include "TextureDecode.h"
+
+// 矩形のパッキング(スカイライン法、下詰め優先).
+// 配置済みの上端を左から順に持ち、各位置に置いた場合に最も低くなる場所を選ぶ.
+class SkylinePacker
+{
+public:
+  SkylinePacker(uint32_t width, uint32_t height);
+
+  // 配置できない場合は false を返す.
+  bool Insert(uint32_t width, uint32_t height, uint32_t& outX, uint32_t& outY);
+
+  uint32_t GetWidth() const { return m_width; }
+  uint32_t GetHeight() const { return m_height; }
+  // 配置した矩形の面積の割合.
+  float GetOccupancy() const { return float(double(m_usedArea) / (double(m_width) * m_height)); }
+
+private:
+  struct Node
+  {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+  };
+  // index の位置から幅 width を置いた場合の下端. 置けない場合は false.
+  bool Fit(size_t index, uint32_t width, uint32_t height, uint32_t& outY) const;
+
+  std::vector<Node> m_skyline;
+  uint32_t m_width;
+  uint32_t m_height;
+  uint64_t m_usedArea = 0;
+};
+
+// 小さいテクスチャをまとめる設定.
+struct TexturePackSettings
+{
+  uint32_t atlasMaxTextureSize = 256;  // 幅と高さがこれ以下のものをアトラスの候補とする.
+  uint32_t atlasSize = 2048;
+  uint32_t atlasMipCount = 4;          // アトラスのレベル数. 候補はこの段数分のミップマップを持つこと.
+  uint32_t minArraySize = 2;           // 同じ大きさ・形式のものがこの数以上あれば配列にまとめる.
+  uint32_t maxArraySize = 256;
+};
+
+struct TexturePackInput
+{
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t mipCount = 0;
+  ImageFormat format = ImageFormat::RGBA8;
+  bool srgb = false;
+};
+
+// 各入力の配置先.
+struct TexturePackPlacement
+{
+  static const uint32_t NotPacked = ~0u;
+  uint32_t group = NotPacked;  // TexturePackPlan::groups のインデックス.
+  uint32_t arraySlice = 0;
+  uint32_t x = 0, y = 0;        // アトラス内の位置(mip0 のテクセル単位, 余白を除く).
+  float uvScale[2] = { 1.0f, 1.0f };
+  float uvBias[2] = { 0.0f, 0.0f };
+};
+
+// まとめた先のテクスチャ配列. アトラスは複数ページをスライスとして持つ.
+struct TexturePackGroup
+{
+  bool isAtlas = false;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t mipCount = 0;
+  uint32_t arraySize = 0;
+  ImageFormat format = ImageFormat::RGBA8;
+  bool srgb = false;
+  std::vector<uint32_t> members;  // 入力のインデックス.
+};
+
+struct TexturePackPlan
+{
+  std::vector<TexturePackGroup> groups;
+  std::vector<TexturePackPlacement> placements;  // 入力と同じ順.
+};
+
+// アトラスの各矩形の周囲に確保する余白(mip0 のテクセル単位).
+// 最も小さいレベルでも1テクセル残り、配置もレベルごとの整列が崩れない大きさとする.
+uint32_t GetAtlasPadding(const TexturePackSettings& settings);
+
+// 入力の大きさと形式から、アトラスと配列へのまとめ方を決める.
+// アトラスは RGBA8 で、幅と高さが余白の倍数のもの. 残りは大きさ・形式・レベル数が同じもので配列にする.
+// 色空間(sRGB・線形)の異なるものは同じグループに入れない.
+// いずれにも入らないものは group が NotPacked となる.
+TexturePackPlan PlanTexturePacking(const std::vector<TexturePackInput>& inputs, const TexturePackSettings& settings);
+
+// 計画に従ってまとめたイメージ(グループごとの配列イメージ)を作成する.
+// アトラスの余白は各レベルで端のテクセルを延長して埋め、縮小時に隣の矩形が混ざらないようにする.
+void BuildPackedImages(
+  const TexturePackPlan& plan, const TexturePackSettings& settings,
+  const std::vector<const DecodedImage*>& images, std::vector<DecodedImage>& outImages);
@@ -0,0 +1,203 @@
+﻿#include "TextureResidency.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+TextureResidencyPolicy::TextureId TextureResidencyPolicy::Add(const std::vector<uint64_t>& mipSizes, uint32_t tailMip)
+{
+  TextureId id;
+  if (!m_freeIds.empty())
+  {
+    id = m_freeIds.back();
+    m_freeIds.pop_back();
+  }
+  else
+  {
+    id = TextureId(m_entries.size());
+    m_entries.emplace_back();
+  }
+  auto& entry = m_entries[id];
+  entry = Entry{};
+  entry.mipSizes = mipSizes;
+  entry.tailMip = std::min(tailMip, uint32_t(mipSizes.size()));
+  entry.residentMip = entry.tailMip;
+  entry.requestedMip = entry.tailMip;
+  entry.active = true;
+  for (uint32_t mip = entry.tailMip; mip < mipSizes.size(); ++mip)
+  {
+    m_residentSize += mipSizes[mip];
+  }
+  return id;
+}
+
+void TextureResidencyPolicy::Remove(TextureId id)
+{
+  assert(id < m_entries.size() && m_entries[id].active);
+  auto& entry = m_entries[id];
+  for (uint32_t mip = entry.residentMip; mip < entry.mipSizes.size(); ++mip)
+  {
+    m_residentSize -= entry.mipSizes[mip];
+  }
+  entry = Entry{};
+  m_freeIds.push_back(id);
+}
+
+void TextureResidencyPolicy::Request(TextureId id, uint32_t mip)
+{
+  assert(id < m_entries.size() && m_entries[id].active);
+  auto& entry = m_entries[id];
+  if (entry.lastRequestFrame != m_frame)
+  {
+    entry.requestedMip = mip;
+    entry.lastRequestFrame = m_frame;
+  }
+  else
+  {
+    entry.requestedMip = std::min(entry.requestedMip, mip);
+  }
+}
+
+bool TextureResidencyPolicy::IsRecentlyRequested(const Entry& entry, uint32_t keepFrames) const
+{
+  return entry.lastRequestFrame != 0 && m_frame - entry.lastRequestFrame <= keepFrames;
+}
+
+uint32_t TextureResidencyPolicy::GetTargetMip(const Entry& entry, uint32_t keepFrames) const
+{
+  return IsRecentlyRequested(entry, keepFrames) ? std::min(entry.requestedMip, entry.tailMip) : entry.tailMip;
+}
+
+uint32_t TextureResidencyPolicy::GetTargetMip(TextureId id) const
+{
+  return GetTargetMip(m_entries[id], m_keepFrames);
+}
+
+void TextureResidencyPolicy::Update(const Settings& settings, std::vector<Operation>& outEvictions, std::vector<Operation>& outLoads)
+{
+  m_keepFrames = settings.keepFrames;
+  outEvictions.clear();
+  outLoads.clear();
+
+  // 要求より詳細なレベルを持つものから、最後に要求されたのが最も古いものの最詳細レベルを破棄する.
+  // 要求されているレベルは破棄しないため、読み込みと破棄が交互に起こることはない.
+  auto evictOne = [&](TextureId except) {
+    TextureId victim = InvalidId;
+    for (TextureId id = 0; id < m_entries.size(); ++id)
+    {
+      const auto& entry = m_entries[id];
+      if (!entry.active || id == except || entry.residentMip >= GetTargetMip(entry, settings.keepFrames))
+      {
+        continue;
+      }
+      if (victim == InvalidId || entry.lastRequestFrame < m_entries[victim].lastRequestFrame)
+      {
+        victim = id;
+      }
+    }
+    if (victim == InvalidId)
+    {
+      return false;
+    }
+    auto& entry = m_entries[victim];
+    outEvictions.push_back({ victim, entry.residentMip });
+    m_residentSize -= entry.mipSizes[entry.residentMip];
+    entry.residentMip++;
+    return true;
+  };
+
+  // 予算が減らされた場合に備えて、先に超過分を減らしておく.
+  while (m_residentSize > settings.budget && evictOne(InvalidId))
+  {
+  }
+
+  // 要求に足りないものを、不足している段数が多い順・要求が新しい順に読み込む.
+  std::vector<TextureId> candidates;
+  for (TextureId id = 0; id < m_entries.size(); ++id)
+  {
+    const auto& entry = m_entries[id];
+    if (entry.active && entry.residentMip > GetTargetMip(entry, settings.keepFrames))
+    {
+      candidates.push_back(id);
+    }
+  }
+  std::stable_sort(candidates.begin(), candidates.end(), [&](TextureId a, TextureId b) {
+    const auto& entryA = m_entries[a];
+    const auto& entryB = m_entries[b];
+    const auto shortageA = entryA.residentMip - GetTargetMip(entryA, settings.keepFrames);
+    const auto shortageB = entryB.residentMip - GetTargetMip(entryB, settings.keepFrames);
+    if (shortageA != shortageB)
+    {
+      return shortageA > shortageB;
+    }
+    return entryA.lastRequestFrame > entryB.lastRequestFrame;
+  });
+
+  for (auto id : candidates)
+  {
+    if (outLoads.size() >= settings.maxLoadsPerUpdate)
+    {
+      break;
+    }
+    auto& entry = m_entries[id];
+    const uint32_t mip = entry.residentMip - 1;
+    const uint64_t size = entry.mipSizes[mip];
+    bool fits = true;
+    while (m_residentSize + size > settings.budget)
+    {
+      if (!evictOne(id))
+      {
+        fits = false;
+        break;
+      }
+    }
+    if (!fits)
+    {
+      // 小さいレベルであれば収まる可能性があるため、次の候補を試す.
+      continue;
+    }
+    entry.residentMip = mip;
+    m_residentSize += size;
+    outLoads.push_back({ id, mip });
+  }
+  m_frame++;
+}
+
+float ComputeUvDensity(const float* positions, const float* texcoords, const uint32_t* indices, size_t indexCount)
+{
+  double uvArea = 0.0, worldArea = 0.0;
+  for (size_t i = 0; i + 2 < indexCount; i += 3)
+  {
+    const float* p0 = positions + indices[i + 0] * 3;
+    const float* p1 = positions + indices[i + 1] * 3;
+    const float* p2 = positions + indices[i + 2] * 3;
+    const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+    const double cx = double(e1[1]) * e2[2] - double(e1[2]) * e2[1];
+    const double cy = double(e1[2]) * e2[0] - double(e1[0]) * e2[2];
+    const double cz = double(e1[0]) * e2[1] - double(e1[1]) * e2[0];
+    worldArea += 0.5 * std::sqrt(cx * cx + cy * cy + cz * cz);
+
+    const float* t0 = texcoords + indices[i + 0] * 2;
+    const float* t1 = texcoords + indices[i + 1] * 2;
+    const float* t2 = texcoords + indices[i + 2] * 2;
+    uvArea += 0.5 * std::abs(double(t1[0] - t0[0]) * (t2[1] - t0[1]) - double(t2[0] - t0[0]) * (t1[1] - t0[1]));
+  }
+  return worldArea > 0.0 ? float(std::sqrt(uvArea / worldArea)) : 0.0f;
+}
+
+uint32_t ComputeRequiredMip(uint32_t textureSize, float uvDensity, float pixelWorldSize, uint32_t mipCount)
+{
+  if (mipCount == 0)
+  {
+    return 0;
+  }
+  // 1ピクセルあたりのテクセル数が 2^n であれば mip n で等倍となる. 切り捨てて詳細な側に寄せる.
+  const float texelsPerPixel = float(textureSize) * uvDensity * pixelWorldSize;
+  uint32_t mip = 0;
+  if (texelsPerPixel > 1.0f)
+  {
+    mip = uint32_t(std::floor(std::log2(texelsPerPixel)));
+  }
+  return std::min(mip, mipCount - 1);
+}
@@ -0,0 +1,73 @@
+﻿#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// テクスチャストリーミングの常駐判定.
+// 各テクスチャの必要なミップレベルと VRAM 予算から、フレームごとに読み込み・破棄するレベルを決める.
+// Direct3D に依存しないため、カメラの移動を模したリクエスト列を与えて単体で動作を確認できる.
+class TextureResidencyPolicy
+{
+public:
+  using TextureId = uint32_t;
+  static const TextureId InvalidId = ~0u;
+
+  struct Settings
+  {
+    uint64_t budget = 256ull * 1024 * 1024;  // 常駐させるレベルの合計サイズの上限(バイト).
+    uint32_t maxLoadsPerUpdate = 8;           // 1回の Update で読み込むレベル数の上限.
+    uint32_t keepFrames = 60;                 // リクエストが途絶えてから不要とみなすまでのフレーム数.
+  };
+
+  // mipSizes: 各レベルのメモリ量. tailMip 以降のレベルは登録時から常に常駐している.
+  TextureId Add(const std::vector<uint64_t>& mipSizes, uint32_t tailMip);
+  void Remove(TextureId id);
+
+  // 今フレームで必要な最も詳細なレベルを要求する. 同一フレーム内では最も詳細なものが採用される.
+  void Request(TextureId id, uint32_t mip);
+
+  struct Operation
+  {
+    TextureId id;
+    uint32_t  mip;
+  };
+  // 予算内で読み込み・破棄するレベルを決めて、フレームを進める.
+  // 読み込みは粗いレベルから1段階ずつ行い、予算が足りない場合は不要になったレベルを古いものから破棄する.
+  // 呼び出し側は outEvictions を適用してから outLoads を適用すること.
+  void Update(const Settings& settings, std::vector<Operation>& outEvictions, std::vector<Operation>& outLoads);
+
+  // 常駐している最も詳細なレベル.
+  uint32_t GetResidentMip(TextureId id) const { return m_entries[id].residentMip; }
+  // 現在要求されている最も詳細なレベル(要求が途絶えたものは常駐の末尾レベル).
+  uint32_t GetTargetMip(TextureId id) const;
+  uint64_t GetResidentSize() const { return m_residentSize; }
+  uint64_t GetFrame() const { return m_frame; }
+
+private:
+  struct Entry
+  {
+    std::vector<uint64_t> mipSizes;
+    uint32_t tailMip = 0;
+    uint32_t residentMip = 0;
+    uint32_t requestedMip = 0;
+    uint64_t lastRequestFrame = 0;
+    bool     active = false;
+  };
+
+  bool IsRecentlyRequested(const Entry& entry, uint32_t keepFrames) const;
+  uint32_t GetTargetMip(const Entry& entry, uint32_t keepFrames) const;
+
+  std::vector<Entry> m_entries;
+  std::vector<TextureId> m_freeIds;
+  uint64_t m_residentSize = 0;
+  uint64_t m_frame = 1;
+  uint32_t m_keepFrames = 60;  // 直近の Update で使用した設定.
+};
+
+// メッシュのテクスチャ座標の密度(ワールド空間の単位長あたりの UV 変化量).
+// 三角形ごとの UV 空間の面積とワールド空間の面積の比から求める.
+float ComputeUvDensity(const float* positions, const float* texcoords, const uint32_t* indices, size_t indexCount);
+
+// 画面上の大きさから必要なミップレベルを求める.
+// pixelWorldSize: 描画位置で1ピクセルが占めるワールド空間の大きさ(距離 * 2tan(fov/2) / 画面の高さ).
+uint32_t ComputeRequiredMip(uint32_t textureSize, float uvDensity, float pixelWorldSize, uint32_t mipCount);
@@ -0,0 +1,538 @@
+﻿#include "TextureUtility.h"
+#include "FileLoader.h"
+#include "GpuMipGenerator.h"
+#include "UploadRing.h"
+#include "JobSystem.h"
+
+#include <numeric>
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+bool CreateTextureFromFile(Microsoft::WRL::ComPtr<ID3D12Resource1>& outImage, std::filesystem::path filePath, bool generateMips, D3D12_RESOURCE_STATES afterState, D3D12_RESOURCE_FLAGS resFlags, bool srgb)
+{
+  auto& loader = GetFileLoader();
+  if (std::vector<char> fileData; loader->Load(filePath, fileData))
+  {
+    return CreateTextureFromMemory(outImage, fileData.data(), fileData.size(), generateMips, afterState, resFlags, srgb);
+  }
+  return false;
+}
+
+bool CreateTextureFromMemory(Microsoft::WRL::ComPtr<ID3D12Resource1>& outImage, const void* srcBuffer, size_t bufferSize, bool generateMips, D3D12_RESOURCE_STATES afterState, D3D12_RESOURCE_FLAGS resFlags, bool srgb)
+{
+  DecodedImage image;
+  if (!DecodeImage(srcBuffer, bufferSize, image))
+  {
+    return false;
+  }
+  image.srgb = image.srgb || srgb;
+  // ミップマップイメージを作成する.
+  if (generateMips)
+  {
+    BuildMipChain(image, { .srgb = image.srgb });
+  }
+
+  std::vector<Microsoft::WRL::ComPtr<ID3D12Resource1>> textures;
+  if (!CreateTexturesFromImages(textures, { &image }, afterState, resFlags))
+  {
+    return false;
+  }
+  outImage = textures[0];
+  return true;
+}
+
+DXGI_FORMAT GetTextureFormat(ImageFormat format, bool srgb)
+{
+  switch (format)
+  {
+  case ImageFormat::BC1: return srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+  case ImageFormat::BC3: return srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+  case ImageFormat::BC4: return DXGI_FORMAT_BC4_UNORM;
+  case ImageFormat::BC5: return DXGI_FORMAT_BC5_UNORM;
+  case ImageFormat::BC7: return srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+  default: return srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+  }
+}
+
+DXGI_FORMAT GetShaderResourceFormat(DXGI_FORMAT resourceFormat)
+{
+  return resourceFormat == DXGI_FORMAT_R8G8B8A8_TYPELESS ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : resourceFormat;
+}
+
+// GPU でミップマップを作成する場合は UAV で書き込むため、sRGB のものは TYPELESS で作成する.
+static DXGI_FORMAT GetResourceFormat(ImageFormat format, bool srgb, bool generateMipsOnGpu)
+{
+  return generateMipsOnGpu && srgb ? DXGI_FORMAT_R8G8B8A8_TYPELESS : GetTextureFormat(format, srgb);
+}
+
+bool CreateTexturesFromImages(std::vector<Microsoft::WRL::ComPtr<ID3D12Resource1>>& outImages, const std::vector<const DecodedImage*>& images, D3D12_RESOURCE_STATES afterState, D3D12_RESOURCE_FLAGS resFlags, bool generateMipsOnGpu)
+{
+  auto& gfxDevice = GetGfxDevice();
+  auto& mipGenerator = GetGpuMipGenerator();
+  auto& uploadRing = GetUploadRing();
+  generateMipsOnGpu = generateMipsOnGpu && mipGenerator->IsSupported();
+  auto d3d12Device = gfxDevice->GetD3D12Device();
+
+  // 1つのテクスチャの連続したサブリソース範囲の転送.
+  // リングに収まらない大きなテクスチャは複数の範囲に分けて転送する.
+  struct UploadItem
+  {
+    const DecodedImage* image;
+    Microsoft::WRL::ComPtr<ID3D12Resource1> texture;
+    bool generateMips;  // GPU で残りのレベルを作成する.
+    bool isLast;        // テクスチャの最後の範囲. 転送後に状態を変更する.
+    UINT firstSubresource;
+    ID3D12Resource1* staging;
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints;
+    std::vector<UINT> numRows;
+    std::vector<UINT64> rowSizeInByte;
+  };
+  std::vector<UploadItem> batch;
+  // リングより大きいレベル用に作成したステージングバッファ. 転送完了まで保持する.
+  std::vector<Microsoft::WRL::ComPtr<ID3D12Resource1>> dedicatedStagings;
+  bool result = true;
+
+  auto flush = [&]() {
+    if (batch.empty())
+    {
+      return;
+    }
+    // 完了を待たずに NewFrame へ進んでもよいよう、フレームのアロケーターではなく転送用のものに記録する.
+    auto commandList = gfxDevice->CreateCopyCommandList();
+    std::vector<D3D12_RESOURCE_BARRIER> barriers;
+    for (const auto& item : batch)
+    {
+      for (UINT i = 0; i < UINT(item.footprints.size()); ++i)
+      {
+        D3D12_TEXTURE_COPY_LOCATION dstLoc{
+          .pResource = item.texture.Get(),
+          .Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX,
+          .SubresourceIndex = item.firstSubresource + i,
+        };
+        D3D12_TEXTURE_COPY_LOCATION srcLoc{
+          .pResource = item.staging,
+          .Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT,
+          .PlacedFootprint = item.footprints[i],
+        };
+        commandList->CopyTextureRegion(&dstLoc, 0, 0, 0, &srcLoc, nullptr);
+      }
+      if (!item.isLast)
+      {
+        continue;
+      }
+      barriers.push_back(D3D12_RESOURCE_BARRIER{
+        .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+        .Transition = {
+          .pResource = item.texture.Get(),
+          .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+          .StateBefore = D3D12_RESOURCE_STATE_COPY_DEST,
+          .StateAfter = item.generateMips ? D3D12_RESOURCE_STATE_UNORDERED_ACCESS : afterState,
+        }
+      });
+    }
+    if (!barriers.empty())
+    {
+      commandList->ResourceBarrier(UINT(barriers.size()), barriers.data());
+    }
+    barriers.clear();
+    for (const auto& item : batch)
+    {
+      if (!item.generateMips)
+      {
+        continue;
+      }
+      mipGenerator->Generate(commandList, item.texture);
+      barriers.push_back(D3D12_RESOURCE_BARRIER{
+        .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+        .Transition = {
+          .pResource = item.texture.Get(),
+          .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+          .StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+          .StateAfter = afterState,
+        }
+      });
+    }
+    if (!barriers.empty())
+    {
+      commandList->ResourceBarrier(UINT(barriers.size()), barriers.data());
+    }
+    commandList->Close();
+    gfxDevice->SubmitCopy(commandList.Get());
+    // 完了を待たずに次のバッチの書き込みへ進む. 領域はフェンスの完了後にリングへ戻る.
+    uploadRing->Signal();
+    batch.clear();
+  };
+
+  // 転送元の領域を確保する. リングが未発行の転送で埋まっている場合は、発行してから確保し直す.
+  // リングに収まらない場合は専用のバッファを作成する.
+  auto allocateStaging = [&](UINT64 size, ID3D12Resource1*& outResource, UINT64& outOffset) -> BYTE* {
+    UploadRing::Allocation allocation;
+    bool allocated = uploadRing->Allocate(size, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, allocation);
+    if (!allocated && !batch.empty())
+    {
+      flush();
+      allocated = uploadRing->Allocate(size, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, allocation);
+    }
+    if (allocated)
+    {
+      outResource = allocation.resource;
+      outOffset = allocation.offset;
+      return allocation.cpuAddress;
+    }
+    D3D12_RESOURCE_DESC resDesc{
+      .Dimension = D3D12_RESOURCE_DIMENSION_BUFFER,
+      .Alignment = 0,
+      .Width = size, .Height = 1, .DepthOrArraySize = 1, .MipLevels = 1,
+      .Format = DXGI_FORMAT_UNKNOWN,
+      .SampleDesc = {.Count = 1, .Quality = 0 },
+      .Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR,
+      .Flags = D3D12_RESOURCE_FLAG_NONE,
+    };
+    auto& staging = dedicatedStagings.emplace_back(
+      gfxDevice->CreateBuffer(resDesc, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr));
+    void* p = nullptr;
+    staging->Map(0, nullptr, &p);
+    outResource = staging.Get();
+    outOffset = 0;
+    return reinterpret_cast<BYTE*>(p);
+  };
+
+  // first から count 個のサブリソースを1つの範囲として転送元へ書き込み、バッチに加える.
+  // サブリソースはスライスごとに全レベルが並ぶ順とする.
+  auto addRange = [&](const DecodedImage* image, Microsoft::WRL::ComPtr<ID3D12Resource1> texture,
+    const D3D12_RESOURCE_DESC& texDesc, UINT first, UINT count, bool generateMips) {
+    const auto mipmapCount = image->GetMipLevelCount();
+    UploadItem item{
+      .image = image, .texture = texture, .generateMips = generateMips,
+      .isLast = first + count == mipmapCount * image->arraySize, .firstSubresource = first,
+    };
+    item.footprints.resize(count);
+    item.numRows.resize(count);
+    item.rowSizeInByte.resize(count);
+    UINT64 requiredSize = 0;
+    d3d12Device->GetCopyableFootprints(
+      &texDesc, first, count, 0, item.footprints.data(), item.numRows.data(), item.rowSizeInByte.data(), &requiredSize);
+
+    UINT64 baseOffset = 0;
+    BYTE* destBase = allocateStaging(requiredSize, item.staging, baseOffset);
+    for (UINT i = 0; i < count; ++i)
+    {
+      const auto mip = (first + i) % mipmapCount;
+      const auto slice = (first + i) / mipmapCount;
+      const auto& footprint = item.footprints[i];
+      auto* dstMip = destBase + footprint.Offset;
+      auto* srcMip = image->GetLevelData(mip, slice);
+      const auto srcPitch = image->mipLevels[mip].rowPitch;
+      if (srcPitch == footprint.Footprint.RowPitch)
+      {
+        // DecodedImage はフットプリントと同じピッチで格納しているため、レベル単位でまとめてコピーできる.
+        // 最終行はピッチ分の余白が確保されていないため、行のサイズまでとする.
+        memcpy(dstMip, srcMip, size_t(srcPitch) * (item.numRows[i] - 1) + item.rowSizeInByte[i]);
+        continue;
+      }
+      for (UINT row = 0; row < item.numRows[i]; row++)
+      {
+        memcpy(dstMip + row * footprint.Footprint.RowPitch, srcMip + row * srcPitch, item.rowSizeInByte[i]);
+      }
+    }
+    if (item.staging != uploadRing->GetBuffer())
+    {
+      item.staging->Unmap(0, nullptr);
+    }
+    // 転送元での配置に合わせてオフセットをずらす.
+    for (auto& footprint : item.footprints)
+    {
+      footprint.Offset += baseOffset;
+    }
+    batch.push_back(std::move(item));
+  };
+
+  outImages.assign(images.size(), nullptr);
+  for (size_t i = 0; i < images.size(); ++i)
+  {
+    auto image = images[i];
+    if (image == nullptr || image->GetMipLevelCount() == 0)
+    {
+      result = false;
+      continue;
+    }
+    const auto mipmapCount = image->GetMipLevelCount();
+    const auto subresourceCount = mipmapCount * image->arraySize;
+    // GPU で作成する場合は 1x1 までの全レベルを確保する.
+    // 圧縮形式や、ミップマップを持つ(DDS など)もの、配列はそのまま転送する.
+    const bool generateMips = generateMipsOnGpu && image->format == ImageFormat::RGBA8 && mipmapCount == 1 && image->arraySize == 1;
+    auto textureMipCount = mipmapCount;
+    auto textureFlags = resFlags;
+    if (generateMips)
+    {
+      textureMipCount = uint32_t(floor(log2(std::max(image->GetWidth(), image->GetHeight()))) + 1);
+      textureFlags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+    }
+    D3D12_RESOURCE_DESC texDesc{
+      .Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D,
+      .Alignment = 0,
+      .Width = image->GetWidth(), .Height = image->GetHeight(), .DepthOrArraySize = UINT16(image->arraySize),
+      .MipLevels = UINT16(textureMipCount),
+      .Format = GetResourceFormat(image->format, image->srgb, generateMips),
+      .SampleDesc = {.Count = 1, .Quality = 0 },
+      .Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN,
+      .Flags = textureFlags,
+    };
+    D3D12_HEAP_PROPERTIES heapProps{
+      .Type = D3D12_HEAP_TYPE_DEFAULT,
+      .CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN,
+      .MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN,
+      .CreationNodeMask = 0, .VisibleNodeMask = 0,
+    };
+    auto texture = gfxDevice->CreateImage2D(texDesc, heapProps, D3D12_RESOURCE_STATE_COPY_DEST, nullptr);
+    outImages[i] = texture;
+
+    UINT64 requiredSize = 0;
+    d3d12Device->GetCopyableFootprints(&texDesc, 0, subresourceCount, 0, nullptr, nullptr, nullptr, &requiredSize);
+    if (requiredSize <= uploadRing->GetSize() || !uploadRing->IsInitialized())
+    {
+      addRange(image, texture, texDesc, 0, subresourceCount, generateMips);
+      continue;
+    }
+    // リングに収まる範囲ずつ、先頭のサブリソースから順に転送する.
+    for (UINT first = 0; first < subresourceCount;)
+    {
+      UINT count = 1;
+      while (first + count < subresourceCount)
+      {
+        UINT64 rangeSize = 0;
+        d3d12Device->GetCopyableFootprints(&texDesc, first, count + 1, 0, nullptr, nullptr, nullptr, &rangeSize);
+        if (rangeSize > uploadRing->GetSize())
+        {
+          break;
+        }
+        count++;
+      }
+      addRange(image, texture, texDesc, first, count, generateMips);
+      first += count;
+    }
+  }
+  flush();
+  if (!dedicatedStagings.empty() || generateMipsOnGpu)
+  {
+    // 専用のステージングバッファと、ミップマップ作成のディスクリプタは完了を待ってから解放する.
+    gfxDevice->WaitForGPU();
+    mipGenerator->ReleasePendingDescriptors();
+  }
+  return result;
+}
+
+TextureDecodeStats CreateTexturesFromEncoded(std::vector<Microsoft::WRL::ComPtr<ID3D12Resource1>>& outImages, std::vector<TextureDecodeRequest>& requests, D3D12_RESOURCE_STATES afterState, D3D12_RESOURCE_FLAGS resFlags, bool generateMipsOnGpu)
+{
+  auto& gfxDevice = GetGfxDevice();
+  auto& jobSystem = GetJobSystem();
+  auto& mipGenerator = GetGpuMipGenerator();
+  auto& uploadRing = GetUploadRing();
+  generateMipsOnGpu = generateMipsOnGpu && mipGenerator->IsSupported();
+  auto d3d12Device = gfxDevice->GetD3D12Device();
+
+  struct DirectItem
+  {
+    size_t requestIndex;
+    DecodedImage image;  // リング上の領域を格納先とする.
+    Microsoft::WRL::ComPtr<ID3D12Resource1> texture;
+    bool generateMips;   // GPU で残りのレベルを作成する.
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints;
+  };
+  std::vector<DirectItem> batch;
+  std::vector<size_t> fallbackIndices;
+  TextureDecodeStats stats;
+  stats.threadCount = jobSystem->GetThreadCount();
+
+  // バッチ内の画像をリング上へ並列に展開し、転送コマンドを発行する.
+  auto flush = [&]() {
+    if (batch.empty())
+    {
+      return;
+    }
+    auto decodeStart = std::chrono::high_resolution_clock::now();
+    jobSystem->Dispatch(uint32_t(batch.size()), [&](uint32_t jobIndex, uint32_t) {
+      auto& item = batch[jobIndex];
+      auto& request = requests[item.requestIndex];
+      request.succeeded = DecodeImageInto(request.srcBuffer, request.bufferSize, item.image, request.mipOptions);
+    });
+    auto decodeEnd = std::chrono::high_resolution_clock::now();
+    stats.decodeMs += std::chrono::duration<double, std::milli>(decodeEnd - decodeStart).count();
+
+    // 完了を待たずに NewFrame へ進んでもよいよう、フレームのアロケーターではなく転送用のものに記録する.
+    auto commandList = gfxDevice->CreateCopyCommandList();
+    std::vector<D3D12_RESOURCE_BARRIER> barriers;
+    for (auto& item : batch)
+    {
+      if (!requests[item.requestIndex].succeeded)
+      {
+        // 展開に失敗したものは転送しない. 書きかけの領域はリングの回収に任せる.
+        outImages[item.requestIndex] = nullptr;
+        continue;
+      }
+      stats.imageCount++;
+      stats.pixelCount += uint64_t(item.image.GetWidth()) * item.image.GetHeight();
+      for (UINT mip = 0; mip < UINT(item.footprints.size()); ++mip)
+      {
+        D3D12_TEXTURE_COPY_LOCATION dstLoc{
+          .pResource = item.texture.Get(),
+          .Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX,
+          .SubresourceIndex = mip,
+        };
+        D3D12_TEXTURE_COPY_LOCATION srcLoc{
+          .pResource = uploadRing->GetBuffer(),
+          .Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT,
+          .PlacedFootprint = item.footprints[mip],
+        };
+        commandList->CopyTextureRegion(&dstLoc, 0, 0, 0, &srcLoc, nullptr);
+      }
+      barriers.push_back(D3D12_RESOURCE_BARRIER{
+        .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+        .Transition = {
+          .pResource = item.texture.Get(),
+          .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+          .StateBefore = D3D12_RESOURCE_STATE_COPY_DEST,
+          .StateAfter = item.generateMips ? D3D12_RESOURCE_STATE_UNORDERED_ACCESS : afterState,
+        }
+      });
+    }
+    if (!barriers.empty())
+    {
+      commandList->ResourceBarrier(UINT(barriers.size()), barriers.data());
+    }
+    barriers.clear();
+    for (const auto& item : batch)
+    {
+      if (!item.generateMips || !requests[item.requestIndex].succeeded)
+      {
+        continue;
+      }
+      mipGenerator->Generate(commandList, item.texture);
+      barriers.push_back(D3D12_RESOURCE_BARRIER{
+        .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+        .Transition = {
+          .pResource = item.texture.Get(),
+          .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+          .StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+          .StateAfter = afterState,
+        }
+      });
+    }
+    if (!barriers.empty())
+    {
+      commandList->ResourceBarrier(UINT(barriers.size()), barriers.data());
+    }
+    commandList->Close();
+    gfxDevice->SubmitCopy(commandList.Get());
+    uploadRing->Signal();
+    batch.clear();
+  };
+
+  outImages.assign(requests.size(), nullptr);
+  for (size_t i = 0; i < requests.size(); ++i)
+  {
+    auto& request = requests[i];
+    request.succeeded = false;
+    ImageInfo info;
+    if (!uploadRing->IsInitialized() || !ReadImageInfo(request.srcBuffer, request.bufferSize, info))
+    {
+      fallbackIndices.push_back(i);
+      continue;
+    }
+    // ヘッダの情報から最終的なレベル配置を決める. CPU で作成する場合は全レベル、GPU で作成する場合は mip0 のみ.
+    const bool canGenerate = info.mipCount == 1 && info.format == ImageFormat::RGBA8;
+    const bool generateMips = canGenerate && generateMipsOnGpu;
+    const uint32_t layoutMipCount = canGenerate && request.generateMips && !generateMips ? 0 : info.mipCount;
+
+    DirectItem item{ .requestIndex = i, .generateMips = generateMips };
+    const auto layoutSize = item.image.Layout(info.width, info.height, layoutMipCount, info.format);
+    item.image.srgb = info.srgb || request.mipOptions.srgb;
+    const auto mipmapCount = item.image.GetMipLevelCount();
+    UploadRing::Allocation allocation;
+    bool allocated = layoutSize <= uploadRing->GetSize() &&
+      uploadRing->Allocate(layoutSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, allocation);
+    if (!allocated && layoutSize <= uploadRing->GetSize() && !batch.empty())
+    {
+      flush();
+      allocated = uploadRing->Allocate(layoutSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, allocation);
+    }
+    if (!allocated)
+    {
+      // リングに収まらないものは中間のイメージを経由して分割転送する.
+      fallbackIndices.push_back(i);
+      continue;
+    }
+    item.image.AttachStorage(allocation.cpuAddress);
+
+    auto textureMipCount = mipmapCount;
+    auto textureFlags = resFlags;
+    if (generateMips)
+    {
+      textureMipCount = uint32_t(floor(log2(std::max(info.width, info.height))) + 1);
+      textureFlags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+    }
+    D3D12_RESOURCE_DESC texDesc{
+      .Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D,
+      .Alignment = 0,
+      .Width = info.width, .Height = info.height, .DepthOrArraySize = 1,
+      .MipLevels = UINT16(textureMipCount),
+      .Format = GetResourceFormat(info.format, item.image.srgb, generateMips),
+      .SampleDesc = {.Count = 1, .Quality = 0 },
+      .Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN,
+      .Flags = textureFlags,
+    };
+    // DecodedImage の配置は GetCopyableFootprints と一致するため、展開前にフットプリントが決まる.
+    item.footprints.resize(mipmapCount);
+    d3d12Device->GetCopyableFootprints(&texDesc, 0, mipmapCount, allocation.offset, item.footprints.data(), nullptr, nullptr, nullptr);
+    for (UINT mip = 0; mip < mipmapCount; ++mip)
+    {
+      assert(item.footprints[mip].Offset == allocation.offset + item.image.mipLevels[mip].offset);
+      assert(item.footprints[mip].Footprint.RowPitch == item.image.mipLevels[mip].rowPitch);
+    }
+
+    D3D12_HEAP_PROPERTIES heapProps{
+      .Type = D3D12_HEAP_TYPE_DEFAULT,
+      .CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN,
+      .MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN,
+      .CreationNodeMask = 0, .VisibleNodeMask = 0,
+    };
+    item.texture = gfxDevice->CreateImage2D(texDesc, heapProps, D3D12_RESOURCE_STATE_COPY_DEST, nullptr);
+    outImages[i] = item.texture;
+    batch.push_back(std::move(item));
+  }
+  flush();
+  if (generateMipsOnGpu)
+  {
+    gfxDevice->WaitForGPU();
+    mipGenerator->ReleasePendingDescriptors();
+  }
+
+  // 直接展開できなかったものは通常の経路で作成する.
+  if (!fallbackIndices.empty())
+  {
+    std::vector<TextureDecodeRequest> fallbackRequests;
+    for (auto index : fallbackIndices)
+    {
+      fallbackRequests.push_back(std::move(requests[index]));
+    }
+    auto fallbackStats = DecodeImages(fallbackRequests);
+    stats.imageCount += fallbackStats.imageCount;
+    stats.pixelCount += fallbackStats.pixelCount;
+    stats.decodeMs += fallbackStats.decodeMs;
+
+    std::vector<const DecodedImage*> images;
+    for (const auto& request : fallbackRequests)
+    {
+      images.push_back(request.succeeded ? &request.image : nullptr);
+    }
+    std::vector<Microsoft::WRL::ComPtr<ID3D12Resource1>> textures;
+    CreateTexturesFromImages(textures, images, afterState, resFlags, generateMipsOnGpu);
+    for (size_t i = 0; i < fallbackIndices.size(); ++i)
+    {
+      outImages[fallbackIndices[i]] = textures[i];
+      requests[fallbackIndices[i]] = std::move(fallbackRequests[i]);
+    }
+  }
+  return stats;
+}
@@ -0,0 +1,56 @@
+﻿#pragma once
+#include "GfxDevice.h"
+#include "TextureDecode.h"
+#include <filesystem>
+
+// DecodedImage の格納形式に対応するテクスチャフォーマット.
+// srgb の場合は _SRGB 形式とする(sRGB 形式の無い BC4, BC5 は UNORM のまま).
+DXGI_FORMAT GetTextureFormat(ImageFormat format, bool srgb = false);
+// リソースの形式に対応する SRV の形式.
+// GPU でミップマップを作成する sRGB テクスチャは UNORM の UAV と共用するため TYPELESS で作成しており、_SRGB として参照する.
+DXGI_FORMAT GetShaderResourceFormat(DXGI_FORMAT resourceFormat);
+
+// ファイルからテクスチャを作成.
+// テクスチャは GPU 転送済み、ミップマップ作成ありで作成される.
+// srgb はアルベドなどの色データに指定する. _SRGB 形式で作成し、ミップマップは線形空間で作成する.
+bool CreateTextureFromFile(
+  Microsoft::WRL::ComPtr<ID3D12Resource1>& outImage,
+  std::filesystem::path filePath,
+  bool generateMips = false,
+  D3D12_RESOURCE_STATES afterState = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+  D3D12_RESOURCE_FLAGS resFlags = D3D12_RESOURCE_FLAG_NONE,
+  bool srgb = false);
+
+// メモリからテクスチャを作成.
+// テクスチャは GPU 転送済み、ミップマップ作成ありで作成される.
+bool CreateTextureFromMemory(
+  Microsoft::WRL::ComPtr<ID3D12Resource1>& outImage,
+  const void* srcBuffer, size_t bufferSize,
+  bool generateMips = false,
+  D3D12_RESOURCE_STATES afterState = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+  D3D12_RESOURCE_FLAGS resFlags = D3D12_RESOURCE_FLAG_NONE,
+  bool srgb = false);
+
+// CPU で展開済みのイメージ群からテクスチャを作成.
+// 転送はステージングバッファを共有してまとめて行う. 失敗したものは nullptr となる.
+// BC 形式のイメージはブロック単位のフットプリントでそのまま転送する.
+// arraySize が 2 以上のイメージはテクスチャ配列として作成する.
+// generateMipsOnGpu の場合は mip0 のみを転送し、残りのレベルは GpuMipGenerator で作成する(RGBA8 のみ).
+bool CreateTexturesFromImages(
+  std::vector<Microsoft::WRL::ComPtr<ID3D12Resource1>>& outImages,
+  const std::vector<const DecodedImage*>& images,
+  D3D12_RESOURCE_STATES afterState = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+  D3D12_RESOURCE_FLAGS resFlags = D3D12_RESOURCE_FLAG_NONE,
+  bool generateMipsOnGpu = false);
+
+// 画像ファイルのメモリイメージからテクスチャを作成する.
+// ヘッダからレベル配置を決めてアップロードリングの領域を確保し、展開とミップマップ作成はその領域へ直接書き込む.
+// 中間のイメージやステージングへのコピーが無いため、CPU 側に展開結果を残す必要が無い場合に使う.
+// リングに収まらないものやヘッダを読めないものは、DecodeImages と CreateTexturesFromImages の経路で作成する.
+// requests の generateMips, mipOptions を使用し、succeeded を設定する(image は直接展開したものでは空のまま).
+TextureDecodeStats CreateTexturesFromEncoded(
+  std::vector<Microsoft::WRL::ComPtr<ID3D12Resource1>>& outImages,
+  std::vector<TextureDecodeRequest>& requests,
+  D3D12_RESOURCE_STATES afterState = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+  D3D12_RESOURCE_FLAGS resFlags = D3D12_RESOURCE_FLAG_NONE,
+  bool generateMipsOnGpu = false);
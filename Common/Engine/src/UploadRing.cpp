@@ -0,0 +1,166 @@
+﻿#include "UploadRing.h"
+
+static std::unique_ptr<UploadRing> gUploadRing = nullptr;
+
+std::unique_ptr<UploadRing>& GetUploadRing()
+{
+  if (gUploadRing == nullptr)
+  {
+    gUploadRing = std::make_unique<UploadRing>();
+  }
+  return gUploadRing;
+}
+
+void UploadRing::Initialize(UINT64 size)
+{
+  auto& gfxDevice = GetGfxDevice();
+  D3D12_RESOURCE_DESC resDesc{
+    .Dimension = D3D12_RESOURCE_DIMENSION_BUFFER,
+    .Alignment = 0,
+    .Width = size, .Height = 1, .DepthOrArraySize = 1, .MipLevels = 1,
+    .Format = DXGI_FORMAT_UNKNOWN,
+    .SampleDesc = {.Count = 1, .Quality = 0 },
+    .Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR,
+    .Flags = D3D12_RESOURCE_FLAG_NONE,
+  };
+  // 展開先として使い、ミップマップ作成で CPU から読み返すため、
+  // 書き込み結合(UPLOAD ヒープ)ではなくキャッシュの効くシステムメモリに置く.
+  D3D12_HEAP_PROPERTIES heapProps{
+    .Type = D3D12_HEAP_TYPE_CUSTOM,
+    .CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_WRITE_BACK,
+    .MemoryPoolPreference = D3D12_MEMORY_POOL_L0,
+    .CreationNodeMask = 0, .VisibleNodeMask = 0,
+  };
+  m_buffer = gfxDevice->CreateBuffer(resDesc, heapProps);
+  if (m_buffer == nullptr)
+  {
+    return;
+  }
+  if (FAILED(gfxDevice->GetD3D12Device()->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence))))
+  {
+    m_buffer.Reset();
+    return;
+  }
+  // CPU から参照できるヒープは常にマップしたままでよい.
+  void* p = nullptr;
+  m_buffer->Map(0, nullptr, &p);
+  m_mapped = reinterpret_cast<BYTE*>(p);
+  m_size = size;
+  m_head = m_tail = m_used = m_pendingUsed = 0;
+  m_fenceValue = 0;
+  m_segments.clear();
+}
+
+void UploadRing::Shutdown()
+{
+  // 使用中の区間の完了を待ってから解放する.
+  if (!m_segments.empty())
+  {
+    m_fence->SetEventOnCompletion(m_segments.back().fenceValue, nullptr);
+  }
+  m_segments.clear();
+  if (m_buffer)
+  {
+    m_buffer->Unmap(0, nullptr);
+  }
+  m_mapped = nullptr;
+  m_buffer.Reset();
+  m_fence.Reset();
+  m_size = 0;
+}
+
+bool UploadRing::Allocate(UINT64 size, UINT64 alignment, Allocation& outAllocation)
+{
+  if (!IsInitialized() || size > m_size)
+  {
+    return false;
+  }
+  Reclaim();
+  UINT64 offset = 0;
+  while (!TryAllocate(size, alignment, offset))
+  {
+    if (m_segments.empty())
+    {
+      return false;
+    }
+    // 最も古い区間の完了を待って空きを作る.
+    m_fence->SetEventOnCompletion(m_segments.front().fenceValue, nullptr);
+    m_waitCount++;
+    Reclaim();
+  }
+  outAllocation = Allocation{
+    .resource = m_buffer.Get(),
+    .offset = offset,
+    .cpuAddress = m_mapped + offset,
+  };
+  return true;
+}
+
+void UploadRing::Signal()
+{
+  if (!IsInitialized() || m_pendingUsed == 0)
+  {
+    return;
+  }
+  GetGfxDevice()->GetD3D12CommandQueue()->Signal(m_fence.Get(), ++m_fenceValue);
+  m_segments.push_back({ m_fenceValue, m_head, m_pendingUsed });
+  m_pendingUsed = 0;
+}
+
+bool UploadRing::TryAllocate(UINT64 size, UINT64 alignment, UINT64& outOffset)
+{
+  if (m_used == 0)
+  {
+    m_head = m_tail = 0;
+  }
+  else if (m_used >= m_size)
+  {
+    return false;
+  }
+  auto alignUp = [&](UINT64 value) { return (value + alignment - 1) / alignment * alignment; };
+
+  UINT64 offset = 0, consumed = 0;
+  if (m_head >= m_tail)
+  {
+    // 末尾側に空きがあれば使い、足りなければ先頭に折り返す.
+    if (alignUp(m_head) + size <= m_size)
+    {
+      offset = alignUp(m_head);
+      consumed = offset - m_head + size;
+    }
+    else if (size <= m_tail)
+    {
+      offset = 0;
+      consumed = m_size - m_head + size;
+    }
+    else
+    {
+      return false;
+    }
+  }
+  else
+  {
+    if (alignUp(m_head) + size > m_tail)
+    {
+      return false;
+    }
+    offset = alignUp(m_head);
+    consumed = offset - m_head + size;
+  }
+  m_head = offset + size;
+  m_used += consumed;
+  m_pendingUsed += consumed;
+  outOffset = offset;
+  return true;
+}
+
+void UploadRing::Reclaim()
+{
+  const auto completed = m_fence->GetCompletedValue();
+  while (!m_segments.empty() && m_segments.front().fenceValue <= completed)
+  {
+    m_tail = m_segments.front().end;
+    m_used -= m_segments.front().usedSize;
+    m_segments.pop_front();
+  }
+}
@@ -0,0 +1,64 @@
+﻿#pragma once
+#include <memory>
+#include <deque>
+#include <cstdint>
+#include "GfxDevice.h"
+
+// 転送元として使う常駐のアップロードバッファ(リングバッファ).
+// CPU から読み返せるよう、キャッシュ有効なシステムメモリ上に確保する.
+// 確保した領域は Signal で区間として区切り、区間ごとのフェンスが完了した時点で再利用する.
+// 空きが足りない場合は古い区間の完了を待つため、転送ごとにステージングバッファを作成・破棄せずに済む.
+// メインスレッドから使用すること.
+class UploadRing
+{
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+public:
+  struct Allocation
+  {
+    ID3D12Resource1* resource = nullptr;
+    UINT64 offset = 0;        // resource 先頭からのオフセット.
+    BYTE* cpuAddress = nullptr;  // 書き込み先. 常にマップされている.
+  };
+
+  void Initialize(UINT64 size);
+  void Shutdown();
+  bool IsInitialized() const { return m_buffer != nullptr; }
+  UINT64 GetSize() const { return m_size; }
+  ID3D12Resource1* GetBuffer() const { return m_buffer.Get(); }
+
+  // size が容量を超える場合や、Signal 前の領域だけで埋まっている場合は false を返す.
+  // 後者の場合は、呼び出し側で転送コマンドを発行して Signal してから再度呼ぶこと.
+  bool Allocate(UINT64 size, UINT64 alignment, Allocation& outAllocation);
+  // 直前までに確保した領域を参照するコマンドをキューに発行した後に呼ぶ.
+  void Signal();
+
+  // 統計情報.
+  UINT64 GetUsedSize() const { return m_used; }
+  uint32_t GetWaitCount() const { return m_waitCount; }
+
+private:
+  struct Segment
+  {
+    UINT64 fenceValue;
+    UINT64 end;       // 区間の末尾(次の区間の先頭).
+    UINT64 usedSize;  // 区間内の確保量(整列や折り返しで空けた分を含む).
+  };
+  bool TryAllocate(UINT64 size, UINT64 alignment, UINT64& outOffset);
+  void Reclaim();
+
+  ComPtr<ID3D12Resource1> m_buffer;
+  BYTE*  m_mapped = nullptr;
+  UINT64 m_size = 0;
+  UINT64 m_head = 0;  // 次に確保する位置.
+  UINT64 m_tail = 0;  // 使用中の最も古い位置.
+  UINT64 m_used = 0;
+  UINT64 m_pendingUsed = 0;  // Signal 前の確保量.
+
+  ComPtr<ID3D12Fence1> m_fence;
+  UINT64 m_fenceValue = 0;
+  std::deque<Segment> m_segments;
+  uint32_t m_waitCount = 0;
+};
+
+std::unique_ptr<UploadRing>& GetUploadRing();
@@ -0,0 +1,345 @@
+﻿#include "EngineTest.h"
+#include "BcEncoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+// 圧縮結果をテスト側の展開処理(D3D の BC 形式の仕様どおり)で戻し、元画像との PSNR で品質を確かめる.
+// 補間色は仕様では浮動小数で求めるため、整数で最も近い値に丸めて扱う.
+namespace
+{
+  uint64_t ReadBits(const uint8_t* data, uint32_t offset, uint32_t count)
+  {
+    uint64_t value = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      const uint32_t bit = offset + i;
+      value |= uint64_t((data[bit / 8] >> (bit % 8)) & 1) << i;
+    }
+    return value;
+  }
+
+  void DecodeColor565(uint32_t color, uint32_t out[3])
+  {
+    const uint32_t r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+  }
+
+  // BC1 の色ブロック. BC3 の色ブロックは常に4色として扱う.
+  void DecodeColorBlock(const uint8_t* block, bool allowThreeColor, uint8_t* texels)
+  {
+    const uint32_t c0 = block[0] | (block[1] << 8), c1 = block[2] | (block[3] << 8);
+    uint32_t palette[4][3];
+    DecodeColor565(c0, palette[0]);
+    DecodeColor565(c1, palette[1]);
+    const bool fourColor = !allowThreeColor || c0 > c1;
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+      if (fourColor)
+      {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+      }
+      else
+      {
+        palette[2][c] = (palette[0][c] + palette[1][c] + 1) / 2;
+        palette[3][c] = 0;
+      }
+    }
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      const uint32_t index = uint32_t(ReadBits(block + 4, i * 2, 2));
+      for (uint32_t c = 0; c < 3; ++c)
+      {
+        texels[i * 4 + c] = uint8_t(palette[index][c]);
+      }
+    }
+  }
+
+  void DecodeBc4Block(const uint8_t* block, uint32_t channel, uint8_t* texels)
+  {
+    const uint32_t r0 = block[0], r1 = block[1];
+    uint32_t palette[8] = { r0, r1 };
+    if (r0 > r1)
+    {
+      for (uint32_t k = 1; k <= 6; ++k)
+      {
+        palette[k + 1] = ((7 - k) * r0 + k * r1 + 3) / 7;
+      }
+    }
+    else
+    {
+      for (uint32_t k = 1; k <= 4; ++k)
+      {
+        palette[k + 1] = ((5 - k) * r0 + k * r1 + 2) / 5;
+      }
+      palette[6] = 0;
+      palette[7] = 255;
+    }
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      texels[i * 4 + channel] = uint8_t(palette[ReadBits(block + 2, i * 3, 3)]);
+    }
+  }
+
+  // BC7 はエンコーダーの使うモード6だけを展開する.
+  bool DecodeBc7Mode6Block(const uint8_t* block, uint8_t* texels)
+  {
+    if (ReadBits(block, 0, 7) != (1u << 6))
+    {
+      return false;
+    }
+    uint32_t endpoints[2][4];
+    for (uint32_t c = 0; c < 4; ++c)
+    {
+      for (uint32_t e = 0; e < 2; ++e)
+      {
+        endpoints[e][c] = uint32_t(ReadBits(block, 7 + c * 14 + e * 7, 7)) << 1;
+      }
+    }
+    for (uint32_t e = 0; e < 2; ++e)
+    {
+      const uint32_t p = uint32_t(ReadBits(block, 63 + e, 1));
+      for (uint32_t c = 0; c < 4; ++c)
+      {
+        endpoints[e][c] |= p;
+      }
+    }
+    static const uint32_t weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+    uint32_t offset = 65;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+      // 先頭のテクセルのインデックスは最上位ビットを省いた3ビット.
+      const uint32_t bits = i == 0 ? 3 : 4;
+      const uint32_t index = uint32_t(ReadBits(block, offset, bits));
+      offset += bits;
+      for (uint32_t c = 0; c < 4; ++c)
+      {
+        texels[i * 4 + c] = uint8_t(((64 - weights[index]) * endpoints[0][c] + weights[index] * endpoints[1][c] + 32) >> 6);
+      }
+    }
+    return offset == 128;
+  }
+
+  bool DecodeBlock(ImageFormat format, const uint8_t* block, uint8_t* texels)
+  {
+    memset(texels, 0, 64);
+    switch (format)
+    {
+    case ImageFormat::BC1:
+      DecodeColorBlock(block, true, texels);
+      return true;
+    case ImageFormat::BC3:
+      DecodeBc4Block(block, 3, texels);
+      DecodeColorBlock(block + 8, false, texels);
+      return true;
+    case ImageFormat::BC4:
+      DecodeBc4Block(block, 0, texels);
+      return true;
+    case ImageFormat::BC5:
+      DecodeBc4Block(block, 0, texels);
+      DecodeBc4Block(block + 8, 1, texels);
+      return true;
+    case ImageFormat::BC7:
+      return DecodeBc7Mode6Block(block, texels);
+    default:
+      return false;
+    }
+  }
+
+  uint32_t GetChannelCount(ImageFormat format)
+  {
+    switch (format)
+    {
+    case ImageFormat::BC1: return 3;
+    case ImageFormat::BC4: return 1;
+    case ImageFormat::BC5: return 2;
+    default: return 4;
+    }
+  }
+
+  // 写真に近い絵柄として、なだらかなグラデーションに縁と弱いノイズを加える. アルファも滑らかに変化させる.
+  DecodedImage MakeTestImage(uint32_t width, uint32_t height)
+  {
+    DecodedImage image;
+    image.Allocate(width, height, 1);
+    std::mt19937 random(11);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+      uint8_t* row = image.GetLevelData(0) + size_t(y) * image.mipLevels[0].rowPitch;
+      for (uint32_t x = 0; x < width; ++x)
+      {
+        const float u = float(x) / float(width), v = float(y) / float(height);
+        const bool edge = (x / 24 + y / 24) % 2 == 0;
+        const int noise = int(random() % 9) - 4;
+        const float values[4] = {
+          200.0f * u + (edge ? 40.0f : 0.0f),
+          128.0f + 100.0f * std::sin(6.0f * v + 2.0f * u),
+          60.0f + 150.0f * u * v,
+          255.0f * (0.5f + 0.5f * std::cos(4.0f * u)),
+        };
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+          row[x * 4 + c] = uint8_t(std::clamp(values[c] + float(c < 3 ? noise : 0), 0.0f, 255.0f));
+        }
+      }
+    }
+    return image;
+  }
+
+  // mip0 の PSNR(dB). 展開に失敗した場合は 0 を返す.
+  double ComputePsnr(const DecodedImage& source, const DecodedImage& compressed)
+  {
+    const auto format = compressed.format;
+    const uint32_t channelCount = GetChannelCount(format);
+    const auto& srcLevel = source.mipLevels[0];
+    const auto& dstLevel = compressed.mipLevels[0];
+    const uint32_t blockBytes = GetFormatElementBytes(format);
+    double squaredError = 0;
+    for (uint32_t by = 0; by < dstLevel.rowCount; ++by)
+    {
+      for (uint32_t bx = 0; bx < (dstLevel.width + 3) / 4; ++bx)
+      {
+        uint8_t texels[64];
+        if (!DecodeBlock(format, compressed.GetLevelData(0) + size_t(by) * dstLevel.rowPitch + bx * blockBytes, texels))
+        {
+          return 0;
+        }
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+          const uint8_t* src = source.GetLevelData(0) + size_t(by * 4 + i / 4) * srcLevel.rowPitch + (bx * 4 + i % 4) * 4;
+          for (uint32_t c = 0; c < channelCount; ++c)
+          {
+            const double d = double(src[c]) - double(texels[i * 4 + c]);
+            squaredError += d * d;
+          }
+        }
+      }
+    }
+    const double mse = squaredError / (double(srcLevel.width) * srcLevel.height * channelCount);
+    return mse > 0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 100.0;
+  }
+}
+
+ENGINE_TEST(CompressedQualityMeetsPsnr)
+{
+  const auto image = MakeTestImage(96, 64);
+  // 形式ごとの最低限の PSNR. 1チャンネルを8段階で表す BC4/BC5 は、端点が 565 で4段階の BC1 より高い.
+  const struct
+  {
+    ImageFormat format;
+    double minPsnr;
+  } cases[] = {
+    { ImageFormat::BC1, 36.0 },
+    { ImageFormat::BC3, 37.0 },
+    { ImageFormat::BC4, 48.0 },
+    { ImageFormat::BC5, 46.0 },
+    { ImageFormat::BC7, 36.0 },
+  };
+  for (const auto& testCase : cases)
+  {
+    double previous = 0;
+    for (auto quality : { BcQuality::Fast, BcQuality::Normal, BcQuality::High })
+    {
+      DecodedImage compressed;
+      ENGINE_CHECK(CompressImage(image, testCase.format, quality, compressed));
+      ENGINE_CHECK(compressed.format == testCase.format);
+      const double psnr = ComputePsnr(image, compressed);
+      ENGINE_CHECK(psnr >= testCase.minPsnr);
+      // 品質を上げて悪くならない(探索の違いによる僅かな揺れは許す).
+      ENGINE_CHECK(psnr >= previous - 0.1);
+      previous = psnr;
+    }
+  }
+}
+
+ENGINE_TEST(SolidBlocksAreExact)
+{
+  // 端点で表せる色の一様なブロックは誤差なく戻る.
+  uint8_t texels[64];
+  for (uint32_t i = 0; i < 16; ++i)
+  {
+    texels[i * 4 + 0] = 0xff;
+    texels[i * 4 + 1] = 0x82;
+    texels[i * 4 + 2] = 0x00;
+    texels[i * 4 + 3] = 0x40;
+  }
+  for (auto quality : { BcQuality::Fast, BcQuality::Normal, BcQuality::High })
+  {
+    uint8_t block[16];
+    uint8_t decoded[64];
+    EncodeBlockBC1(texels, block, quality);
+    DecodeBlock(ImageFormat::BC1, block, decoded);
+    ENGINE_CHECK(decoded[0] == 0xff && decoded[1] == 0x82 && decoded[2] == 0x00);
+    EncodeBlockBC3(texels, block, quality);
+    DecodeBlock(ImageFormat::BC3, block, decoded);
+    ENGINE_CHECK(decoded[0] == 0xff && decoded[1] == 0x82 && decoded[2] == 0x00 && decoded[3] == 0x40);
+    EncodeBlockBC4(texels, 1, block, quality);
+    DecodeBlock(ImageFormat::BC4, block, decoded);
+    ENGINE_CHECK(decoded[0] == 0x82);
+    EncodeBlockBC7(texels, block, quality);
+    ENGINE_CHECK(DecodeBlock(ImageFormat::BC7, block, decoded));
+    for (uint32_t c = 0; c < 4; ++c)
+    {
+      ENGINE_CHECK(std::abs(int(decoded[c]) - int(texels[c])) <= 1);
+    }
+  }
+}
+
+ENGINE_TEST(Bc1IsOpaque)
+{
+  // BC1 は不透明として扱うため、黒を含むブロックでも透明を表す3色モードを使わない.
+  const auto image = MakeTestImage(64, 64);
+  DecodedImage source = image;
+  for (uint32_t y = 0; y < 64; y += 3)
+  {
+    memset(source.GetLevelData(0) + size_t(y) * source.mipLevels[0].rowPitch, 0, 64 * 4);
+  }
+  DecodedImage compressed;
+  ENGINE_CHECK(CompressImage(source, ImageFormat::BC1, BcQuality::High, compressed));
+  bool opaque = true;
+  const auto& level = compressed.mipLevels[0];
+  for (uint32_t by = 0; by < level.rowCount; ++by)
+  {
+    for (uint32_t bx = 0; bx < 16; ++bx)
+    {
+      const uint8_t* block = compressed.GetLevelData(0) + size_t(by) * level.rowPitch + bx * 8;
+      const uint32_t c0 = block[0] | (block[1] << 8), c1 = block[2] | (block[3] << 8);
+      for (uint32_t i = 0; c0 <= c1 && i < 16; ++i)
+      {
+        opaque = opaque && ReadBits(block + 4, i * 2, 2) != 3;
+      }
+    }
+  }
+  ENGINE_CHECK(opaque);
+}
+
+ENGINE_TEST(CompressesEveryMipLevel)
+{
+  DecodedImage image = MakeTestImage(64, 32);
+  DecodedImage withMips;
+  withMips.Allocate(64, 32, 0);
+  for (uint32_t y = 0; y < 32; ++y)
+  {
+    memcpy(withMips.GetLevelData(0) + size_t(y) * withMips.mipLevels[0].rowPitch,
+      image.GetLevelData(0) + size_t(y) * image.mipLevels[0].rowPitch, 64 * 4);
+  }
+  BuildMipChain(withMips);
+  DecodedImage compressed;
+  ENGINE_CHECK(CompressImage(withMips, ImageFormat::BC7, BcQuality::Fast, compressed));
+  ENGINE_CHECK(compressed.GetMipLevelCount() == withMips.GetMipLevelCount());
+  // 4テクセルに満たないレベルも1ブロックになる.
+  const auto& last = compressed.mipLevels.back();
+  ENGINE_CHECK(last.width == 1 && last.height == 1 && last.rowCount == 1);
+  ENGINE_CHECK(compressed.GetRowSize(compressed.GetMipLevelCount() - 1) == 16);
+
+  // mip0 が4の倍数でないものと、圧縮済みのものは扱わない.
+  DecodedImage odd = MakeTestImage(30, 16);
+  ENGINE_CHECK(!CompressImage(odd, ImageFormat::BC1, BcQuality::Fast, compressed));
+  DecodedImage again;
+  ENGINE_CHECK(!CompressImage(compressed, ImageFormat::BC1, BcQuality::Fast, again));
+}
@@ -0,0 +1,198 @@
+﻿#include "EngineTest.h"
+#include "ComputeDispatch.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+  bool IsSame(const DispatchGroupCount& count, uint32_t x, uint32_t y, uint32_t z)
+  {
+    return count.x == x && count.y == y && count.z == z;
+  }
+
+  // 末尾を広げてから書き込む.
+  void AppendBytes(std::vector<uint8_t>& data, const void* bytes, size_t size)
+  {
+    const size_t offset = data.size();
+    data.resize(offset + size);
+    if (size > 0)
+    {
+      memcpy(data.data() + offset, bytes, size);
+    }
+  }
+  void AppendU32(std::vector<uint8_t>& data, uint32_t value)
+  {
+    AppendBytes(data, &value, sizeof(value));
+  }
+  void WriteU32(std::vector<uint8_t>& data, size_t offset, uint32_t value)
+  {
+    memcpy(data.data() + offset, &value, sizeof(value));
+  }
+
+  struct Part
+  {
+    std::string fourCC;
+    std::vector<uint8_t> data;
+  };
+
+  // DXIL コンテナ(DxilContainerHeader + パートのオフセット表 + 各パート)を組み立てる.
+  std::vector<uint8_t> MakeContainer(const std::vector<Part>& parts)
+  {
+    std::vector<uint8_t> container;
+    AppendBytes(container, "DXBC", 4);
+    container.resize(4 + 16, 0);  // Digest.
+    const uint8_t version[4] = { 1, 0, 0, 0 };  // MajorVersion, MinorVersion.
+    AppendBytes(container, version, sizeof(version));
+    AppendU32(container, 0);  // ContainerSizeInBytes は最後に書く.
+    AppendU32(container, uint32_t(parts.size()));
+    const size_t offsetTable = container.size();
+    container.resize(offsetTable + parts.size() * 4);
+    for (size_t i = 0; i < parts.size(); ++i)
+    {
+      WriteU32(container, offsetTable + i * 4, uint32_t(container.size()));
+      AppendBytes(container, parts[i].fourCC.data(), parts[i].fourCC.size());
+      AppendU32(container, uint32_t(parts[i].data.size()));
+      AppendBytes(container, parts[i].data.data(), parts[i].data.size());
+    }
+    WriteU32(container, 24, uint32_t(container.size()));
+    return container;
+  }
+
+  // PSV0 パート. 先頭に PSVRuntimeInfo の大きさ、続けて PSVRuntimeInfo を置く.
+  // PSVRuntimeInfo1::ShaderStage は 24 バイト目, PSVRuntimeInfo2::NumThreadsX,Y,Z は 36 バイト目から.
+  Part MakePsv0(uint32_t runtimeInfoSize, uint8_t shaderStage, uint32_t x, uint32_t y, uint32_t z)
+  {
+    std::vector<uint8_t> info(runtimeInfoSize, 0);
+    if (runtimeInfoSize > 24)
+    {
+      info[24] = shaderStage;
+    }
+    if (runtimeInfoSize >= 48)
+    {
+      WriteU32(info, 36, x);
+      WriteU32(info, 40, y);
+      WriteU32(info, 44, z);
+    }
+    Part part{ "PSV0", {} };
+    AppendU32(part.data, runtimeInfoSize);
+    AppendBytes(part.data, info.data(), info.size());
+    // 後ろにはリソースのバインド情報などが続く.
+    part.data.resize(part.data.size() + 16, 0xcd);
+    return part;
+  }
+
+  const uint8_t ComputeStage = 5;
+  const uint8_t PixelStage = 0;
+
+  bool Reflect(const std::vector<uint8_t>& blob, ThreadGroupSize& outSize)
+  {
+    return ReflectThreadGroupSize(blob.data(), blob.size(), outSize);
+  }
+}
+
+ENGINE_TEST(GroupCountRoundsUp)
+{
+  const ThreadGroupSize group16{ 16, 16, 1 };
+  ENGINE_CHECK(IsSame(GetDispatchGroupCount(group16, 1920, 1080), 120, 68, 1));
+  ENGINE_CHECK(IsSame(GetDispatchGroupCount(group16, 16, 16), 1, 1, 1));
+  ENGINE_CHECK(IsSame(GetDispatchGroupCount(group16, 17, 15), 2, 1, 1));
+  ENGINE_CHECK(IsSame(GetDispatchGroupCount(group16, 1, 1), 1, 1, 1));
+  ENGINE_CHECK(IsSame(GetDispatchGroupCount({ 64, 1, 1 }, 1000), 16, 1, 1));
+  ENGINE_CHECK(IsSame(GetDispatchGroupCount({ 4, 4, 4 }, 9, 8, 7), 3, 2, 2));
+}
+
+ENGINE_TEST(GroupCountZeroSizeSkipsDispatch)
+{
+  // どれかの軸が 0 なら Dispatch 不要(全て 0).
+  const ThreadGroupSize group{ 8, 8, 1 };
+  ENGINE_CHECK(IsSame(GetDispatchGroupCount(group, 0, 100), 0, 0, 0));
+  ENGINE_CHECK(IsSame(GetDispatchGroupCount(group, 100, 0), 0, 0, 0));
+  ENGINE_CHECK(IsSame(GetDispatchGroupCount(group, 100, 100, 0), 0, 0, 0));
+}
+
+ENGINE_TEST(GroupCountEdgeSizes)
+{
+  // 32bit の上限でも桁あふれしない. グループの大きさ 0 は 1 として扱う.
+  ENGINE_CHECK(IsSame(GetDispatchGroupCount({ 1, 1, 1 }, 0xffffffffu), 0xffffffffu, 1, 1));
+  ENGINE_CHECK(IsSame(GetDispatchGroupCount({ 64, 1, 1 }, 0xffffffffu), 0x4000000u, 1, 1));
+  ENGINE_CHECK(IsSame(GetDispatchGroupCount({ 0, 0, 0 }, 3, 4, 5), 3, 4, 5));
+}
+
+ENGINE_TEST(MipLevelSize)
+{
+  ENGINE_CHECK(GetMipLevelSize(1000, 0) == 1000);
+  ENGINE_CHECK(GetMipLevelSize(1000, 3) == 125);
+  ENGINE_CHECK(GetMipLevelSize(1000, 10) == 1);
+  ENGINE_CHECK(GetMipLevelSize(1, 5) == 1);
+  ENGINE_CHECK(GetMipLevelSize(5, 70) == 1);
+}
+
+ENGINE_TEST(ReflectComputeNumThreads)
+{
+  ThreadGroupSize size;
+  ENGINE_CHECK(Reflect(MakeContainer({ MakePsv0(48, ComputeStage, 8, 4, 2) }), size));
+  ENGINE_CHECK(size.x == 8 && size.y == 4 && size.z == 2);
+
+  // PSVRuntimeInfo3 など新しい版は後ろに項目が増えるだけなので同じ位置から読める.
+  ENGINE_CHECK(Reflect(MakeContainer({ MakePsv0(52, ComputeStage, 128, 1, 1) }), size));
+  ENGINE_CHECK(size.x == 128 && size.y == 1 && size.z == 1);
+
+  // PSV0 以外のパートは読み飛ばす.
+  Part other{ "SFI0", std::vector<uint8_t>(8, 0) };
+  Part dxil{ "DXIL", std::vector<uint8_t>(64, 0x11) };
+  ENGINE_CHECK(Reflect(MakeContainer({ other, dxil, MakePsv0(48, ComputeStage, 16, 16, 1) }), size));
+  ENGINE_CHECK(size.x == 16 && size.y == 16 && size.z == 1);
+}
+
+ENGINE_TEST(ReflectRejectsUnsupportedBlobs)
+{
+  ThreadGroupSize size{ 3, 3, 3 };
+  // コンピュートシェーダー以外.
+  ENGINE_CHECK(!Reflect(MakeContainer({ MakePsv0(48, PixelStage, 8, 8, 1) }), size));
+  // NumThreads を持たない古い版(PSVRuntimeInfo1).
+  ENGINE_CHECK(!Reflect(MakeContainer({ MakePsv0(36, ComputeStage, 8, 8, 1) }), size));
+  // PSV0 が無い(DXBC).
+  ENGINE_CHECK(!Reflect(MakeContainer({ Part{ "SHEX", std::vector<uint8_t>(32, 0) } }), size));
+  // D3D12 の上限を超える値.
+  ENGINE_CHECK(!Reflect(MakeContainer({ MakePsv0(48, ComputeStage, 0, 8, 1) }), size));
+  ENGINE_CHECK(!Reflect(MakeContainer({ MakePsv0(48, ComputeStage, 64, 32, 1) }), size));
+  ENGINE_CHECK(!Reflect(MakeContainer({ MakePsv0(48, ComputeStage, 1, 1, 128) }), size));
+  // 失敗時は出力を変更しない.
+  ENGINE_CHECK(size.x == 3 && size.y == 3 && size.z == 3);
+}
+
+ENGINE_TEST(ReflectRejectsBrokenContainers)
+{
+  ThreadGroupSize size;
+  const auto valid = MakeContainer({ MakePsv0(48, ComputeStage, 8, 8, 1) });
+  ENGINE_CHECK(!ReflectThreadGroupSize(nullptr, 0, size));
+  ENGINE_CHECK(!ReflectThreadGroupSize(valid.data(), 16, size));
+  // ContainerSize が渡された長さより大きい.
+  ENGINE_CHECK(!ReflectThreadGroupSize(valid.data(), valid.size() - 1, size));
+
+  auto badMagic = valid;
+  badMagic[0] = 'X';
+  ENGINE_CHECK(!Reflect(badMagic, size));
+
+  // パートのオフセットが範囲外.
+  auto badOffset = valid;
+  WriteU32(badOffset, 32, uint32_t(valid.size()));
+  ENGINE_CHECK(!Reflect(badOffset, size));
+
+  // パートの大きさが範囲外.
+  auto badPartSize = valid;
+  WriteU32(badPartSize, 36 + 4, 0x10000);
+  ENGINE_CHECK(!Reflect(badPartSize, size));
+
+  // PSVRuntimeInfo の大きさがパートに収まらない.
+  auto badInfoSize = valid;
+  WriteU32(badInfoSize, 36 + 8, 0x1000);
+  ENGINE_CHECK(!Reflect(badInfoSize, size));
+
+  // パート数がオフセット表に収まらない.
+  auto badPartCount = valid;
+  WriteU32(badPartCount, 28, 0x10000000);
+  ENGINE_CHECK(!Reflect(badPartCount, size));
+}
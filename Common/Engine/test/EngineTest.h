@@ -0,0 +1,54 @@
+﻿#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "JobSystem.h"
+
+// テスト実行ファイル用の最小限の仕組み. 外部のテストフレームワークには依存しない.
+//   ENGINE_TEST(Name) { ENGINE_CHECK(式); }
+// main は EngineTestMain.cpp にあり、登録した順に全テストを実行する. 失敗があれば終了コードが 1 になる.
+namespace EngineTest
+{
+  struct TestCase
+  {
+    const char* name;
+    void (*function)();
+  };
+
+  inline std::vector<TestCase>& GetTestCases()
+  {
+    static std::vector<TestCase> testCases;
+    return testCases;
+  }
+  inline int& GetFailureCount()
+  {
+    static int failureCount = 0;
+    return failureCount;
+  }
+
+  struct Registrar
+  {
+    Registrar(const char* name, void (*function)()) { GetTestCases().push_back(TestCase{ name, function }); }
+  };
+
+  inline void ReportFailure(const char* file, int line, const char* expression)
+  {
+    fprintf(stderr, "%s(%d): check failed: %s\n", file, line, expression);
+    GetFailureCount()++;
+  }
+
+  // テスト中だけワーカーを持つ共通のジョブシステム.
+  struct ScopedJobSystem
+  {
+    explicit ScopedJobSystem(uint32_t workerCount) { GetJobSystem()->Initialize(workerCount); }
+    ~ScopedJobSystem() { GetJobSystem()->Shutdown(); }
+  };
+}
+
+#define ENGINE_TEST(name) \
+  static void name(); \
+  static EngineTest::Registrar name##Registrar(#name, name); \
+  static void name()
+
+#define ENGINE_CHECK(expression) \
+  do { if (!(expression)) { EngineTest::ReportFailure(__FILE__, __LINE__, #expression); } } while (false)
@@ -0,0 +1,16 @@
+﻿#include "EngineTest.h"
+
+int main()
+{
+  int failedTests = 0;
+  for (const auto& testCase : EngineTest::GetTestCases())
+  {
+    const int failuresBefore = EngineTest::GetFailureCount();
+    testCase.function();
+    const bool passed = EngineTest::GetFailureCount() == failuresBefore;
+    printf("[%s] %s\n", passed ? "  OK  " : " FAIL ", testCase.name);
+    failedTests += passed ? 0 : 1;
+  }
+  printf("%d / %d passed\n", int(EngineTest::GetTestCases().size()) - failedTests, int(EngineTest::GetTestCases().size()));
+  return failedTests == 0 ? 0 : 1;
+}
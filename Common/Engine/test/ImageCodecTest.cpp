@@ -0,0 +1,164 @@
+﻿#include "EngineTest.h"
+#include "DdsFile.h"
+#include "FileLoader.h"
+#include "PngFile.h"
+#include "TextureDecode.h"
+
+#include <cstring>
+#include <fstream>
+#include <random>
+
+namespace
+{
+  DecodedImage MakeNoiseImage(uint32_t width, uint32_t height, uint32_t mipCount, uint32_t seed)
+  {
+    DecodedImage image;
+    image.Allocate(width, height, mipCount);
+    std::mt19937 random(seed);
+    for (auto& value : image.pixels)
+    {
+      value = uint8_t(random());
+    }
+    return image;
+  }
+
+  bool IsSameLevel(const DecodedImage& a, const DecodedImage& b, uint32_t mip)
+  {
+    const auto& levelA = a.mipLevels[mip];
+    const auto& levelB = b.mipLevels[mip];
+    if (levelA.width != levelB.width || levelA.height != levelB.height || levelA.rowCount != levelB.rowCount)
+    {
+      return false;
+    }
+    for (uint32_t row = 0; row < levelA.rowCount; ++row)
+    {
+      if (memcmp(a.GetLevelData(mip) + size_t(levelA.rowPitch) * row, b.GetLevelData(mip) + size_t(levelB.rowPitch) * row, a.GetRowSize(mip)) != 0)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+ENGINE_TEST(LayoutMatchesCopyableFootprints)
+{
+  // 行は 256 バイト, 各レベルの先頭は 512 バイト単位に揃う.
+  DecodedImage image;
+  const size_t size = image.Layout(37, 5, 0);
+  ENGINE_CHECK(image.GetMipLevelCount() == 6);
+  for (const auto& level : image.mipLevels)
+  {
+    ENGINE_CHECK(level.rowPitch % DecodedImage::RowPitchAlignment == 0);
+    ENGINE_CHECK(level.offset % DecodedImage::PlacementAlignment == 0);
+    ENGINE_CHECK(level.offset + size_t(level.rowPitch) * level.rowCount <= size);
+  }
+  ENGINE_CHECK(image.mipLevels.back().width == 1 && image.mipLevels.back().height == 1);
+}
+
+ENGINE_TEST(PngRoundTrip)
+{
+  // 奇数の大きさでも行の差分フィルタと Deflate を通して元に戻る.
+  for (auto [width, height] : { std::pair{ 1u, 1u }, std::pair{ 37u, 19u }, std::pair{ 300u, 7u } })
+  {
+    auto image = MakeNoiseImage(width, height, 1, width * 31 + height);
+    std::vector<uint8_t> encoded;
+    ENGINE_CHECK(EncodePNG(image, encoded));
+    DecodedImage decoded;
+    ENGINE_CHECK(DecodeImage(encoded.data(), encoded.size(), decoded));
+    ENGINE_CHECK(decoded.GetWidth() == width && decoded.GetHeight() == height);
+    ENGINE_CHECK(IsSameLevel(image, decoded, 0));
+  }
+}
+
+ENGINE_TEST(DdsRoundTrip)
+{
+  // ミップマップと sRGB の指定を含めて読み戻せる.
+  auto image = MakeNoiseImage(64, 24, 0, 7);
+  image.srgb = true;
+  std::vector<uint8_t> encoded;
+  ENGINE_CHECK(EncodeDDS(image, encoded));
+  ENGINE_CHECK(IsDDS(encoded.data(), encoded.size()));
+
+  ImageInfo info;
+  ENGINE_CHECK(ReadImageInfo(encoded.data(), encoded.size(), info));
+  ENGINE_CHECK(info.width == 64 && info.height == 24 && info.mipCount == image.GetMipLevelCount() && info.srgb);
+
+  DecodedImage decoded;
+  ENGINE_CHECK(DecodeImage(encoded.data(), encoded.size(), decoded));
+  ENGINE_CHECK(decoded.GetMipLevelCount() == image.GetMipLevelCount() && decoded.srgb);
+  for (uint32_t mip = 0; mip < image.GetMipLevelCount(); ++mip)
+  {
+    ENGINE_CHECK(IsSameLevel(image, decoded, mip));
+  }
+}
+
+ENGINE_TEST(DdsHeaderOnlyWriter)
+{
+  // EncodeDDSHeader の後ろに画素を並べたものは、そのまま読める RGBA8 の DDS になる.
+  auto image = MakeNoiseImage(13, 9, 1, 3);
+  std::vector<uint8_t> file;
+  const size_t dataOffset = EncodeDDSHeader(13, 9, false, file);
+  ENGINE_CHECK(dataOffset == file.size());
+  for (uint32_t y = 0; y < 9; ++y)
+  {
+    const uint8_t* row = image.GetLevelData(0) + size_t(image.mipLevels[0].rowPitch) * y;
+    file.insert(file.end(), row, row + 13 * 4);
+  }
+  ImageInfo info;
+  size_t readOffset = 0;
+  ENGINE_CHECK(ReadDDSPixelDataOffset(file.data(), file.size(), info, readOffset));
+  ENGINE_CHECK(readOffset == dataOffset && info.width == 13 && info.height == 9 && !info.srgb);
+  DecodedImage decoded;
+  ENGINE_CHECK(DecodeImage(file.data(), file.size(), decoded));
+  ENGINE_CHECK(IsSameLevel(image, decoded, 0));
+}
+
+ENGINE_TEST(RejectsTruncatedFiles)
+{
+  auto image = MakeNoiseImage(16, 16, 1, 5);
+  std::vector<uint8_t> encoded;
+  ENGINE_CHECK(EncodeDDS(image, encoded));
+  DecodedImage decoded;
+  ENGINE_CHECK(!DecodeImage(encoded.data(), encoded.size() / 2, decoded));
+  ENGINE_CHECK(!DecodeImage(encoded.data(), 16, decoded));
+}
+
+ENGINE_TEST(ClampsMipCountToFullChain)
+{
+  // 4x4 の画像が 10 レベルあると主張するヘッダでも、1x1 までの 3 レベルだけを読む.
+  auto image = MakeNoiseImage(4, 4, 3, 6);
+  std::vector<uint8_t> encoded;
+  ENGINE_CHECK(EncodeDDS(image, encoded));
+  // マジックナンバーの後ろの mipMapCount. 後ろに余分なデータを付けてサイズの検査では弾かれないようにする.
+  const uint32_t mipMapCount = 10;
+  memcpy(encoded.data() + 4 + 24, &mipMapCount, sizeof(mipMapCount));
+  encoded.resize(encoded.size() + 1024, 0);
+  ImageInfo info;
+  ENGINE_CHECK(ReadDDSInfo(encoded.data(), encoded.size(), info));
+  ENGINE_CHECK(info.mipCount == 3);
+  DecodedImage decoded;
+  ENGINE_CHECK(DecodeImage(encoded.data(), encoded.size(), decoded));
+  ENGINE_CHECK(decoded.GetMipLevelCount() == 3);
+  for (uint32_t mip = 0; mip < image.GetMipLevelCount(); ++mip)
+  {
+    ENGINE_CHECK(IsSameLevel(image, decoded, mip));
+  }
+}
+
+ENGINE_TEST(FileLoaderReadsWholeFile)
+{
+  const std::filesystem::path path = "FileLoaderTest.bin";
+  std::vector<char> written(100000);
+  for (size_t i = 0; i < written.size(); ++i)
+  {
+    written[i] = char(i * 7);
+  }
+  std::ofstream(path, std::ios::binary).write(written.data(), written.size());
+
+  std::vector<char> loaded;
+  ENGINE_CHECK(GetFileLoader()->Load(path, loaded));
+  ENGINE_CHECK(loaded == written);
+  ENGINE_CHECK(!GetFileLoader()->Load("DoesNotExist.bin", loaded));
+  std::filesystem::remove(path);
+}
@@ -0,0 +1,377 @@
+﻿#include "EngineTest.h"
+#include "ImageFilter.h"
+#include "ImageFilterCpu.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <string>
+
+namespace
+{
+  // チェインのノードを1つずつ、シェーダー(ImageFilterCommon.hlsli, ComputeShader.hlsl, SeparableBlur.hlsl)の
+  // 定義どおりに double で適用する基準の実装. パスへのまとめや演算の入れ替えは行わない.
+  struct ReferenceImage
+  {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<double> texels;  // RGBA の順に並べる.
+
+    double& At(int x, int y, uint32_t c) { return texels[(size_t(y) * width + x) * 4 + c]; }
+    double Clamped(int x, int y, uint32_t c) const
+    {
+      x = std::clamp(x, 0, int(width) - 1);
+      y = std::clamp(y, 0, int(height) - 1);
+      return texels[(size_t(y) * width + x) * 4 + c];
+    }
+  };
+
+  double Frac(double v) { return v - std::floor(v); }
+
+  void ApplyHueShift(double rgb[3], double shift)
+  {
+    // rgb2hsv.
+    const double s1 = rgb[1] >= rgb[2] ? 1.0 : 0.0;
+    const double p[4] = {
+      rgb[2] + (rgb[1] - rgb[2]) * s1, rgb[1] + (rgb[2] - rgb[1]) * s1,
+      -1.0 + s1, 2.0 / 3.0 + (-1.0 / 3.0 - 2.0 / 3.0) * s1,
+    };
+    const double s2 = rgb[0] >= p[0] ? 1.0 : 0.0;
+    const double q[4] = { p[0] + (rgb[0] - p[0]) * s2, p[1], p[3] + (p[2] - p[3]) * s2, rgb[0] + (p[0] - rgb[0]) * s2 };
+    const double d = q[0] - std::min(q[3], q[1]);
+    const double e = 1.0e-10;
+    const double h = Frac(std::fabs(q[2] + (q[3] - q[1]) / (6.0 * d + e)) + shift);
+    const double s = d / (q[0] + e);
+    const double v = q[0];
+    // hsv2rgb.
+    const double offsets[3] = { 1.0, 2.0 / 3.0, 1.0 / 3.0 };
+    for (int c = 0; c < 3; ++c)
+    {
+      const double k = std::fabs(Frac(h + offsets[c]) * 6.0 - 3.0);
+      rgb[c] = v * (1.0 + (std::clamp(k - 1.0, 0.0, 1.0) - 1.0) * s);
+    }
+  }
+
+  void ApplyPerPixelNode(const ImageFilterNode& node, ReferenceImage& image)
+  {
+    for (size_t i = 0; i < image.texels.size(); i += 4)
+    {
+      double* rgb = &image.texels[i];
+      switch (node.type)
+      {
+      case ImageFilterType::Sepia:
+        {
+          const double sepia[9] = { 0.393, 0.769, 0.189, 0.349, 0.686, 0.168, 0.272, 0.534, 0.131 };
+          const double strength = node.params[0];
+          double result[3];
+          for (int row = 0; row < 3; ++row)
+          {
+            const double toned = sepia[row * 3 + 0] * rgb[0] + sepia[row * 3 + 1] * rgb[1] + sepia[row * 3 + 2] * rgb[2];
+            result[row] = rgb[row] + (toned - rgb[row]) * strength;
+          }
+          std::copy(result, result + 3, rgb);
+        }
+        break;
+      case ImageFilterType::HueShift:
+        ApplyHueShift(rgb, node.params[0]);
+        break;
+      case ImageFilterType::ColorMatrix:
+        {
+          const float* m = node.matrix;
+          double result[3];
+          for (int row = 0; row < 3; ++row)
+          {
+            result[row] = m[row * 4] * rgb[0] + m[row * 4 + 1] * rgb[1] + m[row * 4 + 2] * rgb[2] + m[row * 4 + 3];
+          }
+          std::copy(result, result + 3, rgb);
+        }
+        break;
+      case ImageFilterType::ToneMap:
+        for (int c = 0; c < 3; ++c)
+        {
+          const double x = std::max(rgb[c] * std::exp2(double(node.params[0])), 0.0);
+          rgb[c] = node.params[1] >= 0.5f
+            ? std::clamp(x * (2.51 * x + 0.03) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0)
+            : x / (1.0 + x);
+        }
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  void ApplyBlurNode(const ImageFilterNode& node, ReferenceImage& image)
+  {
+    const int radius = std::min(int(std::round(node.params[0])), int(ImageFilterMaxBlurRadius));
+    const double sigma = std::max(node.params[1], 0.0f);
+    std::vector<double> weights;
+    double total = 0.0;
+    for (int d = -radius; d <= radius; ++d)
+    {
+      weights.push_back(sigma > 0.0 ? std::exp(-double(d * d) / (2.0 * sigma * sigma)) : 1.0);
+      total += weights.back();
+    }
+    // 水平、垂直の順に適用する. 端の外側は端の画素を繰り返す.
+    for (int axis = 0; axis < 2; ++axis)
+    {
+      ReferenceImage source = image;
+      for (int y = 0; y < int(image.height); ++y)
+      {
+        for (int x = 0; x < int(image.width); ++x)
+        {
+          for (uint32_t c = 0; c < 4; ++c)
+          {
+            double sum = 0.0;
+            for (int d = -radius; d <= radius; ++d)
+            {
+              sum += weights[d + radius] * (axis == 0 ? source.Clamped(x + d, y, c) : source.Clamped(x, y + d, c));
+            }
+            image.At(x, y, c) = sum / total;
+          }
+        }
+      }
+    }
+  }
+
+  void ApplySharpenNode(const ImageFilterNode& node, ReferenceImage& image)
+  {
+    const double amount = node.params[0];
+    const ReferenceImage source = image;
+    for (int y = 0; y < int(image.height); ++y)
+    {
+      for (int x = 0; x < int(image.width); ++x)
+      {
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+          const double center = source.Clamped(x, y, c);
+          const double neighbors = source.Clamped(x - 1, y, c) + source.Clamped(x + 1, y, c) + source.Clamped(x, y - 1, c) + source.Clamped(x, y + 1, c);
+          image.At(x, y, c) = center + amount * (4.0 * center - neighbors);
+        }
+      }
+    }
+  }
+
+  ReferenceImage ApplyReferenceChain(const std::vector<ImageFilterNode>& chain, ReferenceImage image)
+  {
+    for (const auto& node : chain)
+    {
+      if (node.type == ImageFilterType::Blur)
+      {
+        ApplyBlurNode(node, image);
+      }
+      else if (node.type == ImageFilterType::Sharpen)
+      {
+        ApplySharpenNode(node, image);
+      }
+      else
+      {
+        ApplyPerPixelNode(node, image);
+      }
+    }
+    return image;
+  }
+
+  std::vector<ImageFilterNode> ParseChain(const std::string& text)
+  {
+    std::vector<ImageFilterNode> chain;
+    ENGINE_CHECK(ParseImageFilterChain(text, chain));
+    return chain;
+  }
+
+  // 滑らかなグラデーションにノイズを加えた [0, 1] の画像. 幅は SIMD の幅で割り切れない大きさにする.
+  std::vector<float> MakeTestPixels(uint32_t width, uint32_t height, uint32_t seed)
+  {
+    std::vector<float> pixels(size_t(width) * height * 4);
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> noise(-0.1f, 0.1f);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+      for (uint32_t x = 0; x < width; ++x)
+      {
+        float* texel = &pixels[(size_t(y) * width + x) * 4];
+        texel[0] = float(x) / width;
+        texel[1] = float(y) / height;
+        texel[2] = 0.5f + 0.4f * std::sin(float(x + y) * 0.2f);
+        texel[3] = 0.75f;
+        for (int c = 0; c < 4; ++c)
+        {
+          texel[c] = std::clamp(texel[c] + noise(random), 0.0f, 1.0f);
+        }
+      }
+    }
+    return pixels;
+  }
+
+  std::vector<uint8_t> ToUnorm8(const std::vector<float>& pixels)
+  {
+    std::vector<uint8_t> bytes(pixels.size());
+    for (size_t i = 0; i < pixels.size(); ++i)
+    {
+      bytes[i] = uint8_t(std::lrint(std::clamp(pixels[i], 0.0f, 1.0f) * 255.0f));
+    }
+    return bytes;
+  }
+
+  ImageFilterSurface MakeSurface(std::vector<float>& pixels, uint32_t width, uint32_t height)
+  {
+    return ImageFilterSurface{
+      .format = ImageFilterPixelFormat::RGBA32F,
+      .width = width,
+      .height = height,
+      .rowPitch = size_t(width) * 16,
+      .data = reinterpret_cast<uint8_t*>(pixels.data()),
+    };
+  }
+
+  ImageFilterSurface MakeSurface(std::vector<uint8_t>& pixels, uint32_t width, uint32_t height)
+  {
+    return ImageFilterSurface{
+      .format = ImageFilterPixelFormat::RGBA8,
+      .width = width,
+      .height = height,
+      .rowPitch = size_t(width) * 4,
+      .data = pixels.data(),
+    };
+  }
+
+  std::vector<float> ExecuteFloat(const std::string& text, const ImageFilterPlanOptions& options,
+    std::vector<float> source, uint32_t width, uint32_t height, uint32_t maxThreadCount = 0)
+  {
+    auto plan = PlanImageFilterChain(ParseChain(text), options);
+    BakeImageFilterColorLuts(plan);
+    std::vector<float> destination(source.size());
+    ExecuteImageFilterPlanCpu(plan, MakeSurface(source, width, height), MakeSurface(destination, width, height), maxThreadCount);
+    return destination;
+  }
+
+  ReferenceImage MakeReferenceImage(const std::vector<float>& pixels, uint32_t width, uint32_t height)
+  {
+    return ReferenceImage{ .width = width, .height = height, .texels = std::vector<double>(pixels.begin(), pixels.end()) };
+  }
+
+  double GetMaxError(const std::vector<float>& result, const ReferenceImage& expected)
+  {
+    double maxError = 0.0;
+    for (size_t i = 0; i < result.size(); ++i)
+    {
+      maxError = std::max(maxError, std::fabs(result[i] - expected.texels[i]));
+    }
+    return maxError;
+  }
+
+  const uint32_t TestWidth = 83;
+  const uint32_t TestHeight = 70;
+
+  // 1画素の演算とカーネルを組み合わせたチェイン. パスへのまとめ方や演算の入れ替えが結果を変えないことも確かめる.
+  const char* const TestChains[] = {
+    "sepia",
+    "sepia:0.4",
+    "hue:0.3",
+    "hue:0.7,hue:0.6",
+    "matrix:0.1:1.3:0.8",
+    "tonemap:0.5:0",
+    "tonemap:1:1",
+    "blur:3:0",
+    "blur:5:2",
+    "blur:64:20",
+    "sharpen:0.5",
+    "matrix:0.05:1.2:1.1,blur:4:1.5,sharpen:0.3,hue:0.25",
+    "sepia,blur:2,tonemap:0.3:1,blur:3:0,matrix:-0.1:0.9:1.4",
+  };
+}
+
+ENGINE_TEST(FloatMatchesReference)
+{
+  const auto source = MakeTestPixels(TestWidth, TestHeight, 1);
+  const auto reference = MakeReferenceImage(source, TestWidth, TestHeight);
+  for (const char* text : TestChains)
+  {
+    const auto expected = ApplyReferenceChain(ParseChain(text), reference);
+    for (bool transposedBlur : { false, true })
+    {
+      const auto result = ExecuteFloat(text, { .transposedBlur = transposedBlur }, source, TestWidth, TestHeight);
+      ENGINE_CHECK(GetMaxError(result, expected) < 1.0e-4);
+    }
+  }
+}
+
+ENGINE_TEST(Rgba8MatchesReferenceWithinOneStep)
+{
+  // 入力は UNORM に量子化したものを基準にも与える. 出力の丸めは計算順の差で1段ずれることがある.
+  const auto bytes = ToUnorm8(MakeTestPixels(TestWidth, TestHeight, 2));
+  std::vector<float> quantized(bytes.size());
+  std::transform(bytes.begin(), bytes.end(), quantized.begin(), [](uint8_t v) { return v / 255.0f; });
+  const auto reference = MakeReferenceImage(quantized, TestWidth, TestHeight);
+  for (const char* text : TestChains)
+  {
+    const auto expected = ApplyReferenceChain(ParseChain(text), reference);
+    for (bool transposedBlur : { false, true })
+    {
+      auto plan = PlanImageFilterChain(ParseChain(text), { .transposedBlur = transposedBlur });
+      auto source = bytes;
+      std::vector<uint8_t> destination(bytes.size());
+      ExecuteImageFilterPlanCpu(plan, MakeSurface(source, TestWidth, TestHeight), MakeSurface(destination, TestWidth, TestHeight));
+      int maxError = 0;
+      for (size_t i = 0; i < destination.size(); ++i)
+      {
+        const int expectedValue = int(std::lrint(std::clamp(expected.texels[i], 0.0, 1.0) * 255.0));
+        maxError = std::max(maxError, std::abs(int(destination[i]) - expectedValue));
+      }
+      ENGINE_CHECK(maxError <= 1);
+    }
+  }
+}
+
+ENGINE_TEST(ThreadCountDoesNotChangeResult)
+{
+  // 行のタイル分けだけが変わるため、スレッド数によらず同じビット列になる.
+  EngineTest::ScopedJobSystem jobSystem(3);
+  const auto source = MakeTestPixels(TestWidth, TestHeight, 3);
+  for (const char* text : TestChains)
+  {
+    for (bool transposedBlur : { false, true })
+    {
+      const ImageFilterPlanOptions options = { .transposedBlur = transposedBlur, .colorLutSize = 32 };
+      const auto serial = ExecuteFloat(text, options, source, TestWidth, TestHeight, 1);
+      for (uint32_t threadCount : { 2u, 4u })
+      {
+        const auto parallel = ExecuteFloat(text, options, source, TestWidth, TestHeight, threadCount);
+        ENGINE_CHECK(std::memcmp(serial.data(), parallel.data(), serial.size() * sizeof(float)) == 0);
+      }
+    }
+  }
+}
+
+ENGINE_TEST(InPlaceMatchesSeparateDestination)
+{
+  const auto source = MakeTestPixels(TestWidth, TestHeight, 4);
+  for (const char* text : TestChains)
+  {
+    const auto separate = ExecuteFloat(text, { }, source, TestWidth, TestHeight);
+    auto plan = PlanImageFilterChain(ParseChain(text));
+    auto pixels = source;
+    const auto surface = MakeSurface(pixels, TestWidth, TestHeight);
+    ExecuteImageFilterPlanCpu(plan, surface, surface);
+    ENGINE_CHECK(std::memcmp(separate.data(), pixels.data(), pixels.size() * sizeof(float)) == 0);
+  }
+}
+
+ENGINE_TEST(ColorLutApproximatesOps)
+{
+  // 三線形補間の誤差の分だけずれる(色相シフトは折れ線のため誤差が大きい). 大きい LUT ほど演算を順に適用した結果に近い.
+  const auto source = MakeTestPixels(TestWidth, TestHeight, 5);
+  const char* const chains[] = { "sepia,hue:0.3,tonemap:0.5:0", "blur:2,hue:0.6,tonemap:1:1", "hue:0.2,sepia:0.5,hue:0.4" };
+  for (const char* text : chains)
+  {
+    const auto expected = MakeReferenceImage(ExecuteFloat(text, { }, source, TestWidth, TestHeight), TestWidth, TestHeight);
+    const auto lut32 = ExecuteFloat(text, { .colorLutSize = 32 }, source, TestWidth, TestHeight);
+    const auto lut64 = ExecuteFloat(text, { .colorLutSize = 64 }, source, TestWidth, TestHeight);
+    const double error32 = GetMaxError(lut32, expected);
+    const double error64 = GetMaxError(lut64, expected);
+    ENGINE_CHECK(error32 > 0.0);
+    ENGINE_CHECK(error32 < 0.05);
+    ENGINE_CHECK(error64 <= error32);
+  }
+}
@@ -0,0 +1,120 @@
+﻿#include "EngineTest.h"
+#include "ImageFilter.h"
+#include "ImageFilterCpu.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+
+namespace
+{
+  std::vector<ImageFilterNode> RepeatChain(const std::string& text, uint32_t count)
+  {
+    std::string repeated;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      repeated += (i > 0 ? "," : "") + text;
+    }
+    std::vector<ImageFilterNode> chain;
+    ParseImageFilterChain(repeated, chain);
+    return chain;
+  }
+
+  uint32_t CountColorLutPasses(const ImageFilterPlan& plan)
+  {
+    return uint32_t(std::count_if(plan.passes.begin(), plan.passes.end(), [](const ImageFilterPass& pass) { return pass.colorLut >= 0; }));
+  }
+
+  // 入力は LUT の対象になる [0, 1] の値.
+  std::vector<float> MakeNoisePixels(uint32_t width, uint32_t height, uint32_t seed)
+  {
+    std::vector<float> pixels(size_t(width) * height * 4);
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    for (auto& value : pixels)
+    {
+      value = distribution(random);
+    }
+    return pixels;
+  }
+
+  ImageFilterSurface MakeSurface(std::vector<float>& pixels, uint32_t width, uint32_t height)
+  {
+    return ImageFilterSurface{
+      .format = ImageFilterPixelFormat::RGBA32F,
+      .width = width,
+      .height = height,
+      .rowPitch = size_t(width) * 16,
+      .data = reinterpret_cast<uint8_t*>(pixels.data()),
+    };
+  }
+}
+
+ENGINE_TEST(ColorLutBakesEveryEligiblePass)
+{
+  // ぼかしは範囲を保ち、トーンマップの結果は [0, 1] に収まるため、どのパスも LUT の対象になる.
+  const auto chain = RepeatChain("blur:1,hue:0.1,tonemap", 4);
+  const auto plan = PlanImageFilterChain(chain, { .colorLutSize = 32 });
+  ENGINE_CHECK(plan.colorLutSize == 32);
+  ENGINE_CHECK(plan.colorLutCount == 4);
+  ENGINE_CHECK(CountColorLutPasses(plan) == 4);
+}
+
+ENGINE_TEST(ColorLutCountFitsTextureDepth)
+{
+  const auto chain = RepeatChain("blur:1,hue:0.1,tonemap", 80);
+  for (uint32_t size : { 32u, 64u })
+  {
+    const auto plan = PlanImageFilterChain(chain, { .colorLutSize = size });
+    const uint32_t expectedCount = std::min(80u, ImageFilterMaxColorLutDepth / size);
+    ENGINE_CHECK(plan.colorLutCount == expectedCount);
+    ENGINE_CHECK(plan.colorLutSize * plan.colorLutCount <= ImageFilterMaxColorLutDepth);
+    ENGINE_CHECK(CountColorLutPasses(plan) == plan.colorLutCount);
+
+    // LUT の番号は先頭のパスから連番で、上限を超えた分は演算を順に適用する.
+    int32_t nextColorLut = 0;
+    for (const auto& pass : plan.passes)
+    {
+      if (pass.colorLut >= 0)
+      {
+        ENGINE_CHECK(pass.colorLut == nextColorLut);
+        nextColorLut++;
+      }
+      else if (pass.opCount > 0)
+      {
+        ENGINE_CHECK(nextColorLut == int32_t(plan.colorLutCount));
+      }
+    }
+  }
+
+  // 1つの LUT も収まらない大きさでは LUT を使わない.
+  const auto plan = PlanImageFilterChain(chain, { .colorLutSize = ImageFilterMaxColorLutDepth * 2 });
+  ENGINE_CHECK(plan.colorLutCount == 0);
+  ENGINE_CHECK(plan.colorLutSize == 0);
+}
+
+ENGINE_TEST(ColorLutCapKeepsResult)
+{
+  // 上限で LUT から外れたパスも、全て演算で実行した結果と LUT の誤差の範囲で一致する.
+  const auto chain = RepeatChain("blur:1,hue:0.1,tonemap", 40);
+  auto lutPlan = PlanImageFilterChain(chain, { .colorLutSize = 64 });
+  ENGINE_CHECK(lutPlan.colorLutCount == ImageFilterMaxColorLutDepth / 64);
+  ENGINE_CHECK(CountColorLutPasses(lutPlan) < 40);
+  BakeImageFilterColorLuts(lutPlan);
+  ENGINE_CHECK(lutPlan.colorLutTexels.size() == size_t(64) * 64 * 64 * 4 * lutPlan.colorLutCount);
+  const auto opPlan = PlanImageFilterChain(chain);
+
+  const uint32_t width = 24, height = 16;
+  const auto source = MakeNoisePixels(width, height, 7);
+  auto lutPixels = source;
+  auto opPixels = source;
+  ExecuteImageFilterPlanCpu(lutPlan, MakeSurface(lutPixels, width, height), MakeSurface(lutPixels, width, height), 1);
+  ExecuteImageFilterPlanCpu(opPlan, MakeSurface(opPixels, width, height), MakeSurface(opPixels, width, height), 1);
+  float maxError = 0.0f;
+  for (size_t i = 0; i < lutPixels.size(); ++i)
+  {
+    maxError = std::max(maxError, std::abs(lutPixels[i] - opPixels[i]));
+  }
+  ENGINE_CHECK(maxError < 0.02f);
+}
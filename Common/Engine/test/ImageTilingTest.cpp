@@ -0,0 +1,201 @@
+﻿#include "EngineTest.h"
+#include "DdsFile.h"
+#include "ImageTiling.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string>
+
+namespace
+{
+  ImageFilterPlan MakePlan(const std::string& text, const ImageFilterPlanOptions& options = {})
+  {
+    std::vector<ImageFilterNode> chain;
+    ENGINE_CHECK(ParseImageFilterChain(text, chain));
+    auto plan = PlanImageFilterChain(chain, options);
+    BakeImageFilterColorLuts(plan);
+    return plan;
+  }
+
+  std::vector<uint8_t> MakeNoisePixels(uint32_t width, uint32_t height, uint32_t seed)
+  {
+    std::vector<uint8_t> pixels(size_t(width) * height * 4);
+    std::mt19937 random(seed);
+    for (auto& value : pixels)
+    {
+      value = uint8_t(random());
+    }
+    return pixels;
+  }
+
+  ImageFilterSurface MakeSurface(std::vector<uint8_t>& pixels, uint32_t width, uint32_t height)
+  {
+    return ImageFilterSurface{
+      .format = ImageFilterPixelFormat::RGBA8,
+      .width = width,
+      .height = height,
+      .rowPitch = size_t(width) * 4,
+      .data = pixels.data(),
+    };
+  }
+
+  const uint32_t TestSizes[][2] = { { 201, 127 }, { 40, 300 }, { 5, 7 } };
+  const uint32_t TestTileSizes[] = { 16, 37, 4096 };
+}
+
+ENGINE_TEST(ApronAddsNeighborhoodPerAxis)
+{
+  for (bool transposedBlur : { false, true })
+  {
+    const ImageFilterPlanOptions options = { .transposedBlur = transposedBlur };
+    const auto blur = GetImageFilterPlanApron(MakePlan("blur:5", options));
+    ENGINE_CHECK(blur.x == 5 && blur.y == 5);
+    const auto chained = GetImageFilterPlanApron(MakePlan("blur:3,matrix:0.1:1.3:0.8,blur:7,hue:0.2", options));
+    ENGINE_CHECK(chained.x == 10 && chained.y == 10);
+    const auto sharpen = GetImageFilterPlanApron(MakePlan("sharpen:0.5,sharpen:0.5,tonemap", options));
+    ENGINE_CHECK(sharpen.x == 2 && sharpen.y == 2);
+    // 半径は ImageFilterMaxBlurRadius までに制限される.
+    const auto clamped = GetImageFilterPlanApron(MakePlan("blur:100", options));
+    ENGINE_CHECK(clamped.x == ImageFilterMaxBlurRadius && clamped.y == ImageFilterMaxBlurRadius);
+  }
+  const auto perPixel = GetImageFilterPlanApron(MakePlan("sepia,hue:0.2,tonemap"));
+  ENGINE_CHECK(perPixel.x == 0 && perPixel.y == 0);
+}
+
+ENGINE_TEST(TilesCoverImageExactlyOnce)
+{
+  const ImageFilterApron aprons[] = { { 0, 0 }, { 1, 1 }, { 10, 3 }, { 64, 64 } };
+  for (const auto& size : TestSizes)
+  {
+    const uint32_t width = size[0];
+    const uint32_t height = size[1];
+    for (uint32_t tileSize : TestTileSizes)
+    {
+      for (const auto& apron : aprons)
+      {
+        const auto tiles = MakeImageTiles(width, height, tileSize, apron);
+        ENGINE_CHECK(!tiles.empty());
+        std::vector<uint32_t> coverage(size_t(width) * height, 0);
+        for (const auto& tile : tiles)
+        {
+          // 読み込み範囲は全タイルで同じ大きさで、画像の内側に収まり、書き出す範囲とエプロンを含む.
+          ENGINE_CHECK(tile.inputWidth == tiles[0].inputWidth && tile.inputHeight == tiles[0].inputHeight);
+          ENGINE_CHECK(tile.inputWidth == std::min(width, tileSize + apron.x * 2));
+          ENGINE_CHECK(tile.inputHeight == std::min(height, tileSize + apron.y * 2));
+          ENGINE_CHECK(tile.inputX + tile.inputWidth <= width && tile.inputY + tile.inputHeight <= height);
+          ENGINE_CHECK(tile.inputX <= tile.x - std::min(tile.x, apron.x));
+          ENGINE_CHECK(tile.inputY <= tile.y - std::min(tile.y, apron.y));
+          ENGINE_CHECK(tile.inputX + tile.inputWidth >= std::min(width, tile.x + tile.width + apron.x));
+          ENGINE_CHECK(tile.inputY + tile.inputHeight >= std::min(height, tile.y + tile.height + apron.y));
+          for (uint32_t y = tile.y; y < tile.y + tile.height; ++y)
+          {
+            for (uint32_t x = tile.x; x < tile.x + tile.width; ++x)
+            {
+              coverage[size_t(y) * width + x]++;
+            }
+          }
+        }
+        ENGINE_CHECK(std::all_of(coverage.begin(), coverage.end(), [](uint32_t count) { return count == 1; }));
+      }
+    }
+  }
+}
+
+ENGINE_TEST(TiledMatchesWholeImage)
+{
+  // 読み込み範囲の端でのクランプが画像全体と同じ位置で起こるため、タイルの大きさによらずビット単位で一致する.
+  EngineTest::ScopedJobSystem jobSystem(3);
+  const char* const chains[] = {
+    "blur:5,sharpen:1.0,sepia",
+    "blur:3,matrix:0.1:1.3:0.8,blur:7,hue:0.2",
+    "sharpen:0.5,sharpen:0.5,tonemap",
+    "blur:64",
+  };
+  const ImageFilterPlanOptions optionSets[] = { { }, { .transposedBlur = true }, { .colorLutSize = 32 } };
+  uint32_t seed = 0;
+  for (const char* text : chains)
+  {
+    for (const auto& options : optionSets)
+    {
+      const auto plan = MakePlan(text, options);
+      for (const auto& size : TestSizes)
+      {
+        const uint32_t width = size[0];
+        const uint32_t height = size[1];
+        auto source = MakeNoisePixels(width, height, ++seed);
+        std::vector<uint8_t> expected(source.size());
+        ExecuteImageFilterPlanCpu(plan, MakeSurface(source, width, height), MakeSurface(expected, width, height));
+        for (uint32_t tileSize : TestTileSizes)
+        {
+          std::vector<uint8_t> result(source.size(), 0);
+          ImageTilingStats stats;
+          ENGINE_CHECK(ExecuteImageFilterPlanTiledCpu(plan, width, height, tileSize,
+            MakeSurfaceTileReader(MakeSurface(source, width, height)), MakeSurfaceTileWriter(MakeSurface(result, width, height)), 0, &stats));
+          ENGINE_CHECK(result == expected);
+          ENGINE_CHECK(stats.tileCount == MakeImageTiles(width, height, tileSize, GetImageFilterPlanApron(plan)).size());
+          ENGINE_CHECK(stats.pixelCount == uint64_t(width) * height);
+          ENGINE_CHECK(stats.inputPixelCount >= stats.pixelCount);
+        }
+      }
+    }
+  }
+}
+
+ENGINE_TEST(TiledStopsWhenReadFails)
+{
+  const uint32_t width = 100;
+  const uint32_t height = 100;
+  const auto plan = MakePlan("blur:2");
+  auto source = MakeNoisePixels(width, height, 1);
+  std::vector<uint8_t> result(source.size());
+  const auto read = MakeSurfaceTileReader(MakeSurface(source, width, height));
+  uint32_t readCount = 0;
+  const bool succeeded = ExecuteImageFilterPlanTiledCpu(plan, width, height, 16,
+    [&](const ImageTile& tile, const ImageFilterSurface& input) { return ++readCount < 3 && read(tile, input); },
+    MakeSurfaceTileWriter(MakeSurface(result, width, height)));
+  ENGINE_CHECK(!succeeded);
+  ENGINE_CHECK(readCount < MakeImageTiles(width, height, 16, GetImageFilterPlanApron(plan)).size());
+}
+
+ENGINE_TEST(DdsTileFileRoundTrip)
+{
+  // DDS ファイルからタイルずつ読み込んでフィルタを適用し、別の DDS ファイルへタイルずつ書き出す.
+  const uint32_t width = 333;
+  const uint32_t height = 222;
+  const std::filesystem::path inputPath = "ImageTilingTestInput.dds";
+  const std::filesystem::path outputPath = "ImageTilingTestOutput.dds";
+  auto source = MakeNoisePixels(width, height, 5);
+  {
+    std::vector<uint8_t> header;
+    EncodeDDSHeader(width, height, true, header);
+    std::ofstream file(inputPath, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    file.write(reinterpret_cast<const char*>(source.data()), source.size());
+  }
+
+  const auto plan = MakePlan("blur:4,sharpen:1");
+  std::vector<uint8_t> expected(source.size());
+  ExecuteImageFilterPlanCpu(plan, MakeSurface(source, width, height), MakeSurface(expected, width, height));
+  {
+    DdsTileFile input;
+    DdsTileFile output;
+    ENGINE_CHECK(input.OpenRead(inputPath));
+    ENGINE_CHECK(input.GetWidth() == width && input.GetHeight() == height && input.IsSrgb());
+    ENGINE_CHECK(output.Create(outputPath, width, height, input.IsSrgb()));
+    ENGINE_CHECK(ExecuteImageFilterPlanTiledCpu(plan, width, height, 50, input.MakeReader(), output.MakeWriter()));
+  }
+
+  std::ifstream file(outputPath, std::ios::binary);
+  std::vector<uint8_t> written((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  file.close();
+  ImageInfo info;
+  size_t dataOffset = 0;
+  ENGINE_CHECK(ReadDDSPixelDataOffset(written.data(), written.size(), info, dataOffset));
+  ENGINE_CHECK(info.width == width && info.height == height && info.srgb);
+  ENGINE_CHECK(written.size() == dataOffset + expected.size());
+  ENGINE_CHECK(written.size() >= dataOffset + expected.size() && std::memcmp(written.data() + dataOffset, expected.data(), expected.size()) == 0);
+
+  std::filesystem::remove(inputPath);
+  std::filesystem::remove(outputPath);
+}
@@ -0,0 +1,159 @@
+﻿#include "EngineTest.h"
+#include "JobSystem.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  // 各ジョブ番号が1回ずつ実行され、スレッド番号が範囲内であることを確かめる.
+  void CheckDispatch(JobSystem& jobSystem, uint32_t jobCount)
+  {
+    std::vector<std::atomic<uint32_t>> counts(jobCount);
+    std::atomic<uint32_t> badThreadIndex = 0;
+    jobSystem.Dispatch(jobCount, [&](uint32_t jobIndex, uint32_t threadIndex) {
+      counts[jobIndex].fetch_add(1, std::memory_order_relaxed);
+      if (threadIndex >= jobSystem.GetThreadCount())
+      {
+        badThreadIndex++;
+      }
+    });
+    bool allOnce = true;
+    for (auto& count : counts)
+    {
+      allOnce &= count.load() == 1;
+    }
+    ENGINE_CHECK(allOnce);
+    ENGINE_CHECK(badThreadIndex.load() == 0);
+  }
+}
+
+ENGINE_TEST(RunsInlineWithoutWorkers)
+{
+  // Initialize 前は呼び出したスレッドでその場で処理する.
+  JobSystem jobSystem;
+  ENGINE_CHECK(jobSystem.GetThreadCount() == 1);
+  CheckDispatch(jobSystem, 0);
+  CheckDispatch(jobSystem, 100);
+}
+
+ENGINE_TEST(EveryJobRunsOnce)
+{
+  for (uint32_t workerCount : { 1u, 3u, 7u })
+  {
+    JobSystem jobSystem;
+    jobSystem.Initialize(workerCount);
+    ENGINE_CHECK(jobSystem.GetThreadCount() == workerCount + 1);
+    for (uint32_t jobCount : { 1u, 2u, 7u, 64u, 1000u, 100000u })
+    {
+      CheckDispatch(jobSystem, jobCount);
+    }
+    ENGINE_CHECK(jobSystem.GetPendingJobCount() == 0);
+    jobSystem.Shutdown();
+  }
+}
+
+ENGINE_TEST(PendingCountNeverUnderflows)
+{
+  // 発行と奪取が重なっても、未取り出しのジョブ数は発行した数を超えない(負にならない).
+  JobSystem jobSystem;
+  jobSystem.Initialize(3);
+  const uint32_t jobCount = 64;
+  std::atomic<uint32_t> maxPending = 0;
+  for (uint32_t iteration = 0; iteration < 2000; ++iteration)
+  {
+    jobSystem.Dispatch(jobCount, [&](uint32_t, uint32_t) {
+      const auto pending = jobSystem.GetPendingJobCount();
+      auto current = maxPending.load();
+      while (pending > current && !maxPending.compare_exchange_weak(current, pending))
+      {
+      }
+    });
+  }
+  ENGINE_CHECK(maxPending.load() <= jobCount);
+  ENGINE_CHECK(jobSystem.GetPendingJobCount() == 0);
+}
+
+ENGINE_TEST(ConcurrentGroups)
+{
+  // 複数のグループを発行してから、発行と逆の順に待つ.
+  JobSystem jobSystem;
+  jobSystem.Initialize(3);
+  const uint32_t groupCount = 8;
+  const uint32_t jobCount = 500;
+  std::vector<std::unique_ptr<JobSystem::JobGroup>> groups;
+  std::vector<std::atomic<uint32_t>> sums(groupCount);
+  for (uint32_t g = 0; g < groupCount; ++g)
+  {
+    groups.push_back(std::make_unique<JobSystem::JobGroup>());
+    jobSystem.Run(*groups.back(), jobCount, [&sums, g](uint32_t jobIndex, uint32_t) {
+      sums[g].fetch_add(jobIndex + 1, std::memory_order_relaxed);
+    });
+  }
+  for (uint32_t g = groupCount; g-- > 0;)
+  {
+    jobSystem.Wait(*groups[g]);
+    ENGINE_CHECK(!groups[g]->IsBusy());
+    ENGINE_CHECK(sums[g].load() == jobCount * (jobCount + 1) / 2);
+  }
+}
+
+ENGINE_TEST(NestedDispatchFromWorkers)
+{
+  // ジョブの中から発行したジョブは、待っているワーカー自身や他のワーカーが処理して完了する.
+  JobSystem jobSystem;
+  jobSystem.Initialize(3);
+  std::atomic<uint32_t> innerCount = 0;
+  jobSystem.Dispatch(16, [&](uint32_t, uint32_t) {
+    jobSystem.Dispatch(32, [&](uint32_t, uint32_t) {
+      innerCount.fetch_add(1, std::memory_order_relaxed);
+    });
+  });
+  ENGINE_CHECK(innerCount.load() == 16 * 32);
+}
+
+ENGINE_TEST(DispatchToAnotherInstanceFromWorkers)
+{
+  // 別のインスタンスのワーカーから発行した場合は、ワーカー以外のスレッドからの発行として扱う.
+  // キューの少ないインスタンスへ発行しても、発行元のワーカー番号でキューを選ばない.
+  JobSystem outer;
+  outer.Initialize(7);
+  JobSystem inner;
+  inner.Initialize(1);
+  std::atomic<uint32_t> arrived = 0;
+  std::atomic<uint32_t> innerCount = 0;
+  std::atomic<uint32_t> badThreadIndex = 0;
+  // 全スレッドが揃うまで待たせ、outer の全ワーカーから inner へ発行させる.
+  outer.Dispatch(outer.GetThreadCount(), [&](uint32_t, uint32_t) {
+    arrived++;
+    while (arrived.load() < outer.GetThreadCount())
+    {
+      std::this_thread::yield();
+    }
+    inner.Dispatch(8, [&](uint32_t, uint32_t threadIndex) {
+      innerCount.fetch_add(1, std::memory_order_relaxed);
+      if (threadIndex >= inner.GetThreadCount())
+      {
+        badThreadIndex++;
+      }
+    });
+  });
+  ENGINE_CHECK(innerCount.load() == outer.GetThreadCount() * 8);
+  ENGINE_CHECK(badThreadIndex.load() == 0);
+}
+
+ENGINE_TEST(RestartAfterShutdown)
+{
+  JobSystem jobSystem;
+  for (int i = 0; i < 3; ++i)
+  {
+    jobSystem.Initialize(2);
+    CheckDispatch(jobSystem, 257);
+    jobSystem.Shutdown();
+    ENGINE_CHECK(jobSystem.GetThreadCount() == 1);
+  }
+  // 終了後は再びその場で処理する.
+  CheckDispatch(jobSystem, 10);
+}
@@ -0,0 +1,175 @@
+﻿#include "EngineTest.h"
+#include "MipGenerator.h"
+
+#include <cmath>
+#include <random>
+
+namespace
+{
+  // 行末に余白のある RGBA8 のノイズ画像.
+  std::vector<uint8_t> MakeNoisePixels(uint32_t width, uint32_t height, uint32_t pitch, uint32_t seed)
+  {
+    std::vector<uint8_t> pixels(size_t(pitch) * height);
+    std::mt19937 random(seed);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+      for (uint32_t x = 0; x < width * 4; ++x)
+      {
+        pixels[size_t(y) * pitch + x] = uint8_t(random());
+      }
+    }
+    return pixels;
+  }
+
+  double ComputeMean(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t pitch, uint32_t channel)
+  {
+    double sum = 0;
+    for (uint32_t y = 0; y < height; ++y)
+    {
+      for (uint32_t x = 0; x < width; ++x)
+      {
+        sum += pixels[size_t(y) * pitch + x * 4 + channel];
+      }
+    }
+    return sum / (double(width) * height);
+  }
+}
+
+ENGINE_TEST(SimdBoxFilterMatchesScalar)
+{
+  // SIMD は2ピクセルずつ処理するため、出力の幅が奇数のものや1のものも含める.
+  const uint32_t sizes[][2] = { { 2, 2 }, { 4, 2 }, { 6, 4 }, { 34, 10 }, { 130, 6 }, { 258, 64 }, { 512, 2 } };
+  for (const auto& size : sizes)
+  {
+    const uint32_t srcWidth = size[0], srcHeight = size[1];
+    const uint32_t dstWidth = srcWidth / 2, dstHeight = srcHeight / 2;
+    const uint32_t srcPitch = srcWidth * 4 + 12, dstPitch = dstWidth * 4 + 20;
+    const auto src = MakeNoisePixels(srcWidth, srcHeight, srcPitch, srcWidth);
+    std::vector<uint8_t> dst(size_t(dstPitch) * dstHeight, 0xcd);
+    DownsampleLevel(src.data(), srcWidth, srcHeight, srcPitch, dst.data(), dstWidth, dstHeight, dstPitch, false);
+
+    bool same = true;
+    for (uint32_t y = 0; y < dstHeight; ++y)
+    {
+      const uint8_t* row0 = src.data() + size_t(2 * y) * srcPitch;
+      const uint8_t* row1 = row0 + srcPitch;
+      const uint8_t* dstRow = dst.data() + size_t(y) * dstPitch;
+      for (uint32_t x = 0; x < dstWidth * 4; ++x)
+      {
+        const uint32_t i = (x / 4) * 8 + x % 4;
+        const uint32_t sum = row0[i] + row0[i + 4] + row1[i] + row1[i + 4];
+        same = same && dstRow[x] == uint8_t((sum + 2) / 4);
+      }
+      // 行末の余白には書き込まない.
+      for (uint32_t x = dstWidth * 4; x < dstPitch; ++x)
+      {
+        same = same && dstRow[x] == 0xcd;
+      }
+    }
+    ENGINE_CHECK(same);
+  }
+}
+
+ENGINE_TEST(OddSizesKeepAverage)
+{
+  // 奇数サイズの軸は3タップで元の全ピクセルを均等に使うため、平均は丸めの誤差以内で保たれる.
+  const uint32_t sizes[][2] = { { 3, 3 }, { 5, 4 }, { 4, 7 }, { 37, 21 }, { 1, 9 }, { 9, 1 } };
+  for (const auto& size : sizes)
+  {
+    const uint32_t srcWidth = size[0], srcHeight = size[1];
+    const uint32_t dstWidth = std::max(srcWidth / 2, 1u), dstHeight = std::max(srcHeight / 2, 1u);
+    const auto src = MakeNoisePixels(srcWidth, srcHeight, srcWidth * 4, srcHeight);
+    std::vector<uint8_t> dst(size_t(dstWidth) * dstHeight * 4);
+    DownsampleLevel(src.data(), srcWidth, srcHeight, srcWidth * 4, dst.data(), dstWidth, dstHeight, dstWidth * 4, false);
+    for (uint32_t c = 0; c < 4; ++c)
+    {
+      const double srcMean = ComputeMean(src.data(), srcWidth, srcHeight, srcWidth * 4, c);
+      const double dstMean = ComputeMean(dst.data(), dstWidth, dstHeight, dstWidth * 4, c);
+      ENGINE_CHECK(std::abs(srcMean - dstMean) <= 0.5);
+    }
+  }
+}
+
+ENGINE_TEST(NonSquareChainReachesOnePixel)
+{
+  // 短い軸が 1 になっても、長い軸が 1 になるまで縮小を続ける.
+  DecodedImage image;
+  image.Allocate(37, 5, 0);
+  ENGINE_CHECK(image.GetMipLevelCount() == 6);
+  std::mt19937 random(3);
+  for (uint32_t y = 0; y < 5; ++y)
+  {
+    for (uint32_t x = 0; x < 37 * 4; ++x)
+    {
+      image.GetLevelData(0)[size_t(y) * image.mipLevels[0].rowPitch + x] = uint8_t(random());
+    }
+  }
+  GenerateMipLevels(image, {});
+  const auto& last = image.mipLevels.back();
+  ENGINE_CHECK(last.width == 1 && last.height == 1);
+  for (uint32_t c = 0; c < 4; ++c)
+  {
+    const double srcMean = ComputeMean(image.GetLevelData(0), 37, 5, image.mipLevels[0].rowPitch, c);
+    // レベルごとに最大 0.5 の丸め誤差が積み重なる.
+    ENGINE_CHECK(std::abs(srcMean - image.GetLevelData(image.GetMipLevelCount() - 1)[c]) <= 0.5 * image.GetMipLevelCount());
+  }
+}
+
+ENGINE_TEST(SrgbAveragesInLinearSpace)
+{
+  // 黒と白の市松模様は線形空間で 0.5、sRGB で約 188 になる(sRGB のまま平均すると 128).
+  const uint8_t src[] = {
+    0, 0, 0, 255,        255, 255, 255, 255,
+    255, 255, 255, 255,  0, 0, 0, 255,
+  };
+  uint8_t dst[4] = { };
+  DownsampleLevel(src, 2, 2, 8, dst, 1, 1, 4, true);
+  ENGINE_CHECK(dst[0] == 188 && dst[1] == 188 && dst[2] == 188);
+  ENGINE_CHECK(dst[3] == 255);
+  DownsampleLevel(src, 2, 2, 8, dst, 1, 1, 4, false);
+  ENGINE_CHECK(dst[0] == 128);
+
+  // 一様な色は sRGB 指定でも変わらない.
+  std::vector<uint8_t> flat(5 * 3 * 4);
+  for (size_t i = 0; i < flat.size(); ++i)
+  {
+    flat[i] = uint8_t(i % 4 == 3 ? 200 : 60 + i % 4 * 40);
+  }
+  std::vector<uint8_t> flatDst(2 * 1 * 4);
+  DownsampleLevel(flat.data(), 5, 3, 20, flatDst.data(), 2, 1, 8, true);
+  ENGINE_CHECK(flatDst[0] == 60 && flatDst[1] == 100 && flatDst[2] == 140 && flatDst[3] == 200);
+  ENGINE_CHECK(flatDst[4] == 60 && flatDst[5] == 100 && flatDst[6] == 140 && flatDst[7] == 200);
+}
+
+ENGINE_TEST(AlphaCoveragePreserved)
+{
+  // 細かいノイズのアルファは平均すると閾値を下回り、そのままでは粗いレベルほど通過率が下がる.
+  DecodedImage image;
+  image.Allocate(64, 64, 0);
+  std::mt19937 random(5);
+  for (uint32_t y = 0; y < 64; ++y)
+  {
+    uint8_t* row = image.GetLevelData(0) + size_t(y) * image.mipLevels[0].rowPitch;
+    for (uint32_t x = 0; x < 64; ++x)
+    {
+      row[x * 4 + 3] = (random() % 100) < 30 ? 255 : 0;
+    }
+  }
+  const float cutoff = 0.5f;
+  const float coverage0 = ComputeAlphaCoverage(image.GetLevelData(0), 64, 64, image.mipLevels[0].rowPitch, cutoff);
+
+  DecodedImage plain = image;
+  GenerateMipLevels(plain, {});
+  GenerateMipLevels(image, { .preserveAlphaCoverage = true, .alphaCutoff = cutoff });
+  float plainError = 0, preservedError = 0;
+  for (uint32_t mip = 1; mip <= 3; ++mip)
+  {
+    const auto& level = image.mipLevels[mip];
+    const float preserved = ComputeAlphaCoverage(image.GetLevelData(mip), level.width, level.height, level.rowPitch, cutoff);
+    const float unpreserved = ComputeAlphaCoverage(plain.GetLevelData(mip), level.width, level.height, level.rowPitch, cutoff);
+    preservedError = std::max(preservedError, std::abs(preserved - coverage0));
+    plainError = std::max(plainError, std::abs(unpreserved - coverage0));
+  }
+  ENGINE_CHECK(preservedError < 0.1f);
+  ENGINE_CHECK(preservedError < plainError);
+}
@@ -0,0 +1,135 @@
+﻿#include "EngineTest.h"
+#include "PngFile.h"
+#include "TextureDecode.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <random>
+
+namespace
+{
+  std::vector<uint8_t> MakeNoisePng(uint32_t width, uint32_t height, uint32_t seed)
+  {
+    DecodedImage image;
+    image.Allocate(width, height, 1);
+    std::mt19937 random(seed);
+    for (auto& value : image.pixels)
+    {
+      value = uint8_t(random());
+    }
+    std::vector<uint8_t> buffer;
+    EncodePNG(image, buffer);
+    return buffer;
+  }
+
+  bool IsSameImage(const DecodedImage& a, const DecodedImage& b)
+  {
+    if (a.GetMipLevelCount() != b.GetMipLevelCount() || a.srgb != b.srgb)
+    {
+      return false;
+    }
+    for (uint32_t mip = 0; mip < a.GetMipLevelCount(); ++mip)
+    {
+      const auto& level = a.mipLevels[mip];
+      if (level.width != b.mipLevels[mip].width || level.height != b.mipLevels[mip].height)
+      {
+        return false;
+      }
+      for (uint32_t row = 0; row < level.rowCount; ++row)
+      {
+        if (memcmp(a.GetLevelData(mip) + size_t(level.rowPitch) * row, b.GetLevelData(mip) + size_t(b.mipLevels[mip].rowPitch) * row, a.GetRowSize(mip)) != 0)
+        {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+}
+
+ENGINE_TEST(ParallelDecodeMatchesSerial)
+{
+  const uint32_t sizes[][2] = { { 64, 64 }, { 100, 37 }, { 1, 1 }, { 3, 200 }, { 256, 128 }, { 17, 17 } };
+  std::vector<std::vector<uint8_t>> files;
+  for (uint32_t i = 0; i < 12; ++i)
+  {
+    const auto& size = sizes[i % std::size(sizes)];
+    files.push_back(MakeNoisePng(size[0], size[1], i));
+  }
+
+  EngineTest::ScopedJobSystem jobSystem(3);
+  std::vector<TextureDecodeRequest> requests(files.size());
+  for (size_t i = 0; i < files.size(); ++i)
+  {
+    requests[i].srcBuffer = files[i].data();
+    requests[i].bufferSize = files[i].size();
+    requests[i].generateMips = i % 3 != 0;
+    requests[i].mipOptions.srgb = i % 2 == 0;
+  }
+  const auto stats = DecodeImages(requests);
+  ENGINE_CHECK(stats.imageCount == files.size());
+  ENGINE_CHECK(stats.threadCount == 4);
+
+  uint64_t pixelCount = 0;
+  for (size_t i = 0; i < files.size(); ++i)
+  {
+    // 1枚ずつ順に展開した結果と一致する.
+    DecodedImage expected;
+    ENGINE_CHECK(DecodeImage(files[i].data(), files[i].size(), expected));
+    expected.srgb = requests[i].mipOptions.srgb;
+    if (requests[i].generateMips)
+    {
+      BuildMipChain(expected, requests[i].mipOptions);
+    }
+    ENGINE_CHECK(requests[i].succeeded);
+    ENGINE_CHECK(IsSameImage(requests[i].image, expected));
+    // 縦横の短い方が 1 になっても、長い方が 1 になるまでレベルを作る.
+    const auto& size = sizes[i % std::size(sizes)];
+    const uint32_t expectedMips = requests[i].generateMips ? uint32_t(std::bit_width(std::max(size[0], size[1]))) : 1;
+    ENGINE_CHECK(requests[i].image.GetMipLevelCount() == expectedMips);
+    pixelCount += uint64_t(size[0]) * size[1];
+  }
+  ENGINE_CHECK(stats.pixelCount == pixelCount);
+}
+
+ENGINE_TEST(ParallelDecodeReportsFailures)
+{
+  auto valid = MakeNoisePng(32, 32, 1);
+  auto truncated = valid;
+  truncated.resize(truncated.size() / 2);
+  const uint8_t garbage[64] = { 1, 2, 3 };
+
+  EngineTest::ScopedJobSystem jobSystem(2);
+  std::vector<TextureDecodeRequest> requests(4);
+  requests[0].srcBuffer = valid.data();
+  requests[0].bufferSize = valid.size();
+  requests[1].srcBuffer = truncated.data();
+  requests[1].bufferSize = truncated.size();
+  requests[2].srcBuffer = garbage;
+  requests[2].bufferSize = sizeof(garbage);
+  requests[3].srcBuffer = valid.data();
+  requests[3].bufferSize = valid.size();
+  requests[3].generateMips = true;
+  const auto stats = DecodeImages(requests);
+  ENGINE_CHECK(requests[0].succeeded && requests[3].succeeded);
+  ENGINE_CHECK(!requests[1].succeeded && !requests[2].succeeded);
+  ENGINE_CHECK(stats.imageCount == 2);
+  ENGINE_CHECK(stats.pixelCount == 32 * 32 * 2);
+  ENGINE_CHECK(requests[3].image.GetMipLevelCount() == 6);
+}
+
+ENGINE_TEST(DecodeWithoutWorkers)
+{
+  // ワーカーが無くても発行元スレッドで全て処理する.
+  auto valid = MakeNoisePng(8, 4, 2);
+  std::vector<TextureDecodeRequest> requests(3);
+  for (auto& request : requests)
+  {
+    request.srcBuffer = valid.data();
+    request.bufferSize = valid.size();
+  }
+  const auto stats = DecodeImages(requests);
+  ENGINE_CHECK(stats.imageCount == 3);
+  ENGINE_CHECK(stats.threadCount == 1);
+}
@@ -0,0 +1,231 @@
+﻿#include "EngineTest.h"
+#include "MipGenerator.h"
+#include "TexturePacker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+namespace
+{
+  struct Rect
+  {
+    uint32_t slice, x, y, width, height;
+  };
+
+  bool Overlaps(const Rect& a, const Rect& b)
+  {
+    return a.slice == b.slice && a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+  }
+
+  bool HasOverlap(const std::vector<Rect>& rects)
+  {
+    for (size_t i = 0; i < rects.size(); ++i)
+    {
+      for (size_t j = i + 1; j < rects.size(); ++j)
+      {
+        if (Overlaps(rects[i], rects[j]))
+        {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  DecodedImage MakeNoiseImage(uint32_t width, uint32_t height, uint32_t mipCount, uint32_t seed)
+  {
+    DecodedImage image;
+    image.Allocate(width, height, mipCount);
+    std::mt19937 random(seed);
+    for (auto& value : image.pixels)
+    {
+      value = uint8_t(random());
+    }
+    return image;
+  }
+
+  const uint8_t* GetTexel(const DecodedImage& image, uint32_t mip, uint32_t slice, uint32_t x, uint32_t y)
+  {
+    return image.GetLevelData(mip, slice) + size_t(y) * image.mipLevels[mip].rowPitch + size_t(x) * DecodedImage::PixelBytes;
+  }
+}
+
+ENGINE_TEST(SkylinePackerPlacesWithoutOverlap)
+{
+  SkylinePacker packer(512, 256);
+  std::mt19937 random(1);
+  std::vector<Rect> rects;
+  uint64_t area = 0;
+  for (int i = 0; i < 200; ++i)
+  {
+    const uint32_t width = 4 + random() % 60, height = 4 + random() % 60;
+    uint32_t x = 0, y = 0;
+    if (packer.Insert(width, height, x, y))
+    {
+      ENGINE_CHECK(x + width <= 512 && y + height <= 256);
+      rects.push_back({ 0, x, y, width, height });
+      area += uint64_t(width) * height;
+    }
+  }
+  ENGINE_CHECK(!rects.empty());
+  ENGINE_CHECK(!HasOverlap(rects));
+  ENGINE_CHECK(packer.GetOccupancy() == float(double(area) / (512.0 * 256.0)));
+  // 200個は収まらないため、ある程度詰まっていること.
+  ENGINE_CHECK(packer.GetOccupancy() > 0.6f);
+
+  uint32_t x = 0, y = 0;
+  SkylinePacker small(64, 64);
+  ENGINE_CHECK(!small.Insert(65, 1, x, y));
+  ENGINE_CHECK(!small.Insert(1, 65, x, y));
+  ENGINE_CHECK(small.Insert(64, 64, x, y) && x == 0 && y == 0);
+  ENGINE_CHECK(!small.Insert(1, 1, x, y));
+}
+
+ENGINE_TEST(PlanGroupsByFormatSizeAndColorSpace)
+{
+  const TexturePackSettings settings{ .atlasMaxTextureSize = 128, .atlasSize = 512, .atlasMipCount = 3, .minArraySize = 2, .maxArraySize = 3 };
+  const uint32_t padding = GetAtlasPadding(settings);
+  ENGINE_CHECK(padding == 4);
+
+  std::vector<TexturePackInput> inputs;
+  // アトラスの候補(sRGB と線形).
+  for (uint32_t i = 0; i < 10; ++i)
+  {
+    inputs.push_back({ .width = 16u << (i % 4), .height = 8u << (i % 3), .mipCount = 8, .format = ImageFormat::RGBA8, .srgb = i % 2 == 0 });
+  }
+  // 余白の倍数でないもの, レベルが足りないもの, 大きいものはアトラスに入れず、同じものが揃えば配列にする.
+  inputs.push_back({ .width = 30, .height = 30, .mipCount = 5, .format = ImageFormat::RGBA8, .srgb = true });
+  inputs.push_back({ .width = 30, .height = 30, .mipCount = 5, .format = ImageFormat::RGBA8, .srgb = true });
+  inputs.push_back({ .width = 64, .height = 64, .mipCount = 2, .format = ImageFormat::RGBA8 });
+  for (uint32_t i = 0; i < 7; ++i)
+  {
+    inputs.push_back({ .width = 256, .height = 256, .mipCount = 9, .format = ImageFormat::BC1, .srgb = true });
+  }
+  inputs.push_back({ .width = 256, .height = 256, .mipCount = 9, .format = ImageFormat::BC1, .srgb = false });
+  inputs.push_back({ .width = 256, .height = 256, .mipCount = 9, .format = ImageFormat::BC7, .srgb = true });
+
+  const auto plan = PlanTexturePacking(inputs, settings);
+  ENGINE_CHECK(plan.placements.size() == inputs.size());
+
+  std::vector<Rect> atlasRects;
+  for (uint32_t groupIndex = 0; groupIndex < plan.groups.size(); ++groupIndex)
+  {
+    const auto& group = plan.groups[groupIndex];
+    ENGINE_CHECK(group.members.size() >= 2);
+    ENGINE_CHECK(group.arraySize > 0 && group.arraySize <= settings.maxArraySize);
+    std::vector<bool> usedSlices(group.arraySize, false);
+    for (auto member : group.members)
+    {
+      const auto& input = inputs[member];
+      const auto& placement = plan.placements[member];
+      ENGINE_CHECK(placement.group == groupIndex);
+      ENGINE_CHECK(placement.arraySlice < group.arraySize);
+      ENGINE_CHECK(input.srgb == group.srgb && input.format == group.format);
+      if (group.isAtlas)
+      {
+        ENGINE_CHECK(input.width <= settings.atlasMaxTextureSize && input.mipCount >= group.mipCount);
+        // 余白を含めて範囲内にあり、位置は余白の倍数に揃っている.
+        ENGINE_CHECK(placement.x >= padding && placement.y >= padding);
+        ENGINE_CHECK(placement.x + input.width + padding <= group.width && placement.y + input.height + padding <= group.height);
+        ENGINE_CHECK(placement.x % padding == 0 && placement.y % padding == 0);
+        ENGINE_CHECK(placement.uvScale[0] * group.width == float(input.width) && placement.uvBias[1] * group.height == float(placement.y));
+        atlasRects.push_back({ groupIndex * 1000 + placement.arraySlice,
+          placement.x - padding, placement.y - padding, input.width + padding * 2, input.height + padding * 2 });
+      }
+      else
+      {
+        ENGINE_CHECK(input.width == group.width && input.height == group.height && input.mipCount == group.mipCount);
+        ENGINE_CHECK(!usedSlices[placement.arraySlice]);
+        usedSlices[placement.arraySlice] = true;
+      }
+    }
+  }
+  // 余白を含めた矩形同士も重ならない.
+  ENGINE_CHECK(!HasOverlap(atlasRects));
+
+  for (uint32_t i = 0; i < 10; ++i)
+  {
+    ENGINE_CHECK(plan.groups[plan.placements[i].group].isAtlas);
+  }
+  ENGINE_CHECK(!plan.groups[plan.placements[10].group].isAtlas);
+  ENGINE_CHECK(plan.placements[10].group == plan.placements[11].group);
+  // 1枚だけのものはまとめない. 配列は maxArraySize ごとに分け、最後の1枚は残る.
+  ENGINE_CHECK(plan.placements[12].group == TexturePackPlacement::NotPacked);
+  ENGINE_CHECK(plan.placements[13].group != TexturePackPlacement::NotPacked);
+  ENGINE_CHECK(plan.placements[13].group != plan.placements[16].group);
+  ENGINE_CHECK(plan.placements[19].group == TexturePackPlacement::NotPacked);
+  ENGINE_CHECK(plan.placements[20].group == TexturePackPlacement::NotPacked);
+  ENGINE_CHECK(plan.placements[21].group == TexturePackPlacement::NotPacked);
+}
+
+ENGINE_TEST(AtlasSpillsToMorePages)
+{
+  const TexturePackSettings settings{ .atlasMaxTextureSize = 128, .atlasSize = 256, .atlasMipCount = 2, .maxArraySize = 4 };
+  std::vector<TexturePackInput> inputs(12, { .width = 120, .height = 120, .mipCount = 7 });
+  const auto plan = PlanTexturePacking(inputs, settings);
+  ENGINE_CHECK(plan.groups.size() >= 1 && plan.groups[0].isAtlas);
+  // 余白を含めて 124x124 なので1ページに4枚.
+  ENGINE_CHECK(plan.groups[0].arraySize == 3);
+  ENGINE_CHECK(plan.groups[0].members.size() == 12);
+}
+
+ENGINE_TEST(PackedImagesCopyLevelsAndFillPadding)
+{
+  const TexturePackSettings settings{ .atlasMaxTextureSize = 64, .atlasSize = 128, .atlasMipCount = 3 };
+  const uint32_t padding = GetAtlasPadding(settings);
+  std::vector<DecodedImage> sources;
+  sources.push_back(MakeNoiseImage(32, 16, 6, 1));
+  sources.push_back(MakeNoiseImage(16, 32, 6, 2));
+  sources.push_back(MakeNoiseImage(64, 64, 7, 3));
+  sources.push_back(MakeNoiseImage(200, 100, 3, 4));
+  sources.push_back(MakeNoiseImage(200, 100, 3, 5));
+  std::vector<TexturePackInput> inputs;
+  std::vector<const DecodedImage*> images;
+  for (auto& source : sources)
+  {
+    GenerateMipLevels(source, {});
+    inputs.push_back({ .width = source.GetWidth(), .height = source.GetHeight(), .mipCount = source.GetMipLevelCount() });
+    images.push_back(&source);
+  }
+  const auto plan = PlanTexturePacking(inputs, settings);
+  std::vector<DecodedImage> packed;
+  BuildPackedImages(plan, settings, images, packed);
+  ENGINE_CHECK(packed.size() == plan.groups.size());
+
+  bool same = true;
+  for (size_t i = 0; i < sources.size(); ++i)
+  {
+    const auto& placement = plan.placements[i];
+    ENGINE_CHECK(placement.group != TexturePackPlacement::NotPacked);
+    const auto& group = plan.groups[placement.group];
+    const auto& image = packed[placement.group];
+    ENGINE_CHECK(image.arraySize == group.arraySize && image.GetMipLevelCount() == group.mipCount);
+    for (uint32_t mip = 0; mip < group.mipCount; ++mip)
+    {
+      const auto& level = sources[i].mipLevels[mip];
+      if (!group.isAtlas)
+      {
+        for (uint32_t y = 0; y < level.height; ++y)
+        {
+          same = same && memcmp(GetTexel(image, mip, placement.arraySlice, 0, y), GetTexel(sources[i], mip, 0, 0, y), level.width * 4) == 0;
+        }
+        continue;
+      }
+      // 余白は端のテクセルを延長したもの.
+      const int border = int(padding >> mip);
+      const int originX = int(placement.x >> mip), originY = int(placement.y >> mip);
+      for (int y = -border; y < int(level.height) + border; ++y)
+      {
+        for (int x = -border; x < int(level.width) + border; ++x)
+        {
+          const uint32_t sx = uint32_t(std::clamp(x, 0, int(level.width) - 1));
+          const uint32_t sy = uint32_t(std::clamp(y, 0, int(level.height) - 1));
+          same = same && memcmp(GetTexel(image, mip, placement.arraySlice, uint32_t(originX + x), uint32_t(originY + y)),
+            GetTexel(sources[i], mip, 0, sx, sy), 4) == 0;
+        }
+      }
+    }
+  }
+  ENGINE_CHECK(same);
+}
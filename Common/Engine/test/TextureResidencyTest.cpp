@@ -0,0 +1,193 @@
+﻿#include "EngineTest.h"
+#include "TextureResidency.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+  // width x width の RGBA8 テクスチャの各レベルのメモリ量. 64KB のタイル単位で確保する.
+  std::vector<uint64_t> MakeMipSizes(uint32_t width)
+  {
+    std::vector<uint64_t> sizes;
+    for (uint32_t size = width; size > 0; size /= 2)
+    {
+      const uint64_t bytes = uint64_t(size) * size * 4;
+      sizes.push_back((bytes + 65535) / 65536 * 65536);
+    }
+    return sizes;
+  }
+
+  // Update の結果を適用した常駐状態. ポリシーの内部状態と食い違わないかを確かめる.
+  struct ResidencyMirror
+  {
+    std::vector<std::vector<uint64_t>> mipSizes;
+    std::vector<uint32_t> residentMips;
+
+    uint64_t GetResidentSize() const
+    {
+      uint64_t size = 0;
+      for (size_t i = 0; i < mipSizes.size(); ++i)
+      {
+        for (uint32_t mip = residentMips[i]; mip < mipSizes[i].size(); ++mip)
+        {
+          size += mipSizes[i][mip];
+        }
+      }
+      return size;
+    }
+  };
+}
+
+ENGINE_TEST(RequiredMipFollowsScreenSize)
+{
+  // 1ピクセルに1テクセルなら mip0、2テクセルなら mip1.
+  ENGINE_CHECK(ComputeRequiredMip(1024, 1.0f, 1.0f / 1024.0f, 11) == 0);
+  ENGINE_CHECK(ComputeRequiredMip(1024, 1.0f, 2.0f / 1024.0f, 11) == 1);
+  ENGINE_CHECK(ComputeRequiredMip(1024, 1.0f, 3.9f / 1024.0f, 11) == 1);
+  ENGINE_CHECK(ComputeRequiredMip(1024, 1.0f, 64.0f / 1024.0f, 11) == 6);
+  // 拡大表示は mip0, 遠すぎる場合は最も粗いレベル.
+  ENGINE_CHECK(ComputeRequiredMip(1024, 1.0f, 0.0001f, 11) == 0);
+  ENGINE_CHECK(ComputeRequiredMip(1024, 1.0f, 1000.0f, 11) == 10);
+  ENGINE_CHECK(ComputeRequiredMip(1024, 1.0f, 1.0f, 0) == 0);
+}
+
+ENGINE_TEST(UvDensityOfQuad)
+{
+  // 2x2 の四角形に UV 0..1 を貼ると、単位長あたりの UV 変化は 0.5.
+  const float positions[] = { 0, 0, 0,  2, 0, 0,  2, 2, 0,  0, 2, 0 };
+  const float texcoords[] = { 0, 0,  1, 0,  1, 1,  0, 1 };
+  const uint32_t indices[] = { 0, 1, 2,  0, 2, 3 };
+  ENGINE_CHECK(std::abs(ComputeUvDensity(positions, texcoords, indices, 6) - 0.5f) < 1e-5f);
+  const float tiled[] = { 0, 0,  4, 0,  4, 4,  0, 4 };
+  ENGINE_CHECK(std::abs(ComputeUvDensity(positions, tiled, indices, 6) - 2.0f) < 1e-5f);
+  ENGINE_CHECK(ComputeUvDensity(positions, texcoords, indices, 0) == 0.0f);
+}
+
+ENGINE_TEST(LoadsCoarseToFineWithinBudget)
+{
+  TextureResidencyPolicy policy;
+  const auto sizes = MakeMipSizes(1024);
+  const auto id = policy.Add(sizes, 4);
+  ENGINE_CHECK(policy.GetResidentMip(id) == 4);
+
+  TextureResidencyPolicy::Settings settings{ .budget = 64ull * 1024 * 1024, .maxLoadsPerUpdate = 8 };
+  std::vector<TextureResidencyPolicy::Operation> evictions, loads;
+  for (uint32_t expected = 3; expected != ~0u; --expected)
+  {
+    // 1回の Update で1テクスチャにつき1段階ずつ詳細にする.
+    policy.Request(id, 0);
+    policy.Update(settings, evictions, loads);
+    ENGINE_CHECK(evictions.empty());
+    ENGINE_CHECK(loads.size() == 1 && loads[0].id == id && loads[0].mip == expected);
+    ENGINE_CHECK(policy.GetResidentMip(id) == expected);
+  }
+  policy.Request(id, 0);
+  policy.Update(settings, evictions, loads);
+  ENGINE_CHECK(loads.empty());
+
+  // 予算を減らすと、要求されていないレベルから破棄する.
+  settings.budget = 1024 * 1024;
+  for (uint32_t frame = 0; frame < settings.keepFrames + 2; ++frame)
+  {
+    policy.Update(settings, evictions, loads);
+  }
+  ENGINE_CHECK(policy.GetResidentSize() <= settings.budget);
+  ENGINE_CHECK(policy.GetResidentMip(id) == 2);
+  policy.Remove(id);
+  ENGINE_CHECK(policy.GetResidentSize() == 0);
+}
+
+ENGINE_TEST(SimulatedCameraPath)
+{
+  // 直線上に並んだ物体の横をカメラが通り過ぎる. 近くの物体ほど詳細なレベルを要求する.
+  const uint32_t objectCount = 48;
+  const uint32_t textureSize = 1024;
+  const float objectSpacing = 10.0f;
+  const float pixelAngle = 2.0f * std::tan(0.5f) / 1080.0f;  // 縦の画角 1 ラジアン, 高さ 1080 ピクセル.
+  const float uvDensity = 0.25f;                              // 4x4 の面に UV 0..1.
+  const float viewDistance = 60.0f;
+
+  TextureResidencyPolicy policy;
+  ResidencyMirror mirror;
+  const uint32_t tailMip = 5;
+  for (uint32_t i = 0; i < objectCount; ++i)
+  {
+    // 大きさの異なるテクスチャを混ぜる.
+    const auto sizes = MakeMipSizes(i % 3 == 0 ? textureSize / 2 : textureSize);
+    ENGINE_CHECK(policy.Add(sizes, tailMip) == i);
+    mirror.mipSizes.push_back(sizes);
+    mirror.residentMips.push_back(tailMip);
+  }
+  const uint64_t tailSize = mirror.GetResidentSize();
+  ENGINE_CHECK(policy.GetResidentSize() == tailSize);
+
+  const TextureResidencyPolicy::Settings settings{
+    .budget = tailSize + 24ull * 1024 * 1024,
+    .maxLoadsPerUpdate = 4,
+    .keepFrames = 30,
+  };
+  std::vector<TextureResidencyPolicy::Operation> evictions, loads;
+  std::vector<uint32_t> requested(objectCount);
+  bool consistent = true;
+  uint32_t loadCount = 0, evictionCount = 0;
+  const uint32_t moveFrames = 600, settleFrames = 60;
+  for (uint32_t frame = 0; frame < moveFrames + settleFrames; ++frame)
+  {
+    const float cameraX = float(std::min(frame, moveFrames - 1)) * (objectSpacing * objectCount / moveFrames);
+    std::fill(requested.begin(), requested.end(), ~0u);
+    for (uint32_t i = 0; i < objectCount; ++i)
+    {
+      const float dx = float(i) * objectSpacing - cameraX;
+      const float distance = std::sqrt(dx * dx + 4.0f);
+      if (distance < viewDistance)
+      {
+        const uint32_t mipCount = uint32_t(mirror.mipSizes[i].size());
+        requested[i] = ComputeRequiredMip(mipCount == 11 ? textureSize : textureSize / 2, uvDensity, distance * pixelAngle, mipCount);
+        policy.Request(i, requested[i]);
+      }
+    }
+    policy.Update(settings, evictions, loads);
+    ENGINE_CHECK(loads.size() <= settings.maxLoadsPerUpdate);
+
+    // 破棄は常駐している最も詳細なレベル、読み込みはその1段階詳細なレベルから順に行われる.
+    for (const auto& eviction : evictions)
+    {
+      consistent = consistent && eviction.mip == mirror.residentMips[eviction.id] && eviction.mip < tailMip;
+      // 今フレームで要求されているレベルは破棄しない.
+      consistent = consistent && (requested[eviction.id] == ~0u || eviction.mip < requested[eviction.id]);
+      mirror.residentMips[eviction.id]++;
+    }
+    for (const auto& load : loads)
+    {
+      consistent = consistent && load.mip + 1 == mirror.residentMips[load.id];
+      consistent = consistent && std::none_of(evictions.begin(), evictions.end(),
+        [&](const TextureResidencyPolicy::Operation& eviction) { return eviction.id == load.id; });
+      mirror.residentMips[load.id]--;
+    }
+    loadCount += uint32_t(loads.size());
+    evictionCount += uint32_t(evictions.size());
+
+    consistent = consistent && mirror.GetResidentSize() == policy.GetResidentSize();
+    consistent = consistent && policy.GetResidentSize() <= settings.budget;
+    for (uint32_t i = 0; i < objectCount; ++i)
+    {
+      consistent = consistent && mirror.residentMips[i] == policy.GetResidentMip(i);
+    }
+  }
+  ENGINE_CHECK(consistent);
+  // 予算に全ては収まらないため、通り過ぎた物体のレベルが破棄されて再利用される.
+  ENGINE_CHECK(loadCount > 0);
+  ENGINE_CHECK(evictionCount > 0);
+
+  // 停止後は読み込みが落ち着き、見えている物体は要求したレベルまで常駐している.
+  // 予算に余裕があれば、近づいたときに読み込んだより詳細なレベルも残っている.
+  ENGINE_CHECK(loads.empty() && evictions.empty());
+  for (uint32_t i = 0; i < objectCount; ++i)
+  {
+    if (requested[i] != ~0u)
+    {
+      ENGINE_CHECK(policy.GetResidentMip(i) <= std::min(requested[i], tailMip));
+    }
+  }
+}
@@ -0,0 +1,49 @@
+﻿// 入力画像の輝度ヒストグラムを集計する.
+// 1グループ(HISTOGRAM_BIN_COUNT スレッド)で 16x16 画素を groupshared のビンへ数え、最後にグループの結果をバッファへ加算する.
+// グローバルなバッファへのアトミック加算は1グループあたり最大でビンの数だけになる.
+// 輝度とビンの求め方は CPU の GetImageHistogramBin と一致させること.
+// Dispatch は (ceil(幅 / 16), ceil(高さ / 16)). gHistogram は事前に 0 にしておく.
+#define HISTOGRAM_BIN_COUNT 256  // ImageHistogramBinCount と一致させること.
+
+Texture2D<float4> gSourceTex : register(t0);
+RWByteAddressBuffer gHistogram : register(u0);
+
+groupshared uint gBins[HISTOGRAM_BIN_COUNT];
+
+[numthreads(16, 16, 1)]
+void main(uint3 dtid : SV_DispatchThreadID, uint groupIndex : SV_GroupIndex)
+{
+    gBins[groupIndex] = 0;
+    GroupMemoryBarrierWithGroupSync();
+
+    uint width = 0, height = 0;
+    gSourceTex.GetDimensions(width, height);
+    if (dtid.x < width && dtid.y < height)
+    {
+        float3 rgb = gSourceTex.Load(int3(dtid.xy, 0)).rgb;
+        float luminance = saturate(dot(rgb, float3(0.2126, 0.7152, 0.0722)));
+        uint bin = min(uint(luminance * HISTOGRAM_BIN_COUNT), HISTOGRAM_BIN_COUNT - 1);
+
+        // 平坦な領域ではウェーブ内の画素が同じビンに入るため、先頭のレーンがまとめて加算する.
+        // レーン数は分岐の前に数えておく(分岐の中では先頭のレーンしか有効でないため).
+        uint laneCount = WaveActiveCountBits(true);
+        if (WaveActiveAllEqual(bin))
+        {
+            if (WaveIsFirstLane())
+            {
+                InterlockedAdd(gBins[bin], laneCount);
+            }
+        }
+        else
+        {
+            InterlockedAdd(gBins[bin], 1);
+        }
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    uint count = gBins[groupIndex];
+    if (count > 0)
+    {
+        gHistogram.InterlockedAdd(groupIndex * 4, count);
+    }
+}
\ No newline at end of file
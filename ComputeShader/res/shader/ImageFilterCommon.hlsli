@@ -0,0 +1,116 @@
+﻿// フィルタチェインのシェーダー(ComputeShader.hlsl, SeparableBlur.hlsl)で共通の定義.
+// 定数の値と並びは ImageFilter.h (ImageFilterOp, ImageFilterKernel) と一致させること.
+#define FILTER_MAX_OPS 8
+
+#define FILTER_OP_COLOR_MATRIX 0
+#define FILTER_OP_HUE_SHIFT 1
+#define FILTER_OP_TONE_MAP 2
+
+#define FILTER_KERNEL_PER_PIXEL 0
+#define FILTER_KERNEL_BLUR_HORIZONTAL 1
+#define FILTER_KERNEL_BLUR_VERTICAL 2
+#define FILTER_KERNEL_SHARPEN 3
+#define FILTER_KERNEL_BLUR_TRANSPOSED 4
+
+struct FilterOp
+{
+    uint type;
+    uint3 reserved;
+    float4 params;
+    float4 matrixRows[3];
+};
+
+struct FilterPassParameters
+{
+    uint kernel;
+    uint opCount;
+    int colorLut;       // 0 以上なら ops の代わりに引く LUT の番号.
+    uint colorLutSize;  // LUT の1辺の大きさ.
+    float4 kernelParams;
+    FilterOp ops[FILTER_MAX_OPS];
+};
+
+ConstantBuffer<FilterPassParameters> gPass : register(b0);
+
+Texture2D<float4> gSourceTex : register(t0);
+RWTexture2D<float4> gDestinationTex : register(u0);
+// ops を焼き込んだ3D LUT. 奥行き方向に LUT を並べている.
+Texture3D<float4> gColorLut : register(t1);
+SamplerState gLinearClampSampler : register(s0);
+
+float3 rgb2hsv(float3 rgbColor)
+{
+    float4 k = float4(0.0, -1.0 / 3.0, 2.0 / 3.0, -1.0);
+    float4 p = lerp(float4(rgbColor.bg, k.wz), float4(rgbColor.gb, k.xy), step(rgbColor.b, rgbColor.g));
+    float4 q = lerp(float4(p.xyw, rgbColor.r), float4(rgbColor.r, p.yzx), step(p.x, rgbColor.r));
+
+    float d = q.x - min(q.w, q.y);
+    float e = 1.0e-10;
+    return float3(abs(q.z + (q.w - q.y) / (6.0 * d + e)), d / (q.x + e), q.x);
+}
+
+float3 hsv2rgb(float3 color)
+{
+    float4 K = float4(1.0, 2.0 / 3.0, 1.0 / 3.0, 3.0);
+    float3 p = abs(frac(color.xxx + K.xyz) * 6.0 - K.www);
+    return color.z * lerp(K.xxx, saturate(p - K.xxx), color.y);
+}
+
+float3 ApplyOp(FilterOp op, float3 color)
+{
+    if (op.type == FILTER_OP_COLOR_MATRIX)
+    {
+        float4 c = float4(color, 1.0);
+        return float3(dot(op.matrixRows[0], c), dot(op.matrixRows[1], c), dot(op.matrixRows[2], c));
+    }
+    if (op.type == FILTER_OP_HUE_SHIFT)
+    {
+        // 色相シフト.
+        float3 hsv = rgb2hsv(color);
+        hsv.x = frac(hsv.x + op.params.x);
+        return hsv2rgb(hsv);
+    }
+    // トーンマップ. params.x は露出の倍率.
+    float3 x = max(color * op.params.x, 0.0);
+    float3 reinhard = x / (1.0 + x);
+    float3 aces = saturate((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14));
+    return lerp(reinhard, aces, step(0.5, op.params.y));
+}
+
+// パスにまとめられた1画素の演算を順に適用する.
+float4 ApplyPassOps(float4 color)
+{
+    for (uint i = 0; i < gPass.opCount; ++i)
+    {
+        color.rgb = ApplyOp(gPass.ops[i], color.rgb);
+    }
+    return color;
+}
+
+// [0, 1] の色で LUT を引く. 隣の LUT と混ざらないよう、奥行きは LUT の範囲内のテクセル中心に収める.
+float3 SampleColorLut(float3 color)
+{
+    uint width, height, depth;
+    gColorLut.GetDimensions(width, height, depth);
+    float size = float(gPass.colorLutSize);
+    float3 texel = saturate(color) * (size - 1.0) + 0.5;
+    texel.z += float(gPass.colorLut) * size;
+    return gColorLut.SampleLevel(gLinearClampSampler, texel / float3(size, size, float(depth)), 0).rgb;
+}
+
+// カーネルの結果にパスの1画素の演算を適用する.
+float4 ApplyPassColor(float4 color)
+{
+    if (gPass.colorLut >= 0)
+    {
+        color.rgb = SampleColorLut(color.rgb);
+        return color;
+    }
+    return ApplyPassOps(color);
+}
+
+// 参考文献:
+// HSV変換コードは https://gist.github.com/983/e170a24ae8eba2cd174f より.
+// https://stackoverflow.com/questions/15095909/from-rgb-to-hsv-in-opengl-glsl にも同様コードが掲載されている.
+// これらを元にHLSL化して使用しています.
+// ACES の近似式は https://knarkowicz.wordpress.com/2016/01/06/aces-filmic-tone-mapping-curve/ より.
\ No newline at end of file
@@ -0,0 +1,63 @@
+﻿// 1方向のぼかし(ガウス分布またはボックス)のパスを処理する.
+// 1グループで1行(垂直方向なら1列)の BLUR_TILE_SIZE 画素を受け持ち、
+// 両側に半径分の apron を加えた範囲を groupshared メモリへ一度だけ読み込んでから畳み込む.
+// テクスチャからの読込みは1画素あたり (BLUR_TILE_SIZE + 2 * 半径) / BLUR_TILE_SIZE 回で済む.
+//  - FILTER_KERNEL_BLUR_HORIZONTAL: 行に沿ってぼかす.
+//  - FILTER_KERNEL_BLUR_VERTICAL: 列に沿ってぼかす.
+//  - FILTER_KERNEL_BLUR_TRANSPOSED: 行に沿ってぼかし、縦横を入れ替えて書き出す. 2回続けると水平・垂直のぼかしになる.
+// Dispatch は (ceil(線分の長さ / BLUR_TILE_SIZE), 線分の数, 1) グループで行う.
+#include "ImageFilterCommon.hlsli"
+
+#define BLUR_TILE_SIZE 128
+#define BLUR_MAX_RADIUS 64  // ImageFilterMaxBlurRadius と一致させること.
+
+groupshared float4 gTile[BLUR_TILE_SIZE + BLUR_MAX_RADIUS * 2];
+groupshared float gWeights[BLUR_MAX_RADIUS + 1];
+
+[numthreads(BLUR_TILE_SIZE, 1, 1)]
+void main(uint3 gid : SV_GroupID, uint3 gtid : SV_GroupThreadID)
+{
+    uint width = 0, height = 0;
+    gSourceTex.GetDimensions(width, height);
+
+    // 列に沿って読む場合は x と y を入れ替えて扱う.
+    bool alongColumn = (gPass.kernel == FILTER_KERNEL_BLUR_VERTICAL);
+    int lineLength = int(alongColumn ? height : width);
+    int lineIndex = int(gid.y);
+    int tileStart = int(gid.x) * BLUR_TILE_SIZE;
+    int radius = min(int(gPass.kernelParams.x), BLUR_MAX_RADIUS);
+    float sigma = gPass.kernelParams.y;
+
+    // タイルと apron を読み込む. 範囲外は端のテクセルを使う.
+    for (int i = int(gtid.x); i < BLUR_TILE_SIZE + radius * 2; i += BLUR_TILE_SIZE)
+    {
+        int x = clamp(tileStart - radius + i, 0, lineLength - 1);
+        gTile[i] = gSourceTex[alongColumn ? int2(lineIndex, x) : int2(x, lineIndex)];
+    }
+    // 中心からの距離ごとの重み. 標準偏差が 0 ならボックスフィルタ.
+    if (int(gtid.x) <= radius)
+    {
+        float d = float(gtid.x);
+        gWeights[gtid.x] = sigma > 0.0 ? exp(-d * d / (2.0 * sigma * sigma)) : 1.0;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    int x = tileStart + int(gtid.x);
+    if (x >= lineLength)
+    {
+        return;
+    }
+    float4 sum = 0;
+    float weightSum = 0;
+    for (int j = -radius; j <= radius; ++j)
+    {
+        float w = gWeights[abs(j)];
+        sum += gTile[int(gtid.x) + radius + j] * w;
+        weightSum += w;
+    }
+    float4 color = ApplyPassColor(sum / weightSum);
+
+    // 水平方向以外は (lineIndex, x) へ書く. 転置する場合は出力の列が入力の行になる.
+    bool writeRow = (gPass.kernel == FILTER_KERNEL_BLUR_HORIZONTAL);
+    gDestinationTex[writeRow ? int2(x, lineIndex) : int2(lineIndex, x)] = color;
+}
\ No newline at end of file
@@ -2,7 +2,6 @@
 {
     float4x4 mtxView;
     float4x4 mtxProj;
-    float4 modeParams;
 };
 
 ConstantBuffer<SceneParameters> gScene : register(b0);
@@ -2,6 +2,7 @@
 
 #include "GfxDevice.h"
 #include "FileLoader.h"
+#include "JobSystem.h"
 #include "Win32Application.h"
 
 #include "imgui.h"
@@ -9,6 +10,12 @@
 #include "imgui/backends/imgui_impl_win32.h"
 
 #include "TextureUtility.h"
+#include "PngFile.h"
+
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 
 using namespace Microsoft::WRL;
 using namespace DirectX;
@@ -37,10 +44,16 @@ MyApplication::MyApplication()
 
 void MyApplication::Initialize()
 {
+  // CPU でフィルタを処理するためのスレッドを準備.
+  GetJobSystem()->Initialize();
+
   auto& gfxDevice = GetGfxDevice();
   GfxDevice::DeviceInitParams initParams;
+  initParams.hwnd = Win32Application::GetHwnd();
   initParams.formatDesired = DXGI_FORMAT_R8G8B8A8_UNORM;
   gfxDevice->Initialize(initParams);
+  // 計測結果やフィルタの結果を読み返すための領域. 画像1枚分(RGBA8)を複数収められる大きさにしておく.
+  GetReadbackRing()->Initialize(32 * 1024 * 1024);
 
   PrepareImGui();
 
@@ -268,88 +281,14 @@ void MyApplication::PrepareDrawPipeline()
 
 void MyApplication::PrepareComputePipeline()
 {
-  auto& gfxDevice = GetGfxDevice();
-  auto& loader = GetFileLoader();
-
-  // コンピュートシェーダーのためのパイプラインステートオブジェクトを作成.
-  // ルートシグネチャの作成.
-  D3D12_DESCRIPTOR_RANGE rangeSrvRanges[] = {
-    {  // t0 テクスチャ.
-      .RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV,
-      .NumDescriptors = 1,
-      .BaseShaderRegister = 0,
-      .RegisterSpace = 0,
-      .OffsetInDescriptorsFromTableStart = 0,
-    }
-  };
-  D3D12_DESCRIPTOR_RANGE rangeUavRanges[] = {
-    {  // u0 書込先テクスチャ.
-      .RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV,
-      .NumDescriptors = 1,
-      .BaseShaderRegister = 0,
-      .RegisterSpace = 0,
-      .OffsetInDescriptorsFromTableStart = 0,
-    }
-  };
-
-  D3D12_ROOT_PARAMETER rootParams[] = {
-    {
-      .ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV,
-      .Constants = {
-        .ShaderRegister = 0,
-        .RegisterSpace = 0,
-      },
-      .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL
-    },
-    {
-      .ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE,
-      .DescriptorTable = {
-        .NumDescriptorRanges = _countof(rangeSrvRanges),
-        .pDescriptorRanges = rangeSrvRanges,
-      },
-      .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL,
-    },
-    {
-      .ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE,
-      .DescriptorTable = {
-        .NumDescriptorRanges = _countof(rangeUavRanges),
-        .pDescriptorRanges = rangeUavRanges,
-      },
-      .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL,
-    },
-  };
-
-  D3D12_ROOT_SIGNATURE_DESC rootSignatureDesc{
-    .NumParameters = _countof(rootParams),
-    .pParameters = rootParams,
-    .NumStaticSamplers = 0,
-    .pStaticSamplers = nullptr,
-    .Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE
-  };
-
-  ComPtr<ID3DBlob> signature;
-  ComPtr<ID3DBlob> error;
-  D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error);
-  m_rootSignatureCS = gfxDevice->CreateRootSignature(signature);
-
-  // シェーダーコードの読み込み.
-  std::vector<char> csdata;
-  loader->Load(L"res/shader/ComputeShader.cso", csdata);
-  D3D12_SHADER_BYTECODE cs{
-    .pShaderBytecode = csdata.data(),
-    .BytecodeLength = csdata.size(),
-  };
-
-  // 情報が揃ったのでパイプラインステートオブジェクトを作成する.
-  D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc{
-    .pRootSignature = m_rootSignatureCS.Get(),
-    .CS = cs,
-    .NodeMask = 1,
-    .CachedPSO = { },
-    .Flags = D3D12_PIPELINE_STATE_FLAG_NONE
-  };
-
-  m_filterPipeline = gfxDevice->CreateComputePipelineState(psoDesc);
+  // フィルタ処理のためのパイプラインは ImageFilterGraph が持つ.
+  m_filterGraph.Initialize();
+  m_histogramPass.Initialize();
+  m_tiledFilter.Initialize();
+
+  // 初期状態はセピア化のみ.
+  m_filterChain = { MakeImageFilterNode(ImageFilterType::Sepia) };
+  m_filterGraph.SetChain(m_filterChain, m_filterPlanOptions);
 }
 
 void MyApplication::PrepareImageFilterResources()
@@ -357,14 +296,18 @@ void MyApplication::PrepareImageFilterResources()
   auto& gfxDevice = GetGfxDevice();
   std::filesystem::path filePath = "res/texture/image.png";
   bool generateMips = false;
+  // 元画像はフィルタの入力と表示の両方で読むため、どちらの状態も兼ねておく.
+  // フィルタの結果は表示用の状態にしておき、フィルタを実行するときだけ UAV にする.
   CreateTextureFromFile(m_sourceImage, filePath,
     generateMips,
-    D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+    D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE,
     D3D12_RESOURCE_FLAG_NONE);
   CreateTextureFromFile(m_filteredImage, filePath,
     generateMips,
-    D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+    D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
     D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+  m_filterCache.Invalidate();
+  m_histogramCache.Invalidate();
 
   auto resDesc = m_sourceImage->GetDesc();
   D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{
@@ -391,17 +334,6 @@ void MyApplication::PrepareImageFilterResources()
   };
   m_filteredImageUAV = gfxDevice->CreateUnorderedAccessView(m_filteredImage, uavDesc);
 
-  // フィルター実行のためのDispatchサイズを計算.
-  auto dispatchAlign = [](auto v) {
-    // CSのスレッド数はXY共に16のため.
-    return UINT((v + 16 - 1) & ~(16- 1));
-  };
-  m_filterDispatchSize = {
-    .x = dispatchAlign(resDesc.Width),
-    .y = dispatchAlign(resDesc.Height)
-  };
-
-
   float offset = 10.0f;
   Vertex vertices[] = {
     { XMFLOAT3(-480.0f - offset, -135.0f, 0.0f), XMFLOAT2(0.0f, 1.0f) },
@@ -474,11 +406,13 @@ void MyApplication::OnUpdate()
   ImGui_ImplWin32_NewFrame();
   ImGui::NewFrame();
 
+  // 数フレーム前に要求した読み返しが完了していれば、そのコールバックを呼ぶ.
+  GetReadbackRing()->Update();
+
   // ImGuiを使用したUIの描画指示.
   ImGui::Begin("Information");
   ImGui::Text("FPS: %.2f", ImGui::GetIO().Framerate);
-  ImGui::Combo("Mode", &m_filterMode, "Sepia\0Hue Shift\0\0");
-  ImGui::SliderFloat("Offset", &m_hueShift, 0.0f, 1.0f);
+  DrawFilterChainUI();
   ImGui::End();
 
   // 行列情報などを更新する.
@@ -489,8 +423,6 @@ void MyApplication::OnUpdate()
 
   XMStoreFloat4x4(&m_sceneParams.mtxView, mtxView);
   XMStoreFloat4x4(&m_sceneParams.mtxProj, mtxProj);
-  m_sceneParams.modeParams.x = float(m_filterMode);
-  m_sceneParams.modeParams.y = m_hueShift;
   m_frameDeltaAccum += ImGui::GetIO().DeltaTime;
 
   auto& gfxDevice = GetGfxDevice();
@@ -501,6 +433,12 @@ void MyApplication::OnUpdate()
 
   // 作成したコマンドを実行.
   gfxDevice->Submit(commandList.Get());
+  GetReadbackRing()->Signal();
+  if (m_tiledRequested)
+  {
+    RunTiledFilter();
+    m_tiledRequested = false;
+  }
   // 描画した内容を画面へ反映.
   gfxDevice->Present(1);
 }
@@ -512,9 +450,11 @@ void MyApplication::Shutdown()
 
   // リソースを解放.
   m_drawPipeline.Reset();
-  m_filterPipeline.Reset();
   m_rootSignature.Reset();
-  m_rootSignatureCS.Reset();
+  m_filterGraph.Shutdown();
+  m_histogramPass.Shutdown();
+  m_tiledFilter.Shutdown();
+  GetReadbackRing()->Shutdown();
 
   m_vertexBuffer.Reset();
   m_sourceImage.Reset();
@@ -534,6 +474,8 @@ void MyApplication::Shutdown()
 
   // グラフィックスデバイス関連解放.
   gfxDevice->Shutdown();
+
+  GetJobSystem()->Shutdown();
 }
 
 ComPtr<ID3D12GraphicsCommandList>  MyApplication::MakeCommandList()
@@ -555,7 +497,50 @@ ComPtr<ID3D12GraphicsCommandList>  MyApplication::MakeCommandList()
   };
   commandList->SetDescriptorHeaps(_countof(heaps), heaps);
 
-  FilterImage(commandList);
+  // ヒストグラムは元画像が変わったときだけ集計する. 届いた結果は計測を使うフィルタへ反映する.
+  const auto histogramKey = HashBuilder().Add(m_sourceImage.Get()).Get();
+  if (m_histogramCache.IsDirty(histogramKey))
+  {
+    auto onHistogram = [this](const ImageHistogram& histogram) {
+      m_histogram = histogram;
+      m_histogramReady = true;
+      if (ApplyImageHistogramToChain(m_histogram, m_filterChain))
+      {
+        m_filterGraph.SetChain(m_filterChain, m_filterPlanOptions);
+      }
+    };
+    // 読み返しの領域が空いていなければ、次のフレームで集計し直す.
+    if (m_histogramPass.Dispatch(commandList.Get(), m_sourceImage.Get(), m_sourceImageSRV, onHistogram))
+    {
+      m_histogramCache.MarkValid(histogramKey);
+    }
+  }
+
+  // 元画像とチェインが前回の実行時から変わっていなければ、前回の結果をそのまま表示する.
+  const auto filterKey = HashBuilder()
+    .Add(m_filterGraph.GetPlanHash())
+    .Add(m_sourceImage.Get())
+    .Add(m_filteredImage.Get())
+    .Get();
+  if (m_filterCache.IsDirty(filterKey))
+  {
+    FilterImage(commandList);
+    m_filterCache.MarkValid(filterKey);
+  }
+
+  // 要求があればフィルタの結果を読み返す. 比較に使うプランは要求した時点のものを渡す.
+  if (m_saveFilteredRequested || m_compareFilteredRequested)
+  {
+    auto onReadback = [this, save = m_saveFilteredRequested, compare = m_compareFilteredRequested, plan = m_filterGraph.GetPlan()](
+      const ReadbackRing::Data& data) {
+      OnFilteredImageReadback(data, save, compare, plan);
+    };
+    if (GetReadbackRing()->RequestReadback(commandList.Get(), m_filteredImage.Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, onReadback))
+    {
+      m_saveFilteredRequested = false;
+      m_compareFilteredRequested = false;
+    }
+  }
 
   // 結果を描画する.
   // ルートシグネチャおよびパイプラインステートオブジェクト(PSO)をセット.
@@ -605,7 +590,6 @@ ComPtr<ID3D12GraphicsCommandList>  MyApplication::MakeCommandList()
 
   // 末尾のリソースバリアをセット.
   //  - スワップチェインを表示可能
-  //  - フィルタ処理画像をUAVへ戻す.
   D3D12_RESOURCE_BARRIER barrierFrameEnd[] = {
     {
       .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
@@ -617,26 +601,6 @@ ComPtr<ID3D12GraphicsCommandList>  MyApplication::MakeCommandList()
         .StateAfter = D3D12_RESOURCE_STATE_PRESENT,
       },
     },
-    {
-      .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
-      .Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE,
-      .Transition = {
-        .pResource = m_filteredImage.Get(),
-        .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
-        .StateBefore = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-        .StateAfter = D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-      },
-    },
-    {
-      .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
-      .Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE,
-      .Transition = {
-        .pResource = m_sourceImage.Get(),
-        .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
-        .StateBefore = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-        .StateAfter = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
-      },
-    },
   };
 
   commandList->ResourceBarrier(_countof(barrierFrameEnd), barrierFrameEnd);
@@ -646,39 +610,438 @@ ComPtr<ID3D12GraphicsCommandList>  MyApplication::MakeCommandList()
 
 void MyApplication::FilterImage(ComPtr<ID3D12GraphicsCommandList> commandList)
 {
-  auto& gfxDevice = GetGfxDevice();
-  int frameIndex = gfxDevice->GetFrameIndex();
-  auto cb = m_constantBuffer[frameIndex].buffer;
-
   // フィルター処理をコンピュートシェーダーで行う.
-  commandList->SetComputeRootSignature(m_rootSignatureCS.Get());
-  commandList->SetPipelineState(m_filterPipeline.Get());
-  commandList->SetComputeRootConstantBufferView(0, cb->GetGPUVirtualAddress());
-  commandList->SetComputeRootDescriptorTable(1, m_sourceImageSRV.hGpu);
-  commandList->SetComputeRootDescriptorTable(2, m_filteredImageUAV.hGpu);
-  commandList->Dispatch(m_filterDispatchSize.x, m_filterDispatchSize.y, 1);
+  // チェインの各パスを順に Dispatch し、最後のパスが m_filteredImage へ書き込む.
+  // 結果を作り直すときだけ呼ばれるため、書込み先は表示用の状態から UAV にして使う.
+  D3D12_RESOURCE_BARRIER barrierToUav{
+    .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+    .Transition = {
+      .pResource = m_filteredImage.Get(),
+      .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+      .StateBefore = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+      .StateAfter = D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+    }
+  };
+  commandList->ResourceBarrier(1, &barrierToUav);
+
+  m_filterGraph.Execute(commandList.Get(),
+    m_sourceImage.Get(), m_sourceImageSRV,
+    m_filteredImage.Get(), m_filteredImageUAV);
 
   // 変換完了後のバリアを設定.
-  D3D12_RESOURCE_BARRIER barrierToSrv[] = {
+  D3D12_RESOURCE_BARRIER barrierToSrv{
+    .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+    .Transition = {
+      .pResource = m_filteredImage.Get(),
+      .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+      .StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+      .StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+    }
+  };
+  commandList->ResourceBarrier(1, &barrierToSrv);
+}
+
+void MyApplication::DrawFilterChainUI()
+{
+  // フィルタチェインの編集. 変更があればパスを組み直す.
+  bool changed = false;
+  int removeIndex = -1;
+  int moveFrom = -1, moveTo = -1;
+  for (int i = 0; i < int(m_filterChain.size()); ++i)
+  {
+    auto& node = m_filterChain[i];
+    ImGui::PushID(i);
+    changed |= ImGui::Checkbox("##Enabled", &node.enabled);
+    ImGui::SameLine();
+    bool open = ImGui::TreeNodeEx("Node", ImGuiTreeNodeFlags_DefaultOpen, "%d: %s", i, GetImageFilterName(node.type));
+    ImGui::SameLine();
+    if (ImGui::SmallButton("Up"))
     {
-      .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
-      .Transition = {
-        .pResource = m_filteredImage.Get(),
-        .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
-        .StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-        .StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-      }
-    },
+      moveFrom = i; moveTo = i - 1;
+    }
+    ImGui::SameLine();
+    if (ImGui::SmallButton("Down"))
     {
-      .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
-      .Transition = {
-        .pResource = m_sourceImage.Get(),
-        .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
-        .StateBefore = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
-        .StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+      moveFrom = i; moveTo = i + 1;
+    }
+    ImGui::SameLine();
+    if (ImGui::SmallButton("Remove"))
+    {
+      removeIndex = i;
+    }
+    if (open)
+    {
+      switch (node.type)
+      {
+      case ImageFilterType::Sepia:
+        changed |= ImGui::SliderFloat("Strength", &node.params[0], 0.0f, 1.0f);
+        break;
+      case ImageFilterType::HueShift:
+        changed |= ImGui::SliderFloat("Offset", &node.params[0], 0.0f, 1.0f);
+        break;
+      case ImageFilterType::ColorMatrix:
+        {
+          bool adjusted = false;
+          adjusted |= ImGui::SliderFloat("Brightness", &node.params[0], -0.5f, 0.5f);
+          adjusted |= ImGui::SliderFloat("Contrast", &node.params[1], 0.0f, 2.0f);
+          adjusted |= ImGui::SliderFloat("Saturation", &node.params[2], 0.0f, 2.0f);
+          if (adjusted)
+          {
+            MakeColorAdjustMatrix(node.params[0], node.params[1], node.params[2], node.matrix);
+            changed = true;
+          }
+        }
+        break;
+      case ImageFilterType::ToneMap:
+        {
+          int mode = int(node.params[1]);
+          changed |= ImGui::SliderFloat("Exposure", &node.params[0], -4.0f, 4.0f);
+          if (ImGui::Combo("Operator", &mode, "Reinhard\0ACES\0\0"))
+          {
+            node.params[1] = float(mode);
+            changed = true;
+          }
+        }
+        break;
+      case ImageFilterType::Blur:
+        {
+          int radius = int(node.params[0]);
+          if (ImGui::SliderInt("Radius", &radius, 0, 16))
+          {
+            node.params[0] = float(radius);
+            changed = true;
+          }
+          changed |= ImGui::SliderFloat("Sigma", &node.params[1], 0.0f, 8.0f);
+        }
+        break;
+      case ImageFilterType::Sharpen:
+        changed |= ImGui::SliderFloat("Amount", &node.params[0], 0.0f, 2.0f);
+        break;
+      case ImageFilterType::AutoExposure:
+        changed |= ImGui::SliderFloat("Target", &node.params[0], 0.05f, 0.5f);
+        changed |= ImGui::SliderFloat("Low %", &node.params[1], 0.0f, 100.0f);
+        changed |= ImGui::SliderFloat("High %", &node.params[2], 0.0f, 100.0f);
+        ImGui::Text("Exposure: %+.2f EV", node.params[3]);
+        break;
+      case ImageFilterType::AutoLevels:
+        changed |= ImGui::SliderFloat("Low %", &node.params[0], 0.0f, 10.0f);
+        changed |= ImGui::SliderFloat("High %", &node.params[1], 90.0f, 100.0f);
+        ImGui::Text("Black: %.3f  White: %.3f", node.params[2], node.params[3]);
+        break;
+      default:
+        break;
       }
-    },
+      ImGui::TreePop();
+    }
+    ImGui::PopID();
+  }
+
+  if (removeIndex >= 0)
+  {
+    m_filterChain.erase(m_filterChain.begin() + removeIndex);
+    changed = true;
+  }
+  if (moveFrom >= 0 && moveTo >= 0 && moveTo < int(m_filterChain.size()))
+  {
+    std::swap(m_filterChain[moveFrom], m_filterChain[moveTo]);
+    changed = true;
+  }
+
+  ImGui::Combo("##Filter", &m_filterToAdd, "Sepia\0Hue Shift\0Color Matrix\0Tone Map\0Blur\0Sharpen\0Auto Exposure\0Auto Levels\0\0");
+  ImGui::SameLine();
+  if (ImGui::Button("Add"))
+  {
+    m_filterChain.push_back(MakeImageFilterNode(ImageFilterType(m_filterToAdd)));
+    changed = true;
+  }
+
+  // ぼかしを縦横を入れ替える2パスで行うか. GPU と CPU ベンチマークの両方に反映される.
+  changed |= ImGui::Checkbox("Transposed Blur", &m_filterPlanOptions.transposedBlur);
+  // 1画素の演算を3D LUT にまとめる.
+  int lutMode = m_filterPlanOptions.colorLutSize == 0 ? 0 : (m_filterPlanOptions.colorLutSize == 32 ? 1 : 2);
+  if (ImGui::Combo("Color LUT", &lutMode, "Off\0Size 32\0Size 64\0\0"))
+  {
+    const uint32_t lutSizes[] = { 0, 32, 64 };
+    m_filterPlanOptions.colorLutSize = lutSizes[lutMode];
+    changed = true;
+  }
+
+  if (changed)
+  {
+    // 計測範囲の変更や追加したノードには、受け取り済みのヒストグラムから値を設定する.
+    if (m_histogramReady)
+    {
+      ApplyImageHistogramToChain(m_histogram, m_filterChain);
+    }
+    m_filterGraph.SetChain(m_filterChain, m_filterPlanOptions);
+  }
+  const auto& plan = m_filterGraph.GetPlan();
+  ImGui::Text("Passes: %d  Fused Ops: %d  Transient: %d  LUTs: %d",
+    int(plan.passes.size()), int(plan.ops.size()), int(plan.transientSlotCount), int(plan.colorLutCount));
+  ImGui::Text("Filter Dispatch: %u  Reused: %u",
+    m_filterCache.GetMissCount(), m_filterCache.GetHitCount());
+
+  if (ImGui::CollapsingHeader("Histogram") && m_histogramReady)
+  {
+    float bins[ImageHistogramBinCount];
+    for (uint32_t i = 0; i < ImageHistogramBinCount; ++i)
+    {
+      bins[i] = float(m_histogram.bins[i]);
+    }
+    ImGui::PlotHistogram("##Luminance", bins, int(ImageHistogramBinCount), 0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 80));
+    ImGui::Text("1%%: %.3f  50%%: %.3f  99%%: %.3f",
+      GetImageHistogramPercentile(m_histogram, 1.0f),
+      GetImageHistogramPercentile(m_histogram, 50.0f),
+      GetImageHistogramPercentile(m_histogram, 99.0f));
+    if (ImGui::Button("Verify (CPU)"))
+    {
+      VerifyHistogram();
+    }
+    if (m_histogramMismatch >= 0)
+    {
+      ImGui::SameLine();
+      ImGui::Text("Mismatched pixels: %lld", (long long)m_histogramMismatch);
+    }
+  }
+
+  if (ImGui::CollapsingHeader("Readback"))
+  {
+    m_saveFilteredRequested |= ImGui::Button("Save PNG");
+    ImGui::SameLine();
+    m_compareFilteredRequested |= ImGui::Button("Compare with CPU");
+    if (!m_readbackStatus.empty())
+    {
+      ImGui::TextUnformatted(m_readbackStatus.c_str());
+    }
+    const auto& readbackRing = GetReadbackRing();
+    ImGui::Text("Readback Ring: %.1f / %.1f MB  Pending: %u  Completed: %u  Failed: %u",
+      double(readbackRing->GetUsedSize()) / (1024.0 * 1024.0), double(readbackRing->GetSize()) / (1024.0 * 1024.0),
+      readbackRing->GetPendingCount(), readbackRing->GetCompletedCount(), readbackRing->GetFailedCount());
+  }
+
+  if (ImGui::CollapsingHeader("Tiled"))
+  {
+    ImGui::SliderInt("Tile Size", &m_tileSize, 64, 2048);
+    m_tiledRequested |= ImGui::Button("Run Tiled (GPU)");
+    if (!m_tiledStatus.empty())
+    {
+      ImGui::TextUnformatted(m_tiledStatus.c_str());
+    }
+  }
+
+  if (ImGui::CollapsingHeader("CPU Benchmark"))
+  {
+    if (ImGui::Button("Run"))
+    {
+      RunCpuBenchmark();
+    }
+    for (size_t i = 0; i < m_cpuBenchmarkRgba8.size(); ++i)
+    {
+      ImGui::Text("Threads %2u: RGBA8 %7.1f MPix/s  RGBA32F %7.1f MPix/s",
+        m_cpuBenchmarkRgba8[i].threadCount,
+        m_cpuBenchmarkRgba8[i].GetMegaPixelsPerSecond(),
+        m_cpuBenchmarkRgba32f[i].GetMegaPixelsPerSecond());
+    }
+  }
+}
+
+bool MyApplication::LoadSourcePixels()
+{
+  // CPU で処理するための元画像. GPU へ転送したものと同じファイルを展開しておく.
+  if (!m_sourcePixels.mipLevels.empty())
+  {
+    return true;
+  }
+  std::vector<char> fileData;
+  return GetFileLoader()->Load(L"res/texture/image.png", fileData) &&
+    DecodeImage(fileData.data(), fileData.size(), m_sourcePixels);
+}
+
+void MyApplication::RunCpuBenchmark()
+{
+  // GPU と同じフィルタチェインを CPU で実行し、スレッド数ごとの処理速度を測る.
+  if (!LoadSourcePixels())
+  {
+    return;
+  }
+  const auto& level = m_sourcePixels.mipLevels[0];
+  ImageFilterSurface source8{
+    .format = ImageFilterPixelFormat::RGBA8,
+    .width = level.width,
+    .height = level.height,
+    .rowPitch = level.rowPitch,
+    .data = m_sourcePixels.GetLevelData(0),
+  };
+  std::vector<uint8_t> pixels8(size_t(level.rowPitch) * level.height);
+  auto destination8 = source8;
+  destination8.data = pixels8.data();
+
+  // 浮動小数点の画像は、空のチェイン(形式の変換のみ)で RGBA8 から作る.
+  std::vector<float> source32f(size_t(level.width) * level.height * 4);
+  std::vector<float> pixels32f(source32f.size());
+  ImageFilterSurface source32{
+    .format = ImageFilterPixelFormat::RGBA32F,
+    .width = level.width,
+    .height = level.height,
+    .rowPitch = size_t(level.width) * 16,
+    .data = reinterpret_cast<uint8_t*>(source32f.data()),
   };
-  commandList->ResourceBarrier(_countof(barrierToSrv), barrierToSrv);
+  auto destination32 = source32;
+  destination32.data = reinterpret_cast<uint8_t*>(pixels32f.data());
+  ExecuteImageFilterPlanCpu(PlanImageFilterChain({}), source8, source32);
+
+  // 1, 2, 4, ... と全スレッド.
+  std::vector<uint32_t> threadCounts;
+  const auto maxThreads = GetJobSystem()->GetThreadCount();
+  for (uint32_t count = 1; count < maxThreads; count *= 2)
+  {
+    threadCounts.push_back(count);
+  }
+  threadCounts.push_back(maxThreads);
+
+  const auto& plan = m_filterGraph.GetPlan();
+  const uint32_t iterationCount = 4;
+  m_cpuBenchmarkRgba8 = BenchmarkImageFilterCpu(plan, source8, destination8, threadCounts, iterationCount);
+  m_cpuBenchmarkRgba32f = BenchmarkImageFilterCpu(plan, source32, destination32, threadCounts, iterationCount);
+}
+
+void MyApplication::VerifyHistogram()
+{
+  // GPU で集計したヒストグラムを CPU の集計と比べる.
+  // 輝度の計算順序の違いで、ビンの境界にある画素は隣のビンへ入ることがある.
+  if (!LoadSourcePixels())
+  {
+    return;
+  }
+  const auto& level = m_sourcePixels.mipLevels[0];
+  ImageFilterSurface source{
+    .format = ImageFilterPixelFormat::RGBA8,
+    .width = level.width,
+    .height = level.height,
+    .rowPitch = level.rowPitch,
+    .data = m_sourcePixels.GetLevelData(0),
+  };
+  ImageHistogram reference;
+  ComputeImageHistogram(source, reference);
+
+  int64_t difference = 0;
+  for (uint32_t i = 0; i < ImageHistogramBinCount; ++i)
+  {
+    difference += std::abs(int64_t(m_histogram.bins[i]) - int64_t(reference.bins[i]));
+  }
+  // 1画素のずれで2つのビンの値が変わる.
+  m_histogramMismatch = difference / 2;
 }
 
+void MyApplication::RunTiledFilter()
+{
+  // 表示中のチェインを元画像にタイルごとに適用する. エプロンを含めて読み込むため、画像全体に適用した結果と一致するはず.
+  if (!LoadSourcePixels())
+  {
+    return;
+  }
+  const auto& level = m_sourcePixels.mipLevels[0];
+  ImageFilterSurface source{
+    .format = ImageFilterPixelFormat::RGBA8,
+    .width = level.width,
+    .height = level.height,
+    .rowPitch = level.rowPitch,
+    .data = m_sourcePixels.GetLevelData(0),
+  };
+  std::vector<uint8_t> tiledPixels(size_t(level.rowPitch) * level.height);
+  auto tiled = source;
+  tiled.data = tiledPixels.data();
+
+  m_tiledFilter.SetChain(m_filterChain, m_filterPlanOptions);
+  ImageTilingStats stats;
+  if (!m_tiledFilter.Execute(level.width, level.height, uint32_t(m_tileSize),
+    MakeSurfaceTileReader(source), MakeSurfaceTileWriter(tiled), &stats))
+  {
+    m_tiledStatus = "Tiled filter failed";
+    return;
+  }
+
+  std::vector<uint8_t> referencePixels(tiledPixels.size());
+  auto reference = source;
+  reference.data = referencePixels.data();
+  ExecuteImageFilterPlanCpu(m_tiledFilter.GetPlan(), source, reference);
+  int maxDifference = 0;
+  for (uint32_t y = 0; y < level.height; ++y)
+  {
+    const uint8_t* tiledRow = tiled.GetRow(y);
+    const uint8_t* cpuRow = reference.GetRow(y);
+    for (uint32_t x = 0; x < level.width * 4; ++x)
+    {
+      int difference = std::abs(int(tiledRow[x]) - int(cpuRow[x]));
+      maxDifference = difference > maxDifference ? difference : maxDifference;
+    }
+  }
+
+  char text[192];
+  snprintf(text, sizeof(text), "Tiles: %u (%ux%u)  %.1f ms  Overhead: %.1f%%\nTiled GPU vs CPU: max %d (8bit)",
+    stats.tileCount, m_tiledFilter.GetTextureWidth(), m_tiledFilter.GetTextureHeight(),
+    stats.elapsedMs, stats.GetOverhead() * 100.0, maxDifference);
+  m_tiledStatus = text;
+}
+
+void MyApplication::OnFilteredImageReadback(const ReadbackRing::Data& data, bool save, bool compare, const ImageFilterPlan& plan)
+{
+  if (!data.isTexture || data.footprint.Format != DXGI_FORMAT_R8G8B8A8_UNORM)
+  {
+    m_readbackStatus = "Unsupported format";
+    return;
+  }
+
+  // 読み返した結果を RGBA8 の画像にする. 行のピッチはどちらも 256 バイト単位だが、念のため行ごとにコピーする.
+  DecodedImage image;
+  image.Allocate(data.footprint.Width, data.footprint.Height, 1);
+  const auto& level = image.mipLevels[0];
+  for (uint32_t y = 0; y < level.height; ++y)
+  {
+    memcpy(image.GetLevelData(0) + size_t(level.rowPitch) * y, data.cpuAddress + size_t(data.footprint.RowPitch) * y, size_t(level.width) * 4);
+  }
+
+  m_readbackStatus.clear();
+  if (save)
+  {
+    std::vector<uint8_t> encoded;
+    std::ofstream outfile("filtered.png", std::ios::binary);
+    bool saved = EncodePNG(image, encoded) && outfile.write(reinterpret_cast<const char*>(encoded.data()), encoded.size()).good();
+    m_readbackStatus += saved ? "Saved filtered.png. " : "Failed to save filtered.png. ";
+  }
+
+  // 同じプランを CPU で実行し、画素ごとの差を調べる.
+  if (compare && LoadSourcePixels() && m_sourcePixels.GetWidth() == level.width && m_sourcePixels.GetHeight() == level.height)
+  {
+    const auto& sourceLevel = m_sourcePixels.mipLevels[0];
+    ImageFilterSurface source{
+      .format = ImageFilterPixelFormat::RGBA8,
+      .width = sourceLevel.width,
+      .height = sourceLevel.height,
+      .rowPitch = sourceLevel.rowPitch,
+      .data = m_sourcePixels.GetLevelData(0),
+    };
+    std::vector<uint8_t> pixels(size_t(sourceLevel.rowPitch) * sourceLevel.height);
+    auto reference = source;
+    reference.data = pixels.data();
+    ExecuteImageFilterPlanCpu(plan, source, reference);
+
+    int maxDifference = 0;
+    uint64_t differenceSum = 0;
+    for (uint32_t y = 0; y < level.height; ++y)
+    {
+      const uint8_t* gpuRow = image.GetLevelData(0) + size_t(level.rowPitch) * y;
+      const uint8_t* cpuRow = reference.GetRow(y);
+      for (uint32_t x = 0; x < level.width * 4; ++x)
+      {
+        int difference = std::abs(int(gpuRow[x]) - int(cpuRow[x]));
+        maxDifference = difference > maxDifference ? difference : maxDifference;
+        differenceSum += difference;
+      }
+    }
+    char text[128];
+    snprintf(text, sizeof(text), "GPU vs CPU: max %d, mean %.3f (8bit)",
+      maxDifference, double(differenceSum) / (double(level.width) * level.height * 4));
+    m_readbackStatus += text;
+  }
+}
@@ -7,6 +7,12 @@
 #include <DirectXMath.h>
 
 #include "GfxDevice.h"
+#include "ImageFilterGraph.h"
+#include "ImageFilterCpu.h"
+#include "ImageHistogramPass.h"
+#include "ReadbackRing.h"
+#include "TiledImageFilter.h"
+#include "TextureDecode.h"
 
 class MyApplication 
 {
@@ -29,6 +35,12 @@ private:
 
   void PrepareImGui();
   void DestroyImGui();
+  void DrawFilterChainUI();
+  void RunCpuBenchmark();
+  void VerifyHistogram();
+  void RunTiledFilter();
+  void OnFilteredImageReadback(const ReadbackRing::Data& data, bool save, bool compare, const ImageFilterPlan& plan);
+  bool LoadSourcePixels();
   ComPtr<ID3D12GraphicsCommandList> MakeCommandList();
 
   void FilterImage(ComPtr<ID3D12GraphicsCommandList> commandList);
@@ -40,9 +52,7 @@ private:
   };
 
   ComPtr<ID3D12RootSignature> m_rootSignature;
-  ComPtr<ID3D12RootSignature> m_rootSignatureCS;
   ComPtr<ID3D12PipelineState> m_drawPipeline;
-  ComPtr<ID3D12PipelineState> m_filterPipeline;
 
   ComPtr<ID3D12Resource1> m_sourceImage;
   ComPtr<ID3D12Resource1> m_filteredImage;
@@ -50,10 +60,38 @@ private:
   GfxDevice::DescriptorHandle m_filteredImageSRV;
   GfxDevice::DescriptorHandle m_filteredImageUAV;
 
-  struct FilterDispatchSize
-  {
-    UINT x, y;
-  } m_filterDispatchSize;
+  // 適用するフィルタの並び. UI で編集し、変更のたびに m_filterGraph のパスを組み直す.
+  std::vector<ImageFilterNode> m_filterChain;
+  ImageFilterPlanOptions m_filterPlanOptions;
+  ImageFilterGraph m_filterGraph;
+  int m_filterToAdd = 0;
+  // 元画像とチェインが変わらない間は m_filteredImage を作り直さない.
+  CachedPass m_filterCache;
+
+  // 元画像の輝度ヒストグラム. GPU で集計し、数フレーム後に読み返したものを自動露出などに使う.
+  ImageHistogramPass m_histogramPass;
+  CachedPass m_histogramCache;
+  ImageHistogram m_histogram;
+  bool m_histogramReady = false;
+  // CPU で集計した結果とビンの値が異なる画素の数. 未検証なら負の値.
+  int64_t m_histogramMismatch = -1;
+
+  // フィルタの結果の読み返し. 要求したフレームで読み返しのコピーを記録し、結果は数フレーム後に届く.
+  bool m_saveFilteredRequested = false;
+  bool m_compareFilteredRequested = false;
+  std::string m_readbackStatus;
+
+  // 元画像をタイルに分けて GPU で処理し、画像全体を CPU で処理した結果と比べる.
+  // フレームのコマンドとは別に発行して完了まで待つため、要求されたフレームの描画を発行した後に実行する.
+  TiledImageFilter m_tiledFilter;
+  int m_tileSize = 256;
+  bool m_tiledRequested = false;
+  std::string m_tiledStatus;
+
+  // CPU で同じチェインを実行した場合の処理速度(スレッド数ごと).
+  DecodedImage m_sourcePixels;
+  std::vector<ImageFilterCpuStats> m_cpuBenchmarkRgba8;
+  std::vector<ImageFilterCpuStats> m_cpuBenchmarkRgba32f;
 
   D3D12_VERTEX_BUFFER_VIEW m_vbv;
   ComPtr<ID3D12Resource1> m_vertexBuffer;
@@ -73,12 +111,8 @@ private:
   {
     DirectX::XMFLOAT4X4 mtxView;
     DirectX::XMFLOAT4X4 mtxProj;
-    DirectX::XMFLOAT4 modeParams;
   } m_sceneParams;
 
-  int m_filterMode = 0;
-  float m_hueShift = 0.5f;
-
   float m_frameDeltaAccum = 0.0f;
   std::wstring m_title;
 };
@@ -0,0 +1,280 @@
+﻿#include "BatchMode.h"
+
+#include <shellapi.h>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "ImageBatch.h"
+#include "ImageFilter.h"
+#include "ImageFilterCpu.h"
+#include "ImageHistogram.h"
+#include "ImageTiling.h"
+#include "JobSystem.h"
+
+namespace
+{
+  void PrintUsage()
+  {
+    wprintf(L"usage: ComputeShader.exe --batch <outdir> <input>... [--chain <spec>] [--format png|dds] [--threads N] [--lut 32|64] [--skip-existing] [--tile N]\n");
+    wprintf(L"  chain: sepia[:amount], hue:<turns>, matrix:<brightness>:<contrast>:<saturation>,\n");
+    wprintf(L"         tonemap:<ev>:<0=Reinhard|1=ACES>, blur:<radius>:<sigma>, sharpen[:amount],\n");
+    wprintf(L"         autoexposure[:<target>:<low%%>:<high%%>], autolevels[:<low%%>:<high%%>]\n");
+    wprintf(L"  tile:  streams uncompressed RGBA8 .dds inputs in NxN tiles and writes .dds\n");
+  }
+
+  // 親プロセス(コンソール)があれば標準出力をそちらへつなぐ.
+  void AttachParentConsole()
+  {
+    if (AttachConsole(ATTACH_PARENT_PROCESS))
+    {
+      FILE* fp = nullptr;
+      freopen_s(&fp, "CONOUT$", "w", stdout);
+      freopen_s(&fp, "CONOUT$", "w", stderr);
+    }
+  }
+
+  std::string ToNarrow(const std::wstring& s)
+  {
+    // チェイン指定は ASCII のみなので単純に変換する.
+    std::string result;
+    result.reserve(s.size());
+    for (wchar_t c : s)
+    {
+      result.push_back(c < 0x80 ? char(c) : '?');
+    }
+    return result;
+  }
+
+  // 画像全体を読み込まずに、タイルごとに読み込み・フィルタ・書き出しを行う.
+  // タイルの読み込みと書き出しは、別のタイルのフィルタ処理と並行して進む.
+  // 画像は1枚ずつ処理するため、タイルのフィルタ処理には全スレッドを使う.
+  ImageBatchStats RunTiledBatch(const ImageBatchSettings& settings, const ImageFilterPlan& plan, uint32_t tileSize)
+  {
+    ImageBatchStats stats;
+    auto startTime = std::chrono::high_resolution_clock::now();
+    for (const auto& entry : CollectImageBatchEntries(settings.inputs))
+    {
+      stats.imageCount++;
+      auto output = settings.outputDirectory / entry.relativeOutput;
+      output += L".dds";
+      if (settings.skipExisting && std::filesystem::exists(output))
+      {
+        stats.skippedCount++;
+        wprintf(L"skip %s\n", output.c_str());
+        continue;
+      }
+
+      DdsTileFile source, destination;
+      std::error_code ec;
+      std::filesystem::create_directories(output.parent_path(), ec);
+      if (!source.OpenRead(entry.input))
+      {
+        stats.failedCount++;
+        wprintf(L"FAIL %s (not an uncompressed RGBA8 dds)\n", entry.input.c_str());
+        continue;
+      }
+      ImageTilingStats tilingStats;
+      bool succeeded = destination.Create(output, source.GetWidth(), source.GetHeight(), source.IsSrgb()) &&
+        ExecuteImageFilterPlanTiledCpu(plan, source.GetWidth(), source.GetHeight(), tileSize,
+          source.MakeReader(), destination.MakeWriter(), 0, &tilingStats);
+      destination.Close();
+      if (!succeeded)
+      {
+        stats.failedCount++;
+        wprintf(L"FAIL %s (tile read/write failed)\n", entry.input.c_str());
+        continue;
+      }
+      stats.succeededCount++;
+      stats.pixelCount += tilingStats.pixelCount;
+      stats.filterMs += tilingStats.elapsedMs;
+      wprintf(L"ok   %s (%u tiles, overhead %.1f%%)\n", output.c_str(), tilingStats.tileCount, tilingStats.GetOverhead() * 100.0);
+    }
+    auto endTime = std::chrono::high_resolution_clock::now();
+    stats.elapsedMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+    return stats;
+  }
+}
+
+bool RunBatchMode(LPCWSTR cmdLine, int& exitCode)
+{
+  int argc = 0;
+  LPWSTR* argv = CommandLineToArgvW(cmdLine, &argc);
+  if (argv == nullptr)
+  {
+    return false;
+  }
+  std::vector<std::wstring> args(argv, argv + argc);
+  LocalFree(argv);
+
+  // CommandLineToArgvW は空文字列に対して実行ファイル名を返すため、先頭の引数が --batch かどうかで判定する.
+  if (args.empty() || args[0] != L"--batch")
+  {
+    return false;
+  }
+
+  AttachParentConsole();
+  exitCode = 1;
+
+  ImageBatchSettings settings;
+  std::string chainSpec = "sepia";
+  uint32_t threadCount = 0;
+  ImageFilterPlanOptions planOptions;
+  uint32_t tileSize = 0;
+  for (size_t i = 1; i < args.size(); ++i)
+  {
+    const std::wstring& arg = args[i];
+    bool hasValue = i + 1 < args.size();
+    if (arg == L"--chain" && hasValue)
+    {
+      chainSpec = ToNarrow(args[++i]);
+    }
+    else if (arg == L"--format" && hasValue)
+    {
+      const std::wstring& format = args[++i];
+      if (format == L"png")
+      {
+        settings.outputFormat = ImageBatchOutputFormat::PNG;
+      }
+      else if (format == L"dds")
+      {
+        settings.outputFormat = ImageBatchOutputFormat::DDS;
+      }
+      else
+      {
+        PrintUsage();
+        return true;
+      }
+    }
+    else if (arg == L"--threads" && hasValue)
+    {
+      threadCount = uint32_t(wcstoul(args[++i].c_str(), nullptr, 10));
+    }
+    else if (arg == L"--lut" && hasValue)
+    {
+      planOptions.colorLutSize = uint32_t(wcstoul(args[++i].c_str(), nullptr, 10));
+      if (planOptions.colorLutSize != 32 && planOptions.colorLutSize != 64)
+      {
+        PrintUsage();
+        return true;
+      }
+    }
+    else if (arg == L"--tile" && hasValue)
+    {
+      tileSize = uint32_t(wcstoul(args[++i].c_str(), nullptr, 10));
+      if (tileSize == 0)
+      {
+        PrintUsage();
+        return true;
+      }
+    }
+    else if (arg == L"--skip-existing")
+    {
+      settings.skipExisting = true;
+    }
+    else if (arg.starts_with(L"--"))
+    {
+      PrintUsage();
+      return true;
+    }
+    else if (settings.outputDirectory.empty())
+    {
+      settings.outputDirectory = arg;
+    }
+    else
+    {
+      settings.inputs.push_back(arg);
+    }
+  }
+  if (settings.outputDirectory.empty() || settings.inputs.empty())
+  {
+    PrintUsage();
+    return true;
+  }
+
+  std::vector<ImageFilterNode> chain;
+  if (!ParseImageFilterChain(chainSpec, chain))
+  {
+    wprintf(L"invalid filter chain: %hs\n", chainSpec.c_str());
+    PrintUsage();
+    return true;
+  }
+  ImageFilterPlan plan = PlanImageFilterChain(chain, planOptions);
+  BakeImageFilterColorLuts(plan);
+
+  // GPU を使わないため、デバイスは作らず JobSystem だけを起動する.
+  auto& jobSystem = GetJobSystem();
+  jobSystem->Initialize(threadCount);
+
+  // タイルごとの処理では画像全体のヒストグラムを求められないため、計測を使うフィルタは扱わない.
+  if (tileSize > 0)
+  {
+    if (ImageFilterChainNeedsHistogram(chain))
+    {
+      wprintf(L"--tile does not support autoexposure/autolevels\n");
+      jobSystem->Shutdown();
+      return true;
+    }
+    ImageBatchStats stats = RunTiledBatch(settings, plan, tileSize);
+    jobSystem->Shutdown();
+    wprintf(L"%u images: %u ok, %u skipped, %u failed\n",
+      stats.imageCount, stats.succeededCount, stats.skippedCount, stats.failedCount);
+    wprintf(L"%.1f ms, %.2f MPix/s\n", stats.elapsedMs, stats.GetMegaPixelsPerSecond());
+    exitCode = stats.failedCount == 0 ? 0 : 1;
+    return true;
+  }
+
+  // 自動露出などは画像ごとにヒストグラムを求め、その値でパスを組み直す.
+  if (ImageFilterChainNeedsHistogram(chain))
+  {
+    settings.filter = [&](DecodedImage& image)
+      {
+        const auto& level = image.mipLevels[0];
+        ImageFilterSurface surface{
+          .format = ImageFilterPixelFormat::RGBA8,
+          .width = level.width,
+          .height = level.height,
+          .rowPitch = level.rowPitch,
+          .data = image.GetLevelData(0),
+        };
+        ImageHistogram histogram;
+        ComputeImageHistogram(surface, histogram, settings.filterThreadsPerImage);
+        auto measuredChain = chain;
+        ApplyImageHistogramToChain(histogram, measuredChain);
+        auto measuredPlan = PlanImageFilterChain(measuredChain, planOptions);
+        BakeImageFilterColorLuts(measuredPlan);
+        ExecuteImageFilterPlanCpu(measuredPlan, surface, surface, settings.filterThreadsPerImage);
+        return true;
+      };
+  }
+
+  settings.onItemFinished = [](const ImageBatchItemResult& result)
+    {
+      if (result.skipped)
+      {
+        wprintf(L"skip %s\n", result.output.c_str());
+      }
+      else if (result.succeeded)
+      {
+        wprintf(L"ok   %s\n", result.output.c_str());
+      }
+      else
+      {
+        wprintf(L"FAIL %s (%hs)\n", result.input.c_str(), result.error.c_str());
+      }
+    };
+  ImageBatchStats stats = RunImageBatch(settings, plan);
+  jobSystem->Shutdown();
+
+  wprintf(L"%u images: %u ok, %u skipped, %u failed\n",
+    stats.imageCount, stats.succeededCount, stats.skippedCount, stats.failedCount);
+  wprintf(L"%.1f ms, %.2f images/s, %.2f MPix/s\n",
+    stats.elapsedMs, stats.GetImagesPerSecond(), stats.GetMegaPixelsPerSecond());
+  wprintf(L"stage total: read %.1f ms, decode %.1f ms, filter %.1f ms, encode %.1f ms, write %.1f ms\n",
+    stats.readMs, stats.decodeMs, stats.filterMs, stats.encodeMs, stats.writeMs);
+
+  exitCode = stats.failedCount == 0 ? 0 : 1;
+  return true;
+}
@@ -0,0 +1,12 @@
+﻿#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+// ウィンドウを作らずに画像をまとめてフィルタ処理するモード.
+//   ComputeShader.exe --batch <出力ディレクトリ> <入力ファイルまたはディレクトリ>...
+//     [--chain "sepia,hue:0.3,..."] [--format png|dds] [--threads N] [--lut 32|64] [--skip-existing] [--tile N]
+// --tile を指定すると、RGBA8 の DDS を全体を読み込まずに N 四方のタイルずつ処理し、DDS で書き出す.
+// コマンドラインが --batch で始まらない場合は false を返し、通常どおりウィンドウを作成する.
+bool RunBatchMode(LPCWSTR cmdLine, int& exitCode);
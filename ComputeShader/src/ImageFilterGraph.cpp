@@ -0,0 +1,556 @@
+﻿#include "ImageFilterGraph.h"
+#include "FileLoader.h"
+#include "ImageFilterCpu.h"
+
+#include <algorithm>
+#include <cstring>
+
+// 中間テクスチャの形式. 範囲外の値や精度を保つため半精度浮動小数点とする.
+static const DXGI_FORMAT TransientFormat = DXGI_FORMAT_R16G16B16A16_FLOAT;
+// LUT の形式. 焼き込んだ値をそのまま転送する.
+static const DXGI_FORMAT ColorLutFormat = DXGI_FORMAT_R32G32B32A32_FLOAT;
+
+void ImageFilterGraph::Initialize()
+{
+  auto& gfxDevice = GetGfxDevice();
+  auto& loader = GetFileLoader();
+
+  // ルートシグネチャの作成.
+  // b0: パスの定数, t0: 入力, u0: 出力, t1: 3D LUT, s0: LUT 用のサンプラー.
+  D3D12_DESCRIPTOR_RANGE rangeSrvRanges[] = {
+    {  // t0 入力テクスチャ.
+      .RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV,
+      .NumDescriptors = 1,
+      .BaseShaderRegister = 0,
+      .RegisterSpace = 0,
+      .OffsetInDescriptorsFromTableStart = 0,
+    }
+  };
+  D3D12_DESCRIPTOR_RANGE rangeUavRanges[] = {
+    {  // u0 書込先テクスチャ.
+      .RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV,
+      .NumDescriptors = 1,
+      .BaseShaderRegister = 0,
+      .RegisterSpace = 0,
+      .OffsetInDescriptorsFromTableStart = 0,
+    }
+  };
+
+  D3D12_DESCRIPTOR_RANGE rangeLutRanges[] = {
+    {  // t1 3D LUT.
+      .RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV,
+      .NumDescriptors = 1,
+      .BaseShaderRegister = 1,
+      .RegisterSpace = 0,
+      .OffsetInDescriptorsFromTableStart = 0,
+    }
+  };
+
+  D3D12_ROOT_PARAMETER rootParams[] = {
+    {
+      .ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV,
+      .Constants = {
+        .ShaderRegister = 0,
+        .RegisterSpace = 0,
+      },
+      .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL
+    },
+    {
+      .ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE,
+      .DescriptorTable = {
+        .NumDescriptorRanges = _countof(rangeSrvRanges),
+        .pDescriptorRanges = rangeSrvRanges,
+      },
+      .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL,
+    },
+    {
+      .ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE,
+      .DescriptorTable = {
+        .NumDescriptorRanges = _countof(rangeUavRanges),
+        .pDescriptorRanges = rangeUavRanges,
+      },
+      .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL,
+    },
+    {
+      .ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE,
+      .DescriptorTable = {
+        .NumDescriptorRanges = _countof(rangeLutRanges),
+        .pDescriptorRanges = rangeLutRanges,
+      },
+      .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL,
+    },
+  };
+
+  // LUT は三線形補間で引く.
+  D3D12_STATIC_SAMPLER_DESC staticSamplers[] = {
+    {
+      .Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR,
+      .AddressU = D3D12_TEXTURE_ADDRESS_MODE_CLAMP,
+      .AddressV = D3D12_TEXTURE_ADDRESS_MODE_CLAMP,
+      .AddressW = D3D12_TEXTURE_ADDRESS_MODE_CLAMP,
+      .MipLODBias = 0.0f,
+      .MaxAnisotropy = 0,
+      .ComparisonFunc = D3D12_COMPARISON_FUNC_NEVER,
+      .BorderColor = D3D12_STATIC_BORDER_COLOR_TRANSPARENT_BLACK,
+      .MinLOD = 0.0f,
+      .MaxLOD = 0.0f,
+      .ShaderRegister = 0,
+      .RegisterSpace = 0,
+      .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL,
+    },
+  };
+
+  D3D12_ROOT_SIGNATURE_DESC rootSignatureDesc{
+    .NumParameters = _countof(rootParams),
+    .pParameters = rootParams,
+    .NumStaticSamplers = _countof(staticSamplers),
+    .pStaticSamplers = staticSamplers,
+    .Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE
+  };
+
+  ComPtr<ID3DBlob> signature;
+  ComPtr<ID3DBlob> error;
+  D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error);
+  m_rootSignature = gfxDevice->CreateRootSignature(signature);
+
+  // シェーダーコードの読み込み.
+  std::vector<char> csdata;
+  loader->Load(L"res/shader/ComputeShader.cso", csdata);
+  D3D12_SHADER_BYTECODE cs{
+    .pShaderBytecode = csdata.data(),
+    .BytecodeLength = csdata.size(),
+  };
+  m_groupSize = GfxDevice::GetThreadGroupSize(cs, { 16, 16, 1 });
+
+  D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc{
+    .pRootSignature = m_rootSignature.Get(),
+    .CS = cs,
+    .NodeMask = 1,
+    .CachedPSO = { },
+    .Flags = D3D12_PIPELINE_STATE_FLAG_NONE
+  };
+  m_pipeline = gfxDevice->CreateComputePipelineState(psoDesc);
+
+  // ぼかしのパスは同じルートシグネチャで別のシェーダーを使う.
+  std::vector<char> blurData;
+  loader->Load(L"res/shader/SeparableBlur.cso", blurData);
+  psoDesc.CS = D3D12_SHADER_BYTECODE{
+    .pShaderBytecode = blurData.data(),
+    .BytecodeLength = blurData.size(),
+  };
+  m_blurGroupSize = GfxDevice::GetThreadGroupSize(psoDesc.CS, { 128, 1, 1 });
+  m_blurPipeline = gfxDevice->CreateComputePipelineState(psoDesc);
+
+  CreatePassParameterBuffers(InitialPassCapacity);
+}
+
+void ImageFilterGraph::CreatePassParameterBuffers(UINT passCount)
+{
+  ReleasePassParameterBuffers();
+
+  // パスの定数はフレームごとに 256 バイト単位で並べる. 書込みのため常にマップしておく.
+  auto& gfxDevice = GetGfxDevice();
+  D3D12_RESOURCE_DESC cbResDesc{
+    .Dimension = D3D12_RESOURCE_DIMENSION_BUFFER,
+    .Alignment = 0,
+    .Width = UINT64(PassParametersStride) * passCount,
+    .Height = 1,
+    .DepthOrArraySize = 1,
+    .MipLevels = 1,
+    .Format = DXGI_FORMAT_UNKNOWN,
+    .SampleDesc = {.Count = 1, .Quality = 0},
+    .Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR,
+    .Flags = D3D12_RESOURCE_FLAG_NONE
+  };
+  for (UINT i = 0; i < GfxDevice::BackBufferCount; ++i)
+  {
+    m_passParameterBuffer[i] = gfxDevice->CreateBuffer(cbResDesc, D3D12_HEAP_TYPE_UPLOAD);
+    m_passParameterBuffer[i]->Map(0, nullptr, &m_passParameterMapped[i]);
+  }
+  m_passCapacity = passCount;
+}
+
+void ImageFilterGraph::ReleasePassParameterBuffers()
+{
+  for (UINT i = 0; i < GfxDevice::BackBufferCount; ++i)
+  {
+    if (m_passParameterBuffer[i])
+    {
+      m_passParameterBuffer[i]->Unmap(0, nullptr);
+    }
+    m_passParameterBuffer[i].Reset();
+    m_passParameterMapped[i] = nullptr;
+  }
+  m_passCapacity = 0;
+}
+
+void ImageFilterGraph::Shutdown()
+{
+  auto& gfxDevice = GetGfxDevice();
+  for (auto& texture : m_transientPool)
+  {
+    gfxDevice->DeallocateDescriptor(texture.srv);
+    gfxDevice->DeallocateDescriptor(texture.uav);
+  }
+  m_transientPool.clear();
+  for (auto& texture : m_colorLutPool)
+  {
+    gfxDevice->DeallocateDescriptor(texture.srv);
+  }
+  m_colorLutPool.clear();
+
+  for (UINT i = 0; i < GfxDevice::BackBufferCount; ++i)
+  {
+    if (m_colorLutUploadBuffer[i])
+    {
+      m_colorLutUploadBuffer[i]->Unmap(0, nullptr);
+    }
+    m_colorLutUploadBuffer[i].Reset();
+    m_colorLutUploadMapped[i] = nullptr;
+  }
+  ReleasePassParameterBuffers();
+  m_pipeline.Reset();
+  m_blurPipeline.Reset();
+  m_rootSignature.Reset();
+}
+
+void ImageFilterGraph::SetChain(const std::vector<ImageFilterNode>& chain, const ImageFilterPlanOptions& options)
+{
+  m_plan = PlanImageFilterChain(chain, options);
+  if (m_plan.passes.size() > m_passCapacity)
+  {
+    // パスを削るとスロットの割り当てや縦横の入れ替えが崩れるため、定数の領域の方を広げる.
+    // 以前のフレームが参照しているバッファを破棄するので、GPU の完了を待つ. 長さは倍々に増やして待つ回数を抑える.
+    GetGfxDevice()->WaitForGPU();
+    CreatePassParameterBuffers(std::max(UINT(m_plan.passes.size()), m_passCapacity * 2));
+  }
+  // LUT はチェインを変えたときにだけ焼き込み、次の Execute で転送する.
+  BakeImageFilterColorLuts(m_plan);
+  m_colorLutDirty = m_plan.colorLutCount > 0;
+  // LUT の中身は ops から決まるため含めない.
+  m_planHash = HashBuilder().Add(m_plan.ops).Add(m_plan.passes).Add(m_plan.colorLutSize).Get();
+}
+
+std::vector<ImageFilterGraph::TransientTexture*> ImageFilterGraph::AcquireTransientTextures(const ImageFilterPlan& plan, UINT64 width, UINT height)
+{
+  // 追加でポインタが無効になるため、プール内の番号で割り当ててから最後にポインタへ変換する.
+  std::vector<size_t> assigned;
+  std::vector<bool> used(m_transientPool.size(), false);
+  auto& gfxDevice = GetGfxDevice();
+  for (UINT slot = 0; slot < plan.transientSlotCount; ++slot)
+  {
+    const bool transposed = plan.transientSlotTransposed[slot];
+    const UINT64 slotWidth = transposed ? height : width;
+    const UINT slotHeight = transposed ? UINT(width) : height;
+    size_t found = m_transientPool.size();
+    for (size_t i = 0; i < m_transientPool.size(); ++i)
+    {
+      if (!used[i] && m_transientPool[i].width == slotWidth && m_transientPool[i].height == slotHeight)
+      {
+        found = i;
+        break;
+      }
+    }
+    if (found < m_transientPool.size())
+    {
+      used[found] = true;
+      assigned.push_back(found);
+      continue;
+    }
+
+    // 足りない分を作成する.
+    D3D12_RESOURCE_DESC resDesc{
+      .Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D,
+      .Alignment = 0,
+      .Width = slotWidth,
+      .Height = slotHeight,
+      .DepthOrArraySize = 1,
+      .MipLevels = 1,
+      .Format = TransientFormat,
+      .SampleDesc = {.Count = 1, .Quality = 0 },
+      .Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN,
+      .Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+    };
+    D3D12_HEAP_PROPERTIES heapProps{
+      .Type = D3D12_HEAP_TYPE_DEFAULT,
+    };
+    TransientTexture texture{
+      .resource = gfxDevice->CreateImage2D(resDesc, heapProps, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr),
+      .state = D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+      .width = slotWidth,
+      .height = slotHeight,
+    };
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{
+      .Format = TransientFormat,
+      .ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D,
+      .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
+      .Texture2D = {
+        .MostDetailedMip = 0,
+        .MipLevels = 1,
+        .PlaneSlice = 0,
+        .ResourceMinLODClamp = 0,
+      }
+    };
+    D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc{
+      .Format = TransientFormat,
+      .ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D,
+      .Texture2D = {
+        .MipSlice = 0, .PlaneSlice = 0,
+      }
+    };
+    texture.srv = gfxDevice->CreateShaderResourceView(texture.resource, srvDesc);
+    texture.uav = gfxDevice->CreateUnorderedAccessView(texture.resource, uavDesc);
+    m_transientPool.push_back(texture);
+    used.push_back(true);
+    assigned.push_back(m_transientPool.size() - 1);
+  }
+
+  std::vector<TransientTexture*> result;
+  for (auto index : assigned)
+  {
+    result.push_back(&m_transientPool[index]);
+  }
+  return result;
+}
+
+ImageFilterGraph::ColorLutTexture* ImageFilterGraph::AcquireColorLutTexture(UINT size, UINT count)
+{
+  for (auto& texture : m_colorLutPool)
+  {
+    if (texture.size == size && texture.count == count)
+    {
+      return &texture;
+    }
+  }
+
+  auto& gfxDevice = GetGfxDevice();
+  D3D12_RESOURCE_DESC resDesc{
+    .Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE3D,
+    .Alignment = 0,
+    .Width = size,
+    .Height = size,
+    .DepthOrArraySize = UINT16(size * count),
+    .MipLevels = 1,
+    .Format = ColorLutFormat,
+    .SampleDesc = {.Count = 1, .Quality = 0 },
+    .Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN,
+    .Flags = D3D12_RESOURCE_FLAG_NONE,
+  };
+  D3D12_HEAP_PROPERTIES heapProps{
+    .Type = D3D12_HEAP_TYPE_DEFAULT,
+  };
+  ColorLutTexture texture{
+    .resource = gfxDevice->CreateImage2D(resDesc, heapProps, D3D12_RESOURCE_STATE_COPY_DEST, nullptr),
+    .state = D3D12_RESOURCE_STATE_COPY_DEST,
+    .size = size,
+    .count = count,
+  };
+  D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{
+    .Format = ColorLutFormat,
+    .ViewDimension = D3D12_SRV_DIMENSION_TEXTURE3D,
+    .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
+    .Texture3D = {
+      .MostDetailedMip = 0,
+      .MipLevels = 1,
+      .ResourceMinLODClamp = 0,
+    }
+  };
+  texture.srv = gfxDevice->CreateShaderResourceView(texture.resource, srvDesc);
+  m_colorLutPool.push_back(texture);
+  return &m_colorLutPool.back();
+}
+
+void ImageFilterGraph::UploadColorLut(ID3D12GraphicsCommandList* commandList, ColorLutTexture* texture)
+{
+  auto& gfxDevice = GetGfxDevice();
+  auto d3d12Device = gfxDevice->GetD3D12Device();
+  const auto frameIndex = gfxDevice->GetFrameIndex();
+  const auto resDesc = texture->resource->GetDesc();
+  D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint{};
+  UINT rowCount = 0;
+  UINT64 rowSize = 0, totalSize = 0;
+  d3d12Device->GetCopyableFootprints(&resDesc, 0, 1, 0, &footprint, &rowCount, &rowSize, &totalSize);
+
+  // このフレームの転送元が足りなければ作り直す. 同じフレーム番号の以前の転送は完了している.
+  auto& uploadBuffer = m_colorLutUploadBuffer[frameIndex];
+  if (!uploadBuffer || uploadBuffer->GetDesc().Width < totalSize)
+  {
+    if (uploadBuffer)
+    {
+      uploadBuffer->Unmap(0, nullptr);
+    }
+    D3D12_RESOURCE_DESC bufferDesc{
+      .Dimension = D3D12_RESOURCE_DIMENSION_BUFFER,
+      .Alignment = 0,
+      .Width = totalSize,
+      .Height = 1,
+      .DepthOrArraySize = 1,
+      .MipLevels = 1,
+      .Format = DXGI_FORMAT_UNKNOWN,
+      .SampleDesc = {.Count = 1, .Quality = 0},
+      .Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR,
+      .Flags = D3D12_RESOURCE_FLAG_NONE
+    };
+    uploadBuffer = gfxDevice->CreateBuffer(bufferDesc, D3D12_HEAP_TYPE_UPLOAD);
+    uploadBuffer->Map(0, nullptr, &m_colorLutUploadMapped[frameIndex]);
+  }
+
+  // 焼き込んだ LUT は隙間なく並んでいるため、行ごとにフットプリントの配置へ写す.
+  auto mapped = static_cast<uint8_t*>(m_colorLutUploadMapped[frameIndex]) + footprint.Offset;
+  const auto src = reinterpret_cast<const uint8_t*>(m_plan.colorLutTexels.data());
+  const size_t srcRowSize = size_t(texture->size) * sizeof(float) * 4;
+  for (UINT row = 0; row < rowCount * footprint.Footprint.Depth; ++row)
+  {
+    memcpy(mapped + size_t(footprint.Footprint.RowPitch) * row, src + srcRowSize * row, srcRowSize);
+  }
+
+  if (texture->state != D3D12_RESOURCE_STATE_COPY_DEST)
+  {
+    D3D12_RESOURCE_BARRIER barrier{
+      .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+      .Transition = {
+        .pResource = texture->resource.Get(),
+        .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+        .StateBefore = texture->state,
+        .StateAfter = D3D12_RESOURCE_STATE_COPY_DEST,
+      }
+    };
+    commandList->ResourceBarrier(1, &barrier);
+    texture->state = D3D12_RESOURCE_STATE_COPY_DEST;
+  }
+  D3D12_TEXTURE_COPY_LOCATION dst{
+    .pResource = texture->resource.Get(),
+    .Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX,
+    .SubresourceIndex = 0,
+  };
+  D3D12_TEXTURE_COPY_LOCATION srcLocation{
+    .pResource = uploadBuffer.Get(),
+    .Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT,
+    .PlacedFootprint = footprint,
+  };
+  commandList->CopyTextureRegion(&dst, 0, 0, 0, &srcLocation, nullptr);
+}
+
+void ImageFilterGraph::Execute(ID3D12GraphicsCommandList* commandList,
+  ID3D12Resource* source, const GfxDevice::DescriptorHandle& sourceSrv,
+  ID3D12Resource* destination, const GfxDevice::DescriptorHandle& destinationUav)
+{
+  auto& gfxDevice = GetGfxDevice();
+  const auto frameIndex = gfxDevice->GetFrameIndex();
+  const auto destDesc = destination->GetDesc();
+  auto transients = AcquireTransientTextures(m_plan, destDesc.Width, destDesc.Height);
+
+  // LUT を使わないプランでもルートパラメータは設定するため、その場合は最小のものを割り当てる.
+  const bool useColorLut = m_plan.colorLutCount > 0;
+  auto colorLut = AcquireColorLutTexture(useColorLut ? m_plan.colorLutSize : 2, useColorLut ? m_plan.colorLutCount : 1);
+  if (useColorLut && m_colorLutDirty)
+  {
+    UploadColorLut(commandList, colorLut);
+    m_colorLutDirty = false;
+  }
+  if (colorLut->state != D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE)
+  {
+    D3D12_RESOURCE_BARRIER barrier{
+      .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+      .Transition = {
+        .pResource = colorLut->resource.Get(),
+        .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+        .StateBefore = colorLut->state,
+        .StateAfter = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+      }
+    };
+    commandList->ResourceBarrier(1, &barrier);
+    colorLut->state = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+  }
+
+  commandList->SetComputeRootSignature(m_rootSignature.Get());
+  ID3D12PipelineState* currentPipeline = nullptr;
+
+  auto cbBase = m_passParameterBuffer[frameIndex]->GetGPUVirtualAddress();
+  auto mapped = static_cast<uint8_t*>(m_passParameterMapped[frameIndex]);
+  for (size_t passIndex = 0; passIndex < m_plan.passes.size(); ++passIndex)
+  {
+    const auto& pass = m_plan.passes[passIndex];
+
+    // 中間テクスチャを読み書きできる状態にする.
+    std::vector<D3D12_RESOURCE_BARRIER> barriers;
+    auto transition = [&](TransientTexture* texture, D3D12_RESOURCE_STATES state) {
+      if (texture->state != state)
+      {
+        barriers.push_back(D3D12_RESOURCE_BARRIER{
+          .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+          .Transition = {
+            .pResource = texture->resource.Get(),
+            .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+            .StateBefore = texture->state,
+            .StateAfter = state,
+          }
+        });
+        texture->state = state;
+      }
+    };
+    auto srv = sourceSrv;
+    auto uav = destinationUav;
+    if (pass.input >= 0)
+    {
+      transition(transients[pass.input], D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+      srv = transients[pass.input]->srv;
+    }
+    if (pass.output >= 0)
+    {
+      transition(transients[pass.output], D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+      uav = transients[pass.output]->uav;
+    }
+    if (!barriers.empty())
+    {
+      commandList->ResourceBarrier(UINT(barriers.size()), barriers.data());
+    }
+
+    PassParameters params{
+      .kernel = pass.kernel,
+      .opCount = pass.opCount,
+      .colorLut = pass.colorLut,
+      .colorLutSize = m_plan.colorLutSize,
+    };
+    std::copy_n(pass.kernelParams, 4, params.kernelParams);
+    std::copy_n(m_plan.ops.begin() + pass.firstOp, pass.opCount, params.ops);
+    memcpy(mapped + PassParametersStride * passIndex, &params, sizeof(params));
+
+    commandList->SetComputeRootConstantBufferView(0, cbBase + PassParametersStride * passIndex);
+    commandList->SetComputeRootDescriptorTable(1, srv.hGpu);
+    commandList->SetComputeRootDescriptorTable(2, uav.hGpu);
+    commandList->SetComputeRootDescriptorTable(3, colorLut->srv.hGpu);
+
+    const bool blur = IsBlurImageFilterKernel(pass.kernel);
+    auto pipeline = blur ? m_blurPipeline.Get() : m_pipeline.Get();
+    if (pipeline != currentPipeline)
+    {
+      commandList->SetPipelineState(pipeline);
+      currentPipeline = pipeline;
+    }
+    if (blur)
+    {
+      // 1グループで入力の1行(垂直方向なら1列)の m_blurGroupSize.x 画素を処理する.
+      UINT64 inputWidth = destDesc.Width;
+      UINT inputHeight = destDesc.Height;
+      if (pass.input >= 0)
+      {
+        inputWidth = transients[pass.input]->width;
+        inputHeight = transients[pass.input]->height;
+      }
+      if (pass.kernel == ImageFilterKernel::BlurVertical)
+      {
+        GfxDevice::Dispatch(commandList, m_blurGroupSize, inputHeight, UINT(inputWidth));
+      }
+      else
+      {
+        GfxDevice::Dispatch(commandList, m_blurGroupSize, UINT(inputWidth), inputHeight);
+      }
+    }
+    else
+    {
+      // 1ピクセル1スレッドで処理する.
+      GfxDevice::DispatchForResource(commandList, m_groupSize, destination);
+    }
+  }
+}
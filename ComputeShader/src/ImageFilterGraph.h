@@ -0,0 +1,106 @@
+﻿#pragma once
+#include <vector>
+#include <wrl.h>
+#include <d3d12.h>
+
+#include "CachedPass.h"
+#include "GfxDevice.h"
+#include "ImageFilter.h"
+
+// フィルタチェインをコンピュートシェーダーで実行する.
+// チェインは PlanImageFilterChain でパスに変換し、1画素フィルタは1回の Dispatch にまとめる.
+// パス間の中間テクスチャはプールから割り当て、生存区間の重ならないパスで使い回す.
+// ぼかしのパスは groupshared メモリでタイル化した SeparableBlur.hlsl で実行する.
+// 1画素の演算を3D LUT にまとめたパスは、チェイン設定時に焼き込んだ LUT を1回引くだけで済ませる.
+class ImageFilterGraph
+{
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+public:
+  void Initialize();
+  void Shutdown();
+
+  // 実行するフィルタチェインを設定する. パスの構成はここで決まる.
+  void SetChain(const std::vector<ImageFilterNode>& chain, const ImageFilterPlanOptions& options = {});
+  const ImageFilterPlan& GetPlan() const { return m_plan; }
+  // パスの構成と定数のハッシュ. 結果を使い回せるかの判定(CachedPass のキー)に使う.
+  uint64_t GetPlanHash() const { return m_planHash; }
+  // プールに確保済みの中間テクスチャの数.
+  UINT GetTransientTextureCount() const { return UINT(m_transientPool.size()); }
+
+  // source にフィルタを適用して destination へ書き込むコマンドを記録する.
+  // source は D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE を含む状態, destination は D3D12_RESOURCE_STATE_UNORDERED_ACCESS にしておくこと.
+  // destination と同じ大きさで処理する. ディスクリプタヒープは設定済みであること.
+  void Execute(ID3D12GraphicsCommandList* commandList,
+    ID3D12Resource* source, const GfxDevice::DescriptorHandle& sourceSrv,
+    ID3D12Resource* destination, const GfxDevice::DescriptorHandle& destinationUav);
+
+private:
+  // 1パスの定数. シェーダーの FilterPassParameters と同じ並び.
+  struct PassParameters
+  {
+    ImageFilterKernel kernel;
+    UINT opCount;
+    INT colorLut;
+    UINT colorLutSize;
+    float kernelParams[4];
+    ImageFilterOp ops[ImageFilterMaxOpsPerPass];
+  };
+  static const UINT PassParametersStride = (sizeof(PassParameters) + 255) & ~255u;
+  // パス定数の領域の初期のパス数. これより長いプランを設定したときに作り直す.
+  static const UINT InitialPassCapacity = 32;
+
+  struct TransientTexture
+  {
+    ComPtr<ID3D12Resource1> resource;
+    GfxDevice::DescriptorHandle srv;
+    GfxDevice::DescriptorHandle uav;
+    D3D12_RESOURCE_STATES state;
+    UINT64 width;
+    UINT height;
+  };
+  // プランの各スロットに大きさの合う中間テクスチャを割り当て、スロット順に返す.
+  // 縦横を入れ替えるスロットは width と height を入れ替えた大きさになる.
+  std::vector<TransientTexture*> AcquireTransientTextures(const ImageFilterPlan& plan, UINT64 width, UINT height);
+
+  // 奥行き方向に count 個の LUT を並べた3Dテクスチャ.
+  struct ColorLutTexture
+  {
+    ComPtr<ID3D12Resource1> resource;
+    GfxDevice::DescriptorHandle srv;
+    D3D12_RESOURCE_STATES state;
+    UINT size;
+    UINT count;
+  };
+  // passCount 個のパス定数が入るフレームごとのバッファを作成する. 既存のものは破棄する.
+  void CreatePassParameterBuffers(UINT passCount);
+  void ReleasePassParameterBuffers();
+
+  // 大きさと数の合う LUT テクスチャを返す. 無ければ作成する.
+  ColorLutTexture* AcquireColorLutTexture(UINT size, UINT count);
+  // m_plan.colorLutTexels を texture へ転送するコマンドを記録する.
+  void UploadColorLut(ID3D12GraphicsCommandList* commandList, ColorLutTexture* texture);
+
+  ComPtr<ID3D12RootSignature> m_rootSignature;
+  ComPtr<ID3D12PipelineState> m_pipeline;
+  ThreadGroupSize m_groupSize = { 16, 16, 1 };
+  // ぼかし. x が1グループで処理する線分の長さ.
+  ComPtr<ID3D12PipelineState> m_blurPipeline;
+  ThreadGroupSize m_blurGroupSize = { 128, 1, 1 };
+
+  // フレームごとのパス定数. 書込み中のフレームのものだけを更新する.
+  ComPtr<ID3D12Resource1> m_passParameterBuffer[GfxDevice::BackBufferCount];
+  void* m_passParameterMapped[GfxDevice::BackBufferCount] = { };
+  UINT m_passCapacity = 0;
+
+  ImageFilterPlan m_plan;
+  uint64_t m_planHash = 0;
+  // 大きさの異なる中間テクスチャも保持しておき、GPU が使用中のものを破棄しない.
+  std::vector<TransientTexture> m_transientPool;
+
+  std::vector<ColorLutTexture> m_colorLutPool;
+  // LUT の転送元. チェインを変更したフレームでだけ書き込む.
+  ComPtr<ID3D12Resource1> m_colorLutUploadBuffer[GfxDevice::BackBufferCount];
+  void* m_colorLutUploadMapped[GfxDevice::BackBufferCount] = { };
+  bool m_colorLutDirty = false;
+};
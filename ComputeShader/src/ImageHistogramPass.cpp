@@ -0,0 +1,155 @@
+﻿#include "ImageHistogramPass.h"
+#include "FileLoader.h"
+#include "ReadbackRing.h"
+
+#include <cstring>
+#include <vector>
+
+void ImageHistogramPass::Initialize()
+{
+  auto& gfxDevice = GetGfxDevice();
+  auto& loader = GetFileLoader();
+
+  // ルートシグネチャの作成.
+  // t0: 入力, u0: 集計先(ディスクリプタを使わずにアドレスで渡す).
+  D3D12_DESCRIPTOR_RANGE rangeSrvRanges[] = {
+    {  // t0 入力テクスチャ.
+      .RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV,
+      .NumDescriptors = 1,
+      .BaseShaderRegister = 0,
+      .RegisterSpace = 0,
+      .OffsetInDescriptorsFromTableStart = 0,
+    }
+  };
+  D3D12_ROOT_PARAMETER rootParams[] = {
+    {
+      .ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE,
+      .DescriptorTable = {
+        .NumDescriptorRanges = _countof(rangeSrvRanges),
+        .pDescriptorRanges = rangeSrvRanges,
+      },
+      .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL,
+    },
+    {
+      .ParameterType = D3D12_ROOT_PARAMETER_TYPE_UAV,
+      .Descriptor = {
+        .ShaderRegister = 0,
+        .RegisterSpace = 0,
+      },
+      .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL,
+    },
+  };
+  D3D12_ROOT_SIGNATURE_DESC rootSignatureDesc{
+    .NumParameters = _countof(rootParams),
+    .pParameters = rootParams,
+    .NumStaticSamplers = 0,
+    .pStaticSamplers = nullptr,
+    .Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE
+  };
+
+  ComPtr<ID3DBlob> signature;
+  ComPtr<ID3DBlob> error;
+  D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error);
+  m_rootSignature = gfxDevice->CreateRootSignature(signature);
+
+  std::vector<char> csdata;
+  loader->Load(L"res/shader/Histogram.cso", csdata);
+  D3D12_SHADER_BYTECODE cs{
+    .pShaderBytecode = csdata.data(),
+    .BytecodeLength = csdata.size(),
+  };
+  m_groupSize = GfxDevice::GetThreadGroupSize(cs, { 16, 16, 1 });
+
+  D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc{
+    .pRootSignature = m_rootSignature.Get(),
+    .CS = cs,
+    .NodeMask = 1,
+    .CachedPSO = { },
+    .Flags = D3D12_PIPELINE_STATE_FLAG_NONE
+  };
+  m_pipeline = gfxDevice->CreateComputePipelineState(psoDesc);
+
+  D3D12_RESOURCE_DESC resDesc{
+    .Dimension = D3D12_RESOURCE_DIMENSION_BUFFER,
+    .Alignment = 0,
+    .Width = HistogramBufferSize,
+    .Height = 1,
+    .DepthOrArraySize = 1,
+    .MipLevels = 1,
+    .Format = DXGI_FORMAT_UNKNOWN,
+    .SampleDesc = {.Count = 1, .Quality = 0},
+    .Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR,
+    .Flags = D3D12_RESOURCE_FLAG_NONE
+  };
+  const std::vector<uint32_t> zero(ImageHistogramBinCount, 0);
+  m_zeroBuffer = gfxDevice->CreateBuffer(resDesc, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ, zero.data());
+  resDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+  m_histogramBuffer = gfxDevice->CreateBuffer(resDesc, D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_STATE_COPY_DEST);
+}
+
+void ImageHistogramPass::Shutdown()
+{
+  m_histogramBuffer.Reset();
+  m_zeroBuffer.Reset();
+  m_pipeline.Reset();
+  m_rootSignature.Reset();
+}
+
+bool ImageHistogramPass::Dispatch(ID3D12GraphicsCommandList* commandList, ID3D12Resource* source, const GfxDevice::DescriptorHandle& sourceSrv,
+  Callback callback)
+{
+  auto& readbackRing = GetReadbackRing();
+  if (!readbackRing->IsInitialized())
+  {
+    return false;
+  }
+
+  // 前回の集計結果を 0 で上書きしてから数える.
+  commandList->CopyBufferRegion(m_histogramBuffer.Get(), 0, m_zeroBuffer.Get(), 0, HistogramBufferSize);
+  D3D12_RESOURCE_BARRIER barrierToUav{
+    .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+    .Transition = {
+      .pResource = m_histogramBuffer.Get(),
+      .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+      .StateBefore = D3D12_RESOURCE_STATE_COPY_DEST,
+      .StateAfter = D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+    }
+  };
+  commandList->ResourceBarrier(1, &barrierToUav);
+
+  commandList->SetComputeRootSignature(m_rootSignature.Get());
+  commandList->SetPipelineState(m_pipeline.Get());
+  commandList->SetComputeRootDescriptorTable(0, sourceSrv.hGpu);
+  commandList->SetComputeRootUnorderedAccessView(1, m_histogramBuffer->GetGPUVirtualAddress());
+  GfxDevice::DispatchForResource(commandList, m_groupSize, source);
+
+  // 読み返しのコピーを記録し、次の集計に備えてコピー先の状態へ戻す.
+  // 読み返しの領域が無い場合も、集計先の状態は元に戻しておく.
+  D3D12_RESOURCE_BARRIER barrierToCopySource{
+    .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+    .Transition = {
+      .pResource = m_histogramBuffer.Get(),
+      .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+      .StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+      .StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE,
+    }
+  };
+  commandList->ResourceBarrier(1, &barrierToCopySource);
+  const bool requested = readbackRing->RequestReadback(commandList, m_histogramBuffer.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE,
+    [callback = std::move(callback)](const ReadbackRing::Data& data) {
+      ImageHistogram histogram;
+      std::memcpy(histogram.bins, data.cpuAddress, HistogramBufferSize);
+      callback(histogram);
+    });
+  D3D12_RESOURCE_BARRIER barrierToCopyDest{
+    .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+    .Transition = {
+      .pResource = m_histogramBuffer.Get(),
+      .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+      .StateBefore = D3D12_RESOURCE_STATE_COPY_SOURCE,
+      .StateAfter = D3D12_RESOURCE_STATE_COPY_DEST,
+    }
+  };
+  commandList->ResourceBarrier(1, &barrierToCopyDest);
+  return requested;
+}
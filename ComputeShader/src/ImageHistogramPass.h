@@ -0,0 +1,38 @@
+﻿#pragma once
+#include <functional>
+#include <wrl.h>
+#include <d3d12.h>
+
+#include "GfxDevice.h"
+#include "ImageHistogram.h"
+
+// 輝度ヒストグラムをコンピュートシェーダー(Histogram.hlsl)で集計し、ReadbackRing で CPU へ読み返す.
+// GPU の完了を待たないため、結果は数フレーム後の ReadbackRing::Update で届く.
+class ImageHistogramPass
+{
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+public:
+  using Callback = std::function<void(const ImageHistogram& histogram)>;
+
+  void Initialize();
+  void Shutdown();
+
+  // source の mip0 のヒストグラムを集計し、読み返すコマンドを記録する. 読み返した結果を callback に渡す.
+  // source は D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE を含む状態にしておくこと.
+  // ディスクリプタヒープは設定済みであること. 読み返しの領域を確保できなければ何も記録せずに false を返す.
+  bool Dispatch(ID3D12GraphicsCommandList* commandList, ID3D12Resource* source, const GfxDevice::DescriptorHandle& sourceSrv,
+    Callback callback);
+
+private:
+  static const UINT HistogramBufferSize = ImageHistogramBinCount * sizeof(uint32_t);
+
+  ComPtr<ID3D12RootSignature> m_rootSignature;
+  ComPtr<ID3D12PipelineState> m_pipeline;
+  ThreadGroupSize m_groupSize = { 16, 16, 1 };
+
+  // 集計先. 使用しないときは D3D12_RESOURCE_STATE_COPY_DEST にしておく.
+  ComPtr<ID3D12Resource1> m_histogramBuffer;
+  // 集計前にコピーして 0 にするための転送元.
+  ComPtr<ID3D12Resource1> m_zeroBuffer;
+};
@@ -0,0 +1,315 @@
+﻿#include "TiledImageFilter.h"
+
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+void TiledImageFilter::Initialize()
+{
+  auto& gfxDevice = GetGfxDevice();
+  auto d3d12Device = gfxDevice->GetD3D12Device();
+  m_graph.Initialize();
+
+  // タイルのコマンドはフレームとは独立に発行するため、スロットごとにアロケーターを持つ.
+  for (auto& slot : m_slots)
+  {
+    if (FAILED(d3d12Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&slot.commandAllocator))) ||
+      FAILED(d3d12Device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, slot.commandAllocator.Get(), nullptr, IID_PPV_ARGS(&slot.commandList))))
+    {
+      throw std::runtime_error("Failed to create the command list for tiles.");
+    }
+    slot.commandList->Close();
+  }
+  if (FAILED(d3d12Device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence))))
+  {
+    throw std::runtime_error("Failed to create the fence for tiles.");
+  }
+  m_fenceValue = 0;
+}
+
+void TiledImageFilter::Shutdown()
+{
+  for (const auto& slot : m_slots)
+  {
+    WaitForSlot(slot);
+  }
+  ReleaseSlotResources();
+  for (auto& slot : m_slots)
+  {
+    slot.commandList.Reset();
+    slot.commandAllocator.Reset();
+  }
+  m_fence.Reset();
+  m_graph.Shutdown();
+}
+
+void TiledImageFilter::SetChain(const std::vector<ImageFilterNode>& chain, const ImageFilterPlanOptions& options)
+{
+  m_graph.SetChain(chain, options);
+}
+
+void TiledImageFilter::ReleaseSlotResources()
+{
+  auto& gfxDevice = GetGfxDevice();
+  for (auto& slot : m_slots)
+  {
+    if (slot.source)
+    {
+      gfxDevice->DeallocateDescriptor(slot.sourceSrv);
+      gfxDevice->DeallocateDescriptor(slot.destinationUav);
+    }
+    slot.source.Reset();
+    slot.destination.Reset();
+    slot.uploadBuffer.Reset();
+    slot.readbackBuffer.Reset();
+    slot.uploadMapped = nullptr;
+    slot.readbackMapped = nullptr;
+    slot.tileIndex = -1;
+  }
+  m_textureWidth = m_textureHeight = 0;
+}
+
+void TiledImageFilter::PrepareSlots(uint32_t width, uint32_t height)
+{
+  if (m_textureWidth == width && m_textureHeight == height)
+  {
+    return;
+  }
+  ReleaseSlotResources();
+
+  auto& gfxDevice = GetGfxDevice();
+  D3D12_RESOURCE_DESC texDesc{
+    .Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D,
+    .Alignment = 0,
+    .Width = width,
+    .Height = height,
+    .DepthOrArraySize = 1,
+    .MipLevels = 1,
+    .Format = TextureFormat,
+    .SampleDesc = {.Count = 1, .Quality = 0 },
+    .Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN,
+    .Flags = D3D12_RESOURCE_FLAG_NONE,
+  };
+  UINT64 bufferSize = 0;
+  gfxDevice->GetD3D12Device()->GetCopyableFootprints(&texDesc, 0, 1, 0, &m_footprint, nullptr, nullptr, &bufferSize);
+  D3D12_RESOURCE_DESC bufferDesc{
+    .Dimension = D3D12_RESOURCE_DIMENSION_BUFFER,
+    .Alignment = 0,
+    .Width = bufferSize,
+    .Height = 1,
+    .DepthOrArraySize = 1,
+    .MipLevels = 1,
+    .Format = DXGI_FORMAT_UNKNOWN,
+    .SampleDesc = {.Count = 1, .Quality = 0},
+    .Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR,
+    .Flags = D3D12_RESOURCE_FLAG_NONE
+  };
+  D3D12_HEAP_PROPERTIES heapProps{
+    .Type = D3D12_HEAP_TYPE_DEFAULT,
+  };
+  D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{
+    .Format = TextureFormat,
+    .ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D,
+    .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
+    .Texture2D = {
+      .MostDetailedMip = 0,
+      .MipLevels = 1,
+      .PlaneSlice = 0,
+      .ResourceMinLODClamp = 0,
+    }
+  };
+  D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc{
+    .Format = TextureFormat,
+    .ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D,
+    .Texture2D = {
+      .MipSlice = 0, .PlaneSlice = 0,
+    }
+  };
+
+  // 出力は全タイルで必ず読み返し、大きさも決まっているため、ReadbackRing は使わずスロットごとに専用のバッファを持つ.
+  for (auto& slot : m_slots)
+  {
+    slot.uploadBuffer = gfxDevice->CreateBuffer(bufferDesc, D3D12_HEAP_TYPE_UPLOAD);
+    slot.readbackBuffer = gfxDevice->CreateBuffer(bufferDesc, D3D12_HEAP_TYPE_READBACK);
+    slot.uploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&slot.uploadMapped));
+    slot.readbackBuffer->Map(0, nullptr, reinterpret_cast<void**>(&slot.readbackMapped));
+
+    texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+    slot.source = gfxDevice->CreateImage2D(texDesc, heapProps, D3D12_RESOURCE_STATE_COPY_DEST, nullptr);
+    texDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+    slot.destination = gfxDevice->CreateImage2D(texDesc, heapProps, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr);
+    slot.sourceSrv = gfxDevice->CreateShaderResourceView(slot.source, srvDesc);
+    slot.destinationUav = gfxDevice->CreateUnorderedAccessView(slot.destination, uavDesc);
+  }
+  m_textureWidth = width;
+  m_textureHeight = height;
+}
+
+void TiledImageFilter::WaitForSlot(const Slot& slot)
+{
+  if (m_fence && m_fence->GetCompletedValue() < slot.fenceValue)
+  {
+    m_fence->SetEventOnCompletion(slot.fenceValue, nullptr);
+  }
+}
+
+bool TiledImageFilter::Execute(uint32_t width, uint32_t height, uint32_t tileSize,
+  const ImageTileReader& read, const ImageTileWriter& write, ImageTilingStats* outStats)
+{
+  auto startTime = std::chrono::high_resolution_clock::now();
+  const auto tiles = MakeImageTiles(width, height, tileSize, GetImageFilterPlanApron(m_graph.GetPlan()));
+  if (tiles.empty())
+  {
+    return false;
+  }
+  PrepareSlots(tiles[0].inputWidth, tiles[0].inputHeight);
+
+  auto makeSurface = [this](BYTE* mapped) {
+    return ImageFilterSurface{
+      .format = ImageFilterPixelFormat::RGBA8,
+      .width = m_textureWidth,
+      .height = m_textureHeight,
+      .rowPitch = m_footprint.Footprint.RowPitch,
+      .data = mapped + m_footprint.Offset,
+    };
+  };
+  // 処理を終えたスロットの読み返し結果から、タイルの書き出す範囲を渡す.
+  auto writeSlot = [&](Slot& slot) {
+    if (slot.tileIndex < 0)
+    {
+      return true;
+    }
+    WaitForSlot(slot);
+    const auto& tile = tiles[size_t(slot.tileIndex)];
+    const auto output = makeSurface(slot.readbackMapped);
+    ImageFilterSurface region{
+      .format = ImageFilterPixelFormat::RGBA8,
+      .width = tile.width,
+      .height = tile.height,
+      .rowPitch = output.rowPitch,
+      .data = output.GetRow(tile.y - tile.inputY) + size_t(tile.x - tile.inputX) * 4,
+    };
+    slot.tileIndex = -1;
+    return write(tile, region);
+  };
+
+  auto& gfxDevice = GetGfxDevice();
+  ID3D12DescriptorHeap* heaps[] = {
+    gfxDevice->GetDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV).Get(),
+  };
+  bool succeeded = true;
+  for (size_t i = 0; succeeded && i < tiles.size(); ++i)
+  {
+    // 2つ前のタイルを書き出してから、空いたスロットへこのタイルを読み込む.
+    // その間、GPU は直前のタイルをもう一方のスロットで処理している.
+    auto& slot = m_slots[i % SlotCount];
+    if (!writeSlot(slot) || !read(tiles[i], makeSurface(slot.uploadMapped)))
+    {
+      succeeded = false;
+      break;
+    }
+
+    slot.commandAllocator->Reset();
+    auto commandList = slot.commandList.Get();
+    commandList->Reset(slot.commandAllocator.Get(), nullptr);
+    commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+
+    D3D12_TEXTURE_COPY_LOCATION uploadLocation{
+      .pResource = slot.uploadBuffer.Get(),
+      .Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT,
+      .PlacedFootprint = m_footprint,
+    };
+    D3D12_TEXTURE_COPY_LOCATION sourceLocation{
+      .pResource = slot.source.Get(),
+      .Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX,
+      .SubresourceIndex = 0,
+    };
+    commandList->CopyTextureRegion(&sourceLocation, 0, 0, 0, &uploadLocation, nullptr);
+    D3D12_RESOURCE_BARRIER barrierToSrv{
+      .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+      .Transition = {
+        .pResource = slot.source.Get(),
+        .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+        .StateBefore = D3D12_RESOURCE_STATE_COPY_DEST,
+        .StateAfter = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+      }
+    };
+    commandList->ResourceBarrier(1, &barrierToSrv);
+
+    // パスの定数はタイルごとに書き直すが、プランが同じため内容は変わらない.
+    m_graph.Execute(commandList, slot.source.Get(), slot.sourceSrv, slot.destination.Get(), slot.destinationUav);
+
+    D3D12_RESOURCE_BARRIER barriersAfterFilter[] = {
+      {
+        .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+        .Transition = {
+          .pResource = slot.destination.Get(),
+          .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+          .StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+          .StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE,
+        }
+      },
+      {
+        .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+        .Transition = {
+          .pResource = slot.source.Get(),
+          .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+          .StateBefore = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+          .StateAfter = D3D12_RESOURCE_STATE_COPY_DEST,
+        }
+      },
+    };
+    commandList->ResourceBarrier(_countof(barriersAfterFilter), barriersAfterFilter);
+    D3D12_TEXTURE_COPY_LOCATION destinationLocation{
+      .pResource = slot.destination.Get(),
+      .Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX,
+      .SubresourceIndex = 0,
+    };
+    D3D12_TEXTURE_COPY_LOCATION readbackLocation{
+      .pResource = slot.readbackBuffer.Get(),
+      .Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT,
+      .PlacedFootprint = m_footprint,
+    };
+    commandList->CopyTextureRegion(&readbackLocation, 0, 0, 0, &destinationLocation, nullptr);
+    D3D12_RESOURCE_BARRIER barrierToUav{
+      .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+      .Transition = {
+        .pResource = slot.destination.Get(),
+        .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+        .StateBefore = D3D12_RESOURCE_STATE_COPY_SOURCE,
+        .StateAfter = D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+      }
+    };
+    commandList->ResourceBarrier(1, &barrierToUav);
+    commandList->Close();
+
+    gfxDevice->Submit(commandList);
+    slot.fenceValue = ++m_fenceValue;
+    gfxDevice->GetD3D12CommandQueue()->Signal(m_fence.Get(), slot.fenceValue);
+    slot.tileIndex = int64_t(i);
+  }
+
+  // 残りのタイルを処理した順に書き出す. 失敗した場合も GPU の完了は待っておく.
+  for (size_t i = tiles.size(); i < tiles.size() + SlotCount; ++i)
+  {
+    auto& slot = m_slots[i % SlotCount];
+    if (succeeded)
+    {
+      succeeded = writeSlot(slot);
+    }
+    WaitForSlot(slot);
+    slot.tileIndex = -1;
+  }
+
+  if (outStats)
+  {
+    auto endTime = std::chrono::high_resolution_clock::now();
+    *outStats = ImageTilingStats{
+      .tileCount = uint32_t(tiles.size()),
+      .pixelCount = uint64_t(width) * height,
+      .inputPixelCount = uint64_t(m_textureWidth) * m_textureHeight * tiles.size(),
+      .elapsedMs = std::chrono::duration<double, std::milli>(endTime - startTime).count(),
+    };
+  }
+  return succeeded;
+}
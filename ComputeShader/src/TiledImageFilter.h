@@ -0,0 +1,74 @@
+﻿#pragma once
+#include <vector>
+#include <wrl.h>
+#include <d3d12.h>
+
+#include "GfxDevice.h"
+#include "ImageFilterGraph.h"
+#include "ImageTiling.h"
+
+// テクスチャに収まらない大きさの画像に、タイルごとに ImageFilterGraph を適用する.
+// タイルの分け方とエプロン(近傍を読むフィルタのための周囲の画素)は MakeImageTiles に従う.
+// 読み込み範囲は全タイルで同じ大きさのため、テクスチャは最初に作ったものを使い回す.
+// 転送用のバッファとテクスチャを2組(スロット)持ち、GPU が一方のタイルを処理している間に
+// CPU がもう一方のスロットへ次のタイルを読み込み、処理済みのタイルを書き出す.
+class TiledImageFilter
+{
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+public:
+  void Initialize();
+  void Shutdown();
+
+  // 実行するフィルタチェインを設定する. 表示用のグラフとは別に、自身のグラフでパスを組む.
+  void SetChain(const std::vector<ImageFilterNode>& chain, const ImageFilterPlanOptions& options = {});
+  const ImageFilterPlan& GetPlan() const { return m_graph.GetPlan(); }
+
+  // width x height の画像を tileSize 四方のタイルに分けて処理し、全タイルを書き出すまで待つ.
+  // read と write はこの関数を呼んだスレッドで、タイルの順に呼ばれる.
+  // コマンドは自身のアロケーターで記録してキューへ直接発行する. フレームのコマンドを発行した後に呼ぶこと.
+  bool Execute(uint32_t width, uint32_t height, uint32_t tileSize,
+    const ImageTileReader& read, const ImageTileWriter& write, ImageTilingStats* outStats = nullptr);
+
+  // 処理に使ったタイルのテクスチャの大きさ(エプロンを含む).
+  uint32_t GetTextureWidth() const { return m_textureWidth; }
+  uint32_t GetTextureHeight() const { return m_textureHeight; }
+
+private:
+  static const UINT SlotCount = 2;
+  static const DXGI_FORMAT TextureFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+  struct Slot
+  {
+    ComPtr<ID3D12CommandAllocator> commandAllocator;
+    ComPtr<ID3D12GraphicsCommandList> commandList;
+    // 入力の転送元と出力の読み返し先. どちらも常に Map しておく.
+    ComPtr<ID3D12Resource1> uploadBuffer;
+    ComPtr<ID3D12Resource1> readbackBuffer;
+    BYTE* uploadMapped = nullptr;
+    BYTE* readbackMapped = nullptr;
+    // source は D3D12_RESOURCE_STATE_COPY_DEST, destination は D3D12_RESOURCE_STATE_UNORDERED_ACCESS で待機する.
+    ComPtr<ID3D12Resource1> source;
+    ComPtr<ID3D12Resource1> destination;
+    GfxDevice::DescriptorHandle sourceSrv;
+    GfxDevice::DescriptorHandle destinationUav;
+    UINT64 fenceValue = 0;
+    // 処理中のタイル. 書き出し済みなら負の値.
+    int64_t tileIndex = -1;
+  };
+
+  // タイルのテクスチャの大きさに合わせてスロットのリソースを用意する. 大きさが同じなら作り直さない.
+  void PrepareSlots(uint32_t width, uint32_t height);
+  void ReleaseSlotResources();
+  void WaitForSlot(const Slot& slot);
+
+  ImageFilterGraph m_graph;
+  Slot m_slots[SlotCount];
+  // 読み込み範囲の1行のバイト数は D3D12_TEXTURE_DATA_PITCH_ALIGNMENT 単位に揃える.
+  D3D12_PLACED_SUBRESOURCE_FOOTPRINT m_footprint = { };
+  uint32_t m_textureWidth = 0;
+  uint32_t m_textureHeight = 0;
+
+  ComPtr<ID3D12Fence1> m_fence;
+  UINT64 m_fenceValue = 0;
+};
@@ -1,4 +1,5 @@
 ﻿#include "Win32Application.h"
+#include "BatchMode.h"
 
 #include <combaseapi.h>
 
@@ -8,10 +9,15 @@ int __stdcall wWinMain(_In_ HINSTANCE hInstance,
   _In_ int nCmdShow)
 {
   UNREFERENCED_PARAMETER(hPrevInstance);
-  UNREFERENCED_PARAMETER(lpCmdLine);
-
   ::CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
 
+  // --batch 指定時はウィンドウを作らずに処理して終了する.
+  int exitCode = 0;
+  if (RunBatchMode(lpCmdLine, exitCode))
+  {
+    return exitCode;
+  }
+
   Win32Application::WindowInitParams initParams{
     .width = 1280,
     .height = 720,
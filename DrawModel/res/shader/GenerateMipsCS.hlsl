@@ -0,0 +1,142 @@
+﻿// ミップマップ作成用コンピュートシェーダー.
+// 1回のディスパッチで最大4レベルを作成する. 2レベル目以降はグループ共有メモリ上の結果から縮小する.
+// 計算は整数で行い、CPU の参照実装(GenerateMipLevelsReference)と同じ結果になるようにしている.
+// sRGB のテクスチャは UNORM の UAV で参照し、RGB を線形空間に戻して平均してから sRGB に戻す.
+// 各レベルは 8bit に量子化した値から次のレベルを作成する(CPU の参照実装と同じ).
+struct MipParameters
+{
+    uint2 srcSize;
+    uint numMipLevels;
+    uint srgb;
+};
+ConstantBuffer<MipParameters> gParams : register(b0);
+
+RWTexture2D<unorm float4> gSrcMip : register(u0);
+RWTexture2D<unorm float4> gOutMip1 : register(u1);
+RWTexture2D<unorm float4> gOutMip2 : register(u2);
+RWTexture2D<unorm float4> gOutMip3 : register(u3);
+RWTexture2D<unorm float4> gOutMip4 : register(u4);
+
+// RGBA8 をパックして保持する.
+groupshared uint gTexels[64];
+
+uint4 LoadTexel(uint2 pos)
+{
+    // 奇数サイズの場合は端のテクセルを繰り返す.
+    pos = min(pos, gParams.srcSize - 1);
+    return uint4(round(gSrcMip[pos] * 255.0));
+}
+
+uint Pack(uint4 c)
+{
+    return c.r | (c.g << 8) | (c.b << 16) | (c.a << 24);
+}
+
+uint4 Unpack(uint v)
+{
+    return uint4(v & 0xFF, (v >> 8) & 0xFF, (v >> 16) & 0xFF, v >> 24);
+}
+
+float3 SrgbToLinear(uint3 c)
+{
+    float3 v = float3(c) / 255.0;
+    return lerp(pow((v + 0.055) / 1.055, 2.4), v / 12.92, step(v, 0.04045));
+}
+
+uint3 LinearToSrgb(float3 v)
+{
+    v = saturate(v);
+    v = lerp(1.055 * pow(v, 1.0 / 2.4) - 0.055, v * 12.92, step(v, 0.0031308));
+    return uint3(v * 255.0 + 0.5);
+}
+
+uint4 Average(uint4 a, uint4 b, uint4 c, uint4 d)
+{
+    uint4 result = (a + b + c + d + 2) >> 2;
+    if (gParams.srgb != 0)
+    {
+        float3 sum = SrgbToLinear(a.rgb) + SrgbToLinear(b.rgb) + SrgbToLinear(c.rgb) + SrgbToLinear(d.rgb);
+        result.rgb = LinearToSrgb(sum * 0.25);
+    }
+    return result;
+}
+
+float4 ToUnorm(uint4 c)
+{
+    return float4(c) / 255.0;
+}
+
+[numthreads(8, 8, 1)]
+void main(uint3 dispatchID : SV_DispatchThreadID, uint groupIndex : SV_GroupIndex)
+{
+    uint2 size = max(gParams.srcSize >> 1, 1);
+    uint2 pos = dispatchID.xy;
+    uint2 srcPos = pos * 2;
+    uint4 color = Average(
+        LoadTexel(srcPos), LoadTexel(srcPos + uint2(1, 0)),
+        LoadTexel(srcPos + uint2(0, 1)), LoadTexel(srcPos + uint2(1, 1)));
+    if (all(pos < size))
+    {
+        gOutMip1[pos] = ToUnorm(color);
+    }
+    if (gParams.numMipLevels == 1)
+    {
+        return;
+    }
+    gTexels[groupIndex] = Pack(color);
+    GroupMemoryBarrierWithGroupSync();
+
+    // 2レベル目: X,Y とも偶数のスレッドが処理.
+    size = max(size >> 1, 1);
+    pos >>= 1;
+    if ((groupIndex & 0x9) == 0)
+    {
+        color = Average(
+            Unpack(gTexels[groupIndex]), Unpack(gTexels[groupIndex + 1]),
+            Unpack(gTexels[groupIndex + 8]), Unpack(gTexels[groupIndex + 9]));
+        if (all(pos < size))
+        {
+            gOutMip2[pos] = ToUnorm(color);
+        }
+        gTexels[groupIndex] = Pack(color);
+    }
+    if (gParams.numMipLevels == 2)
+    {
+        return;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    // 3レベル目: X,Y とも4の倍数のスレッドが処理.
+    size = max(size >> 1, 1);
+    pos >>= 1;
+    if ((groupIndex & 0x1B) == 0)
+    {
+        color = Average(
+            Unpack(gTexels[groupIndex]), Unpack(gTexels[groupIndex + 2]),
+            Unpack(gTexels[groupIndex + 16]), Unpack(gTexels[groupIndex + 18]));
+        if (all(pos < size))
+        {
+            gOutMip3[pos] = ToUnorm(color);
+        }
+        gTexels[groupIndex] = Pack(color);
+    }
+    if (gParams.numMipLevels == 3)
+    {
+        return;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    // 4レベル目: 先頭スレッドのみ.
+    size = max(size >> 1, 1);
+    pos >>= 1;
+    if (groupIndex == 0)
+    {
+        color = Average(
+            Unpack(gTexels[0]), Unpack(gTexels[4]),
+            Unpack(gTexels[32]), Unpack(gTexels[36]));
+        if (all(pos < size))
+        {
+            gOutMip4[pos] = ToUnorm(color);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+﻿// マテリアルのリソース定義と参照処理. 本描画とデプスプリパスで共有する.
+// よく使われる設定(線形補間・ラップ)のサンプラーはルートシグネチャの静的サンプラーを使う.
+SamplerState gStaticSampler : register(s0, space3);
+static const uint STATIC_SAMPLER_INDEX = 0xFFFFFFFF;
+
+#if defined(USE_BINDLESS_MATERIAL)
+// バインドレス: 全テクスチャ・サンプラーをヒープ全体のテーブルから参照する.
+struct MaterialParameters
+{
+    float4 diffuse;
+    float4 specular;
+    float4 ambient;
+    uint textureIndex;
+    uint samplerIndex;
+    uint mode;
+    float minLod;
+    float4 uvScaleBias;
+    uint arraySlice;
+};
+struct DrawConstants
+{
+    uint materialIndex;
+};
+Texture2DArray gTextures[] : register(t0, space1);
+SamplerState gSamplers[] : register(s0, space1);
+StructuredBuffer<MaterialParameters> gMaterials : register(t0, space2);
+ConstantBuffer<DrawConstants> gDraw : register(b2);
+#else
+Texture2DArray gTex : register(t0);
+SamplerState gSampler : register(s0);
+#endif
+
+// ストリーミング中のテクスチャは未転送のレベルを参照しないよう、LOD を minLod 以上に制限する.
+// テクスチャは全て配列として参照し、アトラスにまとめたものは uvScaleBias で領域へ変換する.
+// アトラスでは繰り返しを frac で領域内に折り返し、LOD は折り返す前の UV から求めて境界で飛ばないようにする.
+float4 SampleClamped(Texture2DArray tex, SamplerState s, float2 uv, float4 uvScaleBias, uint arraySlice, float minLod)
+{
+    float lod = tex.CalculateLevelOfDetail(s, uv * uvScaleBias.xy);
+    float2 regionUv = any(uvScaleBias.xy != 1.0) ? frac(uv) : uv;
+    float3 location = float3(regionUv * uvScaleBias.xy + uvScaleBias.zw, arraySlice);
+    return tex.SampleLevel(s, location, max(lod, minLod));
+}
+
+struct SurfaceMaterial
+{
+    float4 diffuse;
+    float4 specular;
+    float4 ambient;
+    uint mode;
+};
+
+SurfaceMaterial LoadSurfaceMaterial(float2 uv0)
+{
+    SurfaceMaterial result;
+#if defined(USE_BINDLESS_MATERIAL)
+    MaterialParameters material = gMaterials[gDraw.materialIndex];
+    if (material.samplerIndex == STATIC_SAMPLER_INDEX)
+    {
+        result.diffuse = SampleClamped(gTextures[material.textureIndex], gStaticSampler, uv0, material.uvScaleBias, material.arraySlice, material.minLod);
+    }
+    else
+    {
+        result.diffuse = SampleClamped(gTextures[material.textureIndex], gSamplers[material.samplerIndex], uv0, material.uvScaleBias, material.arraySlice, material.minLod);
+    }
+    result.mode = material.mode;
+    result.specular = material.specular;
+    result.ambient = material.ambient;
+#else
+    if (gMesh.useStaticSampler != 0)
+    {
+        result.diffuse = SampleClamped(gTex, gStaticSampler, uv0, gMesh.uvScaleBias, gMesh.arraySlice, gMesh.minLod);
+    }
+    else
+    {
+        result.diffuse = SampleClamped(gTex, gSampler, uv0, gMesh.uvScaleBias, gMesh.arraySlice, gMesh.minLod);
+    }
+    result.mode = gMesh.mode;
+    result.specular = gMesh.specular;
+    result.ambient = gMesh.ambient;
+#endif
+    return result;
+}
\ No newline at end of file
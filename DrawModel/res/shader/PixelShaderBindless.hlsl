@@ -0,0 +1,3 @@
+﻿// マテリアルをインデックスで参照するバインドレス版.
+#define USE_BINDLESS_MATERIAL
+#include "PixelShader.hlsl"
\ No newline at end of file
@@ -0,0 +1,12 @@
+﻿#include "ShaderCommon.hlsli"
+#include "MaterialCommon.hlsli"
+
+// デプスプリパスのアルファテスト用. 深度のみ書き込み、ライティングは行わない.
+void main(DepthPSInput input)
+{
+    SurfaceMaterial material = LoadSurfaceMaterial(input.uv0);
+    if (material.mode == 1 && material.diffuse.a < 0.5)
+    {
+        discard;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,3 @@
+﻿// デプスプリパス(アルファテスト)のバインドレス版.
+#define USE_BINDLESS_MATERIAL
+#include "PixelShaderDepth.hlsl"
\ No newline at end of file
@@ -13,6 +13,10 @@ struct MeshParameters
     float4 specular;
     float4 ambient;
     uint mode;
+    uint useStaticSampler;
+    float minLod;
+    uint arraySlice;
+    float4 uvScaleBias;
 };
 
 ConstantBuffer<SceneParameters> gScene : register(b0);
@@ -25,10 +29,30 @@ struct VSInput
     float2 texcoord0 : TEXCOORD0;
 };
 
+// デプスプリパスと本描画で同一の深度値になるよう、座標変換はこの関数で行う.
+float4 TransformPosition(float4 worldPosition)
+{
+    precise float4x4 mtxVP = mul(gScene.mtxView, gScene.mtxProj);
+    precise float4 position = mul(worldPosition, mtxVP);
+    return position;
+}
+
 struct PSInput
 {
     float4 position : SV_POSITION;
     float4 worldPosition : POSITION;
     float3 worldNormal : NORMAL;
     float2 uv0 : TEXCOORD0;
+};
+
+struct DepthVSInput
+{
+    float4 position : POSITION;
+    float2 texcoord0 : TEXCOORD0;
+};
+
+struct DepthPSInput
+{
+    float4 position : SV_POSITION;
+    float2 uv0 : TEXCOORD0;
 };
\ No newline at end of file
@@ -0,0 +1,11 @@
+﻿#include "ShaderCommon.hlsli"
+
+// デプスプリパス用. 法線などは不要なため位置とアルファテスト用のUVのみ出力する.
+DepthPSInput main(DepthVSInput input)
+{
+    DepthPSInput result = (DepthPSInput) 0;
+    precise float4 worldPos = mul(input.position, gMesh.mtxWorld);
+    result.position = TransformPosition(worldPos);
+    result.uv0 = input.texcoord0;
+    return result;
+}
\ No newline at end of file
@@ -8,11 +8,53 @@
 #include "imgui/backends/imgui_impl_dx12.h"
 #include "imgui/backends/imgui_impl_win32.h"
 
+#include "DdsFile.h"
 #include "TextureUtility.h"
+#include "GpuMipGenerator.h"
+#include "TextureStreamer.h"
+#include "UploadRing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 
 using namespace Microsoft::WRL;
 using namespace DirectX;
 
+namespace
+{
+  // 静的サンプラーとしてルートシグネチャに埋め込む設定(線形補間・ラップ).
+  // モデルのマテリアルのほとんどはこの設定になる.
+  const D3D12_SAMPLER_DESC StaticLinearWrapSampler{
+    .Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR,
+    .AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP,
+    .AddressV = D3D12_TEXTURE_ADDRESS_MODE_WRAP,
+    .AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP,
+    .ComparisonFunc = D3D12_COMPARISON_FUNC_NEVER,
+    .MinLOD = 0, .MaxLOD = D3D12_FLOAT32_MAX,
+  };
+
+  bool IsStaticSamplerCompatible(const D3D12_SAMPLER_DESC& desc)
+  {
+    return memcmp(&desc, &StaticLinearWrapSampler, sizeof(desc)) == 0;
+  }
+
+  XMFLOAT4 GetUvScaleBias(const TextureManager::TextureRegion& region)
+  {
+    return XMFLOAT4(region.uvScale[0], region.uvScale[1], region.uvBias[0], region.uvBias[1]);
+  }
+
+  // 読み込みに失敗したテクスチャの代わりに使う白の 1x1 テクスチャ. マテリアルの色だけで描画される.
+  // 内容で重複を判定するため、呼ぶたびに同じテクスチャの参照カウントが増える.
+  TextureManager::TextureHandle LoadWhiteTexture(TextureManager& textureManager)
+  {
+    std::vector<uint8_t> file;
+    EncodeDDSHeader(1, 1, true, file);
+    file.insert(file.end(), 4, 0xFF);
+    return textureManager.LoadFromMemory(file.data(), file.size());
+  }
+}
+
 static std::unique_ptr<MyApplication> gMyApplication;
 std::unique_ptr<MyApplication>& GetApplication()
 {
@@ -30,11 +72,25 @@ MyApplication::MyApplication()
 
 void MyApplication::Initialize()
 {
+  // コマンドリストを並列に記録するためのスレッドを準備.
+  auto& jobSystem = GetJobSystem();
+  jobSystem->Initialize();
+
   auto& gfxDevice = GetGfxDevice();
   GfxDevice::DeviceInitParams initParams;
+  initParams.hwnd = Win32Application::GetHwnd();
   initParams.formatDesired = DXGI_FORMAT_R8G8B8A8_UNORM;
+  initParams.commandThreadCount = jobSystem->GetThreadCount();
+  // ライティングは線形空間で行い、書き込み時に sRGB へ変換する.
+  initParams.srgbRenderTarget = true;
   gfxDevice->Initialize(initParams);
 
+  // テクスチャ読み込み時に使うため先に準備する.
+  // バッファとテクスチャの転送元は常駐のアップロードリングから確保する.
+  GetUploadRing()->Initialize(64 * 1024 * 1024);
+  GetGpuMipGenerator()->Initialize();
+  GetTextureStreamer()->Initialize(uint64_t(m_streamingBudgetMB) * 1024 * 1024);
+
   PrepareDepthBuffer();
 
   PrepareImGui();
@@ -194,11 +250,30 @@ void MyApplication::PrepareModelDrawPipeline()
     },
   };
 
+  // s0, space3 静的サンプラー.
+  D3D12_STATIC_SAMPLER_DESC staticSamplers[] = {
+    {
+      .Filter = StaticLinearWrapSampler.Filter,
+      .AddressU = StaticLinearWrapSampler.AddressU,
+      .AddressV = StaticLinearWrapSampler.AddressV,
+      .AddressW = StaticLinearWrapSampler.AddressW,
+      .MipLODBias = StaticLinearWrapSampler.MipLODBias,
+      .MaxAnisotropy = StaticLinearWrapSampler.MaxAnisotropy,
+      .ComparisonFunc = StaticLinearWrapSampler.ComparisonFunc,
+      .BorderColor = D3D12_STATIC_BORDER_COLOR_TRANSPARENT_BLACK,
+      .MinLOD = StaticLinearWrapSampler.MinLOD,
+      .MaxLOD = StaticLinearWrapSampler.MaxLOD,
+      .ShaderRegister = 0,
+      .RegisterSpace = 3,
+      .ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL,
+    },
+  };
+
   D3D12_ROOT_SIGNATURE_DESC rootSignatureDesc{
     .NumParameters = _countof(rootParams),
     .pParameters = rootParams,
-    .NumStaticSamplers = 0,
-    .pStaticSamplers = nullptr,
+    .NumStaticSamplers = _countof(staticSamplers),
+    .pStaticSamplers = staticSamplers,
     .Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT
   };
 
@@ -310,9 +385,10 @@ void MyApplication::PrepareModelDrawPipeline()
   };
   psoDesc.DepthStencilState = depthStencilState;
   psoDesc.NumRenderTargets = 1;
-  psoDesc.RTVFormats[0] = gfxDevice->GetSwapchainFormat();
+  psoDesc.RTVFormats[0] = gfxDevice->GetRenderTargetFormat();
   psoDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
   m_drawOpaquePipeline = gfxDevice->CreateGraphicsPipelineState(psoDesc);
+  const auto psoDescOpaque = psoDesc;
 
   // アルファブレンド用の設定.
   D3D12_DEPTH_STENCIL_DESC dssBlend = depthStencilState;
@@ -327,6 +403,143 @@ void MyApplication::PrepareModelDrawPipeline()
   psoDesc.DepthStencilState = dssBlend;
   psoDesc.BlendState = blendState;
   m_drawBlendPipeline = gfxDevice->CreateGraphicsPipelineState(psoDesc);
+
+  // デプスプリパス用の設定.
+  // プリパスで確定した深度と一致するピクセルのみ本描画でシェーディングする.
+  D3D12_DEPTH_STENCIL_DESC dssEqual = depthStencilState;
+  dssEqual.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+  dssEqual.DepthFunc = D3D12_COMPARISON_FUNC_EQUAL;
+  auto psoDescEqual = psoDescOpaque;
+  psoDescEqual.DepthStencilState = dssEqual;
+  m_drawOpaqueEqualPipeline = gfxDevice->CreateGraphicsPipelineState(psoDescEqual);
+
+  D3D12_INPUT_ELEMENT_DESC inputElementDescDepth[] = {
+    inputElementDesc[0],  // POSITION
+    inputElementDesc[2],  // TEXCOORD
+  };
+  std::vector<char> vsDepthData, psDepthData;
+  loader->Load(L"res/shader/VertexShaderDepth.cso", vsDepthData);
+  loader->Load(L"res/shader/PixelShaderDepth.cso", psDepthData);
+  auto psoDescDepth = psoDescOpaque;
+  psoDescDepth.InputLayout = D3D12_INPUT_LAYOUT_DESC{
+    .pInputElementDescs = inputElementDescDepth,
+    .NumElements = _countof(inputElementDescDepth),
+  };
+  psoDescDepth.VS = D3D12_SHADER_BYTECODE{
+    .pShaderBytecode = vsDepthData.data(),
+    .BytecodeLength = vsDepthData.size(),
+  };
+  psoDescDepth.PS = D3D12_SHADER_BYTECODE{};
+  psoDescDepth.BlendState.RenderTarget[0].RenderTargetWriteMask = 0;
+  psoDescDepth.NumRenderTargets = 0;
+  psoDescDepth.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
+  m_depthPrepassPipeline = gfxDevice->CreateGraphicsPipelineState(psoDescDepth);
+
+  // アルファテストが必要なものはテクスチャを参照するピクセルシェーダーを使う.
+  psoDescDepth.PS = D3D12_SHADER_BYTECODE{
+    .pShaderBytecode = psDepthData.data(),
+    .BytecodeLength = psDepthData.size(),
+  };
+  m_depthPrepassMaskPipeline = gfxDevice->CreateGraphicsPipelineState(psoDescDepth);
+
+  // バインドレス描画用のルートシグネチャとパイプラインを作成.
+  // ヒープ全体を上限なしのテーブルとして参照するため、リソースバインディングTier2以上が必要.
+  D3D12_FEATURE_DATA_D3D12_OPTIONS options{};
+  gfxDevice->GetD3D12Device()->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options));
+  if (options.ResourceBindingTier < D3D12_RESOURCE_BINDING_TIER_2)
+  {
+    return;
+  }
+
+  D3D12_DESCRIPTOR_RANGE rangeBindlessSrvRanges[] = {
+    {  // t0, space1 全テクスチャ.
+      .RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV,
+      .NumDescriptors = UINT_MAX,
+      .BaseShaderRegister = 0,
+      .RegisterSpace = 1,
+      .OffsetInDescriptorsFromTableStart = 0,
+    }
+  };
+  D3D12_DESCRIPTOR_RANGE rangeBindlessSamplerRanges[] = {
+    {  // s0, space1 全サンプラー.
+      .RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER,
+      .NumDescriptors = UINT_MAX,
+      .BaseShaderRegister = 0,
+      .RegisterSpace = 1,
+      .OffsetInDescriptorsFromTableStart = 0,
+    }
+  };
+  D3D12_ROOT_PARAMETER rootParamsBindless[] = {
+    rootParams[0],  // b0 シーン情報.
+    rootParams[1],  // b1 ワールド行列(全描画で共通).
+    {  // b2 マテリアルインデックス.
+      .ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS,
+      .Constants = {
+        .ShaderRegister = 2,
+        .RegisterSpace = 0,
+        .Num32BitValues = 1,
+      },
+      .ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL
+    },
+    {  // t0, space2 マテリアル情報.
+      .ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV,
+      .Descriptor = {
+        .ShaderRegister = 0,
+        .RegisterSpace = 2,
+      },
+      .ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL
+    },
+    {
+      .ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE,
+      .DescriptorTable = {
+        .NumDescriptorRanges = _countof(rangeBindlessSrvRanges),
+        .pDescriptorRanges = rangeBindlessSrvRanges,
+      },
+      .ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL,
+    },
+    {
+      .ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE,
+      .DescriptorTable = {
+        .NumDescriptorRanges = _countof(rangeBindlessSamplerRanges),
+        .pDescriptorRanges = rangeBindlessSamplerRanges,
+      },
+      .ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL,
+    },
+  };
+  rootSignatureDesc.NumParameters = _countof(rootParamsBindless);
+  rootSignatureDesc.pParameters = rootParamsBindless;
+  signature.Reset();
+  error.Reset();
+  D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error);
+  m_rootSignatureBindless = gfxDevice->CreateRootSignature(signature);
+
+  std::vector<char> psBindlessData;
+  loader->Load(L"res/shader/PixelShaderBindless.cso", psBindlessData);
+  auto psoDescBindless = psoDescOpaque;
+  psoDescBindless.pRootSignature = m_rootSignatureBindless.Get();
+  psoDescBindless.PS = D3D12_SHADER_BYTECODE{
+    .pShaderBytecode = psBindlessData.data(),
+    .BytecodeLength = psBindlessData.size(),
+  };
+  m_drawOpaqueBindlessPipeline = gfxDevice->CreateGraphicsPipelineState(psoDescBindless);
+
+  psoDescBindless.DepthStencilState = dssEqual;
+  m_drawOpaqueEqualBindlessPipeline = gfxDevice->CreateGraphicsPipelineState(psoDescBindless);
+
+  psoDescBindless.DepthStencilState = dssBlend;
+  psoDescBindless.BlendState = blendState;
+  m_drawBlendBindlessPipeline = gfxDevice->CreateGraphicsPipelineState(psoDescBindless);
+
+  std::vector<char> psDepthBindlessData;
+  loader->Load(L"res/shader/PixelShaderDepthBindless.cso", psDepthBindlessData);
+  psoDescDepth.pRootSignature = m_rootSignatureBindless.Get();
+  psoDescDepth.PS = D3D12_SHADER_BYTECODE{};
+  m_depthPrepassBindlessPipeline = gfxDevice->CreateGraphicsPipelineState(psoDescDepth);
+  psoDescDepth.PS = D3D12_SHADER_BYTECODE{
+    .pShaderBytecode = psDepthBindlessData.data(),
+    .BytecodeLength = psDepthBindlessData.size(),
+  };
+  m_depthPrepassMaskBindlessPipeline = gfxDevice->CreateGraphicsPipelineState(psoDescDepth);
 }
 
 void MyApplication::PrepareModelData()
@@ -346,14 +559,59 @@ void MyApplication::PrepareModelData()
   }
 
   auto& gfxDevice = GetGfxDevice();
+  // モデルが参照するテクスチャをまとめて読み込む.
+  // 展開は並列に行われ、転送も1度にまとめられる.
+  auto& textureManager = GetTextureManager();
+  std::vector<TextureManager::LoadSource> textureSources;
   for (const auto& embeddedInfo : modelEmbeddedTextures)
   {
-    auto& texture = m_model.embeddedTextures.emplace_back();
-    auto success = CreateTextureFromMemory(texture.texResource, embeddedInfo.data.data(), embeddedInfo.data.size());
-    assert(success);
+    textureSources.push_back({
+      .srcBuffer = embeddedInfo.data.data(), .bufferSize = embeddedInfo.data.size(), .generateMips = true, .packable = true
+    });
   }
+  std::vector<int> materialTextureIndices;
+  m_bakeTargets.clear();
   for (const auto& material : modelMaterials)
   {
+    materialTextureIndices.push_back(int(textureSources.size()));
+    if (material.texDiffuse.embeddedIndex == -1)
+    {
+      // ディフューズは sRGB で格納されているため、線形空間で平均する.
+      // アルファテストを行うものは縮小で抜けが増えないように通過率を維持する.
+      MipGenerateOptions mipOptions{
+        .srgb = true,
+        .preserveAlphaCoverage = material.alphaMode == ModelMaterial::ALPHA_MODE_MASK,
+      };
+      // 圧縮済みのものがあればそちらを使う. ミップマップも含まれているため展開のみで済む.
+      std::filesystem::path filePath = material.texDiffuse.filePath;
+      if (auto bakedPath = GetBakedTexturePath(filePath); std::filesystem::exists(bakedPath))
+      {
+        filePath = bakedPath;
+      }
+      else
+      {
+        // 不透明なものは BC1、アルファを使うものは BC7 で圧縮する.
+        m_bakeTargets.push_back({
+          .filePath = material.texDiffuse.filePath,
+          .options = {
+            .format = material.alphaMode == ModelMaterial::ALPHA_MODE_OPAQUE ? ImageFormat::BC1 : ImageFormat::BC7,
+            .mipOptions = mipOptions,
+          }
+        });
+      }
+      // ファイルから読み込むものは詳細なレベルを必要になった時点で転送する.
+      // 小さいものはストリーミングせず、アトラスや配列にまとめてリソースと SRV の切り替えを減らす.
+      textureSources.push_back({
+        .filePath = filePath, .generateMips = true, .mipOptions = mipOptions, .streaming = true, .packable = true
+      });
+    }
+  }
+  auto textureHandles = textureManager->LoadBatch(textureSources);
+  m_model.embeddedTextures.assign(textureHandles.begin(), textureHandles.begin() + modelEmbeddedTextures.size());
+
+  for (size_t materialIndex = 0; materialIndex < modelMaterials.size(); ++materialIndex)
+  {
+    const auto& material = modelMaterials[materialIndex];
     auto& dstMaterial = m_model.materials.emplace_back();
 
     dstMaterial.alphaMode = material.alphaMode;
@@ -375,44 +633,36 @@ void MyApplication::PrepareModelData()
       .MinLOD = 0, .MaxLOD = D3D12_FLOAT32_MAX,
     };
 
-    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{
-      .Format = DXGI_FORMAT_R8G8B8A8_UNORM,
-      .ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D,
-      .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
-      .Texture2D = {
-        .MostDetailedMip = 0,
-        .MipLevels = 1,
-        .PlaneSlice = 0, .ResourceMinLODClamp = 0.
-      }
-    };
-    GfxDevice::DescriptorHandle diffuseSrvDescriptor;
-
-    bool success;
+    // 同じテクスチャを参照するマテリアルは TextureManager 経由でリソースとSRVを共有する.
+    TextureManager::TextureHandle texture;
     if (material.texDiffuse.embeddedIndex == -1)
     {
       // ファイルから読み込み.
-      auto& info = m_model.textureList.emplace_back();
-      info.filePath = material.texDiffuse.filePath;
-
-      success = CreateTextureFromFile(info.texResource, info.filePath);
-      const auto texDesc = info.texResource->GetDesc();
-      srvDesc.Format = texDesc.Format;
-      srvDesc.Texture2D.MipLevels = texDesc.MipLevels;
-      assert(success);
-      diffuseSrvDescriptor = gfxDevice->CreateShaderResourceView(info.texResource, srvDesc);
+      texture = textureHandles[materialTextureIndices[materialIndex]];
+      m_model.textureList.push_back(texture);
     }
     else
     {
       // 埋め込みテクスチャから読み込み.
-      auto& embTexture = m_model.embeddedTextures[material.texDiffuse.embeddedIndex];
-      const auto texDesc = embTexture.texResource->GetDesc();
-      srvDesc.Format = texDesc.Format;
-      srvDesc.Texture2D.MipLevels = texDesc.MipLevels;
-      diffuseSrvDescriptor = gfxDevice->CreateShaderResourceView(embTexture.texResource, srvDesc);
+      texture = m_model.embeddedTextures[material.texDiffuse.embeddedIndex];
+    }
+    if (texture == TextureManager::InvalidHandle)
+    {
+      texture = LoadWhiteTexture(*textureManager);
+      m_model.textureList.push_back(texture);
     }
 
-    dstMaterial.srvDiffuse = diffuseSrvDescriptor;
-    dstMaterial.samplerDiffuse = gfxDevice->CreateSampler(samplerDesc);
+    dstMaterial.srvDiffuse = textureManager->GetShaderResourceView(texture);
+    dstMaterial.streamId = textureManager->GetStreamId(texture);
+    dstMaterial.region = textureManager->GetRegion(texture);
+    // アトラスに入っているものは、アトラス内の大きさとする.
+    const auto texDesc = textureManager->GetResource(texture)->GetDesc();
+    const auto width = UINT(float(texDesc.Width) * dstMaterial.region.uvScale[0]);
+    const auto height = UINT(float(texDesc.Height) * dstMaterial.region.uvScale[1]);
+    dstMaterial.textureSize = width > height ? width : height;
+    // 同一設定のサンプラーは共有して、サンプラーヒープの消費を抑える.
+    dstMaterial.samplerDiffuse = gfxDevice->GetSampler(samplerDesc);
+    dstMaterial.useStaticSampler = IsStaticSamplerCompatible(samplerDesc);
   }
 
   for (const auto& mesh : modelMeshes)
@@ -479,6 +729,25 @@ void MyApplication::PrepareModelData()
     dstMesh.indexCount = indexCount;
     dstMesh.vertexCount = vertexCount;
     dstMesh.materialIndex = mesh.materialIndex;
+
+    XMVECTOR boundsMin = g_XMFltMax, boundsMax = -g_XMFltMax;
+    for (const auto& position : mesh.positions)
+    {
+      auto v = XMLoadFloat3(&position);
+      boundsMin = XMVectorMin(boundsMin, v);
+      boundsMax = XMVectorMax(boundsMax, v);
+    }
+    if (mesh.positions.empty())
+    {
+      boundsMin = boundsMax = XMVectorZero();
+    }
+    XMStoreFloat3(&dstMesh.boundsCenter, XMVectorScale(XMVectorAdd(boundsMin, boundsMax), 0.5f));
+    dstMesh.boundsRadius = XMVectorGetX(XMVector3Length(XMVectorSubtract(boundsMax, boundsMin))) * 0.5f;
+    dstMesh.uvDensity = 0.0f;
+    if (!mesh.texcoords.empty())
+    {
+      dstMesh.uvDensity = ComputeUvDensity(&mesh.positions[0].x, &mesh.texcoords[0].x, mesh.indices.data(), mesh.indices.size());
+    }
   }
 
   // メッシュ単位の描画情報を組み立てる.
@@ -509,6 +778,63 @@ void MyApplication::PrepareModelData()
         resDesc, D3D12_HEAP_TYPE_UPLOAD);
     }
   }
+
+  PrepareBindlessMaterialBuffers();
+}
+
+void MyApplication::PrepareBindlessMaterialBuffers()
+{
+  if (m_rootSignatureBindless == nullptr)
+  {
+    return;
+  }
+  auto& gfxDevice = GetGfxDevice();
+  auto materialCount = m_model.materials.empty() ? 1 : m_model.materials.size();
+  D3D12_RESOURCE_DESC resDesc{
+    .Dimension = D3D12_RESOURCE_DIMENSION_BUFFER,
+    .Alignment = 0,
+    .Width = sizeof(MaterialParameters) * materialCount,
+    .Height = 1, .DepthOrArraySize = 1, .MipLevels = 1,
+    .Format = DXGI_FORMAT_UNKNOWN,
+    .SampleDesc = {.Count = 1, .Quality = 0 },
+    .Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR,
+    .Flags = D3D12_RESOURCE_FLAG_NONE,
+  };
+  D3D12_RESOURCE_DESC cbResDesc = resDesc;
+  cbResDesc.Width = (sizeof(DrawParameters) + 255) & ~255u;
+
+  // マテリアル数は少ないので、フレームごとに作り直せるようアップロードヒープに置く.
+  for (auto& buffers : m_bindlessBuffers)
+  {
+    buffers.materials = gfxDevice->CreateBuffer(resDesc, D3D12_HEAP_TYPE_UPLOAD);
+    buffers.drawParams = gfxDevice->CreateBuffer(cbResDesc, D3D12_HEAP_TYPE_UPLOAD);
+  }
+}
+
+void MyApplication::BakeModelTextures()
+{
+  // 同じファイルを参照するマテリアルがあるため、1ファイル1回にまとめる.
+  std::vector<const BakeTarget*> targets;
+  for (const auto& target : m_bakeTargets)
+  {
+    auto itr = std::find_if(targets.begin(), targets.end(),
+      [&](const BakeTarget* other) { return other->filePath == target.filePath; });
+    if (itr == targets.end())
+    {
+      targets.push_back(&target);
+    }
+  }
+
+  // ファイルごとに並列で変換する. 圧縮処理の中でもブロック行単位で並列化される.
+  std::atomic<uint32_t> bakedCount = 0;
+  GetJobSystem()->Dispatch(uint32_t(targets.size()), [&](uint32_t jobIndex, uint32_t) {
+    const auto& target = *targets[jobIndex];
+    if (BakeTextureFile(target.filePath, GetBakedTexturePath(target.filePath), target.options))
+    {
+      bakedCount++;
+    }
+  });
+  m_bakedTextureCount = bakedCount;
 }
 
 void MyApplication::PrepareImGui()
@@ -556,16 +882,64 @@ void MyApplication::OnUpdate()
   ImGui::InputFloat("Power", (float*)&m_globalSpecular.w);
   float* ambientColor = (float*)&m_globalAmbient;
   ImGui::InputFloat3("Ambient", ambientColor);
+
+  if (m_rootSignatureBindless)
+  {
+    ImGui::Checkbox("Bindless", &m_useBindless);
+  }
+  ImGui::Checkbox("Depth Prepass", &m_useDepthPrepass);
+  ImGui::Checkbox("Multithreaded Recording", &m_multithreadRecording);
+  ImGui::SliderInt("Draws/Chunk", &m_drawsPerChunk, 16, 2048);
+  ImGui::Text("Record: %.3f ms (%u lists, %u threads)",
+    m_recordTimeMs, m_recordCommandListCount, GetJobSystem()->GetThreadCount());
+  ImGui::Text("Samplers: %u", uint32_t(GetGfxDevice()->GetCachedSamplerCount()));
+  ImGui::Text("Textures: %u (requests %u, loads %u)", uint32_t(GetTextureManager()->GetTextureCount()),
+    GetTextureManager()->GetRequestCount(), GetTextureManager()->GetLoadCount());
+  const auto& loadStats = GetTextureManager()->GetLastLoadStats();
+  ImGui::Text("Texture Decode: %.1f MPixels/s (%.1f ms, %u threads)",
+    loadStats.decode.GetMegaPixelsPerSecond(), loadStats.decode.decodeMs, loadStats.decode.threadCount);
+  ImGui::Text("Texture Read/Upload: %.1f / %.1f ms", loadStats.readMs, loadStats.uploadMs);
+  ImGui::Text("Upload Ring: %.1f / %.1f MB (waits %u)", double(GetUploadRing()->GetUsedSize()) / (1024.0 * 1024.0),
+    double(GetUploadRing()->GetSize()) / (1024.0 * 1024.0), GetUploadRing()->GetWaitCount());
+  ImGui::Text("GPU Mip Generation: %s", GetGpuMipGenerator()->IsSupported() ? "Supported" : "Unsupported");
+  ImGui::Text("Texture Memory: %.1f MB", double(GetTextureManager()->GetMemorySize()) / (1024.0 * 1024.0));
+  ImGui::Text("Packed Textures: %u in %u resources",
+    GetTextureManager()->GetPackedTextureCount(), GetTextureManager()->GetPackCount());
+  if (auto& streamer = GetTextureStreamer(); streamer->IsSupported())
+  {
+    const int heapSizeMB = int(streamer->GetHeapSize() / (1024 * 1024));
+    if (ImGui::SliderInt("Streaming Budget (MB)", &m_streamingBudgetMB, 16, heapSizeMB))
+    {
+      streamer->SetBudget(uint64_t(m_streamingBudgetMB) * 1024 * 1024);
+    }
+    ImGui::Text("Streaming Resident: %.1f MB (loads %u, evictions %u)",
+      double(streamer->GetResidentSize()) / (1024.0 * 1024.0), streamer->GetLastLoadCount(), streamer->GetLastEvictionCount());
+  }
+  else
+  {
+    ImGui::Text("Texture Streaming: Unsupported");
+  }
+  if (ImGui::Button("Bake Textures"))
+  {
+    BakeModelTextures();
+  }
+  ImGui::Text("Baked: %u / %u (used from next launch)", m_bakedTextureCount, uint32_t(m_bakeTargets.size()));
   ImGui::End();
 
   auto& gfxDevice = GetGfxDevice();
   gfxDevice->NewFrame();
 
   // 描画のコマンドを作成.
-  auto commandList = MakeCommandList();
+  auto commandLists = MakeCommandLists();
 
   // 作成したコマンドを実行.
-  gfxDevice->Submit(commandList.Get());
+  // 記録は並列で行っているが、実行はまとめて順序通りに行う.
+  std::vector<ID3D12CommandList*> submitLists;
+  for (auto& commandList : commandLists)
+  {
+    submitLists.push_back(commandList.Get());
+  }
+  gfxDevice->Submit(UINT(submitLists.size()), submitLists.data());
   // 描画した内容を画面へ反映.
   gfxDevice->Present(1);
 }
@@ -579,26 +953,40 @@ void MyApplication::Shutdown()
   m_drawOpaquePipeline.Reset();
   m_rootSignature.Reset();
 
+  auto& textureManager = GetTextureManager();
+  for (auto texture : m_model.textureList)
+  {
+    textureManager->Release(texture);
+  }
+  for (auto texture : m_model.embeddedTextures)
+  {
+    textureManager->Release(texture);
+  }
+  m_model.textureList.clear();
+  m_model.embeddedTextures.clear();
+  textureManager->Clear();
+  GetGpuMipGenerator()->Shutdown();
+  GetTextureStreamer()->Shutdown();
+  GetUploadRing()->Shutdown();
+
   // ImGui破棄処理.
   DestroyImGui();
 
   // グラフィックスデバイス関連解放.
   gfxDevice->Shutdown();
+
+  GetJobSystem()->Shutdown();
 }
 
-ComPtr<ID3D12GraphicsCommandList>  MyApplication::MakeCommandList()
+std::vector<ComPtr<ID3D12GraphicsCommandList>> MyApplication::MakeCommandLists()
 {
   auto& gfxDevice = GetGfxDevice();
+  auto& jobSystem = GetJobSystem();
   auto frameIndex = gfxDevice->GetFrameIndex();
-  auto commandList = gfxDevice->CreateCommandList();
-
-  // ルートシグネチャおよびパイプラインステートオブジェクト(PSO)をセット.
-  commandList->SetGraphicsRootSignature(m_rootSignature.Get());
-  commandList->SetPipelineState(m_drawOpaquePipeline.Get());
-
-  commandList->RSSetViewports(1, &m_viewport);
-  commandList->RSSetScissorRects(1, &m_scissorRect);
+  std::vector<ComPtr<ID3D12GraphicsCommandList>> commandLists;
 
+  // 描画開始用のコマンドリスト.
+  auto beginCommandList = gfxDevice->CreateCommandList();
   auto renderTarget = gfxDevice->GetSwapchainBufferResource();
   auto barrierToRT = D3D12_RESOURCE_BARRIER{
     .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
@@ -611,21 +999,16 @@ ComPtr<ID3D12GraphicsCommandList>  MyApplication::MakeCommandList()
     }
   };
 
-  commandList->ResourceBarrier(1, &barrierToRT);
+  beginCommandList->ResourceBarrier(1, &barrierToRT);
 
   auto rtvHandle = gfxDevice->GetSwapchainBufferDescriptor();
   auto dsvHandle = m_depthBuffer.dsvHandle;
-  commandList->OMSetRenderTargets(1, &rtvHandle.hCpu, FALSE, &(dsvHandle.hCpu));
-  
-  const float clearColor[] = { 0.75f, 0.9f, 1.0f, 1.0f };
-  commandList->ClearRenderTargetView(rtvHandle.hCpu, clearColor, 0, nullptr);
-  commandList->ClearDepthStencilView(dsvHandle.hCpu, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
-
-  ID3D12DescriptorHeap* heaps[] = {
-    gfxDevice->GetDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV).Get(),
-    gfxDevice->GetDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER).Get(),
-  };
-  commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+  // sRGB の (0.75, 0.9, 1.0) を線形に変換した値.
+  const float clearColor[] = { 0.5225f, 0.7874f, 1.0f, 1.0f };
+  beginCommandList->ClearRenderTargetView(rtvHandle.hCpu, clearColor, 0, nullptr);
+  beginCommandList->ClearDepthStencilView(dsvHandle.hCpu, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+  beginCommandList->Close();
+  commandLists.push_back(beginCommandList);
 
   XMFLOAT3 eyePos(5, 1.0, 0.0f), target(0, 1.0, 0), upDir(0, 1, 0);
   XMMATRIX mtxView = XMMatrixLookAtRH(
@@ -646,14 +1029,76 @@ ComPtr<ID3D12GraphicsCommandList>  MyApplication::MakeCommandList()
   memcpy(p, &m_sceneParams, sizeof(m_sceneParams));
   cb->Unmap(0, nullptr);
 
-  auto cbDescriptor = m_constantBuffer[frameIndex].descriptorCbv;
-  commandList->SetGraphicsRootConstantBufferView(0, cb->GetGPUVirtualAddress());
+  // モデルのワールド行列を更新.
+  m_model.mtxWorld = XMMatrixRotationY(m_sceneParams.time * 0.5f);
+  BuildDrawList();
+  // 転送コマンドはここで発行され、今フレームの描画より先に実行される.
+  UpdateTextureStreaming();
+  if (IsBindlessActive())
+  {
+    UpdateBindlessMaterialBuffer(frameIndex);
+  }
 
-  DrawModel(commandList);
+  // 描画リストをチャンクに分割して、各スレッドでコマンドを記録する.
+  // デプスプリパスのチャンクは本描画のチャンクより前に実行する.
+  auto startTime = std::chrono::high_resolution_clock::now();
+  const auto drawsPerChunk = uint32_t(m_drawsPerChunk > 0 ? m_drawsPerChunk : 1);
+  auto getChunkCount = [&](uint32_t drawCount) {
+    if (m_multithreadRecording && drawCount > drawsPerChunk)
+    {
+      return (drawCount + drawsPerChunk - 1) / drawsPerChunk;
+    }
+    return drawCount > 0 ? 1u : 0u;
+  };
+  const auto depthDrawCount = IsDepthPrepassActive() ? uint32_t(m_depthDrawList.size()) : 0u;
+  const auto drawCount = uint32_t(m_drawList.size());
+  const auto depthChunkCount = getChunkCount(depthDrawCount);
+  const auto chunkCount = getChunkCount(drawCount);
+  std::vector<ComPtr<ID3D12GraphicsCommandList>> chunkCommandLists(depthChunkCount + chunkCount);
+  auto recordChunk = [&](uint32_t chunkIndex, uint32_t threadIndex) {
+    auto commandList = gfxDevice->CreateCommandList(threadIndex);
+    if (chunkIndex < depthChunkCount)
+    {
+      const uint32_t first = chunkIndex * depthDrawCount / depthChunkCount;
+      const uint32_t last = (chunkIndex + 1) * depthDrawCount / depthChunkCount;
+      SetupDrawState(commandList, true);
+      DrawModelDepth(commandList, first, last - first);
+    }
+    else
+    {
+      const auto index = chunkIndex - depthChunkCount;
+      const uint32_t first = index * drawCount / chunkCount;
+      const uint32_t last = (index + 1) * drawCount / chunkCount;
+      SetupDrawState(commandList);
+      DrawModel(commandList, first, last - first);
+    }
+    commandList->Close();
+    chunkCommandLists[chunkIndex] = commandList;
+  };
+  const auto totalChunkCount = uint32_t(chunkCommandLists.size());
+  if (totalChunkCount > 1)
+  {
+    jobSystem->Dispatch(totalChunkCount, recordChunk);
+  }
+  else if (totalChunkCount == 1)
+  {
+    recordChunk(0, 0);
+  }
+  auto endTime = std::chrono::high_resolution_clock::now();
+  m_recordTimeMs = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+  m_recordCommandListCount = totalChunkCount;
+  commandLists.insert(commandLists.end(), chunkCommandLists.begin(), chunkCommandLists.end());
+
+  // 描画終了用のコマンドリスト.
+  auto endCommandList = gfxDevice->CreateCommandList();
+  SetupDrawState(endCommandList);
 
   // ImGui による描画.
+  // ImGui の色は sRGB の値のため、変換を行わない RTV へ描画する.
+  auto uiRtvHandle = gfxDevice->GetSwapchainBufferUnormDescriptor();
+  endCommandList->OMSetRenderTargets(1, &uiRtvHandle.hCpu, FALSE, nullptr);
   ImGui::Render();
-  ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), commandList.Get());
+  ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), endCommandList.Get());
 
   D3D12_RESOURCE_BARRIER barrierToPresent{
     .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
@@ -665,85 +1110,354 @@ ComPtr<ID3D12GraphicsCommandList>  MyApplication::MakeCommandList()
       .StateAfter = D3D12_RESOURCE_STATE_PRESENT,
     }
   };
-  commandList->ResourceBarrier(1, &barrierToPresent);
-  commandList->Close();
-  return commandList;
+  endCommandList->ResourceBarrier(1, &barrierToPresent);
+  endCommandList->Close();
+  commandLists.push_back(endCommandList);
+  return commandLists;
 }
 
-void MyApplication::DrawModel(ComPtr<ID3D12GraphicsCommandList> commandList)
+void MyApplication::SetupDrawState(ComPtr<ID3D12GraphicsCommandList> commandList, bool depthOnly)
 {
+  // コマンドリスト間でステートは引き継がれないため、リストごとに設定する.
   auto& gfxDevice = GetGfxDevice();
-  int frameIndex = gfxDevice->GetFrameIndex();
+  auto frameIndex = gfxDevice->GetFrameIndex();
 
-  // モデルのワールド行列を更新.
-  m_model.mtxWorld = XMMatrixRotationY(m_sceneParams.time * 0.5f);
+  // ルートシグネチャおよびパイプラインステートオブジェクト(PSO)をセット.
+  if (IsBindlessActive())
+  {
+    commandList->SetGraphicsRootSignature(m_rootSignatureBindless.Get());
+    commandList->SetPipelineState(m_drawOpaqueBindlessPipeline.Get());
+  }
+  else
+  {
+    commandList->SetGraphicsRootSignature(m_rootSignature.Get());
+    commandList->SetPipelineState(m_drawOpaquePipeline.Get());
+  }
+
+  commandList->RSSetViewports(1, &m_viewport);
+  commandList->RSSetScissorRects(1, &m_scissorRect);
+
+  auto rtvHandle = gfxDevice->GetSwapchainBufferDescriptor();
+  auto dsvHandle = m_depthBuffer.dsvHandle;
+  if (depthOnly)
+  {
+    commandList->OMSetRenderTargets(0, nullptr, FALSE, &(dsvHandle.hCpu));
+  }
+  else
+  {
+    commandList->OMSetRenderTargets(1, &rtvHandle.hCpu, FALSE, &(dsvHandle.hCpu));
+  }
+
+  ID3D12DescriptorHeap* heaps[] = {
+    gfxDevice->GetDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV).Get(),
+    gfxDevice->GetDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER).Get(),
+  };
+  commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+
+  auto cb = m_constantBuffer[frameIndex].buffer;
+  commandList->SetGraphicsRootConstantBufferView(0, cb->GetGPUVirtualAddress());
+  commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+  if (IsBindlessActive())
+  {
+    // 描画ごとに変わるのはマテリアルインデックス(ルート定数)のみ.
+    const auto& buffers = m_bindlessBuffers[frameIndex];
+    commandList->SetGraphicsRootConstantBufferView(1, buffers.drawParams->GetGPUVirtualAddress());
+    commandList->SetGraphicsRootShaderResourceView(3, buffers.materials->GetGPUVirtualAddress());
+    commandList->SetGraphicsRootDescriptorTable(4, heaps[0]->GetGPUDescriptorHandleForHeapStart());
+    commandList->SetGraphicsRootDescriptorTable(5, heaps[1]->GetGPUDescriptorHandleForHeapStart());
+  }
+}
+
+void MyApplication::BuildDrawList()
+{
+  // カメラからの距離(2乗)を求めておく.
+  const auto drawInfoCount = m_model.drawInfos.size();
+  std::vector<float> viewDistances(drawInfoCount);
+  const auto eyePosition = XMLoadFloat3(&m_sceneParams.eyePosition);
+  for (size_t i = 0; i < drawInfoCount; ++i)
+  {
+    const auto& mesh = m_model.meshes[m_model.drawInfos[i].meshIndex];
+    auto center = XMVector3Transform(XMLoadFloat3(&mesh.boundsCenter), m_model.mtxWorld);
+    viewDistances[i] = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(center, eyePosition)));
+  }
+  auto sortFrontToBack = [&](std::vector<uint32_t>::iterator begin, std::vector<uint32_t>::iterator end) {
+    std::stable_sort(begin, end,
+      [&](uint32_t a, uint32_t b) { return viewDistances[a] < viewDistances[b]; });
+  };
+  auto sortByState = [&](std::vector<uint32_t>::iterator begin, std::vector<uint32_t>::iterator end) {
+    // ディスクリプタテーブルの切り替えが減るように並べる.
+    auto sortKey = [&](uint32_t drawIndex) {
+      const auto& material = m_model.materials[m_model.drawInfos[drawIndex].materialIndex];
+      auto samplerKey = material.useStaticSampler ? 0 : material.samplerDiffuse.hGpu.ptr;
+      return std::make_pair(samplerKey, material.srvDiffuse.hGpu.ptr);
+    };
+    std::stable_sort(begin, end,
+      [&](uint32_t a, uint32_t b) { return sortKey(a) < sortKey(b); });
+  };
+
+  // 不透明 -> マスク -> 半透明 の順に並べる.
+  const bool useDepthPrepass = IsDepthPrepassActive();
+  m_drawList.clear();
+  m_depthDrawList.clear();
   auto modeList = {
     ModelMaterial::ALPHA_MODE_OPAQUE, ModelMaterial::ALPHA_MODE_MASK, ModelMaterial::ALPHA_MODE_BLEND
   };
-  
   for (auto mode : modeList)
   {
-    commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    switch (mode)
-    {
-    default:
-    case ModelMaterial::ALPHA_MODE_OPAQUE:
-      commandList->SetPipelineState(m_drawOpaquePipeline.Get());
-      break;
-    case ModelMaterial::ALPHA_MODE_MASK:
-      commandList->SetPipelineState(m_drawOpaquePipeline.Get());
-      break;
-    case ModelMaterial::ALPHA_MODE_BLEND:
-      commandList->SetPipelineState(m_drawBlendPipeline.Get());
-      break;
-    }
-    for (uint32_t i = 0; i < m_model.drawInfos.size(); ++i)
+    auto modeBegin = m_drawList.size();
+    for (uint32_t i = 0; i < drawInfoCount; ++i)
     {
       const auto& info = m_model.drawInfos[i];
-      const auto& mesh = m_model.meshes[i];
-      const auto& material = m_model.materials[mesh.materialIndex];
-
-      if (material.alphaMode != mode)
+      if (m_model.materials[info.materialIndex].alphaMode == mode)
       {
-        continue;
+        m_drawList.push_back(i);
       }
-      DrawParameters drawParams{};
-      XMStoreFloat4x4(&drawParams.mtxWorld, XMMatrixTranspose(m_model.mtxWorld));
-      drawParams.baseColor = material.diffuse;
-      drawParams.specular = material.specular;
-      drawParams.ambient = material.ambient;
-      if (material.alphaMode == ModelMaterial::ALPHA_MODE_MASK)
-      {
-        drawParams.mode = 1;
-      }
-      if (m_overwrite)
+    }
+    if (mode == ModelMaterial::ALPHA_MODE_BLEND)
+    {
+      continue;
+    }
+
+    if (useDepthPrepass)
+    {
+      // 遮蔽はプリパスで手前から描いて確定させる.
+      // 本描画は深度一致で不要なピクセルが棄却されるため、ステートの切り替えを優先する.
+      auto depthBegin = m_depthDrawList.size();
+      m_depthDrawList.insert(m_depthDrawList.end(), m_drawList.begin() + modeBegin, m_drawList.end());
+      sortFrontToBack(m_depthDrawList.begin() + depthBegin, m_depthDrawList.end());
+      sortByState(m_drawList.begin() + modeBegin, m_drawList.end());
+    }
+    else
+    {
+      // Early-Z で棄却されやすいように手前から描く.
+      sortFrontToBack(m_drawList.begin() + modeBegin, m_drawList.end());
+    }
+  }
+}
+
+void MyApplication::UpdateTextureStreaming()
+{
+  auto& streamer = GetTextureStreamer();
+  if (!streamer->IsSupported())
+  {
+    return;
+  }
+  // 描画位置で1ピクセルが占める大きさから、各メッシュのテクスチャに必要なレベルを求める.
+  // 境界球の手前側の距離を使い、メッシュ内で最も詳細な部分に合わせる.
+  const auto eyePosition = XMLoadFloat3(&m_sceneParams.eyePosition);
+  const float pixelScale = 2.0f * tanf(XM_PIDIV4 * 0.5f) / m_viewport.Height;
+  for (const auto& mesh : m_model.meshes)
+  {
+    const auto& material = m_model.materials[mesh.materialIndex];
+    if (material.streamId == TextureStreamer::InvalidStreamId)
+    {
+      continue;
+    }
+    auto center = XMVector3Transform(XMLoadFloat3(&mesh.boundsCenter), m_model.mtxWorld);
+    float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(center, eyePosition))) - mesh.boundsRadius;
+    distance = distance > 0.1f ? distance : 0.1f;
+    auto mip = ComputeRequiredMip(material.textureSize, mesh.uvDensity, distance * pixelScale,
+      streamer->GetMipLevelCount(material.streamId));
+    streamer->Request(material.streamId, mip);
+  }
+  streamer->Update();
+
+  for (auto& material : m_model.materials)
+  {
+    material.minLod = streamer->GetMinLod(material.streamId);
+  }
+}
+
+void MyApplication::UpdateBindlessMaterialBuffer(UINT frameIndex)
+{
+  auto& gfxDevice = GetGfxDevice();
+  auto& buffers = m_bindlessBuffers[frameIndex];
+
+  MaterialParameters* materials = nullptr;
+  buffers.materials->Map(0, nullptr, reinterpret_cast<void**>(&materials));
+  for (size_t i = 0; i < m_model.materials.size(); ++i)
+  {
+    const auto& material = m_model.materials[i];
+    auto& dst = materials[i];
+    dst.diffuse = material.diffuse;
+    dst.specular = material.specular;
+    dst.ambient = material.ambient;
+    if (m_overwrite)
+    {
+      dst.specular = m_globalSpecular;
+      dst.ambient = m_globalAmbient;
+    }
+    dst.textureIndex = gfxDevice->GetDescriptorIndex(material.srvDiffuse);
+    dst.samplerIndex = gfxDevice->GetDescriptorIndex(material.samplerDiffuse);
+    if (material.useStaticSampler)
+    {
+      dst.samplerIndex = StaticSamplerIndex;
+    }
+    dst.mode = material.alphaMode == ModelMaterial::ALPHA_MODE_MASK ? 1 : 0;
+    dst.minLod = material.minLod;
+    dst.uvScaleBias = GetUvScaleBias(material.region);
+    dst.arraySlice = material.region.arraySlice;
+  }
+  buffers.materials->Unmap(0, nullptr);
+
+  DrawParameters drawParams{};
+  XMStoreFloat4x4(&drawParams.mtxWorld, XMMatrixTranspose(m_model.mtxWorld));
+  void* p;
+  buffers.drawParams->Map(0, nullptr, &p);
+  memcpy(p, &drawParams, sizeof(drawParams));
+  buffers.drawParams->Unmap(0, nullptr);
+}
+
+void MyApplication::DrawModel(ComPtr<ID3D12GraphicsCommandList> commandList, uint32_t first, uint32_t count)
+{
+  // 複数スレッドから同時に呼ばれるため、メンバの書き換えは行わないこと.
+  auto& gfxDevice = GetGfxDevice();
+  int frameIndex = gfxDevice->GetFrameIndex();
+
+  XMFLOAT4X4 mtxWorld;
+  XMStoreFloat4x4(&mtxWorld, XMMatrixTranspose(m_model.mtxWorld));
+
+  const bool useBindless = IsBindlessActive();
+  auto opaquePipeline = useBindless ? m_drawOpaqueBindlessPipeline : m_drawOpaquePipeline;
+  auto blendPipeline = useBindless ? m_drawBlendBindlessPipeline : m_drawBlendPipeline;
+  if (IsDepthPrepassActive())
+  {
+    opaquePipeline = useBindless ? m_drawOpaqueEqualBindlessPipeline : m_drawOpaqueEqualPipeline;
+  }
+
+  int currentMode = -1;
+  D3D12_GPU_DESCRIPTOR_HANDLE currentSrv{}, currentSampler{};
+  for (uint32_t drawIndex = first; drawIndex < first + count; ++drawIndex)
+  {
+    const auto& info = m_model.drawInfos[m_drawList[drawIndex]];
+    const auto& mesh = m_model.meshes[info.meshIndex];
+    const auto& material = m_model.materials[mesh.materialIndex];
+
+    if (currentMode != material.alphaMode)
+    {
+      currentMode = material.alphaMode;
+      switch (material.alphaMode)
       {
-        drawParams.specular = m_globalSpecular;
-        drawParams.ambient = m_globalAmbient;
+      default:
+      case ModelMaterial::ALPHA_MODE_OPAQUE:
+        commandList->SetPipelineState(opaquePipeline.Get());
+        break;
+      case ModelMaterial::ALPHA_MODE_MASK:
+        commandList->SetPipelineState(opaquePipeline.Get());
+        break;
+      case ModelMaterial::ALPHA_MODE_BLEND:
+        commandList->SetPipelineState(blendPipeline.Get());
+        break;
       }
+    }
 
-      // 定数バッファの更新.
-      auto& cb = info.modelMeshConstantBuffer[frameIndex];
-      void* p;
-      cb->Map(0, nullptr, &p);
-      memcpy(p, &drawParams, sizeof(drawParams));
-      cb->Unmap(0, nullptr);
-
-      // 描画.
-      commandList->IASetVertexBuffers(0, _countof(mesh.vbViews), mesh.vbViews);
-      commandList->IASetIndexBuffer(&mesh.ibv);
-      commandList->SetGraphicsRootConstantBufferView(1, cb->GetGPUVirtualAddress());
-      commandList->SetGraphicsRootDescriptorTable(2, material.srvDiffuse.hGpu);
-      commandList->SetGraphicsRootDescriptorTable(3, material.samplerDiffuse.hGpu);
-
+    commandList->IASetVertexBuffers(0, _countof(mesh.vbViews), mesh.vbViews);
+    commandList->IASetIndexBuffer(&mesh.ibv);
+    if (useBindless)
+    {
+      // マテリアル情報はシェーダー側でインデックスから参照する.
+      commandList->SetGraphicsRoot32BitConstant(2, mesh.materialIndex, 0);
       commandList->DrawIndexedInstanced(mesh.indexCount, 1, 0, 0, 0);
+      continue;
     }
-  }
 
+    DrawParameters drawParams{};
+    drawParams.mtxWorld = mtxWorld;
+    drawParams.baseColor = material.diffuse;
+    drawParams.specular = material.specular;
+    drawParams.ambient = material.ambient;
+    if (material.alphaMode == ModelMaterial::ALPHA_MODE_MASK)
+    {
+      drawParams.mode = 1;
+    }
+    drawParams.useStaticSampler = material.useStaticSampler ? 1 : 0;
+    drawParams.minLod = material.minLod;
+    drawParams.arraySlice = material.region.arraySlice;
+    drawParams.uvScaleBias = GetUvScaleBias(material.region);
+    if (m_overwrite)
+    {
+      drawParams.specular = m_globalSpecular;
+      drawParams.ambient = m_globalAmbient;
+    }
+
+    // 定数バッファの更新.
+    auto& cb = info.modelMeshConstantBuffer[frameIndex];
+    void* p;
+    cb->Map(0, nullptr, &p);
+    memcpy(p, &drawParams, sizeof(drawParams));
+    cb->Unmap(0, nullptr);
+
+    // 描画.
+    commandList->SetGraphicsRootConstantBufferView(1, cb->GetGPUVirtualAddress());
+    // 直前の描画と同じテーブルであれば設定を省略する.
+    if (currentSrv.ptr != material.srvDiffuse.hGpu.ptr)
+    {
+      currentSrv = material.srvDiffuse.hGpu;
+      commandList->SetGraphicsRootDescriptorTable(2, currentSrv);
+    }
+    if (currentSampler.ptr != material.samplerDiffuse.hGpu.ptr)
+    {
+      // 静的サンプラー使用時もテーブルは未設定にできないため、有効なものを設定しておく.
+      currentSampler = material.samplerDiffuse.hGpu;
+      commandList->SetGraphicsRootDescriptorTable(3, currentSampler);
+    }
+
+    commandList->DrawIndexedInstanced(mesh.indexCount, 1, 0, 0, 0);
+  }
 }
 
-std::vector<MyApplication::TextureInfo>::const_iterator MyApplication::FindModelTexture(const std::string& filePath, const ModelData& model)
+void MyApplication::DrawModelDepth(ComPtr<ID3D12GraphicsCommandList> commandList, uint32_t first, uint32_t count)
 {
-  return std::find_if(model.textureList.begin(), model.textureList.end(), [&](const auto& v) { return v.filePath == filePath; });
+  // 定数バッファは本描画(DrawModel)で書き込んだものを参照する.
+  // コマンドの実行は全ての記録が終わってからのため、同一フレームの内容が使われる.
+  auto& gfxDevice = GetGfxDevice();
+  int frameIndex = gfxDevice->GetFrameIndex();
+
+  const bool useBindless = IsBindlessActive();
+  auto opaquePipeline = useBindless ? m_depthPrepassBindlessPipeline : m_depthPrepassPipeline;
+  auto maskPipeline = useBindless ? m_depthPrepassMaskBindlessPipeline : m_depthPrepassMaskPipeline;
+
+  int currentMode = -1;
+  D3D12_GPU_DESCRIPTOR_HANDLE currentSrv{}, currentSampler{};
+  for (uint32_t drawIndex = first; drawIndex < first + count; ++drawIndex)
+  {
+    const auto& info = m_model.drawInfos[m_depthDrawList[drawIndex]];
+    const auto& mesh = m_model.meshes[info.meshIndex];
+    const auto& material = m_model.materials[mesh.materialIndex];
+
+    if (currentMode != material.alphaMode)
+    {
+      currentMode = material.alphaMode;
+      auto pipeline = material.alphaMode == ModelMaterial::ALPHA_MODE_MASK ? maskPipeline : opaquePipeline;
+      commandList->SetPipelineState(pipeline.Get());
+    }
+
+    commandList->IASetVertexBuffers(0, _countof(mesh.vbViews), mesh.vbViews);
+    commandList->IASetIndexBuffer(&mesh.ibv);
+    if (useBindless)
+    {
+      commandList->SetGraphicsRoot32BitConstant(2, mesh.materialIndex, 0);
+    }
+    else
+    {
+      auto& cb = info.modelMeshConstantBuffer[frameIndex];
+      commandList->SetGraphicsRootConstantBufferView(1, cb->GetGPUVirtualAddress());
+      if (material.alphaMode == ModelMaterial::ALPHA_MODE_MASK)
+      {
+        if (currentSrv.ptr != material.srvDiffuse.hGpu.ptr)
+        {
+          currentSrv = material.srvDiffuse.hGpu;
+          commandList->SetGraphicsRootDescriptorTable(2, currentSrv);
+        }
+        if (currentSampler.ptr != material.samplerDiffuse.hGpu.ptr)
+        {
+          currentSampler = material.samplerDiffuse.hGpu;
+          commandList->SetGraphicsRootDescriptorTable(3, currentSampler);
+        }
+      }
+    }
+    commandList->DrawIndexedInstanced(mesh.indexCount, 1, 0, 0, 0);
+  }
 }
 
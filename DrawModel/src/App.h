@@ -7,7 +7,10 @@
 #include <DirectXMath.h>
 
 #include "GfxDevice.h"
+#include "JobSystem.h"
 #include "Model.h"
+#include "TextureManager.h"
+#include "TextureBaker.h"
 
 class MyApplication 
 {
@@ -26,11 +29,23 @@ private:
   void PrepareSceneConstantBuffer();
   void PrepareModelDrawPipeline();
   void PrepareModelData();
+  void PrepareBindlessMaterialBuffers();
+  // モデルのテクスチャを圧縮済みの DDS に変換して保存する. 次回起動時から使用される.
+  void BakeModelTextures();
   void PrepareImGui();
   void DestroyImGui();
-  ComPtr<ID3D12GraphicsCommandList> MakeCommandList();
-
-  void DrawModel(ComPtr<ID3D12GraphicsCommandList> commandList);
+  // 1フレーム分のコマンドリスト群を作成する. 配列の順序で実行すること.
+  std::vector<ComPtr<ID3D12GraphicsCommandList>> MakeCommandLists();
+
+  // depthOnly の場合は深度バッファのみを描画先に設定する.
+  void SetupDrawState(ComPtr<ID3D12GraphicsCommandList> commandList, bool depthOnly = false);
+  void BuildDrawList();
+  void UpdateBindlessMaterialBuffer(UINT frameIndex);
+  void UpdateTextureStreaming();
+  bool IsBindlessActive() const { return m_useBindless && m_rootSignatureBindless; }
+  void DrawModel(ComPtr<ID3D12GraphicsCommandList> commandList, uint32_t first, uint32_t count);
+  void DrawModelDepth(ComPtr<ID3D12GraphicsCommandList> commandList, uint32_t first, uint32_t count);
+  bool IsDepthPrepassActive() const { return m_useDepthPrepass && m_depthPrepassPipeline; }
 
   struct Vertex
   {
@@ -41,6 +56,19 @@ private:
   ComPtr<ID3D12PipelineState> m_drawOpaquePipeline;
   ComPtr<ID3D12PipelineState> m_drawBlendPipeline;
 
+  // デプスプリパス用. 本描画の不透明物は深度が一致するピクセルのみ処理する.
+  ComPtr<ID3D12PipelineState> m_depthPrepassPipeline;
+  ComPtr<ID3D12PipelineState> m_depthPrepassMaskPipeline;
+  ComPtr<ID3D12PipelineState> m_drawOpaqueEqualPipeline;
+
+  // バインドレス描画用. リソースバインディングTier2未満の環境では作成しない.
+  ComPtr<ID3D12RootSignature> m_rootSignatureBindless;
+  ComPtr<ID3D12PipelineState> m_drawOpaqueBindlessPipeline;
+  ComPtr<ID3D12PipelineState> m_drawBlendBindlessPipeline;
+  ComPtr<ID3D12PipelineState> m_depthPrepassBindlessPipeline;
+  ComPtr<ID3D12PipelineState> m_depthPrepassMaskBindlessPipeline;
+  ComPtr<ID3D12PipelineState> m_drawOpaqueEqualBindlessPipeline;
+
   struct DepthBufferInfo
   {
     ComPtr<ID3D12Resource1> image;
@@ -79,6 +107,9 @@ private:
     uint32_t indexCount;
     uint32_t vertexCount;
     uint32_t materialIndex;
+    DirectX::XMFLOAT3 boundsCenter;  // 描画順のソートに使う中心位置(ローカル空間).
+    float boundsRadius;              // boundsCenter を中心とする境界球の半径.
+    float uvDensity;                 // ローカル空間の単位長あたりの UV 変化量.
   };
   struct MeshMaterial
   {
@@ -89,7 +120,13 @@ private:
     DirectX::XMFLOAT4 ambient{};
 
     GfxDevice::DescriptorHandle srvDiffuse;
-    GfxDevice::DescriptorHandle samplerDiffuse;
+    GfxDevice::DescriptorHandle samplerDiffuse;  // GfxDevice のキャッシュで共有されている.
+    bool useStaticSampler = false;  // ルートシグネチャの静的サンプラーで代用できる.
+
+    TextureStreamer::StreamId streamId = TextureStreamer::InvalidStreamId;
+    uint32_t textureSize = 0;  // mip0 の幅と高さの大きい方.
+    float minLod = 0.0f;       // 常駐している最も詳細なレベル. UpdateTextureStreaming で更新する.
+    TextureManager::TextureRegion region;  // アトラス・配列にまとめられている場合の参照先.
   };
 
   // 定数バッファに書き込む構造体.
@@ -101,17 +138,33 @@ private:
     DirectX::XMFLOAT4   ambient;   // ambient
 
     uint32_t  mode;
-    uint32_t  padd0;
-    uint32_t  padd1;
-    uint32_t  padd2;
+    uint32_t  useStaticSampler;
+    float     minLod;
+    uint32_t  arraySlice;
+    DirectX::XMFLOAT4   uvScaleBias;  // xy:スケール, zw:オフセット.
   };
 
-  struct TextureInfo
+  // バインドレス描画時に StructuredBuffer に書き込むマテリアル情報.
+  struct MaterialParameters
   {
-    std::string filePath;
-    ComPtr<ID3D12Resource1> texResource;
-    GfxDevice::DescriptorHandle srvDescriptor;
+    DirectX::XMFLOAT4   diffuse;
+    DirectX::XMFLOAT4   specular;
+    DirectX::XMFLOAT4   ambient;
+
+    uint32_t  textureIndex;  // CBV_SRV_UAV ヒープ先頭からのインデックス.
+    uint32_t  samplerIndex;  // サンプラーヒープ先頭からのインデックス. 静的サンプラー使用時は StaticSamplerIndex.
+    uint32_t  mode;
+    float     minLod;
+    DirectX::XMFLOAT4   uvScaleBias;  // xy:スケール, zw:オフセット.
+    uint32_t  arraySlice;
   };
+  static const uint32_t StaticSamplerIndex = 0xFFFFFFFFu;
+  struct BindlessFrameBuffers
+  {
+    ComPtr<ID3D12Resource1> materials;   // MaterialParameters の配列.
+    ComPtr<ID3D12Resource1> drawParams;  // 全描画で共通の DrawParameters.
+  } m_bindlessBuffers[GfxDevice::BackBufferCount];
+
   struct DrawInfo
   {
     ComPtr<ID3D12Resource1> modelMeshConstantBuffer[GfxDevice::BackBufferCount];
@@ -125,15 +178,36 @@ private:
     std::vector<PolygonMesh> meshes;
     std::vector<MeshMaterial> materials;
     std::vector<DrawInfo> drawInfos;
-    std::vector<TextureInfo> textureList;
-    std::vector<TextureInfo> embeddedTextures;
+    // TextureManager から取得したテクスチャ. 参照を保持しているため終了時に Release する.
+    std::vector<TextureManager::TextureHandle> textureList;
+    std::vector<TextureManager::TextureHandle> embeddedTextures;
     DirectX::XMMATRIX mtxWorld;
   } m_model;
-  std::vector<TextureInfo>::const_iterator FindModelTexture(const std::string& filePath, const ModelData& model);
+
+  // 圧縮済みファイルが無かったテクスチャ.
+  struct BakeTarget
+  {
+    std::filesystem::path filePath;
+    TextureBakeOptions options;
+  };
+  std::vector<BakeTarget> m_bakeTargets;
+  uint32_t m_bakedTextureCount = 0;
+
+  // 今フレームで描画する drawInfos のインデックス(描画順).
+  std::vector<uint32_t> m_drawList;
+  // デプスプリパスで描画する drawInfos のインデックス(手前から奥へ).
+  std::vector<uint32_t> m_depthDrawList;
+  bool  m_useDepthPrepass = true;
+  bool  m_useBindless = true;
+  bool  m_multithreadRecording = true;
+  int   m_drawsPerChunk = 256;
+  float m_recordTimeMs = 0.0f;
+  uint32_t m_recordCommandListCount = 0;
 
   DirectX::XMFLOAT4 m_globalSpecular = DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 30.0f);
   DirectX::XMFLOAT4 m_globalAmbient = DirectX::XMFLOAT4(0.15f, 0.15f, 0.15f, 0.0f);
   bool  m_overwrite = false;
+  int   m_streamingBudgetMB = 256;
 
   float m_frameDeltaAccum = 0.0f;
   std::wstring m_title;
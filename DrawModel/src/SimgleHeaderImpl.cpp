@@ -1,5 +0,0 @@
-﻿#define STB_IMAGE_IMPLEMENTATION
-#include "stb/stb_image.h"
-
-#define STB_IMAGE_RESIZE_IMPLEMENTATION
-#include "stb/stb_image_resize.h"
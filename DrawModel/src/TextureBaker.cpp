@@ -0,0 +1,57 @@
+﻿#include "TextureBaker.h"
+#include "DdsFile.h"
+#include "FileLoader.h"
+
+#include <fstream>
+
+bool BakeTexture(const void* srcBuffer, size_t bufferSize, const TextureBakeOptions& options, std::vector<uint8_t>& outBuffer)
+{
+  DecodedImage image;
+  if (!DecodeImage(srcBuffer, bufferSize, image) || IsBlockCompressed(image.format))
+  {
+    return false;
+  }
+  // 色データは DDS に _SRGB 形式として記録する.
+  image.srgb = image.srgb || options.mipOptions.srgb;
+  if (options.generateMips)
+  {
+    BuildMipChain(image, options.mipOptions);
+  }
+  if (IsBlockCompressed(options.format))
+  {
+    DecodedImage compressed;
+    if (!CompressImage(image, options.format, options.quality, compressed))
+    {
+      return false;
+    }
+    image = std::move(compressed);
+  }
+  return EncodeDDS(image, outBuffer);
+}
+
+bool BakeTextureFile(const std::filesystem::path& srcPath, const std::filesystem::path& dstPath, const TextureBakeOptions& options)
+{
+  std::vector<char> fileData;
+  if (!GetFileLoader()->Load(srcPath, fileData))
+  {
+    return false;
+  }
+  std::vector<uint8_t> ddsData;
+  if (!BakeTexture(fileData.data(), fileData.size(), options, ddsData))
+  {
+    return false;
+  }
+  std::ofstream outfile(dstPath, std::ios::binary);
+  if (!outfile)
+  {
+    return false;
+  }
+  outfile.write(reinterpret_cast<const char*>(ddsData.data()), std::streamsize(ddsData.size()));
+  return bool(outfile);
+}
+
+std::filesystem::path GetBakedTexturePath(const std::filesystem::path& srcPath)
+{
+  auto bakedPath = srcPath;
+  return bakedPath.replace_extension(".dds");
+}
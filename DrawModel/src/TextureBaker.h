@@ -0,0 +1,25 @@
+﻿#pragma once
+#include <vector>
+#include <filesystem>
+#include "TextureDecode.h"
+#include "BcEncoder.h"
+
+// 画像ファイルをミップマップ付きのブロック圧縮テクスチャ(DDS)へ変換する.
+// 実行時の展開・ミップマップ作成・圧縮を事前に済ませておき、読み込みは DDS をそのまま転送するだけにする.
+struct TextureBakeOptions
+{
+  ImageFormat format = ImageFormat::BC7;
+  BcQuality quality = BcQuality::Normal;
+  bool generateMips = true;
+  MipGenerateOptions mipOptions;
+};
+
+// 画像ファイルのメモリイメージを変換し、DDS 形式で出力する.
+// 圧縮形式で mip0 の幅・高さが4の倍数でないものは失敗する.
+bool BakeTexture(const void* srcBuffer, size_t bufferSize, const TextureBakeOptions& options, std::vector<uint8_t>& outBuffer);
+
+// ファイルを変換して dstPath へ保存する.
+bool BakeTextureFile(const std::filesystem::path& srcPath, const std::filesystem::path& dstPath, const TextureBakeOptions& options);
+
+// 変換済みファイルの置き場所. 元のファイルと同じフォルダに拡張子を .dds として置く.
+std::filesystem::path GetBakedTexturePath(const std::filesystem::path& srcPath);
@@ -0,0 +1,530 @@
+﻿#include "TextureManager.h"
+#include "TextureUtility.h"
+#include "FileLoader.h"
+#include "JobSystem.h"
+#include "GpuMipGenerator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <chrono>
+
+static std::unique_ptr<TextureManager> gTextureManager = nullptr;
+
+std::unique_ptr<TextureManager>& GetTextureManager()
+{
+  if (gTextureManager == nullptr)
+  {
+    gTextureManager = std::make_unique<TextureManager>();
+  }
+  return gTextureManager;
+}
+
+// GPU のミップマップ作成は単純な平均(sRGB は線形空間での平均)のみに対応している.
+static bool CanGenerateMipsOnGpu(const MipGenerateOptions& options)
+{
+  return !options.preserveAlphaCoverage;
+}
+
+std::vector<TextureManager::TextureHandle> TextureManager::LoadBatch(const std::vector<LoadSource>& sources)
+{
+  std::vector<TextureHandle> handles(sources.size(), InvalidHandle);
+  m_requestCount += uint32_t(sources.size());
+
+  // 読み込み済みでないものを集める. 同じパスはまとめて1回だけ読み込む.
+  struct PendingLoad
+  {
+    std::string pathKey;  // 空の場合はメモリから.
+    std::vector<char> fileData;
+    const void* srcBuffer = nullptr;
+    size_t bufferSize = 0;
+    ContentKey contentKey;
+    TextureHandle handle = InvalidHandle;
+    int decodeIndex = -1;
+    std::vector<size_t> sourceIndices;
+  };
+  std::vector<PendingLoad> pendings;
+  std::unordered_map<std::string, size_t> pendingPaths;
+  for (size_t i = 0; i < sources.size(); ++i)
+  {
+    const auto& source = sources[i];
+    if (source.filePath.empty())
+    {
+      auto& pending = pendings.emplace_back();
+      pending.srcBuffer = source.srcBuffer;
+      pending.bufferSize = source.bufferSize;
+      pending.sourceIndices.push_back(i);
+      continue;
+    }
+
+    auto key = NormalizePath(source.filePath);
+    if (auto itr = m_pathTable.find(key); itr != m_pathTable.end())
+    {
+      AddRef(itr->second);
+      handles[i] = itr->second;
+    }
+    else if (auto pendingItr = pendingPaths.find(key); pendingItr != pendingPaths.end())
+    {
+      pendings[pendingItr->second].sourceIndices.push_back(i);
+    }
+    else
+    {
+      pendingPaths.emplace(key, pendings.size());
+      auto& pending = pendings.emplace_back();
+      pending.pathKey = key;
+      pending.sourceIndices.push_back(i);
+    }
+  }
+  m_lastLoadStats = LoadStats{};
+  if (pendings.empty())
+  {
+    return handles;
+  }
+
+  // ファイル読み込みとハッシュ計算.
+  auto& jobSystem = GetJobSystem();
+  auto readStart = std::chrono::high_resolution_clock::now();
+  jobSystem->Dispatch(uint32_t(pendings.size()), [&](uint32_t jobIndex, uint32_t) {
+    auto& pending = pendings[jobIndex];
+    const auto& source = sources[pending.sourceIndices[0]];
+    if (!pending.pathKey.empty())
+    {
+      if (!GetFileLoader()->Load(source.filePath, pending.fileData))
+      {
+        return;
+      }
+      pending.srcBuffer = pending.fileData.data();
+      pending.bufferSize = pending.fileData.size();
+    }
+    pending.contentKey = ComputeContentKey(pending.srcBuffer, pending.bufferSize);
+  });
+  auto readEnd = std::chrono::high_resolution_clock::now();
+  m_lastLoadStats.readMs = std::chrono::duration<double, std::milli>(readEnd - readStart).count();
+
+  // 別名で読み込み済みのもの、バッチ内で内容が同じものは展開しない.
+  std::vector<TextureDecodeRequest> decodeRequests;
+  std::vector<ContentKey> decodeKeys;
+  std::vector<bool> generateOnGpu, streamed, packed;
+  const bool useStreaming = GetTextureStreamer()->IsSupported();
+  const bool useGpuMips = m_useGpuMipGeneration && GetGpuMipGenerator()->IsSupported();
+  std::unordered_map<ContentKey, int, ContentKeyHash> batchContents;
+  for (auto& pending : pendings)
+  {
+    if (pending.srcBuffer == nullptr)
+    {
+      continue;
+    }
+    if (auto itr = m_contentTable.find(pending.contentKey); itr != m_contentTable.end())
+    {
+      pending.handle = itr->second;
+    }
+    else if (auto batchItr = batchContents.find(pending.contentKey); batchItr != batchContents.end())
+    {
+      pending.decodeIndex = batchItr->second;
+    }
+    else
+    {
+      pending.decodeIndex = int(decodeRequests.size());
+      batchContents.emplace(pending.contentKey, pending.decodeIndex);
+      decodeKeys.push_back(pending.contentKey);
+      auto& request = decodeRequests.emplace_back();
+      request.srcBuffer = pending.srcBuffer;
+      request.bufferSize = pending.bufferSize;
+      const auto& source = sources[pending.sourceIndices[0]];
+      request.generateMips = source.generateMips;
+      request.mipOptions = source.mipOptions;
+      // ストリーミングするものは転送元として CPU 側に全レベルを持つ必要がある.
+      bool stream = source.streaming && useStreaming;
+      // アトラスに入る小さいものは、ほぼ全レベルがパックされたミップになりストリーミングの効果が無いためまとめる.
+      bool pack = source.packable && m_useTexturePacking;
+      if (pack && stream)
+      {
+        ImageInfo info;
+        pack = ReadImageInfo(request.srcBuffer, request.bufferSize, info) &&
+          std::max(info.width, info.height) <= m_packSettings.atlasMaxTextureSize;
+        stream = !pack;
+      }
+      // GPU 側で作成するものは CPU では mip0 のみ展開する. まとめるものは CPU 上で配置するため全レベルを展開する.
+      const bool onGpu = !stream && !pack && request.generateMips && useGpuMips && CanGenerateMipsOnGpu(request.mipOptions);
+      request.generateMips = request.generateMips && !onGpu;
+      generateOnGpu.push_back(onGpu);
+      streamed.push_back(stream);
+      packed.push_back(pack);
+    }
+  }
+
+  // 展開・ミップマップ作成と GPU への転送.
+  // ストリーミングするものは転送元のイメージを CPU 側に残すため通常の展開を行い、
+  // まとめるものは展開したイメージからアトラス・配列のイメージを作成して転送する.
+  // それ以外はアップロードリング上へ直接展開して中間のイメージを作らない.
+  enum UploadGroup { GroupCpuMips, GroupGpuMips, GroupStreaming, GroupPacked, GroupCount };
+  std::vector<TextureDecodeRequest> groupRequests[GroupCount];
+  std::vector<size_t> groupIndices[GroupCount];
+  for (size_t i = 0; i < decodeRequests.size(); ++i)
+  {
+    const auto group = streamed[i] ? GroupStreaming : packed[i] ? GroupPacked : (generateOnGpu[i] ? GroupGpuMips : GroupCpuMips);
+    groupRequests[group].push_back(std::move(decodeRequests[i]));
+    groupIndices[group].push_back(i);
+  }
+  auto& decodeStats = m_lastLoadStats.decode;
+  auto addDecodeStats = [&](const TextureDecodeStats& stats) {
+    decodeStats.imageCount += stats.imageCount;
+    decodeStats.pixelCount += stats.pixelCount;
+    decodeStats.decodeMs += stats.decodeMs;
+    decodeStats.threadCount = stats.threadCount;
+  };
+
+  auto uploadStart = std::chrono::high_resolution_clock::now();
+  std::vector<ComPtr<ID3D12Resource1>> resources(decodeRequests.size());
+  std::vector<TextureStreamer::StreamId> streamIds(decodeRequests.size(), TextureStreamer::InvalidStreamId);
+  std::vector<ComPtr<ID3D12Resource1>> uploaded;
+  for (auto group : { GroupCpuMips, GroupGpuMips })
+  {
+    if (groupRequests[group].empty())
+    {
+      continue;
+    }
+    addDecodeStats(CreateTexturesFromEncoded(uploaded, groupRequests[group],
+      D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_FLAG_NONE, group == GroupGpuMips));
+    for (size_t i = 0; i < groupIndices[group].size(); ++i)
+    {
+      resources[groupIndices[group][i]] = uploaded[i];
+    }
+  }
+  if (auto& requests = groupRequests[GroupStreaming]; !requests.empty())
+  {
+    addDecodeStats(DecodeImages(requests));
+    // 詳細なレベルの転送元として、登録解除まで TextureStreamer が保持する.
+    std::vector<std::shared_ptr<const DecodedImage>> streamImages;
+    for (auto& request : requests)
+    {
+      streamImages.push_back(request.succeeded ? std::make_shared<const DecodedImage>(std::move(request.image)) : nullptr);
+    }
+    auto ids = GetTextureStreamer()->Register(streamImages, uploaded);
+    for (size_t i = 0; i < groupIndices[GroupStreaming].size(); ++i)
+    {
+      resources[groupIndices[GroupStreaming][i]] = uploaded[i];
+      streamIds[groupIndices[GroupStreaming][i]] = ids[i];
+    }
+  }
+  std::vector<uint32_t> packIndices(decodeRequests.size(), InvalidPack);
+  std::vector<TexturePackPlacement> placements(decodeRequests.size());
+  if (auto& requests = groupRequests[GroupPacked]; !requests.empty())
+  {
+    addDecodeStats(DecodeImages(requests));
+    std::vector<TexturePackInput> inputs;
+    std::vector<const DecodedImage*> images;
+    for (const auto& request : requests)
+    {
+      const auto& image = request.image;
+      images.push_back(request.succeeded ? &image : nullptr);
+      inputs.push_back(request.succeeded ?
+        TexturePackInput{ image.GetWidth(), image.GetHeight(), image.GetMipLevelCount(), image.format, image.srgb } : TexturePackInput{});
+    }
+    const auto plan = PlanTexturePacking(inputs, m_packSettings);
+    std::vector<DecodedImage> packedImages;
+    BuildPackedImages(plan, m_packSettings, images, packedImages);
+
+    // まとめたものと、どこにも入らなかったものを一緒に転送する.
+    std::vector<const DecodedImage*> uploadImages;
+    for (const auto& image : packedImages)
+    {
+      uploadImages.push_back(&image);
+    }
+    std::vector<size_t> singles;
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+      if (plan.placements[i].group == TexturePackPlacement::NotPacked && images[i] != nullptr)
+      {
+        singles.push_back(i);
+        uploadImages.push_back(images[i]);
+      }
+    }
+    CreateTexturesFromImages(uploaded, uploadImages);
+    for (size_t i = 0; i < singles.size(); ++i)
+    {
+      resources[groupIndices[GroupPacked][singles[i]]] = uploaded[plan.groups.size() + i];
+    }
+    for (size_t groupIndex = 0; groupIndex < plan.groups.size(); ++groupIndex)
+    {
+      if (uploaded[groupIndex] == nullptr)
+      {
+        continue;
+      }
+      const auto packIndex = CreatePack(uploaded[groupIndex]);
+      for (auto member : plan.groups[groupIndex].members)
+      {
+        const auto decodeIndex = groupIndices[GroupPacked][member];
+        packIndices[decodeIndex] = packIndex;
+        placements[decodeIndex] = plan.placements[member];
+      }
+    }
+  }
+  auto uploadEnd = std::chrono::high_resolution_clock::now();
+  // 展開と転送は交互に行われるため、全体から展開の時間を除いたものを転送の時間とする.
+  m_lastLoadStats.uploadMs = std::chrono::duration<double, std::milli>(uploadEnd - uploadStart).count() - decodeStats.decodeMs;
+
+  std::vector<TextureHandle> decodedHandles(decodeRequests.size(), InvalidHandle);
+  for (size_t i = 0; i < decodeRequests.size(); ++i)
+  {
+    if (packIndices[i] != InvalidPack)
+    {
+      decodedHandles[i] = CreatePackedEntry(decodeKeys[i], packIndices[i], placements[i]);
+    }
+    else if (resources[i])
+    {
+      decodedHandles[i] = CreateEntry(decodeKeys[i], resources[i], streamIds[i]);
+    }
+  }
+
+  // 要求元へ割り当てる.
+  for (auto& pending : pendings)
+  {
+    auto handle = pending.decodeIndex >= 0 ? decodedHandles[pending.decodeIndex] : pending.handle;
+    if (handle == InvalidHandle)
+    {
+      continue;
+    }
+    auto& entry = m_textures[handle];
+    if (!pending.pathKey.empty())
+    {
+      m_pathTable.emplace(pending.pathKey, handle);
+      entry.paths.push_back(pending.pathKey);
+    }
+    for (auto sourceIndex : pending.sourceIndices)
+    {
+      entry.refCount++;
+      handles[sourceIndex] = handle;
+    }
+  }
+  return handles;
+}
+
+TextureManager::TextureHandle TextureManager::Load(const std::filesystem::path& filePath, bool generateMips)
+{
+  return LoadBatch({ LoadSource{ .filePath = filePath, .generateMips = generateMips } })[0];
+}
+
+TextureManager::TextureHandle TextureManager::LoadFromMemory(const void* srcBuffer, size_t bufferSize, bool generateMips)
+{
+  return LoadBatch({ LoadSource{ .srcBuffer = srcBuffer, .bufferSize = bufferSize, .generateMips = generateMips } })[0];
+}
+
+void TextureManager::AddRef(TextureHandle handle)
+{
+  assert(handle < m_textures.size() && m_textures[handle].refCount > 0);
+  m_textures[handle].refCount++;
+}
+
+void TextureManager::Release(TextureHandle handle)
+{
+  if (handle == InvalidHandle)
+  {
+    return;
+  }
+  assert(handle < m_textures.size() && m_textures[handle].refCount > 0);
+  if (--m_textures[handle].refCount == 0)
+  {
+    Destroy(handle);
+  }
+}
+
+void TextureManager::Clear()
+{
+  for (TextureHandle i = 0; i < m_textures.size(); ++i)
+  {
+    if (m_textures[i].resource)
+    {
+      Destroy(i);
+    }
+  }
+  m_textures.clear();
+  m_freeHandles.clear();
+  m_packs.clear();
+  m_pathTable.clear();
+  m_contentTable.clear();
+}
+
+TextureManager::ComPtr<ID3D12Resource1> TextureManager::GetResource(TextureHandle handle) const
+{
+  assert(handle < m_textures.size());
+  return m_textures[handle].resource;
+}
+
+GfxDevice::DescriptorHandle TextureManager::GetShaderResourceView(TextureHandle handle) const
+{
+  assert(handle < m_textures.size());
+  return m_textures[handle].srvDescriptor;
+}
+
+TextureStreamer::StreamId TextureManager::GetStreamId(TextureHandle handle) const
+{
+  assert(handle < m_textures.size());
+  return m_textures[handle].streamId;
+}
+
+TextureManager::TextureRegion TextureManager::GetRegion(TextureHandle handle) const
+{
+  assert(handle < m_textures.size());
+  return m_textures[handle].region;
+}
+
+std::string TextureManager::NormalizePath(const std::filesystem::path& filePath)
+{
+  // Windows のファイルシステムに合わせて大文字小文字は区別しない.
+  auto normalized = filePath.lexically_normal().generic_string();
+  std::transform(normalized.begin(), normalized.end(), normalized.begin(),
+    [](unsigned char c) { return char(std::tolower(c)); });
+  return normalized;
+}
+
+TextureManager::ContentKey TextureManager::ComputeContentKey(const void* data, size_t size)
+{
+  // FNV-1a (64bit).
+  auto bytes = reinterpret_cast<const uint8_t*>(data);
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+  return ContentKey{ hash, uint64_t(size) };
+}
+
+GfxDevice::DescriptorHandle TextureManager::CreateView(ComPtr<ID3D12Resource1> resource)
+{
+  // まとめたものとそうでないものを同じシェーダーで参照できるよう、全て配列として参照する.
+  const auto texDesc = resource->GetDesc();
+  D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{
+    .Format = GetShaderResourceFormat(texDesc.Format),
+    .ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY,
+    .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
+    .Texture2DArray = {
+      .MostDetailedMip = 0,
+      .MipLevels = texDesc.MipLevels,
+      .FirstArraySlice = 0,
+      .ArraySize = texDesc.DepthOrArraySize,
+      .PlaneSlice = 0, .ResourceMinLODClamp = 0.
+    }
+  };
+  return GetGfxDevice()->CreateShaderResourceView(resource, srvDesc);
+}
+
+TextureManager::TextureHandle TextureManager::AllocateEntry(const ContentKey& key)
+{
+  m_loadCount++;
+
+  TextureHandle handle;
+  if (!m_freeHandles.empty())
+  {
+    handle = m_freeHandles.back();
+    m_freeHandles.pop_back();
+  }
+  else
+  {
+    handle = TextureHandle(m_textures.size());
+    m_textures.emplace_back();
+  }
+  // 参照カウントは呼び出し側で設定する.
+  auto& entry = m_textures[handle];
+  entry.refCount = 0;
+  entry.contentKey = key;
+  m_contentTable.emplace(key, handle);
+  return handle;
+}
+
+TextureManager::TextureHandle TextureManager::CreateEntry(const ContentKey& key, ComPtr<ID3D12Resource1> resource,
+  TextureStreamer::StreamId streamId)
+{
+  const auto handle = AllocateEntry(key);
+  auto& entry = m_textures[handle];
+  entry.resource = resource;
+  entry.srvDescriptor = CreateView(resource);
+  entry.streamId = streamId;
+  // 予約リソースのメモリはタイルヒープ側で確保される.
+  if (streamId == TextureStreamer::InvalidStreamId)
+  {
+    const auto texDesc = resource->GetDesc();
+    entry.memorySize = GetGfxDevice()->GetD3D12Device()->GetResourceAllocationInfo(0, 1, &texDesc).SizeInBytes;
+  }
+  m_memorySize += entry.memorySize;
+  return handle;
+}
+
+uint32_t TextureManager::CreatePack(ComPtr<ID3D12Resource1> resource)
+{
+  uint32_t packIndex = 0;
+  while (packIndex < m_packs.size() && m_packs[packIndex].resource)
+  {
+    ++packIndex;
+  }
+  if (packIndex == m_packs.size())
+  {
+    m_packs.emplace_back();
+  }
+  // メンバー数は CreatePackedEntry で数える.
+  auto& pack = m_packs[packIndex];
+  const auto texDesc = resource->GetDesc();
+  pack.resource = resource;
+  pack.srvDescriptor = CreateView(resource);
+  pack.memorySize = GetGfxDevice()->GetD3D12Device()->GetResourceAllocationInfo(0, 1, &texDesc).SizeInBytes;
+  pack.memberCount = 0;
+  m_memorySize += pack.memorySize;
+  m_packCount++;
+  return packIndex;
+}
+
+TextureManager::TextureHandle TextureManager::CreatePackedEntry(const ContentKey& key, uint32_t packIndex, const TexturePackPlacement& placement)
+{
+  const auto handle = AllocateEntry(key);
+  auto& entry = m_textures[handle];
+  auto& pack = m_packs[packIndex];
+  entry.resource = pack.resource;
+  entry.srvDescriptor = pack.srvDescriptor;
+  entry.packIndex = packIndex;
+  entry.region = TextureRegion{
+    .arraySlice = placement.arraySlice,
+    .uvScale = { placement.uvScale[0], placement.uvScale[1] },
+    .uvBias = { placement.uvBias[0], placement.uvBias[1] },
+  };
+  pack.memberCount++;
+  m_packedTextureCount++;
+  return handle;
+}
+
+void TextureManager::Destroy(TextureHandle handle)
+{
+  auto& entry = m_textures[handle];
+  for (const auto& path : entry.paths)
+  {
+    m_pathTable.erase(path);
+  }
+  m_contentTable.erase(entry.contentKey);
+  m_memorySize -= entry.memorySize;
+  if (entry.streamId != TextureStreamer::InvalidStreamId)
+  {
+    GetTextureStreamer()->Unregister(entry.streamId);
+  }
+  if (entry.packIndex != InvalidPack)
+  {
+    // SRV はまとめた先のものを共有しているため、最後のメンバーの解放時に解放する.
+    m_packedTextureCount--;
+    auto& pack = m_packs[entry.packIndex];
+    if (--pack.memberCount == 0)
+    {
+      if (auto& gfxDevice = GetGfxDevice(); gfxDevice && pack.srvDescriptor.hCpu.ptr != 0)
+      {
+        gfxDevice->DeallocateDescriptor(pack.srvDescriptor);
+      }
+      m_memorySize -= pack.memorySize;
+      m_packCount--;
+      pack = PackEntry{};
+    }
+  }
+  else if (auto& gfxDevice = GetGfxDevice(); gfxDevice && entry.srvDescriptor.hCpu.ptr != 0)
+  {
+    gfxDevice->DeallocateDescriptor(entry.srvDescriptor);
+  }
+  entry = TextureEntry{};
+  m_freeHandles.push_back(handle);
+}
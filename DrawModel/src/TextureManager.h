@@ -0,0 +1,158 @@
+﻿#pragma once
+#include <memory>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <filesystem>
+#include <cstdint>
+
+#include "GfxDevice.h"
+#include "TextureDecode.h"
+#include "TextureStreamer.h"
+#include "TexturePacker.h"
+
+// 読み込んだテクスチャを共有するための管理クラス.
+// 正規化したファイルパスをキーとし、別名で同じ内容のファイルも内容のハッシュ値で検出する.
+// 各テクスチャは参照カウントを持ち、Release で 0 になった時点で解放される.
+// GPU が使用中のテクスチャを解放しないよう、Release の呼び出し側で同期を取ること.
+class TextureManager
+{
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+public:
+  using TextureHandle = uint32_t;
+  static const TextureHandle InvalidHandle = ~0u;
+
+  // 読み込み元. filePath が空の場合は srcBuffer の内容から作成する.
+  struct LoadSource
+  {
+    std::filesystem::path filePath;
+    const void* srcBuffer = nullptr;
+    size_t bufferSize = 0;
+    // 同じ内容で設定が異なる場合は先に読み込んだものが使われる.
+    bool generateMips = false;
+    MipGenerateOptions mipOptions;
+    // TextureStreamer に登録し、詳細なミップレベルを必要に応じて転送する(非対応の環境では通常通り作成する).
+    bool streaming = false;
+    // 小さいものはアトラスに、同じ大きさ・形式のものはテクスチャ配列にまとめてよい.
+    // streaming と併用した場合、アトラスに入る大きさのものはストリーミングせずにまとめる.
+    bool packable = false;
+  };
+  // まとめたテクスチャ内での位置. uv * uvScale + uvBias と arraySlice で参照する.
+  // SRV は全て Texture2DArray として作成するため、まとめていないものは arraySlice = 0 とそのままの UV で参照できる.
+  struct TextureRegion
+  {
+    uint32_t arraySlice = 0;
+    float uvScale[2] = { 1.0f, 1.0f };
+    float uvBias[2] = { 0.0f, 0.0f };
+    bool IsAtlas() const { return uvScale[0] != 1.0f || uvScale[1] != 1.0f; }
+  };
+  // 複数のテクスチャをまとめて取得する. 読み込み済みであれば参照カウントを増やして返す.
+  // 読み込みと展開・ミップマップ作成はジョブシステムで並列に行い、GPU への転送はまとめて行う.
+  std::vector<TextureHandle> LoadBatch(const std::vector<LoadSource>& sources);
+
+  // ファイルからテクスチャを取得する.
+  TextureHandle Load(const std::filesystem::path& filePath, bool generateMips = false);
+  // メモリ上のデータからテクスチャを取得する. 内容のハッシュ値で重複を判定する.
+  TextureHandle LoadFromMemory(const void* srcBuffer, size_t bufferSize, bool generateMips = false);
+  void AddRef(TextureHandle handle);
+  void Release(TextureHandle handle);
+  // 全テクスチャを参照カウントに関係なく解放する.
+  void Clear();
+
+  ComPtr<ID3D12Resource1> GetResource(TextureHandle handle) const;
+  GfxDevice::DescriptorHandle GetShaderResourceView(TextureHandle handle) const;
+  // ストリーミングしていないテクスチャは TextureStreamer::InvalidStreamId.
+  TextureStreamer::StreamId GetStreamId(TextureHandle handle) const;
+  // まとめたものは同じグループ内で GetResource, GetShaderResourceView が同じものを返す.
+  TextureRegion GetRegion(TextureHandle handle) const;
+
+  // 統計情報.
+  size_t GetTextureCount() const { return m_textures.size() - m_freeHandles.size(); }
+  uint32_t GetRequestCount() const { return m_requestCount; }
+  uint32_t GetLoadCount() const { return m_loadCount; }
+  // 保持しているテクスチャのビデオメモリ使用量(バイト). ストリーミングするものは TextureStreamer 側で集計する.
+  uint64_t GetMemorySize() const { return m_memorySize; }
+  // まとめたテクスチャの数と、まとめた先のリソース数.
+  uint32_t GetPackedTextureCount() const { return m_packedTextureCount; }
+  uint32_t GetPackCount() const { return m_packCount; }
+
+  // 直近の LoadBatch の処理時間.
+  struct LoadStats
+  {
+    TextureDecodeStats decode;
+    double readMs = 0;    // ファイル読み込みとハッシュ計算.
+    double uploadMs = 0;  // GPU への転送.
+  };
+  const LoadStats& GetLastLoadStats() const { return m_lastLoadStats; }
+
+  // 対応環境では単純平均のミップマップを GPU で作成する(sRGB やカバレッジ維持は CPU で作成).
+  void SetUseGpuMipGeneration(bool enable) { m_useGpuMipGeneration = enable; }
+  bool GetUseGpuMipGeneration() const { return m_useGpuMipGeneration; }
+  // LoadSource::packable のものをまとめるか. 次の読み込みから反映される.
+  void SetUseTexturePacking(bool enable) { m_useTexturePacking = enable; }
+  bool GetUseTexturePacking() const { return m_useTexturePacking; }
+  void SetPackSettings(const TexturePackSettings& settings) { m_packSettings = settings; }
+  const TexturePackSettings& GetPackSettings() const { return m_packSettings; }
+
+  ~TextureManager() { Clear(); }
+private:
+  struct ContentKey
+  {
+    uint64_t hash = 0;
+    uint64_t size = 0;
+    bool operator==(const ContentKey& other) const { return hash == other.hash && size == other.size; }
+  };
+  struct ContentKeyHash
+  {
+    size_t operator()(const ContentKey& key) const { return size_t(key.hash ^ (key.size * 0x9E3779B97F4A7C15ull)); }
+  };
+  // まとめた先のリソース. 全てのメンバーが解放された時点で解放する.
+  static const uint32_t InvalidPack = ~0u;
+  struct PackEntry
+  {
+    ComPtr<ID3D12Resource1> resource;
+    GfxDevice::DescriptorHandle srvDescriptor{};
+    uint64_t memorySize = 0;
+    uint32_t memberCount = 0;
+  };
+  struct TextureEntry
+  {
+    ComPtr<ID3D12Resource1> resource;
+    GfxDevice::DescriptorHandle srvDescriptor{};
+    uint32_t refCount = 0;
+    ContentKey contentKey;
+    uint64_t memorySize = 0;
+    TextureStreamer::StreamId streamId = TextureStreamer::InvalidStreamId;
+    uint32_t packIndex = InvalidPack;  // まとめた先の m_packs のインデックス. resource と SRV はそちらと共有する.
+    TextureRegion region;
+    std::vector<std::string> paths;  // このテクスチャを指すパス(別名も含む).
+  };
+
+  static std::string NormalizePath(const std::filesystem::path& filePath);
+  static ContentKey ComputeContentKey(const void* data, size_t size);
+  static GfxDevice::DescriptorHandle CreateView(ComPtr<ID3D12Resource1> resource);
+  TextureHandle AllocateEntry(const ContentKey& key);
+  TextureHandle CreateEntry(const ContentKey& key, ComPtr<ID3D12Resource1> resource,
+    TextureStreamer::StreamId streamId = TextureStreamer::InvalidStreamId);
+  uint32_t CreatePack(ComPtr<ID3D12Resource1> resource);
+  TextureHandle CreatePackedEntry(const ContentKey& key, uint32_t packIndex, const TexturePackPlacement& placement);
+  void Destroy(TextureHandle handle);
+
+  std::vector<TextureEntry> m_textures;
+  std::vector<TextureHandle> m_freeHandles;
+  std::vector<PackEntry> m_packs;
+  std::unordered_map<std::string, TextureHandle> m_pathTable;
+  std::unordered_map<ContentKey, TextureHandle, ContentKeyHash> m_contentTable;
+  uint32_t m_requestCount = 0;
+  uint32_t m_loadCount = 0;
+  uint64_t m_memorySize = 0;
+  uint32_t m_packedTextureCount = 0;
+  uint32_t m_packCount = 0;
+  LoadStats m_lastLoadStats;
+  bool m_useGpuMipGeneration = true;
+  bool m_useTexturePacking = true;
+  TexturePackSettings m_packSettings;
+};
+
+std::unique_ptr<TextureManager>& GetTextureManager();
@@ -0,0 +1,425 @@
+﻿#include "TextureStreamer.h"
+#include "TextureUtility.h"
+#include "UploadRing.h"
+
+#include <algorithm>
+#include <cstring>
+
+static std::unique_ptr<TextureStreamer> gTextureStreamer = nullptr;
+
+std::unique_ptr<TextureStreamer>& GetTextureStreamer()
+{
+  if (gTextureStreamer == nullptr)
+  {
+    gTextureStreamer = std::make_unique<TextureStreamer>();
+  }
+  return gTextureStreamer;
+}
+
+void TextureStreamer::Initialize(uint64_t budgetBytes)
+{
+  auto d3d12Device = GetGfxDevice()->GetD3D12Device();
+  D3D12_FEATURE_DATA_D3D12_OPTIONS options{};
+  d3d12Device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options));
+  if (options.TiledResourcesTier == D3D12_TILED_RESOURCES_TIER_NOT_SUPPORTED)
+  {
+    return;
+  }
+
+  const uint64_t tileSize = D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+  const auto tileCount = uint32_t((budgetBytes + tileSize - 1) / tileSize);
+  D3D12_HEAP_DESC heapDesc{
+    .SizeInBytes = tileCount * tileSize,
+    .Properties = {
+      .Type = D3D12_HEAP_TYPE_DEFAULT,
+      .CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN,
+      .MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN,
+      .CreationNodeMask = 0, .VisibleNodeMask = 0,
+    },
+    .Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT,
+    .Flags = D3D12_HEAP_FLAG_DENY_BUFFERS | D3D12_HEAP_FLAG_DENY_RT_DS_TEXTURES,
+  };
+  if (FAILED(d3d12Device->CreateHeap(&heapDesc, IID_PPV_ARGS(&m_tileHeap))))
+  {
+    m_tileHeap.Reset();
+    return;
+  }
+  m_tileCount = tileCount;
+  // 末尾から取り出すため、先頭のタイルから使われるよう逆順に積む.
+  m_freeTiles.resize(tileCount);
+  for (uint32_t i = 0; i < tileCount; ++i)
+  {
+    m_freeTiles[i] = tileCount - 1 - i;
+  }
+  m_settings.budget = GetHeapSize();
+}
+
+void TextureStreamer::Shutdown()
+{
+  m_textures.clear();
+  m_policy = TextureResidencyPolicy{};
+  for (auto& buffers : m_stagingBuffers)
+  {
+    buffers.clear();
+  }
+  m_freeTiles.clear();
+  m_tileCount = 0;
+  m_tileHeap.Reset();
+}
+
+std::vector<TextureStreamer::StreamId> TextureStreamer::Register(
+  const std::vector<std::shared_ptr<const DecodedImage>>& images,
+  std::vector<ComPtr<ID3D12Resource1>>& outResources)
+{
+  std::vector<StreamId> ids(images.size(), InvalidStreamId);
+  outResources.assign(images.size(), nullptr);
+  if (!IsSupported())
+  {
+    return ids;
+  }
+  auto& gfxDevice = GetGfxDevice();
+  auto d3d12Device = gfxDevice->GetD3D12Device();
+  const UINT64 tileSize = D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+
+  auto commandList = gfxDevice->CreateCommandList();
+  std::vector<ComPtr<ID3D12Resource1>> stagingBuffers;
+  for (size_t i = 0; i < images.size(); ++i)
+  {
+    const auto& image = images[i];
+    if (image == nullptr || image->GetMipLevelCount() == 0)
+    {
+      continue;
+    }
+    const auto mipCount = image->GetMipLevelCount();
+    D3D12_RESOURCE_DESC texDesc{
+      .Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D,
+      .Alignment = 0,
+      .Width = image->GetWidth(), .Height = image->GetHeight(), .DepthOrArraySize = 1,
+      .MipLevels = UINT16(mipCount),
+      .Format = GetTextureFormat(image->format, image->srgb),
+      .SampleDesc = {.Count = 1, .Quality = 0 },
+      .Layout = D3D12_TEXTURE_LAYOUT_64KB_UNDEFINED_SWIZZLE,
+      .Flags = D3D12_RESOURCE_FLAG_NONE,
+    };
+    ComPtr<ID3D12Resource> resource;
+    if (FAILED(d3d12Device->CreateReservedResource(&texDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&resource))))
+    {
+      continue;
+    }
+
+    StreamTexture texture;
+    texture.image = image;
+    resource.As(&texture.resource);
+    texture.tilings.resize(mipCount);
+    UINT totalTileCount = 0;
+    UINT subresourceCount = mipCount;
+    d3d12Device->GetResourceTiling(resource.Get(), &totalTileCount, &texture.packedMipInfo, nullptr,
+      &subresourceCount, 0, texture.tilings.data());
+
+    // パックされたレベル(タイル未満の大きさのもの)は常に常駐させ、作成直後から描画できるようにする.
+    const uint32_t tailMip = texture.packedMipInfo.NumStandardMips;
+    if (texture.packedMipInfo.NumTilesForPackedMips > 0)
+    {
+      if (!AllocateTiles(texture.packedMipInfo.NumTilesForPackedMips, texture.packedTiles))
+      {
+        continue;
+      }
+      MapTiles(texture.resource.Get(), tailMip, texture.packedTiles);
+    }
+    texture.mipTiles.resize(mipCount);
+    texture.mipStates.assign(mipCount, D3D12_RESOURCE_STATE_COPY_DEST);
+    texture.residentMip = tailMip;
+
+    std::vector<uint32_t> packedMips;
+    std::vector<uint64_t> mipSizes(mipCount, 0);
+    for (uint32_t mip = 0; mip < mipCount; ++mip)
+    {
+      if (mip < tailMip)
+      {
+        const auto& tiling = texture.tilings[mip];
+        mipSizes[mip] = uint64_t(tiling.WidthInTiles) * tiling.HeightInTiles * tiling.DepthInTiles * tileSize;
+      }
+      else
+      {
+        packedMips.push_back(mip);
+      }
+    }
+    if (tailMip < mipCount)
+    {
+      mipSizes[tailMip] = uint64_t(texture.packedMipInfo.NumTilesForPackedMips) * tileSize;
+    }
+    RecordUpload(commandList, texture, packedMips, stagingBuffers);
+
+    const auto id = m_policy.Add(mipSizes, tailMip);
+    if (id >= m_textures.size())
+    {
+      m_textures.resize(id + 1);
+    }
+    outResources[i] = texture.resource;
+    m_textures[id] = std::move(texture);
+    ids[i] = id;
+  }
+  commandList->Close();
+  gfxDevice->Submit(commandList.Get());
+  GetUploadRing()->Signal();
+  gfxDevice->WaitForGPU();
+  return ids;
+}
+
+void TextureStreamer::Unregister(StreamId id)
+{
+  if (id == InvalidStreamId || id >= m_textures.size())
+  {
+    return;
+  }
+  auto& texture = m_textures[id];
+  for (auto& tiles : texture.mipTiles)
+  {
+    FreeTiles(tiles);
+  }
+  FreeTiles(texture.packedTiles);
+  texture = StreamTexture{};
+  m_policy.Remove(id);
+}
+
+void TextureStreamer::Request(StreamId id, uint32_t mip)
+{
+  if (id != InvalidStreamId)
+  {
+    m_policy.Request(id, mip);
+  }
+}
+
+void TextureStreamer::Update()
+{
+  if (!IsSupported())
+  {
+    return;
+  }
+  auto& gfxDevice = GetGfxDevice();
+  auto& stagingBuffers = m_stagingBuffers[gfxDevice->GetFrameIndex()];
+  stagingBuffers.clear();
+
+  std::vector<TextureResidencyPolicy::Operation> evictions, loads;
+  m_policy.Update(m_settings, evictions, loads);
+  m_lastEvictionCount = uint32_t(evictions.size());
+  m_lastLoadCount = uint32_t(loads.size());
+
+  // 破棄するレベルは今フレームから参照しないため、すぐにタイルを外してよい.
+  // 前のフレームのコマンドはキュー上で先に実行されるため、使用中のタイルを外すことはない.
+  for (const auto& eviction : evictions)
+  {
+    auto& texture = m_textures[eviction.id];
+    auto& tiles = texture.mipTiles[eviction.mip];
+    UnmapTiles(texture.resource.Get(), eviction.mip, UINT(tiles.size()));
+    FreeTiles(tiles);
+    texture.residentMip = std::max(texture.residentMip, eviction.mip + 1);
+  }
+  if (loads.empty())
+  {
+    return;
+  }
+
+  // 転送コマンドは今フレームの描画より先に実行されるため、読み込んだレベルは今フレームから参照できる.
+  auto commandList = gfxDevice->CreateCommandList();
+  for (const auto& load : loads)
+  {
+    auto& texture = m_textures[load.id];
+    const auto& tiling = texture.tilings[load.mip];
+    const auto tileCount = tiling.WidthInTiles * tiling.HeightInTiles * tiling.DepthInTiles;
+    if (!AllocateTiles(tileCount, texture.mipTiles[load.mip]))
+    {
+      // 予算はヒープの容量以下に制限しているため、通常は起こらない. 粗いレベルのまま描画する.
+      continue;
+    }
+    MapTiles(texture.resource.Get(), load.mip, texture.mipTiles[load.mip]);
+    RecordUpload(commandList, texture, { load.mip }, stagingBuffers);
+    texture.residentMip = load.mip;
+  }
+  commandList->Close();
+  gfxDevice->Submit(commandList.Get());
+  GetUploadRing()->Signal();
+}
+
+float TextureStreamer::GetMinLod(StreamId id) const
+{
+  if (id == InvalidStreamId || id >= m_textures.size())
+  {
+    return 0.0f;
+  }
+  return float(m_textures[id].residentMip);
+}
+
+uint32_t TextureStreamer::GetMipLevelCount(StreamId id) const
+{
+  if (id == InvalidStreamId || id >= m_textures.size() || m_textures[id].image == nullptr)
+  {
+    return 0;
+  }
+  return m_textures[id].image->GetMipLevelCount();
+}
+
+void TextureStreamer::SetBudget(uint64_t budgetBytes)
+{
+  m_settings.budget = std::min(budgetBytes, GetHeapSize());
+}
+
+bool TextureStreamer::AllocateTiles(uint32_t count, std::vector<uint32_t>& outTiles)
+{
+  if (m_freeTiles.size() < count)
+  {
+    return false;
+  }
+  outTiles.assign(m_freeTiles.end() - count, m_freeTiles.end());
+  m_freeTiles.resize(m_freeTiles.size() - count);
+  return true;
+}
+
+void TextureStreamer::FreeTiles(std::vector<uint32_t>& tiles)
+{
+  m_freeTiles.insert(m_freeTiles.end(), tiles.begin(), tiles.end());
+  tiles.clear();
+}
+
+void TextureStreamer::MapTiles(ID3D12Resource* resource, UINT subresource, const std::vector<uint32_t>& tiles)
+{
+  D3D12_TILED_RESOURCE_COORDINATE coordinate{ .X = 0, .Y = 0, .Z = 0, .Subresource = subresource };
+  D3D12_TILE_REGION_SIZE regionSize{ .NumTiles = UINT(tiles.size()), .UseBox = FALSE };
+  // ヒープ上のタイルは連続しているとは限らないため、1タイルずつの範囲で指定する.
+  std::vector<D3D12_TILE_RANGE_FLAGS> rangeFlags(tiles.size(), D3D12_TILE_RANGE_FLAG_NONE);
+  std::vector<UINT> rangeTileCounts(tiles.size(), 1);
+  GetGfxDevice()->GetD3D12CommandQueue()->UpdateTileMappings(
+    resource, 1, &coordinate, &regionSize,
+    m_tileHeap.Get(), UINT(tiles.size()), rangeFlags.data(), tiles.data(), rangeTileCounts.data(),
+    D3D12_TILE_MAPPING_FLAG_NONE);
+}
+
+void TextureStreamer::UnmapTiles(ID3D12Resource* resource, UINT subresource, UINT tileCount)
+{
+  if (tileCount == 0)
+  {
+    return;
+  }
+  D3D12_TILED_RESOURCE_COORDINATE coordinate{ .X = 0, .Y = 0, .Z = 0, .Subresource = subresource };
+  D3D12_TILE_REGION_SIZE regionSize{ .NumTiles = tileCount, .UseBox = FALSE };
+  D3D12_TILE_RANGE_FLAGS rangeFlag = D3D12_TILE_RANGE_FLAG_NULL;
+  GetGfxDevice()->GetD3D12CommandQueue()->UpdateTileMappings(
+    resource, 1, &coordinate, &regionSize,
+    nullptr, 1, &rangeFlag, nullptr, &tileCount,
+    D3D12_TILE_MAPPING_FLAG_NONE);
+}
+
+void TextureStreamer::RecordUpload(ComPtr<ID3D12GraphicsCommandList> commandList, StreamTexture& texture,
+  const std::vector<uint32_t>& mips, std::vector<ComPtr<ID3D12Resource1>>& stagingBuffers)
+{
+  if (mips.empty())
+  {
+    return;
+  }
+  auto& gfxDevice = GetGfxDevice();
+  auto d3d12Device = gfxDevice->GetD3D12Device();
+  const auto texDesc = texture.resource->GetDesc();
+  const auto& image = *texture.image;
+
+  // レベルごとのフットプリントを並べてステージングバッファの大きさを決める.
+  std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints(mips.size());
+  std::vector<UINT> numRows(mips.size());
+  std::vector<UINT64> rowSizeInBytes(mips.size());
+  UINT64 totalSize = 0;
+  for (size_t i = 0; i < mips.size(); ++i)
+  {
+    UINT64 requiredSize = 0;
+    d3d12Device->GetCopyableFootprints(&texDesc, mips[i], 1, 0, &footprints[i], &numRows[i], &rowSizeInBytes[i], &requiredSize);
+    footprints[i].Offset = totalSize;
+    totalSize += requiredSize;
+    totalSize = (totalSize + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) & ~UINT64(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
+  }
+
+  D3D12_RESOURCE_DESC resDesc{
+    .Dimension = D3D12_RESOURCE_DIMENSION_BUFFER,
+    .Alignment = 0,
+    .Width = totalSize, .Height = 1, .DepthOrArraySize = 1, .MipLevels = 1,
+    .Format = DXGI_FORMAT_UNKNOWN,
+    .SampleDesc = {.Count = 1, .Quality = 0 },
+    .Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR,
+    .Flags = D3D12_RESOURCE_FLAG_NONE,
+  };
+  // 通常はアップロードリングから確保し、収まらない場合のみフレームごとのステージングバッファを作成する.
+  UploadRing::Allocation allocation;
+  ComPtr<ID3D12Resource1> staging;
+  if (!GetUploadRing()->Allocate(totalSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, allocation))
+  {
+    staging = gfxDevice->CreateBuffer(resDesc, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr);
+    void* mapped = nullptr;
+    staging->Map(0, nullptr, &mapped);
+    allocation = UploadRing::Allocation{
+      .resource = staging.Get(),
+      .offset = 0,
+      .cpuAddress = reinterpret_cast<BYTE*>(mapped),
+    };
+  }
+  auto destBase = allocation.cpuAddress;
+  for (size_t i = 0; i < mips.size(); ++i)
+  {
+    const auto mip = mips[i];
+    auto* dst = destBase + footprints[i].Offset;
+    auto* src = image.GetLevelData(mip);
+    const auto srcPitch = image.mipLevels[mip].rowPitch;
+    for (UINT row = 0; row < numRows[i]; ++row)
+    {
+      memcpy(dst + size_t(row) * footprints[i].Footprint.RowPitch, src + size_t(row) * srcPitch, size_t(rowSizeInBytes[i]));
+    }
+  }
+  if (staging)
+  {
+    staging->Unmap(0, nullptr);
+    stagingBuffers.push_back(staging);
+  }
+  for (auto& footprint : footprints)
+  {
+    footprint.Offset += allocation.offset;
+  }
+
+  auto makeBarrier = [&](uint32_t mip, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after) {
+    return D3D12_RESOURCE_BARRIER{
+      .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+      .Transition = {
+        .pResource = texture.resource.Get(),
+        .Subresource = mip,
+        .StateBefore = before,
+        .StateAfter = after,
+      }
+    };
+  };
+  std::vector<D3D12_RESOURCE_BARRIER> barriers;
+  for (auto mip : mips)
+  {
+    if (texture.mipStates[mip] != D3D12_RESOURCE_STATE_COPY_DEST)
+    {
+      barriers.push_back(makeBarrier(mip, texture.mipStates[mip], D3D12_RESOURCE_STATE_COPY_DEST));
+    }
+  }
+  if (!barriers.empty())
+  {
+    commandList->ResourceBarrier(UINT(barriers.size()), barriers.data());
+  }
+
+  barriers.clear();
+  for (size_t i = 0; i < mips.size(); ++i)
+  {
+    D3D12_TEXTURE_COPY_LOCATION dstLoc{
+      .pResource = texture.resource.Get(),
+      .Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX,
+      .SubresourceIndex = mips[i],
+    };
+    D3D12_TEXTURE_COPY_LOCATION srcLoc{
+      .pResource = allocation.resource,
+      .Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT,
+      .PlacedFootprint = footprints[i],
+    };
+    commandList->CopyTextureRegion(&dstLoc, 0, 0, 0, &srcLoc, nullptr);
+    barriers.push_back(makeBarrier(mips[i], D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+    texture.mipStates[mips[i]] = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+  }
+  commandList->ResourceBarrier(UINT(barriers.size()), barriers.data());
+}
@@ -0,0 +1,85 @@
+﻿#pragma once
+#include <memory>
+#include <vector>
+#include "GfxDevice.h"
+#include "TextureDecode.h"
+#include "TextureResidency.h"
+
+// 予約リソース(タイルリソース)によるテクスチャのミップレベルストリーミング.
+// 作成時はパックされた末尾の小さいレベルのみを転送し、詳細なレベルは要求に応じてタイルを割り当てて転送する.
+// タイルは予算分を確保したヒープから割り当て、TextureResidencyPolicy の判定に従って割り当て・解除する.
+// 未転送のレベルを参照しないよう、シェーダーでは GetMinLod の値で LOD を制限すること.
+class TextureStreamer
+{
+  template<class T>
+  using ComPtr = Microsoft::WRL::ComPtr<T>;
+public:
+  using StreamId = TextureResidencyPolicy::TextureId;
+  static const StreamId InvalidStreamId = TextureResidencyPolicy::InvalidId;
+
+  // budgetBytes 分のタイルヒープを確保する. タイルリソース非対応の環境では何もしない.
+  void Initialize(uint64_t budgetBytes);
+  void Shutdown();
+  bool IsSupported() const { return m_tileHeap != nullptr; }
+
+  // 全ミップレベルを持つイメージから予約リソースを作成する. 転送はまとめて行い、完了まで待つ.
+  // イメージは詳細なレベルの転送元として登録解除まで保持される.
+  std::vector<StreamId> Register(
+    const std::vector<std::shared_ptr<const DecodedImage>>& images,
+    std::vector<ComPtr<ID3D12Resource1>>& outResources);
+  // GPU が使用中でないことを呼び出し側で保証すること.
+  void Unregister(StreamId id);
+
+  // 今フレームで必要な最も詳細なレベルを要求する.
+  void Request(StreamId id, uint32_t mip);
+  // フレームの描画コマンドを発行する前に呼ぶ. タイルの割り当て変更と転送コマンドを発行する.
+  void Update();
+
+  // シェーダーで参照してよい最も詳細なレベル.
+  float GetMinLod(StreamId id) const;
+  uint32_t GetMipLevelCount(StreamId id) const;
+
+  void SetBudget(uint64_t budgetBytes);
+  uint64_t GetBudget() const { return m_settings.budget; }
+  uint64_t GetHeapSize() const { return uint64_t(m_tileCount) * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES; }
+  uint64_t GetResidentSize() const { return m_policy.GetResidentSize(); }
+  uint32_t GetLastLoadCount() const { return m_lastLoadCount; }
+  uint32_t GetLastEvictionCount() const { return m_lastEvictionCount; }
+
+private:
+  struct StreamTexture
+  {
+    std::shared_ptr<const DecodedImage> image;
+    ComPtr<ID3D12Resource1> resource;
+    D3D12_PACKED_MIP_INFO packedMipInfo{};
+    std::vector<D3D12_SUBRESOURCE_TILING> tilings;
+    std::vector<std::vector<uint32_t>> mipTiles;  // レベルごとに割り当てたヒープ内のタイル番号.
+    std::vector<uint32_t> packedTiles;
+    std::vector<D3D12_RESOURCE_STATES> mipStates;
+    uint32_t residentMip = 0;
+  };
+
+  bool AllocateTiles(uint32_t count, std::vector<uint32_t>& outTiles);
+  void FreeTiles(std::vector<uint32_t>& tiles);
+  void MapTiles(ID3D12Resource* resource, UINT subresource, const std::vector<uint32_t>& tiles);
+  void UnmapTiles(ID3D12Resource* resource, UINT subresource, UINT tileCount);
+  // mips のレベルをステージングバッファ経由で転送するコマンドを記録する.
+  void RecordUpload(ComPtr<ID3D12GraphicsCommandList> commandList, StreamTexture& texture,
+    const std::vector<uint32_t>& mips, std::vector<ComPtr<ID3D12Resource1>>& stagingBuffers);
+
+  ComPtr<ID3D12Heap> m_tileHeap;
+  uint32_t m_tileCount = 0;
+  std::vector<uint32_t> m_freeTiles;
+
+  TextureResidencyPolicy m_policy;
+  TextureResidencyPolicy::Settings m_settings;
+  std::vector<StreamTexture> m_textures;  // StreamId でアクセスする.
+
+  // アップロードリングに収まらなかった場合のフレームごとのステージングバッファ.
+  // 同じフレームインデックスが再び来た時点で GPU の処理は完了している.
+  std::vector<ComPtr<ID3D12Resource1>> m_stagingBuffers[GfxDevice::BackBufferCount];
+  uint32_t m_lastLoadCount = 0;
+  uint32_t m_lastEvictionCount = 0;
+};
+
+std::unique_ptr<TextureStreamer>& GetTextureStreamer();
@@ -36,6 +36,7 @@ void MyApplication::Initialize()
 {
   auto& gfxDevice = GetGfxDevice();
   GfxDevice::DeviceInitParams initParams;
+  initParams.hwnd = Win32Application::GetHwnd();
   initParams.formatDesired = DXGI_FORMAT_R8G8B8A8_UNORM;
   gfxDevice->Initialize(initParams);
 